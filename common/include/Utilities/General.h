@@ -248,6 +248,14 @@ extern void MemProtect(void *baseaddr, size_t size, const PageProtectionMode &mo
 
 extern void Munmap(void *base, size_t size);
 
+// Memory objects that can be mapped at several places at once. CreateSharedMemory returns
+// NULL on failure (and on platforms without support), MapSharedMemory replaces whatever was
+// at baseaddr, which must lie in a range reserved with MmapReserve.
+extern void *CreateSharedMemory(size_t size);
+extern void DestroySharedMemory(void *handle);
+extern bool MapSharedMemory(void *handle, size_t offset, void *baseaddr, size_t size, const PageProtectionMode &mode);
+extern void UnmapSharedMemory(void *baseaddr, size_t size);
+
 template <uint size>
 void MemProtectStatic(u8 (&arr)[size], const PageProtectionMode &mode)
 {
@@ -30,10 +30,12 @@
 struct PageFaultInfo
 {
     uptr addr;
+    uptr pc; // faulting instruction, 0 if the platform doesn't provide it
 
-    PageFaultInfo(uptr address)
+    PageFaultInfo(uptr address, uptr instruction = 0)
     {
         addr = address;
+        pc = instruction;
     }
 };
 
@@ -107,15 +109,40 @@ protected:
 
 protected:
     bool m_handled;
+    bool m_can_step;
+    uptr m_resume_pc;
 
 public:
+    typedef void StepCallback(uptr param);
+
     SrcType_PageFault()
         : m_handled(false)
+        , m_can_step(false)
+        , m_resume_pc(0)
     {
     }
     virtual ~SrcType_PageFault() = default;
 
     bool WasHandled() const { return m_handled; }
+
+    // A handler that rewrote the faulting code can continue somewhere else instead of
+    // re-executing the instruction. Only honoured when the fault provided a pc.
+    void ResumeAt(uptr pc) { m_resume_pc = pc; }
+    uptr GetResumePc() const { return m_resume_pc; }
+
+    // A handler that lifted a protection for the faulting access only can have it put back
+    // right after: the instruction is single-stepped and the callback runs from the trap
+    // that follows it. Returns false when the platform can't step, or too many steps are
+    // already waiting on this thread (an instruction faulting on several pages).
+    bool StepThen(StepCallback *callback, uptr param);
+    bool CanStep() const { return m_can_step; }
+    void EnableStep(bool enable) { m_can_step = enable; }
+
+    // For the platform handlers: BeginStep after a handled fault tells whether to set the
+    // trap flag, EndStep on a single-step trap whether it was ours (it then ran the callbacks).
+    bool BeginStep();
+    bool EndStep();
+
     virtual void Dispatch(const PageFaultInfo &params);
 
 protected:
@@ -311,6 +338,11 @@ extern long __stdcall SysPageFaultExceptionFilter(struct _EXCEPTION_POINTERS *ep
 extern void pxInstallSignalHandler();
 extern void _platform_InstallSignalHandler();
 
+// Single-stepping takes over the trap the debuggers use, so it stays off unless asked for.
+// The platform part returns whether stepping is available afterwards.
+extern void pxEnableSingleStep(bool enable);
+extern bool _platform_EnableSingleStep(bool enable);
+
 #include "Threading.h"
 extern SrcType_PageFault *Source_PageFault;
 extern Threading::Mutex PageFault_Mutex;
@@ -44,6 +44,8 @@ struct xImpl_JmpCall
             pxAssertMsg(dest == (s32)dest, "Indirect jump is too far, must use a register!");
             xWrite8(0xe8);
             xWrite32(dest);
+            if (x86RelativeFieldHook)
+                x86RelativeFieldHook((s32 *)xGetPtr() - 1, xGetPtr());
         }
     }
 };
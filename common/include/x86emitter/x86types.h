@@ -65,6 +65,14 @@ enum XMMSSEType {
 extern __tls_emit u8 *x86Ptr;
 extern __tls_emit XMMSSEType g_xmmtypes[iREGCNT_XMM];
 
+// Lets a recompiler follow the displacements which depend on where the code is placed, so
+// the code can be moved afterwards. Called with each rip-relative operand, rel32 jump and
+// call field and the address it is relative to (NULL for an absolute disp32), or with a
+// NULL field and the new position when the emit pointer is set: anything recorded past it
+// was thrown away.
+typedef void xRelativeFieldHandler(s32 *field, const u8 *base);
+extern __tls_emit xRelativeFieldHandler *x86RelativeFieldHook;
+
 namespace x86Emitter
 {
 
@@ -19,10 +19,14 @@
 
 #include <wx/thread.h>
 
+#include <atomic>
+
 #include <sys/mman.h>
 #include <signal.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <ucontext.h>
 
 // Apple uses the MAP_ANON define instead of MAP_ANONYMOUS, but they mean
 // the same thing.
@@ -32,10 +36,52 @@
 
 extern void SignalExit(int sig);
 
-static const uptr m_pagemask = getpagesize() - 1;
+// Instruction pointer and flags of the interrupted context, so that the handlers can tell which
+// code faulted (and resume elsewhere, or single-step it).
+#if defined(__x86_64__) && defined(__APPLE__)
+#define UCONTEXT_PC(uc) ((uc)->uc_mcontext->__ss.__rip)
+#define UCONTEXT_FLAGS(uc) ((uc)->uc_mcontext->__ss.__rflags)
+#elif defined(__x86_64__) && defined(__FreeBSD__)
+#define UCONTEXT_PC(uc) ((uc)->uc_mcontext.mc_rip)
+#define UCONTEXT_FLAGS(uc) ((uc)->uc_mcontext.mc_rflags)
+#elif defined(__x86_64__)
+#define UCONTEXT_PC(uc) ((uc)->uc_mcontext.gregs[REG_RIP])
+#define UCONTEXT_FLAGS(uc) ((uc)->uc_mcontext.gregs[REG_EFL])
+#endif
+
+static const uptr X86_TRAP_FLAG = 0x100;
+
+#ifdef UCONTEXT_FLAGS
+static struct sigaction s_prev_sigtrap;
+
+// Single-step traps asked for by a page fault handler, anything else goes to whoever had
+// SIGTRAP before us.
+static void SysStepSignalFilter(int signal, siginfo_t *siginfo, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+
+    {
+        Threading::ScopedLock lock(PageFault_Mutex);
+        if (Source_PageFault->EndStep()) {
+            UCONTEXT_FLAGS(uc) &= ~X86_TRAP_FLAG;
+            return;
+        }
+    }
+
+    if (s_prev_sigtrap.sa_flags & SA_SIGINFO) {
+        s_prev_sigtrap.sa_sigaction(signal, siginfo, context);
+    } else if (s_prev_sigtrap.sa_handler == SIG_DFL) {
+        // delivered once we return, since SIGTRAP is blocked while in here
+        sigaction(SIGTRAP, &s_prev_sigtrap, NULL);
+        raise(SIGTRAP);
+    } else if (s_prev_sigtrap.sa_handler != SIG_IGN) {
+        s_prev_sigtrap.sa_handler(signal);
+    }
+}
+#endif
 
 // Linux implementation of SIGSEGV handler.  Bind it using sigaction().
-static void SysPageFaultSignalFilter(int signal, siginfo_t *siginfo, void *)
+static void SysPageFaultSignalFilter(int signal, siginfo_t *siginfo, void *context)
 {
     // [TODO] : Add a thread ID filter to the Linux Signal handler here.
     // Rationale: On windows, the __try/__except model allows per-thread specific behavior
@@ -59,12 +105,26 @@ static void SysPageFaultSignalFilter(int signal, siginfo_t *siginfo, void *)
     // so for now we lock this exception code unless someone can fix this better...
     Threading::ScopedLock lock(PageFault_Mutex);
 
-    Source_PageFault->Dispatch(PageFaultInfo((uptr)siginfo->si_addr & ~m_pagemask));
+#ifdef UCONTEXT_PC
+    ucontext_t *uc = (ucontext_t *)context;
+    Source_PageFault->Dispatch(PageFaultInfo((uptr)siginfo->si_addr, (uptr)UCONTEXT_PC(uc)));
+#else
+    Source_PageFault->Dispatch(PageFaultInfo((uptr)siginfo->si_addr));
+#endif
 
     // resumes execution right where we left off (re-executes instruction that
-    // caused the SIGSEGV).
-    if (Source_PageFault->WasHandled())
+    // caused the SIGSEGV), unless the handler moved it.
+    if (Source_PageFault->WasHandled()) {
+#ifdef UCONTEXT_PC
+        if (uptr resume = Source_PageFault->GetResumePc())
+            UCONTEXT_PC(uc) = resume;
+#endif
+#ifdef UCONTEXT_FLAGS
+        if (Source_PageFault->BeginStep())
+            UCONTEXT_FLAGS(uc) |= X86_TRAP_FLAG;
+#endif
         return;
+    }
 
     if (!wxThread::IsMain()) {
         pxFailRel(pxsFmt("Unhandled page fault @ 0x%08x", siginfo->si_addr));
@@ -94,6 +154,24 @@ void _platform_InstallSignalHandler()
 #endif
 }
 
+bool _platform_EnableSingleStep(bool enable)
+{
+#ifdef UCONTEXT_FLAGS
+    if (!enable) {
+        sigaction(SIGTRAP, &s_prev_sigtrap, NULL);
+        return false;
+    }
+
+    struct sigaction step;
+    sigemptyset(&step.sa_mask);
+    step.sa_flags = SA_SIGINFO;
+    step.sa_sigaction = SysStepSignalFilter;
+    return sigaction(SIGTRAP, &step, &s_prev_sigtrap) == 0;
+#else
+    return false;
+#endif
+}
+
 static __ri void PageSizeAssertionTest(size_t size)
 {
     pxAssertMsg((__pagesize == getpagesize()), pxsFmt(
@@ -218,6 +296,58 @@ void HostSys::Munmap(uptr base, size_t size)
     munmap((void *)base, size);
 }
 
+void *HostSys::CreateSharedMemory(size_t size)
+{
+    PageSizeAssertionTest(size);
+
+    // The name is only needed until the object is opened, unlinking it right away
+    // leaves nothing behind if we crash.
+    char name[64];
+    static std::atomic<u32> counter(0);
+    snprintf(name, sizeof(name), "/pcsx2_%d_%u", (int)getpid(), counter++);
+
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return nullptr;
+    shm_unlink(name);
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // fd 0 is a valid descriptor, keep null free for errors
+    return (void *)(uptr)(fd + 1);
+}
+
+void HostSys::DestroySharedMemory(void *handle)
+{
+    if (handle)
+        close((int)(uptr)handle - 1);
+}
+
+bool HostSys::MapSharedMemory(void *handle, size_t offset, void *baseaddr, size_t size, const PageProtectionMode &mode)
+{
+    PageSizeAssertionTest(size);
+
+    uint lnxmode = 0;
+    if (mode.CanWrite())
+        lnxmode |= PROT_WRITE;
+    if (mode.CanRead())
+        lnxmode |= PROT_READ;
+    if (mode.CanExecute())
+        lnxmode |= PROT_EXEC | PROT_READ;
+
+    void *result = mmap(baseaddr, size, lnxmode, MAP_SHARED | MAP_FIXED, (int)(uptr)handle - 1, offset);
+    return result == baseaddr;
+}
+
+void HostSys::UnmapSharedMemory(void *baseaddr, size_t size)
+{
+    // back to a reserved, inaccessible range
+    MmapResetPtr(baseaddr, size);
+}
+
 void HostSys::MemProtect(void *baseaddr, size_t size, const PageProtectionMode &mode)
 {
     if (!_memprotect(baseaddr, size, mode)) {
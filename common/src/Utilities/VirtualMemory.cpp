@@ -39,6 +39,15 @@ void pxInstallSignalHandler()
     // NOP on Win32 systems -- we use __try{} __except{} instead.
 }
 
+void pxEnableSingleStep(bool enable)
+{
+    if (enable == Source_PageFault->CanStep())
+        return;
+
+    Threading::ScopedLock lock(PageFault_Mutex);
+    Source_PageFault->EnableStep(_platform_EnableSingleStep(enable));
+}
+
 // --------------------------------------------------------------------------------------
 //  EventListener_PageFault  (implementations)
 // --------------------------------------------------------------------------------------
@@ -54,10 +63,61 @@ EventListener_PageFault::~EventListener_PageFault()
         Source_PageFault->Remove(*this);
 }
 
+// Steps asked for by the current fault, and the ones waiting for the trap on this thread
+struct PageFaultStep
+{
+    SrcType_PageFault::StepCallback *callback;
+    uptr param;
+};
+
+static const int MaxPendingSteps = 4;
+static DeclareTls(PageFaultStep) s_pending_steps[MaxPendingSteps];
+static DeclareTls(int) s_pending_count = 0;
+static DeclareTls(int) s_requested_count = 0;
+
 void SrcType_PageFault::Dispatch(const PageFaultInfo &params)
 {
     m_handled = false;
+    m_resume_pc = 0;
     _parent::Dispatch(params);
+
+    // Steps requested by a handler that didn't handle the fault in the end
+    if (!m_handled)
+        s_requested_count = 0;
+}
+
+bool SrcType_PageFault::StepThen(StepCallback *callback, uptr param)
+{
+    if (!m_can_step || s_pending_count + s_requested_count >= MaxPendingSteps)
+        return false;
+
+    PageFaultStep &step = s_pending_steps[s_pending_count + s_requested_count++];
+    step.callback = callback;
+    step.param = param;
+    return true;
+}
+
+bool SrcType_PageFault::BeginStep()
+{
+    if (!s_requested_count)
+        return false;
+
+    s_pending_count += s_requested_count;
+    s_requested_count = 0;
+    return true;
+}
+
+bool SrcType_PageFault::EndStep()
+{
+    if (!s_pending_count)
+        return false;
+
+    // Reset first, a callback is free to change protections again
+    const int count = s_pending_count;
+    s_pending_count = 0;
+    for (int i = 0; i < count; i++)
+        s_pending_steps[i].callback(s_pending_steps[i].param);
+    return true;
 }
 
 void SrcType_PageFault::_DispatchRaw(ListenerIterator iter, const ListenerIterator &iend, const PageFaultInfo &evt)
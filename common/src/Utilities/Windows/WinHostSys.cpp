@@ -19,8 +19,20 @@
 
 #include <winnt.h>
 
+static const DWORD X86_TRAP_FLAG = 0x100;
+
 static long DoSysPageFaultExceptionFilter(EXCEPTION_POINTERS *eps)
 {
+    // Single-step traps asked for by a page fault handler
+    if (eps->ExceptionRecord->ExceptionCode == EXCEPTION_SINGLE_STEP) {
+        Threading::ScopedLock lock(PageFault_Mutex);
+        if (!Source_PageFault->EndStep())
+            return EXCEPTION_CONTINUE_SEARCH;
+
+        eps->ContextRecord->EFlags &= ~X86_TRAP_FLAG;
+        return EXCEPTION_CONTINUE_EXECUTION;
+    }
+
     if (eps->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION)
         return EXCEPTION_CONTINUE_SEARCH;
 
@@ -28,8 +40,21 @@ static long DoSysPageFaultExceptionFilter(EXCEPTION_POINTERS *eps)
     // Source_PageFault is a global variable with its own state information
     // so for now we lock this exception code unless someone can fix this better...
     Threading::ScopedLock lock(PageFault_Mutex);
+#ifdef _WIN64
+    Source_PageFault->Dispatch(PageFaultInfo((uptr)eps->ExceptionRecord->ExceptionInformation[1], (uptr)eps->ContextRecord->Rip));
+#else
     Source_PageFault->Dispatch(PageFaultInfo((uptr)eps->ExceptionRecord->ExceptionInformation[1]));
-    return Source_PageFault->WasHandled() ? EXCEPTION_CONTINUE_EXECUTION : EXCEPTION_CONTINUE_SEARCH;
+#endif
+    if (!Source_PageFault->WasHandled())
+        return EXCEPTION_CONTINUE_SEARCH;
+
+#ifdef _WIN64
+    if (uptr resume = Source_PageFault->GetResumePc())
+        eps->ContextRecord->Rip = resume;
+#endif
+    if (Source_PageFault->BeginStep())
+        eps->ContextRecord->EFlags |= X86_TRAP_FLAG;
+    return EXCEPTION_CONTINUE_EXECUTION;
 }
 
 long __stdcall SysPageFaultExceptionFilter(EXCEPTION_POINTERS *eps)
@@ -54,6 +79,12 @@ void _platform_InstallSignalHandler()
 #endif
 }
 
+// Traps that aren't ours already go on to the debugger, there's nothing to install.
+bool _platform_EnableSingleStep(bool enable)
+{
+    return enable;
+}
+
 
 static DWORD ConvertToWinApi(const PageProtectionMode &mode)
 {
@@ -133,6 +164,26 @@ void HostSys::Munmap(uptr base, size_t size)
     VirtualFree((void *)base, 0, MEM_RELEASE);
 }
 
+// Mapping views into a range that is already reserved needs the placeholder API of
+// recent Windows 10 versions, until then nothing uses shared memory here.
+void *HostSys::CreateSharedMemory(size_t size)
+{
+    return nullptr;
+}
+
+void HostSys::DestroySharedMemory(void *handle)
+{
+}
+
+bool HostSys::MapSharedMemory(void *handle, size_t offset, void *baseaddr, size_t size, const PageProtectionMode &mode)
+{
+    return false;
+}
+
+void HostSys::UnmapSharedMemory(void *baseaddr, size_t size)
+{
+}
+
 void HostSys::MemProtect(void *baseaddr, size_t size, const PageProtectionMode &mode)
 {
     pxAssertDev(((size & (__pagesize - 1)) == 0), pxsFmt(
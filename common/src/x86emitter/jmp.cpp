@@ -142,7 +142,10 @@ __emitinline s32 *xJcc32(JccComparisonType comparison, s32 displacement)
     }
     xWrite<s32>(displacement);
 
-    return ((s32 *)xGetPtr()) - 1;
+    s32 *field = ((s32 *)xGetPtr()) - 1;
+    if (x86RelativeFieldHook)
+        x86RelativeFieldHook(field, xGetPtr());
+    return field;
 }
 
 // ------------------------------------------------------------------------
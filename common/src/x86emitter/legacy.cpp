@@ -85,6 +85,8 @@ emitterT u32 *J32Rel(int cc, u32 to)
 emitterT void x86SetPtr(u8 *ptr)
 {
     x86Ptr = ptr;
+    if (x86RelativeFieldHook)
+        x86RelativeFieldHook(NULL, x86Ptr);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
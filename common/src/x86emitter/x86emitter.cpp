@@ -63,6 +63,7 @@
 
 __tls_emit u8 *x86Ptr;
 __tls_emit XMMSSEType g_xmmtypes[iREGCNT_XMM] = {XMMT_INT};
+__tls_emit xRelativeFieldHandler *x86RelativeFieldHook = NULL;
 
 namespace x86Emitter
 {
@@ -295,6 +296,7 @@ static __fi void SibSB(u32 ss, u32 index, u32 base)
 void EmitSibMagic(uint regfield, const void *address, int extraRIPOffset)
 {
     sptr displacement = (sptr)address;
+    const u8 *base = NULL;
 #ifndef __M_X86_64
     ModRM(0, regfield, ModRm_UseDisp32);
 #else
@@ -303,6 +305,7 @@ void EmitSibMagic(uint regfield, const void *address, int extraRIPOffset)
     if (ripRelative == (s32)ripRelative) {
         ModRM(0, regfield, ModRm_UseDisp32);
         displacement = ripRelative;
+        base = x86Ptr + sizeof(s32) + extraRIPOffset;
     } else {
         pxAssertDev(displacement == (s32)displacement, "SIB target is too far away, needs an indirect register");
         ModRM(0, regfield, ModRm_UseSib);
@@ -310,6 +313,8 @@ void EmitSibMagic(uint regfield, const void *address, int extraRIPOffset)
     }
 #endif
 
+    if (x86RelativeFieldHook)
+        x86RelativeFieldHook((s32 *)x86Ptr, base);
     xWrite<s32>((s32)displacement);
 }
 
@@ -527,6 +532,8 @@ void EmitRexImplicitlyWide(const xIndirectVoid &sib)
 __emitinline void xSetPtr(void *ptr)
 {
     x86Ptr = (u8 *)ptr;
+    if (x86RelativeFieldHook)
+        x86RelativeFieldHook(NULL, x86Ptr);
 }
 
 // Retrieves the current emitter buffer target address.
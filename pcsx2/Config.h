@@ -253,7 +253,12 @@ struct Pcsx2Config
 				PreBlockCheckEE	:1,
 				PreBlockCheckIOP:1;
 			bool
-				EnableEECache   :1;
+				EnableEECache   :1,
+				EnableFastmem	:1,
+				EnableEEBlockCache:1,
+				EnableEESuperblocks:1,
+				EnableEETiering:1,
+				EnableWriteFaultStep:1;	// Single-steps writes to protected EE ram pages instead of dropping all their blocks
 		BITFIELD_END
 
 		RecompilerOptions();
@@ -540,6 +545,10 @@ TraceLogFilters&				SetTraceConfig();
 #define INSTANT_VU1					(EmuConfig.Speedhacks.vu1Instant)
 #define CHECK_EEREC					(EmuConfig.Cpu.Recompiler.EnableEE && GetCpuProviders().IsRecAvailable_EE())
 #define CHECK_CACHE					(EmuConfig.Cpu.Recompiler.EnableEECache)
+#define CHECK_FASTMEM				(EmuConfig.Cpu.Recompiler.EnableFastmem)
+#define CHECK_EEBLOCKCACHE			(EmuConfig.Cpu.Recompiler.EnableEEBlockCache)
+#define CHECK_EESUPERBLOCKS			(EmuConfig.Cpu.Recompiler.EnableEESuperblocks)
+#define CHECK_EETIERING				(EmuConfig.Cpu.Recompiler.EnableEETiering)
 #define CHECK_IOPREC				(EmuConfig.Cpu.Recompiler.EnableIOP && GetCpuProviders().IsRecAvailable_IOP())
 
 //------------ SPECIAL GAME FIXES!!! ---------------
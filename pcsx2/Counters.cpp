@@ -550,6 +550,8 @@ static __fi void VSyncEnd(u32 sCycle)
 	if(EmuConfig.Trace.Enabled && EmuConfig.Trace.EE.m_EnableAll)
 		SysTrace.EE.Counters.Write( "    ================  EE COUNTER VSYNC END (frame: %d)  ================", g_FrameCount );
 
+	// tools subscribed to the IPC get the memory of the frame that just ended
+	GetCoreThread().VsyncEndInThread();
 	g_FrameCount++;
 
 	hwIntcIrq(INTC_VBLANK_E);  // HW Irq
@@ -561,6 +563,10 @@ static __fi void VSyncEnd(u32 sCycle)
 	if (!(g_FrameCount % 60))
 		sioNextFrame();
 
+	// Write faults on recompiled code pages count less and less as time goes by
+	if (!(g_FrameCount % 32))
+		mmap_DecayPageStats();
+
 	// This doesn't seem to be needed here.  Games only seem to break with regard to the
 	// vsyncstart irq.
 	//cpuRegs.eCycle[30] = 2;
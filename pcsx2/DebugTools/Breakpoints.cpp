@@ -29,6 +29,9 @@ u64 CBreakPoints::breakSkipFirstTicksIop_ = 0;
 std::vector<MemCheck> CBreakPoints::memChecks_;
 std::vector<MemCheck *> CBreakPoints::cleanupMemChecks_;
 bool CBreakPoints::breakpointTriggered_ = false;
+BreakPointCpu CBreakPoints::breakpointTriggeredCpu_ = BREAKPOINT_EE;
+
+u8 memCheckPages[1 << (32 - MEMCHECK_PAGE_BITS)];
 
 // called from the dynarec
 u32 __fastcall standardizeBreakpointAddress(BreakPointCpu cpu, u32 addr)
@@ -251,14 +254,20 @@ void CBreakPoints::ClearTemporaryBreakPoints()
 	if (breakPoints_.empty())
 		return;
 
+	bool removed = false;
 	for (int i = (int)breakPoints_.size()-1; i >= 0; --i)
 	{
 		if (breakPoints_[i].temporary)
 		{
-			Update(breakPoints_[i].cpu, breakPoints_[i].addr);
 			breakPoints_.erase(breakPoints_.begin() + i);
+			removed = true;
 		}
 	}
+
+	// The core is already stopped and this runs on its own thread, so unlike Update() there
+	// is nothing to pause. The debugger window refreshes anyway once it sees the stop.
+	if (removed)
+		SysClearExecutionCache();
 }
 
 void CBreakPoints::ChangeBreakPointAddCond(BreakPointCpu cpu, u32 addr, const BreakPointCond &cond)
@@ -268,6 +277,7 @@ void CBreakPoints::ChangeBreakPointAddCond(BreakPointCpu cpu, u32 addr, const Br
 	{
 		breakPoints_[bp].hasCond = true;
 		breakPoints_[bp].cond = cond;
+		breakPoints_[bp].cond.Compile();
 		Update();
 	}
 }
@@ -311,12 +321,14 @@ void CBreakPoints::AddMemCheck(BreakPointCpu cpu, u32 start, u32 end, MemCheckCo
 		check.cpu = cpu;
 
 		memChecks_.push_back(check);
+		UpdateMemCheckPages();
 		Update(cpu);
 	}
 	else
 	{
 		memChecks_[mc].cond = (MemCheckCondition)(memChecks_[mc].cond | cond);
 		memChecks_[mc].result = (MemCheckResult)(memChecks_[mc].result | result);
+		UpdateMemCheckPages();
 		Update(cpu);
 	}
 }
@@ -330,6 +342,7 @@ void CBreakPoints::RemoveMemCheck(BreakPointCpu cpu, u32 start, u32 end)
 	if (mc != INVALID_MEMCHECK)
 	{
 		memChecks_.erase(memChecks_.begin() + mc);
+		UpdateMemCheckPages();
 		Update(cpu);
 	}
 }
@@ -341,6 +354,7 @@ void CBreakPoints::ChangeMemCheck(BreakPointCpu cpu, u32 start, u32 end, MemChec
 	{
 		memChecks_[mc].cond = cond;
 		memChecks_[mc].result = result;
+		UpdateMemCheckPages();
 		Update(cpu);
 	}
 }
@@ -353,6 +367,7 @@ void CBreakPoints::ClearAllMemChecks()
 	if (!memChecks_.empty())
 	{
 		memChecks_.clear();
+		UpdateMemCheckPages();
 		Update();
 	}
 }
@@ -397,6 +412,74 @@ const std::vector<MemCheck> CBreakPoints::GetMemCheckRanges()
 	return ranges;
 }
 
+void CBreakPoints::UpdateMemCheckPages()
+{
+	const u32 pageCount = 1 << (32 - MEMCHECK_PAGE_BITS);
+	const BreakPointCpu cpus[] = { BREAKPOINT_EE, BREAKPOINT_IOP };
+
+	memset(memCheckPages, 0, sizeof(memCheckPages));
+	std::vector<u8> watched(pageCount);
+
+	for (BreakPointCpu cpu : cpus)
+	{
+		// mark the ranges in standardized address space first...
+		std::fill(watched.begin(), watched.end(), 0);
+		bool any = false;
+
+		for (const MemCheck& check : memChecks_)
+		{
+			if (check.cpu != cpu || check.result == 0)
+				continue;
+
+			u32 start = standardizeBreakpointAddress(cpu, check.start);
+			u32 end = standardizeBreakpointAddress(cpu, check.end);
+			if (end <= start)
+				continue;
+
+			// an access can start up to 15 bytes before the range and still overlap it
+			u32 first = (start >= 15 ? start - 15 : 0) >> MEMCHECK_PAGE_BITS;
+			u32 last = (end - 1) >> MEMCHECK_PAGE_BITS;
+			for (u32 page = first; page <= last; page++)
+			{
+				if (check.cond & MEMCHECK_READ)
+					watched[page] |= memCheckPageMask(cpu, false);
+				if (check.cond & MEMCHECK_WRITE)
+					watched[page] |= memCheckPageMask(cpu, true);
+			}
+			any = true;
+		}
+
+		if (!any)
+			continue;
+
+		// ...then point every virtual page at its standardized one, so mirrors are caught
+		// too. Standardizing only touches the upper address bits, pages stay whole.
+		for (u32 page = 0; page < pageCount; page++)
+			memCheckPages[page] |= watched[standardizeBreakpointAddress(cpu, page << MEMCHECK_PAGE_BITS) >> MEMCHECK_PAGE_BITS];
+	}
+}
+
+u32 CBreakPoints::CheckMemAccess(BreakPointCpu cpu, u32 addr, u32 size, bool write)
+{
+	u32 start = standardizeBreakpointAddress(cpu, addr);
+	u32 end = start + size;
+	u32 result = 0;
+
+	for (const MemCheck& check : memChecks_)
+	{
+		if (check.cpu != cpu || check.result == 0)
+			continue;
+		if ((check.cond & (write ? MEMCHECK_WRITE : MEMCHECK_READ)) == 0)
+			continue;
+
+		// logic: memAddress < bpEnd && bpStart < memAddress+memSize
+		if (start < standardizeBreakpointAddress(cpu, check.end) && standardizeBreakpointAddress(cpu, check.start) < end)
+			result |= check.result;
+	}
+
+	return result;
+}
+
 const std::vector<MemCheck> CBreakPoints::GetMemChecks()
 {
 	return memChecks_;
@@ -407,6 +490,56 @@ const std::vector<BreakPoint> CBreakPoints::GetBreakpoints()
 	return breakPoints_;
 }
 
+std::mutex CpuStateNotifier::mutex_;
+std::condition_variable CpuStateNotifier::cond_;
+bool CpuStateNotifier::paused_ = true;
+u32 CpuStateNotifier::sequence_ = 0;
+CpuStateNotifier::Listener CpuStateNotifier::listener_ = NULL;
+void* CpuStateNotifier::listenerData_ = NULL;
+
+void CpuStateNotifier::SetListener(Listener listener, void* userdata)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	listener_ = listener;
+	listenerData_ = userdata;
+}
+
+void CpuStateNotifier::Signal(bool paused)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	paused_ = paused;
+	sequence_++;
+	cond_.notify_all();
+
+	// called with the lock held so a listener is never invoked after it was removed
+	if (listener_)
+		listener_(paused, listenerData_);
+}
+
+bool CpuStateNotifier::IsPaused()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return paused_;
+}
+
+u32 CpuStateNotifier::GetSequence()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return sequence_;
+}
+
+bool CpuStateNotifier::WaitForResume(u32 sequence, int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [sequence] { return sequence_ != sequence; });
+}
+
+bool CpuStateNotifier::WaitForPause(u32 sequence, int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [sequence] { return sequence_ != sequence && paused_; });
+}
+
 // including them earlier causes some ambiguities
 #include "App.h"
 #include "Debugger/DisassemblyDialog.h"
@@ -427,6 +560,15 @@ void CBreakPoints::Update(BreakPointCpu cpu, u32 addr)
 
 	if (resume)
 		r5900Debug.resumeCpu();
+
+	// breakpoints also change from the GDB stub's thread, the window can only be touched
+	// from the UI thread
+	if (!wxThread::IsMain())
+	{
+		wxGetApp().PostAppMethod(&Pcsx2App::updateDebugger);
+		return;
+	}
+
 	auto disassembly_window = wxGetApp().GetDisassemblyPtr();
 	if (disassembly_window) // make sure that valid pointer is recieved to prevent potential NULL dereference.
 		disassembly_window->update();
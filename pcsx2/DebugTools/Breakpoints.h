@@ -18,6 +18,8 @@
 #pragma once
 
 #include <vector>
+#include <mutex>
+#include <condition_variable>
 
 #include "DebugInterface.h"
 #include "Pcsx2Types.h"
@@ -26,6 +28,8 @@ struct BreakPointCond
 {
 	DebugInterface *debug;
 	PostfixExpression expression;
+	// expression lowered once for the hot path, empty when it couldn't be compiled
+	CompiledExpression compiled;
 	char expressionString[128];
 
 	BreakPointCond() : debug(NULL)
@@ -33,10 +37,17 @@ struct BreakPointCond
 		expressionString[0] = '\0';
 	}
 
+	void Compile()
+	{
+		if (!debug->compileExpression(expression,compiled))
+			compiled.clear();
+	}
+
 	u32 Evaluate()
 	{
 		u64 result;
-		if (!debug->parseExpression(expression,result) || result == 0) return 0;
+		bool valid = compiled.empty() ? debug->parseExpression(expression,result) : debug->evaluateExpression(compiled,result);
+		if (!valid || result == 0) return 0;
 		return 1;
 	}
 };
@@ -109,7 +120,7 @@ struct MemCheck
 
 // BreakPoints cannot overlap, only one is allowed per address.
 // MemChecks can overlap, as long as their ends are different.
-// WARNING: MemChecks are not used in the interpreter or HLE currently.
+// WARNING: MemChecks are not used in HLE currently.
 class CBreakPoints
 {
 public:
@@ -123,6 +134,7 @@ public:
 	static void RemoveBreakPoint(BreakPointCpu cpu, u32 addr);
 	static void ChangeBreakPoint(BreakPointCpu cpu, u32 addr, bool enable);
 	static void ClearAllBreakPoints();
+	// Only from the core thread while it is stopped, see CDebugControl::CoreStopped
 	static void ClearTemporaryBreakPoints();
 
 	// Makes a copy.  Temporary breakpoints can't have conditions.
@@ -141,19 +153,27 @@ public:
 	// Includes uncached addresses.
 	static const std::vector<MemCheck> GetMemCheckRanges();
 
+	// Exact range check for an access that hit a watched page, returns the combined
+	// MemCheckResult of all memchecks it matches.
+	static u32 CheckMemAccess(BreakPointCpu cpu, u32 addr, u32 size, bool write);
+
 	static const std::vector<MemCheck> GetMemChecks();
 	static const std::vector<BreakPoint> GetBreakpoints();
 	static size_t GetNumMemchecks() { return memChecks_.size(); }
+	static size_t GetNumBreakpoints() { return breakPoints_.size(); }
 
 	static void Update(BreakPointCpu cpu = BREAKPOINT_IOP_AND_EE, u32 addr = 0);
 
-	static void SetBreakpointTriggered(bool b) { breakpointTriggered_ = b; };
+	static void SetBreakpointTriggered(bool b, BreakPointCpu cpu = BREAKPOINT_EE) { breakpointTriggered_ = b; if (b) breakpointTriggeredCpu_ = cpu; };
 	static bool GetBreakpointTriggered() { return breakpointTriggered_; };
+	// the CPU which hit the last breakpoint, kept after the trigger is cleared
+	static BreakPointCpu GetBreakpointTriggeredCpu() { return breakpointTriggeredCpu_; };
 
 private:
 	static size_t FindBreakpoint(BreakPointCpu cpu, u32 addr, bool matchTemp = false, bool temp = false);
 	// Finds exactly, not using a range check.
 	static size_t FindMemCheck(BreakPointCpu cpu, u32 start, u32 end);
+	static void UpdateMemCheckPages();
 
 	static std::vector<BreakPoint> breakPoints_;
 	static u32 breakSkipFirstAtEE_;
@@ -162,11 +182,54 @@ private:
 	static u64 breakSkipFirstTicksIop_;
 
 	static bool breakpointTriggered_;
+	static BreakPointCpu breakpointTriggeredCpu_;
 
 	static std::vector<MemCheck> memChecks_;
 	static std::vector<MemCheck *> cleanupMemChecks_;
 };
 
+// Raised by the core thread whenever it actually stops (breakpoint, pause, suspend) or
+// is resumed, so debugger front ends living on their own thread (the GDB stub) can
+// block on it instead of spinning on isCpuPaused().
+class CpuStateNotifier
+{
+public:
+	// Called with the new state from whichever thread changed it. The listener must
+	// not block and must not call back into CpuStateNotifier.
+	typedef void (*Listener)(bool paused, void* userdata);
+
+	static void SetListener(Listener listener, void* userdata);
+	static void Signal(bool paused);
+
+	static bool IsPaused();
+	static u32 GetSequence();
+
+	// Wait until the state changed at least once since sequence was read. WaitForPause
+	// additionally requires the core to be stopped again, e.g. after a single step.
+	static bool WaitForResume(u32 sequence, int timeoutMs);
+	static bool WaitForPause(u32 sequence, int timeoutMs);
+
+private:
+	static std::mutex mutex_;
+	static std::condition_variable cond_;
+	static bool paused_;
+	static u32 sequence_;
+	static Listener listener_;
+	static void* listenerData_;
+};
+
+// One byte per page of the virtual address space, MEMCHECK_READ/MEMCHECK_WRITE are set
+// when a memcheck covers the page through any of its mirrors (EE in the low nibble, IOP
+// in the high one). The recompilers and interpreters guard each access with a single
+// test on this and only look at the actual ranges on a hit.
+static const u32 MEMCHECK_PAGE_BITS = 12;
+extern u8 memCheckPages[1 << (32 - MEMCHECK_PAGE_BITS)];
+
+inline u8 memCheckPageMask(BreakPointCpu cpu, bool write)
+{
+	u8 mask = write ? MEMCHECK_WRITE : MEMCHECK_READ;
+	return cpu == BREAKPOINT_IOP ? mask << 4 : mask;
+}
 
 // called from the dynarec
 u32 __fastcall standardizeBreakpointAddress(BreakPointCpu cpu, u32 addr);
@@ -0,0 +1,196 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+
+#include <mutex>
+
+#include "DebugControl.h"
+#include "Breakpoints.h"
+#include "MIPSAnalyst.h"
+#include "ReverseExecution.h"
+#include "gdb/PCSX2Interface.h"
+#include "System/SysThreads.h"
+
+std::atomic<bool> CDebugControl::stoppedAtBreakpoint_(false);
+std::atomic<BreakPointCpu> CDebugControl::stopCpu_(BREAKPOINT_EE);
+
+// Created on first use and never destroyed, its thread may still be blocked in a
+// socket call when the process exits.
+static GDB::PCSX2Interface* gdbServer = NULL;
+static std::mutex gdbServerMutex;
+
+DebugInterface* CDebugControl::GetCpu(BreakPointCpu cpu)
+{
+	return cpu == BREAKPOINT_IOP ? (DebugInterface*)&r3000Debug : (DebugInterface*)&r5900Debug;
+}
+
+// A core stopped by the debugger has nothing to reapply, it can continue right away
+// instead of going through the SysExecutor like a regular Resume().
+static void ResumeCore()
+{
+	SysCoreThread& core = GetCoreThread();
+	if (!core.ResumeDebug())
+		core.Resume();
+}
+
+bool CDebugControl::Pause()
+{
+	if (!r5900Debug.isAlive())
+		return false;
+
+	r5900Debug.pauseCpu();
+	return r5900Debug.isCpuPaused();
+}
+
+bool CDebugControl::Resume()
+{
+	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return false;
+
+	// If the current PC is on a breakpoint, the user doesn't want to do nothing.
+	CBreakPoints::SetSkipFirst(BREAKPOINT_EE, r5900Debug.getPC());
+	CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, r3000Debug.getPC());
+	ResumeCore();
+	return true;
+}
+
+u32 CDebugControl::StepInto(BreakPointCpu cpu, u32 instructionSize)
+{
+	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return (u32)-1;
+
+	DebugInterface* debug = GetCpu(cpu);
+	u32 currentPc = debug->getPC();
+
+	MIPSAnalyst::MipsOpcodeInfo info = MIPSAnalyst::GetOpcodeInfo(debug,currentPc);
+	u32 breakpointAddress = currentPc+instructionSize;
+	if (info.isBranch)
+	{
+		if (!info.isConditional || info.conditionMet)
+			breakpointAddress = info.branchTarget;
+		else
+			breakpointAddress = currentPc+2*4;
+	}
+
+	if (info.isSyscall)
+		breakpointAddress = info.branchTarget;
+
+	if (!RunTo(cpu,breakpointAddress))
+		return (u32)-1;
+	return breakpointAddress;
+}
+
+u32 CDebugControl::StepOver(BreakPointCpu cpu, u32 instructionSize)
+{
+	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return (u32)-1;
+
+	DebugInterface* debug = GetCpu(cpu);
+	u32 currentPc = debug->getPC();
+
+	MIPSAnalyst::MipsOpcodeInfo info = MIPSAnalyst::GetOpcodeInfo(debug,currentPc);
+	u32 breakpointAddress = currentPc+instructionSize;
+	if (info.isBranch)
+	{
+		if (!info.isConditional)
+		{
+			if (info.isLinkedBranch)	// jal, jalr
+			{
+				// it's a function call with a delay slot - skip that too
+				breakpointAddress += 4;
+			} else {					// j, ...
+				// in case of absolute branches, set the breakpoint at the branch target
+				breakpointAddress = info.branchTarget;
+			}
+		} else {						// beq, ...
+			if (info.conditionMet)
+				breakpointAddress = info.branchTarget;
+			else
+				breakpointAddress = currentPc+2*4;
+		}
+	}
+
+	if (!RunTo(cpu,breakpointAddress))
+		return (u32)-1;
+	return breakpointAddress;
+}
+
+bool CDebugControl::RunTo(BreakPointCpu cpu, u32 address)
+{
+	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return false;
+
+	// If the current PC is on a breakpoint, the user doesn't want to do nothing.
+	CBreakPoints::SetSkipFirst(cpu, GetCpu(cpu)->getPC());
+	CBreakPoints::AddBreakPoint(cpu, address, true);
+	ResumeCore();
+	return true;
+}
+
+void CDebugControl::CoreStopped()
+{
+	stopCpu_ = CBreakPoints::GetBreakpointTriggeredCpu();
+	stoppedAtBreakpoint_ = CBreakPoints::GetBreakpointTriggered();
+
+	// the step is over, whether it reached its breakpoint or something else stopped first
+	CBreakPoints::ClearTemporaryBreakPoints();
+
+	if (stoppedAtBreakpoint_)
+	{
+		CBreakPoints::SetBreakpointTriggered(false);
+		CBreakPoints::SetSkipFirst(BREAKPOINT_EE, 0);
+		CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, 0);
+	}
+}
+
+void CDebugControl::CoreStarted()
+{
+	if (getenv("PCSX2_GDB_PORT") || getenv("PCSX2_GDB_SOCKET"))
+		StartGdbServer();
+}
+
+void CDebugControl::StartGdbServer()
+{
+	std::lock_guard<std::mutex> lock(gdbServerMutex);
+	if (gdbServer == NULL)
+		gdbServer = new GDB::PCSX2Interface();
+
+	if (gdbServer->IsEnabled() || gdbServer->IsListening())
+		return;
+
+	gdbServer->EnableInSeparateThread();
+}
+
+void CDebugControl::StopGdbServer()
+{
+	std::lock_guard<std::mutex> lock(gdbServerMutex);
+	if (gdbServer == NULL)
+		return;
+
+	// the history was only recorded for the GDB client
+	CReverseExecution::Stop();
+
+	if (gdbServer->IsListening())
+		gdbServer->StopListening();
+	else if (gdbServer->IsEnabled())
+		gdbServer->Disable();
+}
+
+bool CDebugControl::IsGdbServerRunning()
+{
+	std::lock_guard<std::mutex> lock(gdbServerMutex);
+	return gdbServer != NULL && (gdbServer->IsEnabled() || gdbServer->IsListening());
+}
@@ -0,0 +1,61 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "DebugInterface.h"
+#include "Pcsx2Types.h"
+
+// Execution control for the debugger front ends, the debugger window and the GDB stub.
+// Requests go straight to the core thread and the work that has to follow a debug stop
+// (dropping the temporary step breakpoints, resetting the breakpoint state) is done by
+// the core thread itself, so none of it waits for the UI and the GDB server works
+// without the debugger window, e.g. on a headless CI setup.
+class CDebugControl
+{
+public:
+	// all of these can be called from any thread but the core thread
+	static bool Pause();
+	static bool Resume();
+
+	// Resume until cpu executed the instruction at its pc, following branches. StepOver
+	// runs over calls. instructionSize lets the debugger window step over a whole macro.
+	// Returns the address the cpu will stop at, or -1 if it isn't stopped.
+	static u32 StepInto(BreakPointCpu cpu, u32 instructionSize = 4);
+	static u32 StepOver(BreakPointCpu cpu, u32 instructionSize = 4);
+	static bool RunTo(BreakPointCpu cpu, u32 address);
+
+	// Why the core stopped the last time, a finished step counts as a breakpoint
+	static bool StoppedAtBreakpoint() { return stoppedAtBreakpoint_; }
+	static BreakPointCpu GetStopCpu() { return stopCpu_; }
+
+	// The server listens on PCSX2_GDB_PORT (6169 by default) or PCSX2_GDB_SOCKET
+	static void StartGdbServer();
+	static void StopGdbServer();
+	static bool IsGdbServerRunning();
+
+	// Called on the core thread, when it starts and whenever a debug pause took effect.
+	// Starting launches the GDB server right away if one of the variables above is set.
+	static void CoreStarted();
+	static void CoreStopped();
+
+private:
+	static DebugInterface* GetCpu(BreakPointCpu cpu);
+
+	static std::atomic<bool> stoppedAtBreakpoint_;
+	static std::atomic<BreakPointCpu> stopCpu_;
+};
@@ -110,6 +110,37 @@ public:
 		return -1;
 	}
 
+	virtual const void* getReferencePointer(u64 referenceIndex, int& size)
+	{
+		// same values getReferenceValue returns, read straight from the register file
+		if (cpu->getCpuType() == BREAKPOINT_EE)
+		{
+			size = 8;
+			if (referenceIndex < 32)
+				return &cpuRegs.GPR.r[referenceIndex].UD[0];
+			if (referenceIndex == REF_INDEX_HI)
+				return &cpuRegs.HI.UD[0];
+			if (referenceIndex == REF_INDEX_LO)
+				return &cpuRegs.LO.UD[0];
+
+			size = 4;
+			if (referenceIndex == REF_INDEX_PC)
+				return &cpuRegs.pc;
+		} else if (cpu->getCpuType() == BREAKPOINT_IOP) {
+			size = 4;
+			if (referenceIndex < 32)
+				return &psxRegs.GPR.r[referenceIndex];
+			if (referenceIndex == REF_INDEX_HI)
+				return &psxRegs.GPR.n.hi;
+			if (referenceIndex == REF_INDEX_LO)
+				return &psxRegs.GPR.n.lo;
+			if (referenceIndex == REF_INDEX_PC)
+				return &psxRegs.pc;
+		}
+
+		return NULL;
+	}
+
 	virtual ExpressionType getReferenceType(u64 referenceIndex) {
 		if (referenceIndex & REF_INDEX_IS_FLOAT) {
 			return EXPR_TYPE_FLOAT;
@@ -186,6 +217,35 @@ void DebugInterface::resumeCpu()
 }
 
 
+bool DebugInterface::readMemory(u32 address, u32 size, void* dest)
+{
+	u8* dst = (u8*)dest;
+	for (u32 i = 0; i < size; i++)
+	{
+		if (!isValidAddress(address + i))
+			return false;
+		dst[i] = read8(address + i);
+	}
+	return true;
+}
+
+bool DebugInterface::writeMemory(u32 address, u32 size, const void* src)
+{
+	const u8* data = (const u8*)src;
+	for (u32 i = 0; i < size; i++)
+	{
+		if (!isValidAddress(address + i))
+			return false;
+		write8(address + i, data[i]);
+	}
+	return true;
+}
+
+u32 DebugInterface::getPageGeneration(u32 address)
+{
+	return 0;
+}
+
 char* DebugInterface::stringFromPointer(u32 p)
 {
 	const int BUFFER_LEN = 25;
@@ -228,6 +288,18 @@ bool DebugInterface::parseExpression(PostfixExpression& exp, u64& dest)
 	return parsePostfixExpression(exp,&funcs,dest);
 }
 
+bool DebugInterface::compileExpression(const PostfixExpression& exp, CompiledExpression& dest)
+{
+	MipsExpressionFunctions funcs(this);
+	return compilePostfixExpression(exp,&funcs,dest);
+}
+
+bool DebugInterface::evaluateExpression(const CompiledExpression& exp, u64& dest)
+{
+	MipsExpressionFunctions funcs(this);
+	return evaluateCompiledExpression(exp,&funcs,dest);
+}
+
 
 //
 // R5900DebugInterface
@@ -301,6 +373,81 @@ void R5900DebugInterface::write32(u32 address, u32 value)
 	memWrite32(address,value);
 }
 
+// Walks the range one vtlb page at a time. Pages backed by host memory are copied
+// directly (unmapped pages are always handlers), handler (MMIO) pages still go
+// through the per-byte path.
+bool R5900DebugInterface::readMemory(u32 address, u32 size, void* dest)
+{
+	using namespace vtlb_private;
+
+	// the interpreter's cache emulation has to see every access
+	const bool direct = CHECK_EEREC || !CHECK_CACHE;
+	u8* dst = (u8*)dest;
+
+	while (size > 0)
+	{
+		const u32 chunk = std::min(size, VTLB_PAGE_SIZE - (address & VTLB_PAGE_MASK));
+		const auto vmv = vtlbdata.vmap[address >> VTLB_PAGE_BITS];
+
+		if (direct && !vmv.isHandler(address))
+		{
+			memcpy(dst, (void*)vmv.assumePtr(address), chunk);
+		}
+		else if (!DebugInterface::readMemory(address, chunk, dst))
+		{
+			return false;
+		}
+
+		address += chunk;
+		dst += chunk;
+		size -= chunk;
+	}
+
+	return true;
+}
+
+bool R5900DebugInterface::writeMemory(u32 address, u32 size, const void* src)
+{
+	using namespace vtlb_private;
+
+	// same as readMemory, cached writes have to go through the interpreter's cache
+	const bool direct = CHECK_EEREC || !CHECK_CACHE;
+	const u32 start = address;
+	const u32 total = size;
+	const u8* data = (const u8*)src;
+
+	while (size > 0)
+	{
+		const u32 chunk = std::min(size, VTLB_PAGE_SIZE - (address & VTLB_PAGE_MASK));
+		const auto vmv = vtlbdata.vmap[address >> VTLB_PAGE_BITS];
+
+		if (direct && !vmv.isHandler(address))
+		{
+			memcpy((void*)vmv.assumePtr(address), data, chunk);
+		}
+		else if (!DebugInterface::writeMemory(address, chunk, data))
+		{
+			return false;
+		}
+
+		address += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	// the write may have patched code, drop any recompiled blocks covering it
+	if (Cpu)
+		Cpu->Clear(start & ~3, (total + (start & 3) + 3) / 4);
+	return true;
+}
+
+u32 R5900DebugInterface::getPageGeneration(u32 address)
+{
+	// pages holding recompiled code are write protected, every write to them drops the
+	// protection and hands out a new generation once the code is recompiled
+	return mmap_GetRamPageGeneration(address);
+}
+
 
 int R5900DebugInterface::getRegisterCategoryCount()
 {
@@ -573,6 +720,56 @@ void R5900DebugInterface::setRegister(int cat, int num, u128 newValue)
 	}
 }
 
+void R5900DebugInterface::getRegisterSnapshot(DebugRegisterSnapshot& dest)
+{
+	for (int i = 0; i < 32; i++)
+	{
+		dest.gpr[i] = cpuRegs.GPR.r[i].UD[0];
+		dest.gprHi[i] = cpuRegs.GPR.r[i].UD[1];
+		dest.fpr[i] = fpuRegs.fpr[i].UL;
+		dest.vf[i] = VU0.VF[i].UQ;
+	}
+
+	dest.sr = cpuRegs.CP0.n.Status.val;
+	dest.lo = cpuRegs.LO.UD[0];
+	dest.hi = cpuRegs.HI.UD[0];
+	dest.badvaddr = cpuRegs.CP0.n.BadVAddr;
+	dest.cause = cpuRegs.CP0.n.Cause;
+	dest.pc = cpuRegs.pc;
+	dest.fcsr = fpuRegs.fprc[31];
+	dest.fir = fpuRegs.fprc[0];
+	dest.lo1 = cpuRegs.LO.UD[1];
+	dest.hi1 = cpuRegs.HI.UD[1];
+}
+
+void R5900DebugInterface::setRegisterSnapshot(const DebugRegisterSnapshot& src)
+{
+	for (int i = 0; i < 32; i++)
+	{
+		cpuRegs.GPR.r[i].UD[0] = src.gpr[i];
+		cpuRegs.GPR.r[i].UD[1] = src.gprHi[i];
+		fpuRegs.fpr[i].UL = src.fpr[i];
+		VU0.VF[i].UQ = src.vf[i];
+	}
+
+	// $zero and vf00 are hardwired
+	cpuRegs.GPR.r[0].UD[0] = cpuRegs.GPR.r[0].UD[1] = 0;
+	VU0.VF[0].f.x = 0.0f;
+	VU0.VF[0].f.y = 0.0f;
+	VU0.VF[0].f.z = 0.0f;
+	VU0.VF[0].f.w = 1.0f;
+
+	cpuRegs.CP0.n.Status.val = (u32)src.sr;
+	cpuRegs.LO.UD[0] = src.lo;
+	cpuRegs.HI.UD[0] = src.hi;
+	cpuRegs.CP0.n.BadVAddr = (u32)src.badvaddr;
+	cpuRegs.CP0.n.Cause = (u32)src.cause;
+	cpuRegs.pc = (u32)src.pc;
+	fpuRegs.fprc[31] = src.fcsr;
+	cpuRegs.LO.UD[1] = src.lo1;
+	cpuRegs.HI.UD[1] = src.hi1;
+}
+
 std::string R5900DebugInterface::disasm(u32 address, bool simplify)
 {
 	std::string out;
@@ -701,6 +898,81 @@ void R3000DebugInterface::write32(u32 address, u32 value)
 	iopMemWrite32(address,value);
 }
 
+// Main RAM (and its mirrors) and the scratchpad are plain memory, everything else the
+// lookup tables map (hardware registers, the parallel port) has to go through the handlers.
+// Returns the size of the plain run at address, 0 if it isn't one.
+static u32 iopPlainMemorySize(u32 address)
+{
+	const u32 phys = address & 0x1fffffff;
+	if (phys < 0x00800000)
+		return 0x10000 - (phys & 0xffff);
+	if (phys >= 0x1f800000 && phys < 0x1f800400)
+		return 0x1f800400 - phys;
+	return 0;
+}
+
+// The IOP lookup tables map 64k pages, copy whole runs from host memory where we can
+bool R3000DebugInterface::readMemory(u32 address, u32 size, void* dest)
+{
+	u8* dst = (u8*)dest;
+
+	while (size > 0)
+	{
+		const u32 plain = isValidAddress(address) ? iopPlainMemorySize(address) : 0;
+		const u32 chunk = std::min(size, plain ? plain : 0x10000 - (address & 0xffff));
+		const u8* ptr = plain ? iopVirtMemR<u8>(address) : NULL;
+
+		if (ptr)
+		{
+			memcpy(dst, ptr, chunk);
+		}
+		else if (!DebugInterface::readMemory(address, chunk, dst))
+		{
+			return false;
+		}
+
+		address += chunk;
+		dst += chunk;
+		size -= chunk;
+	}
+
+	return true;
+}
+
+bool R3000DebugInterface::writeMemory(u32 address, u32 size, const void* src)
+{
+	const u32 start = address;
+	const u32 total = size;
+	const u8* data = (const u8*)src;
+
+	// isolated cache: RAM writes are dropped, which the write handlers know about
+	const bool isolated = (psxRegs.CP0.n.Status & 0x10000) != 0;
+
+	while (size > 0)
+	{
+		const u32 plain = isValidAddress(address) && !isolated ? iopPlainMemorySize(address) : 0;
+		const u32 chunk = std::min(size, plain ? plain : 0x10000 - (address & 0xffff));
+		u8* ptr = plain ? iopVirtMemW<u8>(address) : NULL;
+
+		if (ptr)
+		{
+			memcpy(ptr, data, chunk);
+		}
+		else if (!DebugInterface::writeMemory(address, chunk, data))
+		{
+			return false;
+		}
+
+		address += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	if (psxCpu)
+		psxCpu->Clear(start & ~3, (total + (start & 3) + 3) / 4);
+	return true;
+}
+
 int R3000DebugInterface::getRegisterCategoryCount()
 {
 	return IOPCAT_COUNT;
@@ -858,6 +1130,35 @@ void R3000DebugInterface::setRegister(int cat, int num, u128 newValue)
 	}
 }
 
+void R3000DebugInterface::getRegisterSnapshot(DebugRegisterSnapshot& dest)
+{
+	memset(&dest, 0, sizeof(dest));
+
+	// sign extended like the EE does for 32 bit values
+	for (int i = 0; i < 32; i++)
+		dest.gpr[i] = (s64)(s32)psxRegs.GPR.r[i];
+
+	dest.sr = psxRegs.CP0.n.Status;
+	dest.lo = (s64)(s32)psxRegs.GPR.n.lo;
+	dest.hi = (s64)(s32)psxRegs.GPR.n.hi;
+	dest.badvaddr = psxRegs.CP0.n.BadVAddr;
+	dest.cause = psxRegs.CP0.n.Cause;
+	dest.pc = (s64)(s32)psxRegs.pc;
+}
+
+void R3000DebugInterface::setRegisterSnapshot(const DebugRegisterSnapshot& src)
+{
+	for (int i = 1; i < 32; i++)
+		psxRegs.GPR.r[i] = (u32)src.gpr[i];
+
+	psxRegs.CP0.n.Status = (u32)src.sr;
+	psxRegs.GPR.n.lo = (u32)src.lo;
+	psxRegs.GPR.n.hi = (u32)src.hi;
+	psxRegs.CP0.n.BadVAddr = (u32)src.badvaddr;
+	psxRegs.CP0.n.Cause = (u32)src.cause;
+	psxRegs.pc = (u32)src.pc;
+}
+
 std::string R3000DebugInterface::disasm(u32 address, bool simplify)
 {
 	std::string out;
@@ -26,6 +26,22 @@ enum BreakPointCpu
 	BREAKPOINT_IOP_AND_EE = 0x03
 };
 
+// Flat copy of a cpu's register file, laid out in the order the GDB stub describes
+// the registers (GDB's mips numbering first, then the R5900 extensions). Values are
+// little endian, registers a cpu doesn't have read as zero and are ignored on write.
+struct DebugRegisterSnapshot
+{
+	u64 gpr[32];
+	u64 sr, lo, hi, badvaddr, cause, pc;
+	u32 fpr[32];
+	u32 fcsr, fir;
+	u64 gprHi[32];	// upper halves of the 128 bit EE GPRs
+	u64 lo1, hi1;
+	u128 vf[32];	// VU0 vector registers
+};
+
+static_assert(sizeof(DebugRegisterSnapshot) == 1224, "DebugRegisterSnapshot is sent as is, it can't have padding");
+
 class DebugInterface
 {
 public:
@@ -39,6 +55,13 @@ public:
 	virtual void write8(u32 address, u8 value) = 0;
 	virtual void write32(u32 address, u32 value) = 0;
 
+	// bulk access, returns false if any byte of the range is invalid
+	virtual bool readMemory(u32 address, u32 size, void* dest);
+	virtual bool writeMemory(u32 address, u32 size, const void* src);
+	// Changes whenever the 4k page holding address is written, 0 if writes to it aren't
+	// tracked and its contents have to be compared instead.
+	virtual u32 getPageGeneration(u32 address);
+
 	// register stuff
 	virtual int getRegisterCategoryCount() = 0;
 	virtual const char* getRegisterCategoryName(int cat) = 0;
@@ -53,6 +76,9 @@ public:
 	virtual u32 getPC() = 0;
 	virtual void setPc(u32 newPc) = 0;
 	virtual void setRegister(int cat, int num, u128 newValue) = 0;
+	// copies the whole register file in one go, for bulk readers like the GDB stub
+	virtual void getRegisterSnapshot(DebugRegisterSnapshot& dest) = 0;
+	virtual void setRegisterSnapshot(const DebugRegisterSnapshot& src) = 0;
 	
 	virtual std::string disasm(u32 address, bool simplify) = 0;
 	virtual bool isValidAddress(u32 address) = 0;
@@ -61,6 +87,8 @@ public:
 	
 	bool initExpression(const char* exp, PostfixExpression& dest);
 	bool parseExpression(PostfixExpression& exp, u64& dest);
+	bool compileExpression(const PostfixExpression& exp, CompiledExpression& dest);
+	bool evaluateExpression(const CompiledExpression& exp, u64& dest);
 	bool isAlive();
 	bool isCpuPaused();
 	void pauseCpu();
@@ -78,6 +106,9 @@ public:
 	virtual u128 read128(u32 address);
 	virtual void write8(u32 address, u8 value);
 	virtual void write32(u32 address, u32 value);
+	virtual bool readMemory(u32 address, u32 size, void* dest);
+	virtual bool writeMemory(u32 address, u32 size, const void* src);
+	virtual u32 getPageGeneration(u32 address);
 
 	// register stuff
 	virtual int getRegisterCategoryCount();
@@ -93,6 +124,8 @@ public:
 	virtual u32 getPC();
 	virtual void setPc(u32 newPc);
 	virtual void setRegister(int cat, int num, u128 newValue);
+	virtual void getRegisterSnapshot(DebugRegisterSnapshot& dest);
+	virtual void setRegisterSnapshot(const DebugRegisterSnapshot& src);
 
 	virtual std::string disasm(u32 address, bool simplify);
 	virtual bool isValidAddress(u32 address);
@@ -111,6 +144,8 @@ public:
 	virtual u128 read128(u32 address);
 	virtual void write8(u32 address, u8 value);
 	virtual void write32(u32 address, u32 value);
+	virtual bool readMemory(u32 address, u32 size, void* dest);
+	virtual bool writeMemory(u32 address, u32 size, const void* src);
 
 	// register stuff
 	virtual int getRegisterCategoryCount();
@@ -126,6 +161,8 @@ public:
 	virtual u32 getPC();
 	virtual void setPc(u32 newPc);
 	virtual void setRegister(int cat, int num, u128 newValue);
+	virtual void getRegisterSnapshot(DebugRegisterSnapshot& dest);
+	virtual void setRegisterSnapshot(const DebugRegisterSnapshot& src);
 
 	virtual std::string disasm(u32 address, bool simplify);
 	virtual bool isValidAddress(u32 address);
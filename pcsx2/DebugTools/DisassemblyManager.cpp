@@ -31,14 +31,31 @@ bool isInInterval(u32 start, u32 size, u32 value)
 	return start <= value && value <= (start+size-1);
 }
 
-static u32 computeHash(u32 address, u32 size)
+// Pages whose writes are tracked only contribute their generation, so checking a large
+// function for changes doesn't have to read all of it again.
+static u32 computeHash(DebugInterface* cpu, u32 address, u32 size)
 {
 	u32 end = address+size;
 	u32 hash = 0xBACD7814;
 	while (address < end)
 	{
-		hash += memRead32(address);
-		address += 4;
+		u32 pageEnd = std::min<u32>(end,(address & ~0xFFF)+0x1000);
+		if (pageEnd == 0)
+			pageEnd = end;
+
+		u32 generation = cpu->getPageGeneration(address);
+		if (generation != 0)
+		{
+			hash = hash*31 + generation;
+			address = pageEnd;
+			continue;
+		}
+
+		while (address < pageEnd)
+		{
+			hash += cpu->read32(address);
+			address += 4;
+		}
 	}
 	return hash;
 }
@@ -155,7 +172,8 @@ void DisassemblyManager::analyze(u32 address, u32 size = 1024)
 		if (it != entries.end())
 		{
 			DisassemblyEntry* entry = it->second;
-			entry->recheck();
+			if (entry->recheck())
+				lineCache.invalidate(entry->getLineAddress(0),entry->getTotalSize());
 			address = entry->getLineAddress(0)+entry->getTotalSize();
 			continue;
 		}
@@ -237,6 +255,9 @@ std::vector<BranchLine> DisassemblyManager::getBranchLines(u32 start, u32 size)
 
 void DisassemblyManager::getLine(u32 address, bool insertSymbols, DisassemblyLineInfo& dest)
 {
+	if (lineCache.find(cpu,address,insertSymbols,dest))
+		return;
+
 	auto it = findDisassemblyEntry(entries,address,false);
 	if (it == entries.end())
 	{
@@ -257,7 +278,10 @@ void DisassemblyManager::getLine(u32 address, bool insertSymbols, DisassemblyLin
 
 	DisassemblyEntry* entry = it->second;
 	if (entry->disassemble(address,dest,insertSymbols))
+	{
+		lineCache.add(cpu,address,insertSymbols,dest);
 		return;
+	}
 	
 	if (address % 4)
 		dest.totalSize = ((address+3) & ~3)-address;
@@ -343,24 +367,155 @@ void DisassemblyManager::clear()
 		delete it->second;
 	}
 	entries.clear();
+	lineCache.clear();
+}
+
+bool DisassemblyLineCache::lineBefore(const Line& line, u32 address)
+{
+	return line.address < address;
+}
+
+DisassemblyLineCache::Page& DisassemblyLineCache::getPage(DebugInterface* cpu, u32 address, bool insertSymbols)
+{
+	u32 key = pageKey(address,insertSymbols);
+	u32 generation = cpu->getPageGeneration(address);
+	u32 symbolVersion = insertSymbols ? symbolMap.GetVersion() : 0;
+
+	auto it = pages.find(key);
+	if (it == pages.end())
+	{
+		if (pages.size() >= MAX_PAGES)
+			clear();
+
+		Page& page = pages[key];
+		page.generation = generation;
+		page.symbolVersion = symbolVersion;
+		return page;
+	}
+
+	// a new generation means the page was written (or only now became tracked), none of
+	// its lines can be trusted anymore. Same when the symbols their names came from changed.
+	Page& page = it->second;
+	if (page.generation != generation || page.symbolVersion != symbolVersion)
+	{
+		page.generation = generation;
+		page.symbolVersion = symbolVersion;
+		page.lines.clear();
+		page.arena.clear();
+	}
+
+	return page;
+}
+
+bool DisassemblyLineCache::find(DebugInterface* cpu, u32 address, bool insertSymbols, DisassemblyLineInfo& dest)
+{
+	Page& page = getPage(cpu,address,insertSymbols);
+
+	auto it = std::lower_bound(page.lines.begin(),page.lines.end(),address,lineBefore);
+	if (it == page.lines.end() || it->address != address)
+		return false;
+
+	const Line& line = *it;
+	const char* text = &page.arena[line.text];
+	const char* bytes = text+line.nameLength+line.paramsLength;
+
+	bool crossesPage = ((address & 0xFFF)+line.totalSize) > 0x1000;
+	if (page.generation == 0 || crossesPage)
+	{
+		u8 buffer[256];
+		if (!cpu->readMemory(address,line.totalSize,buffer) || memcmp(buffer,bytes,line.totalSize) != 0)
+		{
+			page.lines.erase(it);
+			return false;
+		}
+	}
+
+	dest.type = line.type;
+	dest.name.assign(text,line.nameLength);
+	dest.params.assign(text+line.nameLength,line.paramsLength);
+	dest.totalSize = line.totalSize;
+
+	// branch conditions and data addresses depend on the current registers
+	if (line.type == DISTYPE_OPCODE)
+		dest.info = MIPSAnalyst::GetOpcodeInfo(cpu,address);
+	else
+		dest.info = line.info;
+	return true;
+}
+
+void DisassemblyLineCache::add(DebugInterface* cpu, u32 address, bool insertSymbols, const DisassemblyLineInfo& line)
+{
+	u8 buffer[256];
+	if (line.totalSize == 0 || line.totalSize > sizeof(buffer) || !cpu->readMemory(address,line.totalSize,buffer))
+		return;
+
+	// find() set up the page before the line was made, if it has been written since then
+	// the line may already be outdated
+	auto pageIt = pages.find(pageKey(address,insertSymbols));
+	if (pageIt == pages.end() || pageIt->second.generation != cpu->getPageGeneration(address)
+		|| pageIt->second.symbolVersion != (insertSymbols ? symbolMap.GetVersion() : 0))
+		return;
+
+	Page& page = pageIt->second;
+
+	// replaced lines leave their text behind, start over once that adds up
+	if (page.arena.size() >= MAX_ARENA_SIZE)
+	{
+		page.lines.clear();
+		page.arena.clear();
+	}
+
+	Line entry;
+	entry.address = address;
+	entry.totalSize = line.totalSize;
+	entry.type = line.type;
+	entry.info = line.info;
+	entry.text = (u32)page.arena.size();
+	entry.nameLength = (u32)line.name.size();
+	entry.paramsLength = (u32)line.params.size();
+
+	page.arena.insert(page.arena.end(),line.name.begin(),line.name.end());
+	page.arena.insert(page.arena.end(),line.params.begin(),line.params.end());
+	page.arena.insert(page.arena.end(),(const char*)buffer,(const char*)buffer+line.totalSize);
+
+	auto it = std::lower_bound(page.lines.begin(),page.lines.end(),address,lineBefore);
+	if (it != page.lines.end() && it->address == address)
+		*it = entry;
+	else
+		page.lines.insert(it,entry);
+}
+
+void DisassemblyLineCache::invalidate(u32 start, u32 size)
+{
+	if (size == 0)
+		return;
+
+	u32 first = start >> 12;
+	u32 last = (start+size-1) >> 12;
+	for (u32 page = first; page <= last; page++)
+	{
+		pages.erase(page << 1);
+		pages.erase((page << 1) | 1);
+	}
 }
 
 DisassemblyFunction::DisassemblyFunction(DebugInterface* _cpu, u32 _address, u32 _size): address(_address), size(_size)
 {
 	cpu = _cpu;
-	hash = computeHash(address,size);
+	hash = computeHash(cpu,address,size);
 	load();
 }
 
-void DisassemblyFunction::recheck()
+bool DisassemblyFunction::recheck()
 {
-	u32 newHash = computeHash(address,size);
-	if (hash != newHash)
-	{
-		hash = newHash;
-		clear();
-		load();
-	}
+	u32 newHash = computeHash(cpu,address,size);
+	if (hash == newHash)
+		return false;
+
+	clear();
+	hash = newHash;
+	load();
+	return true;
 }
 
 int DisassemblyFunction::getNumLines()
@@ -816,18 +971,19 @@ bool DisassemblyMacro::disassemble(u32 address, DisassemblyLineInfo& dest, bool
 DisassemblyData::DisassemblyData(DebugInterface* _cpu, u32 _address, u32 _size, DataType _type): address(_address), size(_size), type(_type)
 {
 	cpu = _cpu;
-	hash = computeHash(address,size);
+	hash = computeHash(cpu,address,size);
 	createLines();
 }
 
-void DisassemblyData::recheck()
+bool DisassemblyData::recheck()
 {
-	u32 newHash = computeHash(address,size);
-	if (newHash != hash)
-	{
-		hash = newHash;
-		createLines();
-	}
+	u32 newHash = computeHash(cpu,address,size);
+	if (newHash == hash)
+		return false;
+
+	hash = newHash;
+	createLines();
+	return true;
 }
 
 bool DisassemblyData::disassemble(u32 address, DisassemblyLineInfo& dest, bool insertSymbols)
@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <unordered_map>
+
 #include "SymbolMap.h"
 #include "Utilities/Threading.h"
 #include "Pcsx2Types.h"
@@ -53,7 +55,8 @@ class DisassemblyEntry
 {
 public:
 	virtual ~DisassemblyEntry() { };
-	virtual void recheck() = 0;
+	// true if the entry had to be rebuilt because its memory changed
+	virtual bool recheck() = 0;
 	virtual int getNumLines() = 0;
 	virtual int getLineNum(u32 address, bool findStart) = 0;
 	virtual u32 getLineAddress(int line) = 0;
@@ -66,7 +69,7 @@ class DisassemblyFunction: public DisassemblyEntry
 {
 public:
 	DisassemblyFunction(DebugInterface* _cpu, u32 _address, u32 _size);
-	virtual void recheck();
+	virtual bool recheck();
 	virtual int getNumLines();
 	virtual int getLineNum(u32 address, bool findStart);
 	virtual u32 getLineAddress(int line);
@@ -93,7 +96,7 @@ class DisassemblyOpcode: public DisassemblyEntry
 public:
 	DisassemblyOpcode(DebugInterface* _cpu, u32 _address, int _num): cpu(_cpu), address(_address), num(_num) { };
 	virtual ~DisassemblyOpcode() { };
-	virtual void recheck() { };
+	virtual bool recheck() { return false; };
 	virtual int getNumLines() { return num; };
 	virtual int getLineNum(u32 address, bool findStart) { return (address-this->address)/4; };
 	virtual u32 getLineAddress(int line) { return address+line*4; };
@@ -117,7 +120,7 @@ public:
 	void setMacroLi(u32 _immediate, u8 _rt);
 	void setMacroMemory(const std::string& _name, u32 _immediate, u8 _rt, int _dataSize);
 
-	virtual void recheck() { };
+	virtual bool recheck() { return false; };
 	virtual int getNumLines() { return 1; };
 	virtual int getLineNum(u32 address, bool findStart) { return 0; };
 	virtual u32 getLineAddress(int line) { return address; };
@@ -143,7 +146,7 @@ public:
 	DisassemblyData(DebugInterface* _cpu, u32 _address, u32 _size, DataType _type);
 	virtual ~DisassemblyData() { };
 
-	virtual void recheck();
+	virtual bool recheck();
 	virtual int getNumLines() { return (int)lines.size(); };
 	virtual int getLineNum(u32 address, bool findStart);
 	virtual u32 getLineAddress(int line) { return lineAddresses[line]; };
@@ -174,7 +177,7 @@ public:
 	DisassemblyComment(DebugInterface* _cpu, u32 _address, u32 _size,const std::string& name, const std::string& param);
 	virtual ~DisassemblyComment() { };
 
-	virtual void recheck() { };
+	virtual bool recheck() { return false; };
 	virtual int getNumLines() { return 1; };
 	virtual int getLineNum(u32 address, bool findStart) { return 0; };
 	virtual u32 getLineAddress(int line) { return address; };
@@ -188,6 +191,49 @@ private:
 	std::string param;
 };
 
+// Lines handed out by DisassemblyManager::getLine, keyed by 4k page so a repaint only has
+// to render what changed since the last one. A page is dropped as a whole once its memory
+// is reported written (see DebugInterface::getPageGeneration). Lines on pages without that
+// report, or that cross into the next page, are checked against the bytes they were made
+// from instead.
+class DisassemblyLineCache
+{
+public:
+	bool find(DebugInterface* cpu, u32 address, bool insertSymbols, DisassemblyLineInfo& dest);
+	void add(DebugInterface* cpu, u32 address, bool insertSymbols, const DisassemblyLineInfo& line);
+	void invalidate(u32 start, u32 size);
+	void clear() { pages.clear(); };
+private:
+	struct Line
+	{
+		u32 address;
+		u32 totalSize;
+		DisassemblyLineType type;
+		MIPSAnalyst::MipsOpcodeInfo info;
+		// name, params and then the totalSize bytes of memory, in the page's arena
+		u32 text;
+		u32 nameLength;
+		u32 paramsLength;
+	};
+
+	struct Page
+	{
+		u32 generation;
+		u32 symbolVersion;		// of symbolMap, for lines with symbols in them
+		std::vector<Line> lines;	// sorted by address
+		std::vector<char> arena;
+	};
+
+	static u32 pageKey(u32 address, bool insertSymbols) { return ((address >> 12) << 1) | (insertSymbols ? 1 : 0); };
+	static bool lineBefore(const Line& line, u32 address);
+	Page& getPage(DebugInterface* cpu, u32 address, bool insertSymbols);
+
+	static const size_t MAX_PAGES = 1024;
+	static const size_t MAX_ARENA_SIZE = 0x10000;
+
+	std::unordered_map<u32,Page> pages;
+};
+
 class DebugInterface;
 
 class DisassemblyManager
@@ -209,6 +255,7 @@ public:
 private:
 	DisassemblyEntry* getEntry(u32 address);
 	std::map<u32,DisassemblyEntry*> entries;
+	DisassemblyLineCache lineCache;
 	DebugInterface* cpu = NULL;
 	static int maxParamChars;
 };
@@ -0,0 +1,1061 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+
+#include "DwarfInfo.h"
+#include "SymbolMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// file index of the rows ending a sequence, addresses from there on have no line info
+static const u32 NO_FILE = (u32)-1;
+
+struct DwarfTables
+{
+	struct LineRow
+	{
+		u32 address;
+		u32 line;
+		u32 file;
+	};
+
+	// sorted by address, each row covers everything up to the next one
+	std::vector<LineRow> lines;
+	std::vector<std::string> files;
+
+	// sorted by start, names are offsets into the arena
+	std::vector<u32> functionStarts;
+	std::vector<u32> functionEnds;
+	std::vector<u32> functionNames;
+	std::vector<char> names;
+};
+
+static std::shared_ptr<const DwarfTables> tables_ = std::make_shared<DwarfTables>();
+static std::atomic<bool> loaded_(false);
+static std::atomic<bool> cancel_(false);
+static std::mutex loaderLock_;
+
+// Joins the loader on shutdown, a std::thread must not be destroyed while it still runs.
+static struct LoaderThreadHolder
+{
+	std::thread thread;
+
+	void Stop()
+	{
+		cancel_ = true;
+		if (thread.joinable())
+			thread.join();
+		cancel_ = false;
+	}
+
+	~LoaderThreadHolder() { Stop(); }
+} loader_;
+
+// Bounds checked little endian reader, running past the end sets it to failed and
+// returns zeroes from then on.
+class DwarfReader
+{
+public:
+	DwarfReader(const std::vector<u8>& data, size_t start = 0, size_t end = (size_t)-1)
+		: data_(data.data()), pos_(start), end_(std::min(end, data.size())), ok_(start <= data.size()) {}
+
+	bool Ok() const { return ok_; }
+	bool AtEnd() const { return !ok_ || pos_ >= end_; }
+	size_t Pos() const { return pos_; }
+	size_t End() const { return end_; }
+
+	void Seek(size_t pos)
+	{
+		if (pos > end_)
+			ok_ = false;
+		else
+			pos_ = pos;
+	}
+
+	void Skip(u64 count)
+	{
+		if (!ok_ || count > end_ - pos_)
+			ok_ = false;
+		else
+			pos_ += (size_t)count;
+	}
+
+	u64 Read(int size)
+	{
+		if (!ok_ || (size_t)size > end_ - pos_) {
+			ok_ = false;
+			return 0;
+		}
+
+		u64 value = 0;
+		for (int i = 0; i < size; i++)
+			value |= (u64)data_[pos_ + i] << (i * 8);
+		pos_ += size;
+		return value;
+	}
+
+	u8 U8() { return (u8)Read(1); }
+	u16 U16() { return (u16)Read(2); }
+	u32 U32() { return (u32)Read(4); }
+	u64 U64() { return Read(8); }
+
+	u64 ULEB()
+	{
+		u64 value = 0;
+		int shift = 0;
+		while (true) {
+			u8 byte = U8();
+			if (shift < 64)
+				value |= (u64)(byte & 0x7f) << shift;
+			shift += 7;
+			if (!(byte & 0x80) || !ok_)
+				return value;
+		}
+	}
+
+	s64 SLEB()
+	{
+		u64 value = 0;
+		int shift = 0;
+		u8 byte;
+		do {
+			byte = U8();
+			if (shift < 64)
+				value |= (u64)(byte & 0x7f) << shift;
+			shift += 7;
+		} while ((byte & 0x80) && ok_);
+
+		if (shift < 64 && (byte & 0x40))
+			value |= ~(u64)0 << shift;
+		return (s64)value;
+	}
+
+	const char* CStr()
+	{
+		if (!ok_)
+			return "";
+
+		const void* nul = memchr(data_ + pos_, 0, end_ - pos_);
+		if (!nul) {
+			ok_ = false;
+			return "";
+		}
+
+		const char* str = (const char*)(data_ + pos_);
+		pos_ = (const u8*)nul - data_ + 1;
+		return str;
+	}
+
+	// Unit length, switches to 64 bit offsets when the escape value is found. Returns the
+	// end of the unit.
+	size_t UnitLength(bool& dwarf64)
+	{
+		u64 length = U32();
+		dwarf64 = length == 0xffffffff;
+		if (dwarf64)
+			length = U64();
+
+		if (!ok_ || length > end_ - pos_) {
+			ok_ = false;
+			return end_;
+		}
+		return pos_ + (size_t)length;
+	}
+
+	u64 Offset(bool dwarf64) { return dwarf64 ? U64() : U32(); }
+
+private:
+	const u8* data_;
+	size_t pos_;
+	size_t end_;
+	bool ok_;
+};
+
+// String at offset into a string section, nullptr if it's out of range.
+static const char* SectionString(const std::vector<u8>& section, u64 offset)
+{
+	if (offset >= section.size())
+		return nullptr;
+
+	const char* str = (const char*)section.data() + offset;
+	if (!memchr(str, 0, section.size() - (size_t)offset))
+		return nullptr;
+	return str;
+}
+
+enum
+{
+	DW_FORM_addr = 0x01,
+	DW_FORM_block2 = 0x03,
+	DW_FORM_block4 = 0x04,
+	DW_FORM_data2 = 0x05,
+	DW_FORM_data4 = 0x06,
+	DW_FORM_data8 = 0x07,
+	DW_FORM_string = 0x08,
+	DW_FORM_block = 0x09,
+	DW_FORM_block1 = 0x0a,
+	DW_FORM_data1 = 0x0b,
+	DW_FORM_flag = 0x0c,
+	DW_FORM_sdata = 0x0d,
+	DW_FORM_strp = 0x0e,
+	DW_FORM_udata = 0x0f,
+	DW_FORM_ref_addr = 0x10,
+	DW_FORM_ref1 = 0x11,
+	DW_FORM_ref2 = 0x12,
+	DW_FORM_ref4 = 0x13,
+	DW_FORM_ref8 = 0x14,
+	DW_FORM_ref_udata = 0x15,
+	DW_FORM_indirect = 0x16,
+	DW_FORM_sec_offset = 0x17,
+	DW_FORM_exprloc = 0x18,
+	DW_FORM_flag_present = 0x19,
+	DW_FORM_strx = 0x1a,
+	DW_FORM_addrx = 0x1b,
+	DW_FORM_ref_sup4 = 0x1c,
+	DW_FORM_strp_sup = 0x1d,
+	DW_FORM_data16 = 0x1e,
+	DW_FORM_line_strp = 0x1f,
+	DW_FORM_ref_sig8 = 0x20,
+	DW_FORM_implicit_const = 0x21,
+	DW_FORM_loclistx = 0x22,
+	DW_FORM_rnglistx = 0x23,
+	DW_FORM_ref_sup8 = 0x24,
+	DW_FORM_strx1 = 0x25,
+	DW_FORM_strx2 = 0x26,
+	DW_FORM_strx3 = 0x27,
+	DW_FORM_strx4 = 0x28,
+	DW_FORM_addrx1 = 0x29,
+	DW_FORM_addrx2 = 0x2a,
+	DW_FORM_addrx3 = 0x2b,
+	DW_FORM_addrx4 = 0x2c,
+	DW_FORM_GNU_addr_index = 0x1f01,
+	DW_FORM_GNU_str_index = 0x1f02,
+	DW_FORM_GNU_ref_alt = 0x1f20,
+	DW_FORM_GNU_strp_alt = 0x1f21,
+
+	DW_TAG_subprogram = 0x2e,
+
+	DW_AT_name = 0x03,
+	DW_AT_low_pc = 0x11,
+	DW_AT_high_pc = 0x12,
+	DW_AT_abstract_origin = 0x31,
+	DW_AT_specification = 0x47,
+	DW_AT_linkage_name = 0x6e,
+	DW_AT_MIPS_linkage_name = 0x2007,
+
+	DW_LNCT_path = 0x1,
+	DW_LNCT_directory_index = 0x2,
+};
+
+struct DwarfUnit
+{
+	const DwarfSections* sections;
+	size_t start;			// offset of the unit header in its section
+	u16 version;
+	u8 addressSize;
+	bool dwarf64;
+};
+
+// One decoded attribute, strings are left null when the form doesn't hold one this
+// loader can resolve (string offsets tables need the split DWARF sections).
+struct DwarfValue
+{
+	u64 value;
+	const char* str;
+	bool isAddress;
+	bool isReference;
+};
+
+static bool ReadForm(DwarfReader& r, const DwarfUnit& unit, u64 form, s64 implicitConst, DwarfValue& out)
+{
+	out.value = 0;
+	out.str = nullptr;
+	out.isAddress = false;
+	out.isReference = false;
+
+	switch (form) {
+	case DW_FORM_addr:
+		out.value = r.Read(unit.addressSize);
+		out.isAddress = true;
+		break;
+	case DW_FORM_block1: r.Skip(r.U8()); break;
+	case DW_FORM_block2: r.Skip(r.U16()); break;
+	case DW_FORM_block4: r.Skip(r.U32()); break;
+	case DW_FORM_block:
+	case DW_FORM_exprloc:
+		r.Skip(r.ULEB());
+		break;
+	case DW_FORM_data1:
+	case DW_FORM_flag:
+	case DW_FORM_strx1:
+	case DW_FORM_addrx1:
+		out.value = r.U8();
+		break;
+	case DW_FORM_data2:
+	case DW_FORM_strx2:
+	case DW_FORM_addrx2:
+		out.value = r.U16();
+		break;
+	case DW_FORM_strx3:
+	case DW_FORM_addrx3:
+		out.value = r.Read(3);
+		break;
+	case DW_FORM_data4:
+	case DW_FORM_ref_sup4:
+	case DW_FORM_strx4:
+	case DW_FORM_addrx4:
+		out.value = r.U32();
+		break;
+	case DW_FORM_data8:
+	case DW_FORM_ref_sig8:
+	case DW_FORM_ref_sup8:
+		out.value = r.U64();
+		break;
+	case DW_FORM_data16: r.Skip(16); break;
+	case DW_FORM_sdata: out.value = (u64)r.SLEB(); break;
+	case DW_FORM_udata:
+	case DW_FORM_strx:
+	case DW_FORM_addrx:
+	case DW_FORM_loclistx:
+	case DW_FORM_rnglistx:
+	case DW_FORM_GNU_addr_index:
+	case DW_FORM_GNU_str_index:
+		out.value = r.ULEB();
+		break;
+	case DW_FORM_string: out.str = r.CStr(); break;
+	case DW_FORM_strp:
+		out.value = r.Offset(unit.dwarf64);
+		out.str = SectionString(unit.sections->str, out.value);
+		break;
+	case DW_FORM_line_strp:
+		out.value = r.Offset(unit.dwarf64);
+		out.str = SectionString(unit.sections->lineStr, out.value);
+		break;
+	case DW_FORM_sec_offset:
+	case DW_FORM_strp_sup:
+	case DW_FORM_GNU_ref_alt:
+	case DW_FORM_GNU_strp_alt:
+		out.value = r.Offset(unit.dwarf64);
+		break;
+	case DW_FORM_ref_addr:
+		// section relative, DWARF 2 sized these like addresses
+		out.value = unit.version <= 2 ? r.Read(unit.addressSize) : r.Offset(unit.dwarf64);
+		out.isReference = true;
+		break;
+	case DW_FORM_ref1: out.value = unit.start + r.U8(); out.isReference = true; break;
+	case DW_FORM_ref2: out.value = unit.start + r.U16(); out.isReference = true; break;
+	case DW_FORM_ref4: out.value = unit.start + r.U32(); out.isReference = true; break;
+	case DW_FORM_ref8: out.value = unit.start + r.U64(); out.isReference = true; break;
+	case DW_FORM_ref_udata: out.value = unit.start + r.ULEB(); out.isReference = true; break;
+	case DW_FORM_flag_present: out.value = 1; break;
+	case DW_FORM_implicit_const: out.value = (u64)implicitConst; break;
+	case DW_FORM_indirect:
+		{
+			u64 actual = r.ULEB();
+			if (actual == DW_FORM_indirect || actual == DW_FORM_implicit_const)
+				return false;
+			return ReadForm(r, unit, actual, 0, out);
+		}
+	default:
+		// the size of anything else is unknown, the rest of the unit can't be decoded
+		return false;
+	}
+
+	return r.Ok();
+}
+
+// ------------------------------------------------------------------------------------------
+// .debug_line
+
+class LineTableBuilder
+{
+public:
+	struct Row
+	{
+		u32 address;
+		u32 line;
+		u32 file;
+	};
+
+	// files are deduplicated over all units
+	u32 AddFile(const std::string& path)
+	{
+		auto it = fileIndex_.find(path);
+		if (it != fileIndex_.end())
+			return it->second;
+
+		u32 index = (u32)files_.size();
+		files_.push_back(path);
+		fileIndex_[path] = index;
+		return index;
+	}
+
+	void AddRow(u32 address, u32 line, u32 file)
+	{
+		Row row = { address, line, file };
+		sequence_.push_back(row);
+	}
+
+	void EndSequence(u32 address)
+	{
+		// Sequences of functions the linker discarded are relocated to 0 (or -1 by newer
+		// linkers), they'd shadow whatever really lives there.
+		if (!sequence_.empty() && sequence_[0].address != 0 && sequence_[0].address != 0xffffffff) {
+			rows_.insert(rows_.end(), sequence_.begin(), sequence_.end());
+			Row end = { address, 0, NO_FILE };
+			rows_.push_back(end);
+		}
+		sequence_.clear();
+	}
+
+	void DiscardSequence() { sequence_.clear(); }
+
+	void Finish(std::vector<DwarfTables::LineRow>& lines, std::vector<std::string>& files)
+	{
+		// sequence ends sort before rows starting at the same address, and of several
+		// rows for one address the last one wins
+		std::stable_sort(rows_.begin(), rows_.end(), [](const Row& a, const Row& b) {
+			if (a.address != b.address)
+				return a.address < b.address;
+			return a.file == NO_FILE && b.file != NO_FILE;
+		});
+
+		lines.clear();
+		for (const Row& row : rows_) {
+			if (!lines.empty() && lines.back().address == row.address) {
+				lines.pop_back();
+			}
+
+			// consecutive rows for the same line only make the table bigger
+			if (!lines.empty() && lines.back().file == row.file && (row.file == NO_FILE || lines.back().line == row.line))
+				continue;
+
+			DwarfTables::LineRow dest = { row.address, row.line, row.file };
+			lines.push_back(dest);
+		}
+
+		lines.shrink_to_fit();
+		rows_.clear();
+		rows_.shrink_to_fit();
+		files = std::move(files_);
+	}
+
+private:
+	std::vector<Row> rows_;
+	std::vector<Row> sequence_;
+	std::vector<std::string> files_;
+	std::unordered_map<std::string, u32> fileIndex_;
+};
+
+static std::string JoinPath(const char* dir, const char* name)
+{
+	if (!dir || !*dir || name[0] == '/' || name[0] == '\\' || (name[0] && name[1] == ':'))
+		return name;
+
+	std::string path = dir;
+	if (path.back() != '/' && path.back() != '\\')
+		path += '/';
+	return path + name;
+}
+
+// DWARF 5 directory and file tables, described by a list of (content type, form) pairs.
+static bool ReadEntryTable(DwarfReader& r, const DwarfUnit& unit, std::vector<const char*>& paths, std::vector<u64>& dirs)
+{
+	u8 formatCount = r.U8();
+	std::vector<std::pair<u64, u64>> format;
+	for (u8 i = 0; i < formatCount; i++) {
+		u64 type = r.ULEB();
+		u64 form = r.ULEB();
+		format.push_back(std::make_pair(type, form));
+	}
+
+	u64 count = r.ULEB();
+	for (u64 i = 0; i < count && r.Ok(); i++) {
+		const char* path = "";
+		u64 dir = 0;
+		for (const auto& entry : format) {
+			DwarfValue value;
+			if (!ReadForm(r, unit, entry.second, 0, value))
+				return false;
+
+			if (entry.first == DW_LNCT_path && value.str)
+				path = value.str;
+			else if (entry.first == DW_LNCT_directory_index)
+				dir = value.value;
+		}
+
+		paths.push_back(path);
+		dirs.push_back(dir);
+	}
+
+	return r.Ok();
+}
+
+static bool ParseLineProgram(DwarfReader& r, const DwarfSections& sections, LineTableBuilder& builder)
+{
+	DwarfUnit unit;
+	unit.sections = &sections;
+	unit.start = r.Pos();
+	size_t end = r.UnitLength(unit.dwarf64);
+	unit.version = r.U16();
+	unit.addressSize = 4;
+
+	if (!r.Ok() || unit.version < 2 || unit.version > 5) {
+		r.Seek(end);
+		return r.Ok();
+	}
+
+	if (unit.version >= 5) {
+		unit.addressSize = r.U8();
+		r.U8();		// segment selector size
+	}
+
+	u64 headerLength = r.Offset(unit.dwarf64);
+	size_t program = r.Pos() + (size_t)std::min<u64>(headerLength, end - r.Pos());
+
+	u8 minInstLength = r.U8();
+	if (unit.version >= 4)
+		r.U8();		// maximum operations per instruction, VLIW only
+	r.U8();		// default_is_stmt
+	s8 lineBase = (s8)r.U8();
+	u8 lineRange = r.U8();
+	u8 opcodeBase = r.U8();
+
+	std::vector<u8> opcodeLengths;
+	for (int i = 1; i < opcodeBase; i++)
+		opcodeLengths.push_back(r.U8());
+
+	// unit file numbers to indices into the shared file table
+	std::vector<u32> files;
+	if (unit.version >= 5) {
+		std::vector<const char*> dirPaths, filePaths;
+		std::vector<u64> unused, fileDirs;
+		if (!ReadEntryTable(r, unit, dirPaths, unused) || !ReadEntryTable(r, unit, filePaths, fileDirs)) {
+			r.Seek(end);
+			return r.Ok();
+		}
+
+		for (size_t i = 0; i < filePaths.size(); i++) {
+			const char* dir = fileDirs[i] < dirPaths.size() ? dirPaths[(size_t)fileDirs[i]] : nullptr;
+			files.push_back(builder.AddFile(JoinPath(dir, filePaths[i])));
+		}
+	} else {
+		// directory 0 is the compilation directory, which isn't listed here
+		std::vector<const char*> dirs;
+		dirs.push_back(nullptr);
+		while (r.Ok()) {
+			const char* dir = r.CStr();
+			if (!*dir)
+				break;
+			dirs.push_back(dir);
+		}
+
+		// file 0 doesn't exist before DWARF 5
+		files.push_back(NO_FILE);
+		while (r.Ok()) {
+			const char* name = r.CStr();
+			if (!*name)
+				break;
+			u64 dir = r.ULEB();
+			r.ULEB();		// modification time
+			r.ULEB();		// length
+			files.push_back(builder.AddFile(JoinPath(dir < dirs.size() ? dirs[(size_t)dir] : nullptr, name)));
+		}
+	}
+
+	if (!r.Ok() || lineRange == 0) {
+		r.Seek(end);
+		return r.Ok();
+	}
+
+	r.Seek(program);
+
+	u32 address = 0;
+	u64 file = 1;
+	s64 line = 1;
+
+	auto fileIndex = [&]() {
+		return file < files.size() ? files[(size_t)file] : NO_FILE;
+	};
+
+	auto reset = [&]() {
+		address = 0;
+		file = 1;
+		line = 1;
+	};
+
+	while (r.Pos() < end && r.Ok()) {
+		u8 opcode = r.U8();
+
+		if (opcode >= opcodeBase) {
+			// special opcode, advances address and line and appends a row
+			u8 adjusted = opcode - opcodeBase;
+			address += (adjusted / lineRange) * minInstLength;
+			line += lineBase + (adjusted % lineRange);
+			builder.AddRow(address, (u32)line, fileIndex());
+			continue;
+		}
+
+		switch (opcode) {
+		case 0:
+			{
+				u64 length = r.ULEB();
+				size_t next = r.Pos() + (size_t)std::min<u64>(length, end - r.Pos());
+				u8 sub = length ? r.U8() : 0;
+				switch (sub) {
+				case 1:		// DW_LNE_end_sequence
+					builder.EndSequence(address);
+					reset();
+					break;
+				case 2:		// DW_LNE_set_address
+					address = (u32)r.Read((int)std::min<u64>(length - 1, 8));
+					break;
+				case 3:		// DW_LNE_define_file, deprecated and never emitted in practice
+					{
+						const char* name = r.CStr();
+						r.ULEB();
+						files.push_back(builder.AddFile(name));
+					}
+					break;
+				}
+				r.Seek(next);
+			}
+			break;
+		case 1:		// DW_LNS_copy
+			builder.AddRow(address, (u32)line, fileIndex());
+			break;
+		case 2:		// DW_LNS_advance_pc
+			address += (u32)r.ULEB() * minInstLength;
+			break;
+		case 3:		// DW_LNS_advance_line
+			line += r.SLEB();
+			break;
+		case 4:		// DW_LNS_set_file
+			file = r.ULEB();
+			break;
+		case 8:		// DW_LNS_const_add_pc
+			address += ((255 - opcodeBase) / lineRange) * minInstLength;
+			break;
+		case 9:		// DW_LNS_fixed_advance_pc
+			address += r.U16();
+			break;
+		default:
+			// set_column, negate_stmt, prologue_end, ... and vendor opcodes, which the
+			// header describes by their number of LEB128 operands
+			for (u8 i = 0; i < opcodeLengths[opcode - 1]; i++)
+				r.ULEB();
+			break;
+		}
+	}
+
+	// a truncated program leaves an unterminated sequence behind
+	builder.DiscardSequence();
+
+	r.Seek(end);
+	return r.Ok();
+}
+
+// ------------------------------------------------------------------------------------------
+// .debug_info
+
+struct DwarfAbbrev
+{
+	u64 tag;
+	bool children;
+	// attribute, form and the value of implicit constants
+	size_t firstSpec;
+	size_t specCount;
+};
+
+struct DwarfAttrSpec
+{
+	u64 attr;
+	u64 form;
+	s64 implicitConst;
+};
+
+class FunctionTableBuilder
+{
+public:
+	FunctionTableBuilder()
+	{
+		names_.push_back(0);
+	}
+
+	void Add(u32 start, u32 end, const char* name)
+	{
+		Function func = { start, end, AddName(name) };
+		functions_.push_back(func);
+	}
+
+	// out of line definitions name the function through a reference to its declaration,
+	// which usually lives in the same unit
+	void AddPendingName(size_t function, u64 reference)
+	{
+		pending_.push_back(std::make_pair(function, reference));
+	}
+
+	void AddDeclarationName(u64 offset, const char* name)
+	{
+		declarations_[offset] = name;
+	}
+
+	void ResolveUnit()
+	{
+		for (const auto& pending : pending_) {
+			auto it = declarations_.find(pending.second);
+			if (it != declarations_.end())
+				functions_[pending.first].name = AddName(it->second);
+		}
+
+		pending_.clear();
+		declarations_.clear();
+	}
+
+	size_t Count() const { return functions_.size(); }
+
+	void Finish(DwarfTables& tables)
+	{
+		std::sort(functions_.begin(), functions_.end(), [](const Function& a, const Function& b) {
+			return a.start < b.start;
+		});
+
+		for (const Function& func : functions_) {
+			// the same function from several units (inline functions emitted out of line)
+			if (!tables.functionStarts.empty() && tables.functionStarts.back() == func.start)
+				continue;
+
+			tables.functionStarts.push_back(func.start);
+			tables.functionEnds.push_back(func.end);
+			tables.functionNames.push_back(func.name);
+		}
+
+		tables.names = std::move(names_);
+		functions_.clear();
+		functions_.shrink_to_fit();
+	}
+
+private:
+	struct Function
+	{
+		u32 start;
+		u32 end;
+		u32 name;
+	};
+
+	u32 AddName(const char* name)
+	{
+		if (!name || !*name)
+			return 0;
+
+		u32 offset = (u32)names_.size();
+		names_.insert(names_.end(), name, name + strlen(name) + 1);
+		return offset;
+	}
+
+	std::vector<Function> functions_;
+	std::vector<char> names_;
+	std::vector<std::pair<size_t, u64>> pending_;
+	std::unordered_map<u64, const char*> declarations_;
+};
+
+static bool ReadAbbrevTable(const std::vector<u8>& section, u64 offset, std::vector<DwarfAbbrev>& abbrevs, std::vector<DwarfAttrSpec>& specs)
+{
+	abbrevs.clear();
+	specs.clear();
+	if (offset >= section.size())
+		return false;
+
+	DwarfReader r(section, (size_t)offset);
+	while (r.Ok()) {
+		u64 code = r.ULEB();
+		if (code == 0)
+			break;
+
+		// codes are handed out sequentially, anything else is garbage
+		if (code > 0x100000)
+			return false;
+
+		DwarfAbbrev abbrev;
+		abbrev.tag = r.ULEB();
+		abbrev.children = r.U8() != 0;
+		abbrev.firstSpec = specs.size();
+
+		while (r.Ok()) {
+			DwarfAttrSpec spec;
+			spec.attr = r.ULEB();
+			spec.form = r.ULEB();
+			spec.implicitConst = spec.form == DW_FORM_implicit_const ? r.SLEB() : 0;
+			if (spec.attr == 0 && spec.form == 0)
+				break;
+			specs.push_back(spec);
+		}
+
+		abbrev.specCount = specs.size() - abbrev.firstSpec;
+		if (abbrevs.size() <= code)
+			abbrevs.resize((size_t)code + 1, DwarfAbbrev{ 0, false, 0, 0 });
+		abbrevs[(size_t)code] = abbrev;
+	}
+
+	return r.Ok();
+}
+
+static bool ParseInfoUnit(DwarfReader& r, const DwarfSections& sections, FunctionTableBuilder& builder,
+	std::vector<DwarfAbbrev>& abbrevs, std::vector<DwarfAttrSpec>& specs)
+{
+	DwarfUnit unit;
+	unit.sections = &sections;
+	unit.start = r.Pos();
+	size_t end = r.UnitLength(unit.dwarf64);
+	unit.version = r.U16();
+
+	if (!r.Ok() || unit.version < 2 || unit.version > 5) {
+		r.Seek(end);
+		return r.Ok();
+	}
+
+	u64 abbrevOffset;
+	if (unit.version >= 5) {
+		u8 unitType = r.U8();
+		unit.addressSize = r.U8();
+		abbrevOffset = r.Offset(unit.dwarf64);
+
+		// only compile and partial units describe code, type units are skipped whole
+		if (unitType != 0x01 && unitType != 0x03) {
+			r.Seek(end);
+			return r.Ok();
+		}
+	} else {
+		abbrevOffset = r.Offset(unit.dwarf64);
+		unit.addressSize = r.U8();
+	}
+
+	if (!r.Ok() || unit.addressSize == 0 || unit.addressSize > 8 || !ReadAbbrevTable(sections.abbrev, abbrevOffset, abbrevs, specs)) {
+		r.Seek(end);
+		return r.Ok();
+	}
+
+	while (r.Pos() < end && r.Ok()) {
+		size_t offset = r.Pos();
+		u64 code = r.ULEB();
+		if (code == 0)
+			continue;		// end of a list of siblings
+
+		if (code >= abbrevs.size() || abbrevs[(size_t)code].tag == 0)
+			break;
+
+		// Attributes are decoded and dropped straight away, the tree is never built:
+		// only subprograms are of interest and they don't depend on their parents.
+		const DwarfAbbrev& abbrev = abbrevs[(size_t)code];
+		bool subprogram = abbrev.tag == DW_TAG_subprogram;
+		u64 lowPc = 0, highPc = 0, reference = 0;
+		bool hasLowPc = false, hasHighPc = false, highPcIsOffset = false;
+		const char* name = nullptr;
+		const char* linkageName = nullptr;
+
+		bool ok = true;
+		for (size_t i = 0; i < abbrev.specCount && ok; i++) {
+			const DwarfAttrSpec& spec = specs[abbrev.firstSpec + i];
+			DwarfValue value;
+			ok = ReadForm(r, unit, spec.form, spec.implicitConst, value);
+			if (!subprogram)
+				continue;
+
+			switch (spec.attr) {
+			case DW_AT_low_pc:
+				lowPc = value.value;
+				hasLowPc = value.isAddress;
+				break;
+			case DW_AT_high_pc:
+				highPc = value.value;
+				hasHighPc = !value.isReference;
+				highPcIsOffset = !value.isAddress;
+				break;
+			case DW_AT_name:
+				name = value.str;
+				break;
+			case DW_AT_linkage_name:
+			case DW_AT_MIPS_linkage_name:
+				linkageName = value.str;
+				break;
+			case DW_AT_specification:
+			case DW_AT_abstract_origin:
+				if (value.isReference)
+					reference = value.value;
+				break;
+			}
+		}
+
+		if (!ok)
+			break;
+
+		if (!subprogram)
+			continue;
+
+		if (!name)
+			name = linkageName;
+
+		if (name)
+			builder.AddDeclarationName(offset, name);
+
+		if (hasLowPc && hasHighPc && lowPc != 0) {
+			u64 highAddress = highPcIsOffset ? lowPc + highPc : highPc;
+			if (highAddress > lowPc && highAddress <= 0x100000000ULL) {
+				builder.Add((u32)lowPc, (u32)std::min<u64>(highAddress, 0xffffffff), name);
+				if (!name && reference)
+					builder.AddPendingName(builder.Count() - 1, reference);
+			}
+		}
+	}
+
+	builder.ResolveUnit();
+
+	r.Seek(end);
+	return r.Ok();
+}
+
+// ------------------------------------------------------------------------------------------
+
+void CDwarfInfo::LoaderThread(DwarfSections sections)
+{
+	auto tables = std::make_shared<DwarfTables>();
+
+	LineTableBuilder lines;
+	DwarfReader lineReader(sections.line);
+	while (!lineReader.AtEnd() && !cancel_) {
+		if (!ParseLineProgram(lineReader, sections, lines))
+			break;
+	}
+	lines.Finish(tables->lines, tables->files);
+
+	// the raw line program is the largest section, don't hold on to it any longer
+	std::vector<u8>().swap(sections.line);
+
+	FunctionTableBuilder functions;
+	std::vector<DwarfAbbrev> abbrevs;
+	std::vector<DwarfAttrSpec> specs;
+	DwarfReader infoReader(sections.info);
+	while (!infoReader.AtEnd() && !cancel_) {
+		if (!ParseInfoUnit(infoReader, sections, functions, abbrevs, specs))
+			break;
+	}
+	functions.Finish(*tables);
+
+	if (cancel_)
+		return;
+
+	Console.WriteLn("DWARF: loaded %u line entries in %u files and %u functions.",
+		(u32)tables->lines.size(), (u32)tables->files.size(), (u32)tables->functionStarts.size());
+
+	std::atomic_store(&tables_, std::shared_ptr<const DwarfTables>(tables));
+	loaded_ = true;
+
+	// Sized functions make the disassembly and the stack walker much more reliable than
+	// the heuristic scan, which only names what it finds "z_un_<address>".
+	char defaultName[64];
+	for (size_t i = 0; i < tables->functionStarts.size() && !cancel_; i++) {
+		u32 start = tables->functionStarts[i];
+		const char* name = tables->functionNames[i] ? &tables->names[tables->functionNames[i]] : nullptr;
+		if (!name) {
+			sprintf(defaultName, "z_un_%08x", start);
+			name = defaultName;
+		}
+
+		symbolMap.AddFunction(name, start, tables->functionEnds[i] - start);
+		if (name != defaultName && symbolMap.GetLabelString(start).compare(0, 5, "z_un_") == 0)
+			symbolMap.SetLabelName(name, start, false);
+	}
+
+	if (!cancel_)
+		symbolMap.UpdateActiveSymbols();
+}
+
+static std::shared_ptr<const DwarfTables> GetTables()
+{
+	return std::atomic_load(&tables_);
+}
+
+void CDwarfInfo::Load(DwarfSections sections)
+{
+	std::lock_guard<std::mutex> guard(loaderLock_);
+	loader_.Stop();
+
+	loaded_ = false;
+	std::atomic_store(&tables_, std::shared_ptr<const DwarfTables>(std::make_shared<DwarfTables>()));
+
+	if (sections.line.empty() && sections.info.empty())
+		return;
+
+	loader_.thread = std::thread(&CDwarfInfo::LoaderThread, std::move(sections));
+}
+
+void CDwarfInfo::Clear()
+{
+	std::lock_guard<std::mutex> guard(loaderLock_);
+	loader_.Stop();
+
+	loaded_ = false;
+	std::atomic_store(&tables_, std::shared_ptr<const DwarfTables>(std::make_shared<DwarfTables>()));
+}
+
+bool CDwarfInfo::IsLoaded()
+{
+	return loaded_;
+}
+
+bool CDwarfInfo::GetSourceLine(u32 address, std::string& file, u32& line)
+{
+	const auto tables = GetTables();
+	const auto& lines = tables->lines;
+
+	auto it = std::upper_bound(lines.begin(), lines.end(), address, [](u32 addr, const DwarfTables::LineRow& row) {
+		return addr < row.address;
+	});
+	if (it == lines.begin())
+		return false;
+
+	--it;
+	if (it->file == NO_FILE || it->file >= tables->files.size())
+		return false;
+
+	file = tables->files[it->file];
+	line = it->line;
+	return true;
+}
+
+bool CDwarfInfo::GetFunction(u32 address, DwarfFunction& function)
+{
+	const auto tables = GetTables();
+	const auto& starts = tables->functionStarts;
+
+	auto it = std::upper_bound(starts.begin(), starts.end(), address);
+	if (it == starts.begin())
+		return false;
+
+	size_t index = it - starts.begin() - 1;
+	if (address >= tables->functionEnds[index])
+		return false;
+
+	function.start = starts[index];
+	function.end = tables->functionEnds[index];
+	function.name = tables->functionNames[index] ? &tables->names[tables->functionNames[index]] : "";
+	return true;
+}
@@ -0,0 +1,62 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "Pcsx2Types.h"
+
+// Source lines and function ranges from the DWARF debug info of the running ELF (versions
+// 2 to 5, as emitted by the PS2 SDK and by current homebrew toolchains). The sections are
+// parsed on a background thread: the line programs and the DIEs are walked once and only
+// the resulting address tables are kept, so booting doesn't wait on large ELFs.
+
+// Copies of the ELF sections the loader needs, missing ones are left empty.
+struct DwarfSections
+{
+	std::vector<u8> info;
+	std::vector<u8> abbrev;
+	std::vector<u8> line;
+	std::vector<u8> str;
+	std::vector<u8> lineStr;
+};
+
+struct DwarfFunction
+{
+	u32 start;
+	u32 end;		// exclusive
+	std::string name;
+};
+
+class CDwarfInfo
+{
+public:
+	// Replaces whatever was loaded before. Once parsed, the functions are also added to
+	// the symbol map.
+	static void Load(DwarfSections sections);
+	static void Clear();
+
+	// false while nothing is loaded or the loader is still busy
+	static bool IsLoaded();
+
+	static bool GetSourceLine(u32 address, std::string& file, u32& line);
+	static bool GetFunction(u32 address, DwarfFunction& function);
+
+private:
+	static void LoaderThread(DwarfSections sections);
+};
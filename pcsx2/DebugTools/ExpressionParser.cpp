@@ -403,193 +403,333 @@ bool initPostfixExpression(const char* infix, IExpressionFunctions* funcs, Postf
 	return true;
 }
 
-bool parsePostfixExpression(PostfixExpression& exp, IExpressionFunctions* funcs, u64& dest)
+// deeper than any expression fitting in a breakpoint condition
+static const size_t COMPILED_EXPRESSION_STACK_SIZE = 64;
+
+bool compilePostfixExpression(const PostfixExpression& exp, IExpressionFunctions* funcs, CompiledExpression& dest)
 {
 	size_t num = 0;
-	u64 opcode;
-	std::vector<u64> valueStack;
-	u64 arg[5] = {0};
-	float fArg[5] = {0};
+	size_t stackSize = 0;
 	bool useFloat = false;
+	dest.clear();
 
 	while (num < exp.size())
 	{
+		CompiledExpressionOp op = {};
+
 		switch (exp[num].first)
 		{
 		case EXCOMM_CONST:	// konstante zahl
-			valueStack.push_back(exp[num++].second);
+			op.type = CEXOP_CONST;
+			op.value = exp[num++].second;
 			break;
 		case EXCOMM_CONST_FLOAT:
 			useFloat = true;
-			valueStack.push_back(exp[num++].second);
+			op.type = CEXOP_CONST;
+			op.value = exp[num++].second;
 			break;
 		case EXCOMM_REF:
-			useFloat = useFloat || funcs->getReferenceType(exp[num].second) == EXPR_TYPE_FLOAT;
-			opcode = funcs->getReferenceValue(exp[num++].second);
-			valueStack.push_back(opcode);
-			break;
-		case EXCOMM_OP:	// opcode
-			opcode = exp[num++].second;
-			if (valueStack.size() < ExpressionOpcodes[opcode].args)
 			{
-				sprintf(expressionError,"Not enough arguments");
-				return false;
-			}
-			for (int l = 0; l < ExpressionOpcodes[opcode].args; l++)
-			{
-				arg[l] = valueStack[valueStack.size()-1];
-				fArg[l] = arg[l];
-				valueStack.pop_back();
-			}
+				u64 reference = exp[num++].second;
+				useFloat = useFloat || funcs->getReferenceType(reference) == EXPR_TYPE_FLOAT;
 
-			switch (opcode)
+				int size = 0;
+				const void* ptr = funcs->getReferencePointer(reference,size);
+				if (ptr != NULL && (size == 4 || size == 8))
+				{
+					op.type = size == 4 ? CEXOP_LOAD32 : CEXOP_LOAD64;
+					op.value = (uptr)ptr;
+				} else {
+					op.type = CEXOP_REF;
+					op.value = reference;
+				}
+			}
+			break;
+		case EXCOMM_OP:	// opcode
 			{
-			case EXOP_MEMSIZE:	// must be followed by EXOP_MEM
-				if (exp[num++].second != EXOP_MEM)
+				u64 opcode = exp[num++].second;
+				if (opcode >= EXOP_COUNT || ExpressionOpcodes[opcode].args == 0)
 				{
-					sprintf(expressionError,"Invalid memsize operator");
+					sprintf(expressionError,"Invalid expression");
 					return false;
 				}
 
-				u64 val;
-				if(!funcs->getMemoryValue(arg[1],arg[0],val,expressionError))
+				op.args = ExpressionOpcodes[opcode].args;
+				if (stackSize < op.args)
 				{
+					sprintf(expressionError,"Not enough arguments");
 					return false;
 				}
-				valueStack.push_back(val);
-				break;
-			case EXOP_MEM:
+
+				switch (opcode)
 				{
-					u64 val;
-					if (!funcs->getMemoryValue(arg[0],4,val,expressionError))
+				case EXOP_MEMSIZE:	// must be followed by EXOP_MEM
+					if (num >= exp.size() || exp[num++].second != EXOP_MEM)
 					{
+						sprintf(expressionError,"Invalid memsize operator");
 						return false;
 					}
-					valueStack.push_back(val);
-				}
-				break;
-			case EXOP_SIGNPLUS:		// keine aktion ntig
-				break;
-			case EXOP_SIGNMINUS:	// -0
-				if (useFloat)
-					valueStack.push_back(0.0-fArg[0]);
-				else
-					valueStack.push_back(0-arg[0]);
-				break;
-			case EXOP_BITNOT:			// ~b
-				valueStack.push_back(~arg[0]);
-				break;
-			case EXOP_LOGNOT:			// !b
-				valueStack.push_back(!arg[0]);
-				break;
-			case EXOP_MUL:			// a*b
-				if (useFloat)
-					valueStack.push_back(fArg[1]*fArg[0]);
-				else
-					valueStack.push_back(arg[1]*arg[0]);
-				break;
-			case EXOP_DIV:			// a/b
-				if (arg[0] == 0)
-				{
-					sprintf(expressionError,"Division by zero");
-					return false;
-				}
-				if (useFloat)
-					valueStack.push_back(fArg[1]/fArg[0]);
-				else
-					valueStack.push_back(arg[1]/arg[0]);
-				break;
-			case EXOP_MOD:			// a%b
-				if (arg[0] == 0)
-				{
-					sprintf(expressionError,"Modulo by zero");
-					return false;
-				}
-				valueStack.push_back(arg[1]%arg[0]);
-				break;
-			case EXOP_ADD:			// a+b
-				if (useFloat)
-					valueStack.push_back(fArg[1]+fArg[0]);
-				else
-					valueStack.push_back(arg[1]+arg[0]);
-				break;
-			case EXOP_SUB:			// a-b
-				if (useFloat)
-					valueStack.push_back(fArg[1]-fArg[0]);
-				else
-					valueStack.push_back(arg[1]-arg[0]);
-				break;
-			case EXOP_SHL:			// a<<b
-				valueStack.push_back(arg[1]<<arg[0]);
-				break;
-			case EXOP_SHR:			// a>>b
-				valueStack.push_back(arg[1]>>arg[0]);
-				break;
-			case EXOP_GREATEREQUAL:		// a >= b
-				if (useFloat)
-					valueStack.push_back(fArg[1]>=fArg[0]);
-				else
-					valueStack.push_back(arg[1]>=arg[0]);
-				break;
-			case EXOP_GREATER:			// a > b
-				if (useFloat)
-					valueStack.push_back(fArg[1]>fArg[0]);
-				else
-					valueStack.push_back(arg[1]>arg[0]);
-				break;
-			case EXOP_LOWEREQUAL:		// a <= b
-				if (useFloat)
-					valueStack.push_back(fArg[1]<=fArg[0]);
-				else
-					valueStack.push_back(arg[1]<=arg[0]);
-				break;
-			case EXOP_LOWER:			// a < b
-				if (useFloat)
-					valueStack.push_back(fArg[1]<fArg[0]);
-				else
-					valueStack.push_back(arg[1]<arg[0]);
-				break;
-			case EXOP_EQUAL:		// a == b
-				valueStack.push_back(arg[1]==arg[0]);
-				break;
-			case EXOP_NOTEQUAL:			// a != b
-				valueStack.push_back(arg[1]!=arg[0]);
-				break;
-			case EXOP_BITAND:			// a&b
-				valueStack.push_back(arg[1]&arg[0]);
-				break;
-			case EXOP_XOR:			// a^b
-				valueStack.push_back(arg[1]^arg[0]);
-				break;
-			case EXOP_BITOR:			// a|b
-				valueStack.push_back(arg[1]|arg[0]);
-				break;
-			case EXOP_LOGAND:			// a && b
-				valueStack.push_back(arg[1]&&arg[0]);
-				break;
-			case EXOP_LOGOR:			// a || b
-				valueStack.push_back(arg[1]||arg[0]);
-				break;
-			case EXOP_TERTIF:			// darf so nicht vorkommen
-				return false;
-			case EXOP_TERTELSE:			// exp ? exp : exp, else muss zuerst kommen!
-				if (exp[num++].second != EXOP_TERTIF)
-				{
-					sprintf(expressionError,"Invalid tertiary operator");
-					return false;
+					op.type = CEXOP_MEMSIZE;
+					break;
+				case EXOP_MEM:
+					op.type = CEXOP_MEM;
+					op.size = 4;
+					break;
+				case EXOP_TERTELSE:			// exp ? exp : exp, else muss zuerst kommen!
+					if (num >= exp.size() || exp[num++].second != EXOP_TERTIF)
+					{
+						sprintf(expressionError,"Invalid tertiary operator");
+						return false;
+					}
+					op.type = CEXOP_OPERATOR;
+					op.value = opcode;
+					break;
+				default:
+					op.type = CEXOP_OPERATOR;
+					op.value = opcode;
+					break;
 				}
-				valueStack.push_back(arg[2]?arg[1]:arg[0]);
-				break;
+
+				op.useFloat = useFloat;
+				stackSize -= op.args;
 			}
 			break;
+		default:
+			sprintf(expressionError,"Invalid expression");
+			return false;
 		}
+
+		// every op leaves exactly one value behind
+		if (++stackSize > COMPILED_EXPRESSION_STACK_SIZE)
+		{
+			sprintf(expressionError,"Expression too complex");
+			return false;
+		}
+		dest.push_back(op);
+	}
+
+	return stackSize == 1;
+}
+
+static bool applyExpressionOperator(u64 opcode, const u64* arg, bool useFloat, u64& dest)
+{
+	float fArg[3] = {0};
+	for (int l = 0; l < ExpressionOpcodes[opcode].args; l++)
+		fArg[l] = arg[l];
+
+	switch (opcode)
+	{
+	case EXOP_SIGNPLUS:
+		dest = arg[0];
+		break;
+	case EXOP_SIGNMINUS:	// -0
+		if (useFloat)
+			dest = 0.0-fArg[0];
+		else
+			dest = 0-arg[0];
+		break;
+	case EXOP_BITNOT:			// ~b
+		dest = ~arg[0];
+		break;
+	case EXOP_LOGNOT:			// !b
+		dest = !arg[0];
+		break;
+	case EXOP_MUL:			// a*b
+		if (useFloat)
+			dest = fArg[1]*fArg[0];
+		else
+			dest = arg[1]*arg[0];
+		break;
+	case EXOP_DIV:			// a/b
+		if (arg[0] == 0)
+		{
+			sprintf(expressionError,"Division by zero");
+			return false;
+		}
+		if (useFloat)
+			dest = fArg[1]/fArg[0];
+		else
+			dest = arg[1]/arg[0];
+		break;
+	case EXOP_MOD:			// a%b
+		if (arg[0] == 0)
+		{
+			sprintf(expressionError,"Modulo by zero");
+			return false;
+		}
+		dest = arg[1]%arg[0];
+		break;
+	case EXOP_ADD:			// a+b
+		if (useFloat)
+			dest = fArg[1]+fArg[0];
+		else
+			dest = arg[1]+arg[0];
+		break;
+	case EXOP_SUB:			// a-b
+		if (useFloat)
+			dest = fArg[1]-fArg[0];
+		else
+			dest = arg[1]-arg[0];
+		break;
+	case EXOP_SHL:			// a<<b
+		dest = arg[1]<<arg[0];
+		break;
+	case EXOP_SHR:			// a>>b
+		dest = arg[1]>>arg[0];
+		break;
+	case EXOP_GREATEREQUAL:		// a >= b
+		if (useFloat)
+			dest = fArg[1]>=fArg[0];
+		else
+			dest = arg[1]>=arg[0];
+		break;
+	case EXOP_GREATER:			// a > b
+		if (useFloat)
+			dest = fArg[1]>fArg[0];
+		else
+			dest = arg[1]>arg[0];
+		break;
+	case EXOP_LOWEREQUAL:		// a <= b
+		if (useFloat)
+			dest = fArg[1]<=fArg[0];
+		else
+			dest = arg[1]<=arg[0];
+		break;
+	case EXOP_LOWER:			// a < b
+		if (useFloat)
+			dest = fArg[1]<fArg[0];
+		else
+			dest = arg[1]<arg[0];
+		break;
+	case EXOP_EQUAL:		// a == b
+		dest = arg[1]==arg[0];
+		break;
+	case EXOP_NOTEQUAL:			// a != b
+		dest = arg[1]!=arg[0];
+		break;
+	case EXOP_BITAND:			// a&b
+		dest = arg[1]&arg[0];
+		break;
+	case EXOP_XOR:			// a^b
+		dest = arg[1]^arg[0];
+		break;
+	case EXOP_BITOR:			// a|b
+		dest = arg[1]|arg[0];
+		break;
+	case EXOP_LOGAND:			// a && b
+		dest = arg[1]&&arg[0];
+		break;
+	case EXOP_LOGOR:			// a || b
+		dest = arg[1]||arg[0];
+		break;
+	case EXOP_TERTELSE:			// exp ? exp : exp
+		dest = arg[2]?arg[1]:arg[0];
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+bool evaluateCompiledExpression(const CompiledExpression& exp, IExpressionFunctions* funcs, u64& dest)
+{
+	u64 valueStack[COMPILED_EXPRESSION_STACK_SIZE];
+	size_t sp = 0;
+
+	if (exp.empty())
+		return false;
+
+	// the stack depth was already checked by compilePostfixExpression
+	for (const CompiledExpressionOp& op : exp)
+	{
+		u64 arg[3];
+		for (int l = 0; l < op.args; l++)
+			arg[l] = valueStack[--sp];
+
+		u64 value;
+		switch (op.type)
+		{
+		case CEXOP_CONST:
+			value = op.value;
+			break;
+		case CEXOP_LOAD32:
+			value = *(const u32*)(uptr)op.value;
+			break;
+		case CEXOP_LOAD64:
+			value = *(const u64*)(uptr)op.value;
+			break;
+		case CEXOP_REF:
+			value = funcs->getReferenceValue(op.value);
+			break;
+		case CEXOP_MEM:
+			if (!funcs->getMemoryValue(arg[0],op.size,value,expressionError))
+				return false;
+			break;
+		case CEXOP_MEMSIZE:
+			if (!funcs->getMemoryValue(arg[1],arg[0],value,expressionError))
+				return false;
+			break;
+		case CEXOP_OPERATOR:
+			if (!applyExpressionOperator(op.value,arg,op.useFloat,value))
+				return false;
+			break;
+		default:
+			return false;
+		}
+
+		valueStack[sp++] = value;
 	}
 
-	if (valueStack.size() != 1) return false;
 	dest = valueStack[0];
 	return true;
 }
 
+bool getSimpleExpression(const CompiledExpression& exp, SimpleExpression& dest)
+{
+	if (exp.size() != 3)
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		u8 type = exp[i].type;
+		if (type != CEXOP_CONST && type != CEXOP_LOAD32 && type != CEXOP_LOAD64)
+			return false;
+	}
+
+	const CompiledExpressionOp& op = exp[2];
+	if (op.type != CEXOP_OPERATOR)
+		return false;
+
+	switch (op.value)
+	{
+	case EXOP_EQUAL:		dest.compare = EXCMP_EQUAL; break;
+	case EXOP_NOTEQUAL:		dest.compare = EXCMP_NOTEQUAL; break;
+	case EXOP_GREATEREQUAL:	dest.compare = EXCMP_GREATEREQUAL; break;
+	case EXOP_GREATER:		dest.compare = EXCMP_GREATER; break;
+	case EXOP_LOWEREQUAL:	dest.compare = EXCMP_LOWEREQUAL; break;
+	case EXOP_LOWER:		dest.compare = EXCMP_LOWER; break;
+	default:
+		return false;
+	}
+
+	// float compares convert their operands first, leave those to the evaluator
+	if (op.useFloat && op.value != EXOP_EQUAL && op.value != EXOP_NOTEQUAL)
+		return false;
+
+	dest.left = exp[0];
+	dest.right = exp[1];
+	return true;
+}
+
+bool parsePostfixExpression(PostfixExpression& exp, IExpressionFunctions* funcs, u64& dest)
+{
+	CompiledExpression compiled;
+	if (!compilePostfixExpression(exp,funcs,compiled))
+		return false;
+	return evaluateCompiledExpression(compiled,funcs,dest);
+}
+
 bool parseExpression(char* exp, IExpressionFunctions* funcs, u64& dest)
 {
 	PostfixExpression postfix;
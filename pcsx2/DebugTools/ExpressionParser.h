@@ -27,6 +27,46 @@ enum ExpressionType
 	EXPR_TYPE_FLOAT = 2,
 };
 
+// A postfix expression lowered once into a flat program for repeated evaluation
+// (breakpoint conditions). Operands are resolved up front: register references become
+// direct loads when IExpressionFunctions can provide a pointer, and each operator
+// knows whether it works on floats, so no lookups are needed while evaluating.
+enum CompiledExpressionOpType
+{
+	CEXOP_CONST,		// push value
+	CEXOP_LOAD32,		// push *(u32*)value
+	CEXOP_LOAD64,		// push *(u64*)value
+	CEXOP_REF,			// push getReferenceValue(value)
+	CEXOP_MEM,			// pop address, push memory value of size bytes
+	CEXOP_MEMSIZE,		// pop size and address, push memory value
+	CEXOP_OPERATOR,		// apply operator value to the top args values
+};
+
+struct CompiledExpressionOp
+{
+	u8 type;
+	u8 args;
+	u8 size;
+	bool useFloat;
+	u64 value;
+};
+
+typedef std::vector<CompiledExpressionOp> CompiledExpression;
+
+// Comparison of two plain operands, the form most breakpoint conditions take
+// ("a0 == 0x1234"). The recompilers emit these inline.
+enum SimpleExpressionCompare
+{
+	EXCMP_EQUAL, EXCMP_NOTEQUAL, EXCMP_GREATEREQUAL, EXCMP_GREATER, EXCMP_LOWEREQUAL, EXCMP_LOWER
+};
+
+struct SimpleExpression
+{
+	CompiledExpressionOp left;
+	CompiledExpressionOp right;
+	SimpleExpressionCompare compare;
+};
+
 class IExpressionFunctions
 {
 public:
@@ -35,9 +75,15 @@ public:
 	virtual u64 getReferenceValue(u64 referenceIndex) = 0;
 	virtual ExpressionType getReferenceType(u64 referenceIndex) = 0;
 	virtual bool getMemoryValue(u32 address, int size, u64& dest, char* error) = 0;
+	// Storage of a reference for compiled expressions, size is 4 or 8 bytes (zero extended).
+	// References without a fixed location are read through getReferenceValue instead.
+	virtual const void* getReferencePointer(u64 referenceIndex, int& size) { return NULL; }
 };
 
 bool initPostfixExpression(const char* infix, IExpressionFunctions* funcs, PostfixExpression& dest);
 bool parsePostfixExpression(PostfixExpression& exp, IExpressionFunctions* funcs, u64& dest);
 bool parseExpression(const char* exp, IExpressionFunctions* funcs, u64& dest);
+bool compilePostfixExpression(const PostfixExpression& exp, IExpressionFunctions* funcs, CompiledExpression& dest);
+bool evaluateCompiledExpression(const CompiledExpression& exp, IExpressionFunctions* funcs, u64& dest);
+bool getSimpleExpression(const CompiledExpression& exp, SimpleExpression& dest);
 const char* getExpressionError();
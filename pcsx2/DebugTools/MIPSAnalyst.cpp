@@ -18,10 +18,17 @@
 #include "Debug.h"
 #include "DebugInterface.h"
 #include "SymbolMap.h"
+#include "DwarfInfo.h"
 #include "DebugInterface.h"
 #include "../R5900.h"
+#include "../Memory.h"
 #include "../R5900OpcodeTables.h"
 
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <unordered_map>
+
 static std::vector<MIPSAnalyst::AnalyzedFunction> functions;
 
 #define MIPS_MAKE_J(addr)   (0x08000000 | ((addr)>>2))
@@ -36,12 +43,25 @@ static std::vector<MIPSAnalyst::AnalyzedFunction> functions;
 #define OP_SYSCALL_MASK 0xFC00003F
 #define _RS   ((op>>21) & 0x1F)
 #define _RT   ((op>>16) & 0x1F)
+#define MIPS_REG_SP 29
+#define MIPS_REG_FP 30
+#define MIPS_REG_RA 31
 
 namespace MIPSAnalyst
 {
+	// The scan runs on worker threads while the EE is stopped. Game code lives in main RAM,
+	// reading it directly saves the TLB lookup and keeps the threads away from IO handlers.
+	static __fi u32 ReadCode(u32 addr)
+	{
+		u32 phys = addr & 0x1fffffff;
+		if (phys >= Ps2MemSize::MainRam || addr % 4)
+			return -1;
+		return *(u32*)&eeMem->Main[phys];
+	}
+
 	u32 GetJumpTarget(u32 addr)
 	{
-		u32 op = r5900Debug.read32(addr);
+		u32 op = ReadCode(addr);
 		const R5900::OPCODE& opcode = R5900::GetInstruction(op);
 
 		if ((opcode.flags & IS_BRANCH) && (opcode.flags & BRANCHTYPE_MASK) == BRANCHTYPE_JUMP)
@@ -55,7 +75,7 @@ namespace MIPSAnalyst
 
 	u32 GetBranchTarget(u32 addr)
 	{
-		u32 op = r5900Debug.read32(addr);
+		u32 op = ReadCode(addr);
 		const R5900::OPCODE& opcode = R5900::GetInstruction(op);
 		
 		int branchType = (opcode.flags & BRANCHTYPE_MASK);
@@ -67,7 +87,7 @@ namespace MIPSAnalyst
 	
 	u32 GetBranchTargetNoRA(u32 addr)
 	{
-		u32 op = r5900Debug.read32(addr);
+		u32 op = ReadCode(addr);
 		const R5900::OPCODE& opcode = R5900::GetInstruction(op);
 		
 		int branchType = (opcode.flags & BRANCHTYPE_MASK);
@@ -84,7 +104,7 @@ namespace MIPSAnalyst
 
 	u32 GetSureBranchTarget(u32 addr)
 	{
-		u32 op = r5900Debug.read32(addr);
+		u32 op = ReadCode(addr);
 		const R5900::OPCODE& opcode = R5900::GetInstruction(op);
 		
 		if ((opcode.flags & IS_BRANCH) && (opcode.flags & BRANCHTYPE_MASK) == BRANCHTYPE_BRANCH)
@@ -155,7 +175,7 @@ namespace MIPSAnalyst
 		u32 furthestJumpbackAddr = INVALIDTARGET;
 
 		for (u32 ahead = fromAddr; ahead < fromAddr + MAX_AHEAD_SCAN; ahead += 4) {
-			u32 aheadOp = r5900Debug.read32(ahead);
+			u32 aheadOp = ReadCode(ahead);
 			u32 target = GetBranchTargetNoRA(ahead);
 			if (target == INVALIDTARGET && ((aheadOp & 0xFC000000) == 0x08000000)) {
 				target = GetJumpTarget(ahead);
@@ -179,7 +199,7 @@ namespace MIPSAnalyst
 
 		if (closestJumpbackAddr != INVALIDTARGET && furthestJumpbackAddr == INVALIDTARGET) {
 			for (u32 behind = closestJumpbackTarget; behind < fromAddr; behind += 4) {
-				u32 behindOp = r5900Debug.read32(behind);
+				u32 behindOp = ReadCode(behind);
 				u32 target = GetBranchTargetNoRA(behind);
 				if (target == INVALIDTARGET && ((behindOp & 0xFC000000) == 0x08000000)) {
 					target = GetJumpTarget(behind);
@@ -196,36 +216,51 @@ namespace MIPSAnalyst
 		return furthestJumpbackAddr;
 	}
 
-	void ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols) {
-		AnalyzedFunction currentFunction = {startAddr};
+	// Scans functions from start, which has to be where one begins, until one begins at or
+	// after stopAddr. Returns that address, or INVALIDTARGET once endAddr was reached.
+	// What a scan finds only depends on where it started, so two scans reaching the same
+	// function start find the same functions from there on.
+	static u32 ScanFunctions(u32 start, u32 stopAddr, u32 endAddr, std::vector<AnalyzedFunction>& found) {
+		AnalyzedFunction currentFunction = {start};
 
 		u32 furthestBranch = 0;
 		bool looking = false;
 		bool end = false;
 		bool isStraightLeaf = true;
 
-		functions.clear();
-
 		u32 addr;
-		for (addr = startAddr; addr <= endAddr; addr += 4) {
+		for (addr = start; addr <= endAddr; addr += 4) {
+			if (addr == currentFunction.start && addr >= stopAddr && addr != start)
+				return addr;
+
 			// Use pre-existing symbol map info if available. May be more reliable.
 			SymbolInfo syminfo;
-			if (symbolMap.GetSymbolInfo(&syminfo, addr, ST_FUNCTION)) {
+			DwarfFunction dwarfFunc;
+			bool known = symbolMap.GetSymbolInfo(&syminfo, addr, ST_FUNCTION);
+			if (!known && CDwarfInfo::GetFunction(addr, dwarfFunc)) {
+				// the debug info knows the exact bounds, no need to guess them
+				syminfo.address = dwarfFunc.start;
+				syminfo.size = dwarfFunc.end - dwarfFunc.start;
+				known = true;
+			}
+
+			if (known) {
 				addr = syminfo.address + syminfo.size - 4;
 
 				// We still need to insert the func for hashing purposes.
 				currentFunction.start = syminfo.address;
 				currentFunction.end = syminfo.address + syminfo.size - 4;
-				functions.push_back(currentFunction);
+				currentFunction.isStraightLeaf = isStraightLeaf;
+				found.push_back(currentFunction);
 				currentFunction.start = addr + 4;
 				furthestBranch = 0;
 				looking = false;
 				end = false;
+				isStraightLeaf = true;
 				continue;
 			}
 
-			u32 op = r5900Debug.read32(addr);
-
+			u32 op = ReadCode(addr);
 			u32 target = GetBranchTargetNoRA(addr);
 			if (target != INVALIDTARGET) {
 				isStraightLeaf = false;
@@ -294,12 +329,12 @@ namespace MIPSAnalyst
 			if (end) {
 				// most functions are aligned to 8 or 16 bytes
 				// add the padding to this one
-				while (((addr+8) % 16)  && r5900Debug.read32(addr+8) == 0)
+				while (((addr+8) % 16)  && ReadCode(addr+8) == 0)
 					addr += 4;
 
 				currentFunction.end = addr + 4;
 				currentFunction.isStraightLeaf = isStraightLeaf;
-				functions.push_back(currentFunction);
+				found.push_back(currentFunction);
 				furthestBranch = 0;
 				addr += 4;
 				looking = false;
@@ -311,15 +346,406 @@ namespace MIPSAnalyst
 		}
 
 		currentFunction.end = addr + 4;
-		functions.push_back(currentFunction);
+		currentFunction.isStraightLeaf = isStraightLeaf;
+		found.push_back(currentFunction);
+		return INVALIDTARGET;
+	}
+
+	// Continues a scan at next until a function begins at or after limit. Functions of an
+	// earlier scan (known, continuing at knownNext after its last one) are taken over where
+	// the two line up, as far as usable allows, instead of being scanned again.
+	static u32 MergeScan(u32 next, u32 limit, u32 endAddr, const std::vector<AnalyzedFunction>& known,
+		const std::vector<bool>& usable, u32 knownNext, std::vector<AnalyzedFunction>& result) {
+		while (next != INVALIDTARGET && next < limit) {
+			auto it = std::lower_bound(known.begin(), known.end(), next, [](const AnalyzedFunction& func, u32 addr) {
+				return func.start < addr;
+			});
+
+			size_t index = it - known.begin();
+			if (it != known.end() && it->start == next && usable[index]) {
+				result.push_back(*it);
+				next = index + 1 < known.size() ? known[index + 1].start : knownNext;
+			} else {
+				next = ScanFunctions(next, next + 4, endAddr, result);
+			}
+		}
+
+		return next;
+	}
+
+	// Splits the range into one chunk per thread. All but the first chunk start at a guess,
+	// the scan of each chunk is then continued into the next one until it meets a function
+	// found there, which usually takes no more than a function or two.
+	static void ScanParallel(u32 startAddr, u32 endAddr, std::vector<AnalyzedFunction>& result) {
+		static const u32 MIN_CHUNK_SIZE = 0x10000;
+
+		u32 length = endAddr > startAddr ? endAddr - startAddr : 0;
+		u32 chunks = std::min(std::max(std::thread::hardware_concurrency(), 1u), length / MIN_CHUNK_SIZE + 1);
+		u32 chunkSize = (length / chunks + 15) & ~15;
+
+		std::vector<u32> bounds(chunks + 1);
+		for (u32 i = 0; i < chunks; i++)
+			bounds[i] = startAddr + i * chunkSize;
+		bounds[chunks] = INVALIDTARGET;
+
+		std::vector<std::vector<AnalyzedFunction>> pieces(chunks);
+		std::vector<u32> nexts(chunks);
+		std::vector<std::thread> workers;
+		for (u32 i = 1; i < chunks; i++) {
+			workers.emplace_back([&, i]() {
+				nexts[i] = ScanFunctions(bounds[i], bounds[i + 1], endAddr, pieces[i]);
+			});
+		}
+
+		nexts[0] = ScanFunctions(bounds[0], bounds[1], endAddr, pieces[0]);
+		for (auto& worker : workers)
+			worker.join();
+
+		u32 next = startAddr;
+		std::vector<bool> usable;
+		for (u32 i = 0; i < chunks; i++) {
+			usable.assign(pieces[i].size(), true);
+			next = MergeScan(next, bounds[i + 1], endAddr, pieces[i], usable, nexts[i], result);
+		}
+	}
+
+	static u64 HashFunction(const AnalyzedFunction& func) {
+		// FNV-1a over the instruction words
+		u64 hash = 0xcbf29ce484222325ULL;
+		for (u32 addr = func.start; addr <= func.end; addr += 4) {
+			hash ^= ReadCode(addr);
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
 
+	struct ScanCacheHeader {
+		u32 magic;
+		u32 version;
+		u32 startAddr;
+		u32 endAddr;
+		u32 count;
+	};
+
+	struct ScanCacheEntry {
+		u32 start;
+		u32 end;
+		u64 hash;
+		u32 isStraightLeaf;
+		u32 reserved;
+	};
+
+	static const u32 SCAN_CACHE_MAGIC = 0x534e5546;	// "FUNS"
+	static const u32 SCAN_CACHE_VERSION = 1;
+
+	static bool LoadScanCache(const wxString& filename, u32 startAddr, u32 endAddr, std::vector<AnalyzedFunction>& cached) {
+		FILE* f = wxFopen(filename, L"rb");
+		if (!f)
+			return false;
+
+		ScanCacheHeader header;
+		bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == SCAN_CACHE_MAGIC && header.version == SCAN_CACHE_VERSION
+			&& header.startAddr == startAddr && header.endAddr == endAddr;
+
+		// the count comes from disk: no more functions than there are instructions, and no
+		// more entries than the file holds
+		if (ok) {
+			const u64 maxCount = endAddr >= startAddr ? (u64)(endAddr - startAddr) / 4 + 1 : 0;
+			ok = header.count != 0 && header.count <= maxCount;
+		}
+		if (ok) {
+			const long dataStart = ftell(f);
+			ok = dataStart >= 0 && fseek(f, 0, SEEK_END) == 0;
+			const long fileSize = ok ? ftell(f) : -1;
+			ok = ok && fileSize >= dataStart && (u64)(fileSize - dataStart) >= (u64)header.count * sizeof(ScanCacheEntry)
+				&& fseek(f, dataStart, SEEK_SET) == 0;
+		}
+
+		std::vector<ScanCacheEntry> entries;
+		if (ok) {
+			entries.resize(header.count);
+			ok = fread(entries.data(), sizeof(ScanCacheEntry), header.count, f) == header.count;
+		}
+		fclose(f);
+
+		if (!ok)
+			return false;
+
+		for (const ScanCacheEntry& entry : entries) {
+			AnalyzedFunction func = {entry.start};
+			func.end = entry.end;
+			func.hash = entry.hash;
+			func.hasHash = true;
+			func.isStraightLeaf = entry.isStraightLeaf != 0;
+			cached.push_back(func);
+		}
+		return true;
+	}
+
+	static void SaveScanCache(const wxString& filename, u32 startAddr, u32 endAddr) {
+		FILE* f = wxFopen(filename, L"wb");
+		if (!f) {
+			Console.Warning(L"Could not write the function cache %s", WX_STR(filename));
+			return;
+		}
+
+		ScanCacheHeader header = { SCAN_CACHE_MAGIC, SCAN_CACHE_VERSION, startAddr, endAddr, (u32)functions.size() };
+		std::vector<ScanCacheEntry> entries;
+		for (const AnalyzedFunction& func : functions) {
+			ScanCacheEntry entry = { func.start, func.end, func.hash, func.isStraightLeaf ? 1u : 0u, 0 };
+			entries.push_back(entry);
+		}
+
+		bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(entries.data(), sizeof(ScanCacheEntry), entries.size(), f) == entries.size();
+		fclose(f);
+
+		// a partial file would only be rejected next time
+		if (!ok)
+			wxRemoveFile(filename);
+	}
+
+	void ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols, const wxString& cacheFile) {
+		functions.clear();
+
+		// Functions whose code is unchanged since the last run are taken from the cache,
+		// the rest is scanned again.
+		std::vector<AnalyzedFunction> cached;
+		if (!cacheFile.IsEmpty() && LoadScanCache(cacheFile, startAddr, endAddr, cached)) {
+			std::vector<bool> usable(cached.size());
+			for (size_t i = 0; i < cached.size(); i++)
+				usable[i] = HashFunction(cached[i]) == cached[i].hash;
+
+			if (std::find(usable.begin(), usable.end(), true) != usable.end())
+				MergeScan(startAddr, INVALIDTARGET, endAddr, cached, usable, INVALIDTARGET, functions);
+		}
+
+		if (functions.empty())
+			ScanParallel(startAddr, endAddr, functions);
+
+		bool changed = false;
 		for (auto iter = functions.begin(); iter != functions.end(); iter++) {
 			iter->size = iter->end - iter->start + 4;
+			if (!iter->hasHash) {
+				iter->hash = HashFunction(*iter);
+				iter->hasHash = true;
+				changed = true;
+			}
+
 			if (insertSymbols) {
 				char temp[256];
-				symbolMap.AddFunction(DefaultFunctionName(temp, iter->start), iter->start, iter->end - iter->start + 4);
+				DwarfFunction dwarfFunc;
+				if (CDwarfInfo::GetFunction(iter->start, dwarfFunc) && dwarfFunc.start == iter->start && !dwarfFunc.name.empty())
+					symbolMap.AddFunction(dwarfFunc.name.c_str(), iter->start, iter->end - iter->start + 4);
+				else
+					symbolMap.AddFunction(DefaultFunctionName(temp, iter->start), iter->start, iter->end - iter->start + 4);
 			}
 		}
+
+		if (!cacheFile.IsEmpty() && changed)
+			SaveScanCache(cacheFile, startAddr, endAddr);
+	}
+
+	// Reads the code a frame scan looks at a page at a time, EE pages in one go
+	class FrameScanReader {
+	public:
+		FrameScanReader(DebugInterface* cpu) : cpu(cpu), page(INVALIDTARGET), valid(false), low(INVALIDTARGET) {}
+
+		bool Read(u32 addr, u32& op) {
+			u32 base = addr & ~0xfff;
+			if (base != page) {
+				page = base;
+				if (cpu->getCpuType() == BREAKPOINT_EE) {
+					valid = cpu->readMemory(base, sizeof(words), words);
+				} else {
+					valid = cpu->isValidAddress(base);
+					for (u32 i = 0; valid && i < 0x400; i++)
+						words[i] = cpu->read32(base + i * 4);
+				}
+			}
+			if (!valid)
+				return false;
+
+			low = std::min(low, addr);
+			op = words[(addr & 0xfff) / 4];
+			return true;
+		}
+
+		// lowest address read so far
+		u32 Low() const { return low; }
+
+	private:
+		DebugInterface* cpu;
+		u32 page;
+		bool valid;
+		u32 low;
+		u32 words[0x400];
+	};
+
+	static bool IsSWInstr(const R5900::OPCODE& op) {
+		if ((op.flags & IS_MEMORY) && (op.flags & IS_STORE))
+		{
+			switch (op.flags & MEMTYPE_MASK)
+			{
+			case MEMTYPE_WORD:
+			case MEMTYPE_DWORD:
+			case MEMTYPE_QWORD:
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static bool IsAddImmInstr(const R5900::OPCODE& op) {
+		if (op.flags & IS_ALU)
+			return (op.flags & ALUTYPE_MASK) == ALUTYPE_ADDI;
+
+		return false;
+	}
+
+	static bool IsMovRegsInstr(const R5900::OPCODE& op, u32 rawOp) {
+		if (op.flags & IS_ALU)
+			return (op.flags & ALUTYPE_MASK) == ALUTYPE_ADDI && (MIPS_GET_RS(rawOp) == 0 || MIPS_GET_RT(rawOp) == 0);
+
+		return false;
+	}
+
+	static bool ScanForAllocaSignature(FrameScanReader& reader, u32 pc) {
+		// In God Eater Burst, for example, after 0880E750, there's what looks like an alloca().
+		// It's surrounded by "mov fp, sp" and "mov sp, fp", which is unlikely to be used for other reasons.
+
+		// It ought to be pretty close.
+		const u32 start = pc;
+		u32 stop = pc - 32 * 4;
+		u32 rawOp;
+		for (; pc >= stop && pc <= start && reader.Read(pc, rawOp); pc -= 4) {
+			const R5900::OPCODE& op = R5900::GetInstruction(rawOp);
+
+			// We're looking for a "mov fp, sp" close by a "addiu sp, sp, -N".
+			if (IsMovRegsInstr(op, rawOp) && MIPS_GET_RD(rawOp) == MIPS_REG_FP && (MIPS_GET_RS(rawOp) == MIPS_REG_SP || MIPS_GET_RT(rawOp) == MIPS_REG_SP)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool ScanFrameLayout(FrameScanReader& reader, u32 start, u32 stop, FrameLayout& layout) {
+		int ra_offset = -1;
+		u32 rawOp;
+		for (u32 pc = start; pc >= stop && pc <= start && reader.Read(pc, rawOp); pc -= 4) {
+			const R5900::OPCODE& op = R5900::GetInstruction(rawOp);
+
+			// Here's where they store the ra address.
+			if (IsSWInstr(op) && MIPS_GET_RT(rawOp) == MIPS_REG_RA && MIPS_GET_RS(rawOp) == MIPS_REG_SP) {
+				ra_offset = (s16)(rawOp & 0xFFFF);
+			}
+
+			if (IsAddImmInstr(op) && MIPS_GET_RT(rawOp) == MIPS_REG_SP && MIPS_GET_RS(rawOp) == MIPS_REG_SP) {
+				// A positive imm either means alloca() or we went too far.
+				if ((s16)(rawOp & 0xFFFF) > 0) {
+					continue;
+				}
+				if (ScanForAllocaSignature(reader, pc)) {
+					continue;
+				}
+
+				layout.entry = pc;
+				layout.stackSize = -(s16)(rawOp & 0xFFFF);
+				layout.raOffset = ra_offset;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// A scan is reused while the pages it read keep their generation. Pages whose writes
+	// aren't tracked are covered by a hash of the code instead.
+	struct FrameScan {
+		bool found;
+		FrameLayout layout;
+		u32 low;
+		u32 high;
+		std::vector<u32> generations;
+		bool hashed;
+		u64 hash;
+	};
+
+	// enough for the functions a profiling session walks through
+	static const size_t MAX_FRAME_SCANS = 65536;
+
+	static std::unordered_map<u64, FrameScan> frameScans[2];
+	static std::mutex frameScansMutex;
+
+	static bool HashFrameScanCode(DebugInterface* cpu, u32 low, u32 high, u64& hash) {
+		FrameScanReader reader(cpu);
+		hash = 0xcbf29ce484222325ULL;
+		u32 op;
+		for (u32 addr = low & ~3; addr <= high; addr += 4) {
+			if (!reader.Read(addr, op))
+				return false;
+			hash ^= op;
+			hash *= 0x100000001b3ULL;
+		}
+		return true;
+	}
+
+	static bool IsFrameScanValid(DebugInterface* cpu, const FrameScan& scan) {
+		u32 page = scan.low & ~0xfff;
+		for (u32 generation : scan.generations) {
+			if (cpu->getPageGeneration(page) != generation)
+				return false;
+			page += 0x1000;
+		}
+
+		u64 hash;
+		return !scan.hashed || (HashFrameScanCode(cpu, scan.low, scan.high, hash) && hash == scan.hash);
+	}
+
+	bool GetFrameLayout(DebugInterface* cpu, u32 pc, u32 stop, FrameLayout& layout) {
+		std::lock_guard<std::mutex> lock(frameScansMutex);
+		std::unordered_map<u64, FrameScan>& scans = frameScans[cpu->getCpuType() == BREAKPOINT_IOP ? 1 : 0];
+		const u64 key = ((u64)pc << 32) | stop;
+
+		auto it = scans.find(key);
+		if (it != scans.end()) {
+			if (IsFrameScanValid(cpu, it->second)) {
+				layout = it->second.layout;
+				return it->second.found;
+			}
+			scans.erase(it);
+		}
+
+		FrameScanReader reader(cpu);
+		FrameScan scan;
+		scan.layout.entry = INVALIDTARGET;
+		scan.layout.stackSize = 0;
+		scan.layout.raOffset = -1;
+		scan.found = ScanFrameLayout(reader, pc, stop, scan.layout);
+		scan.low = std::min(reader.Low(), pc);
+		scan.high = pc;
+		scan.hashed = false;
+		scan.hash = 0;
+
+		const u32 pages = (scan.high >> 12) - (scan.low >> 12) + 1;
+		for (u32 i = 0; i < pages; i++) {
+			u32 generation = cpu->getPageGeneration((scan.low & ~0xfff) + i * 0x1000);
+			scan.hashed |= generation == 0;
+			scan.generations.push_back(generation);
+		}
+		if (scan.hashed && !HashFrameScanCode(cpu, scan.low, scan.high, scan.hash))
+			scan.generations.clear();
+
+		layout = scan.layout;
+		bool found = scan.found;
+
+		// unreadable code can't be checked later, it's scanned again next time
+		if (scan.generations.empty())
+			return found;
+
+		if (scans.size() >= MAX_FRAME_SCANS)
+			scans.clear();
+		scans.emplace(key, std::move(scan));
+		return found;
 	}
 
 	MipsOpcodeInfo GetOpcodeInfo(DebugInterface* cpu, u32 address) {
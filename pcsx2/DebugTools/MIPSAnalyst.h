@@ -39,7 +39,20 @@ namespace MIPSAnalyst
 		char name[64];
 	};
 
-	void ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols);
+	// With a cache file, functions whose code didn't change since the last scan of the
+	// same ELF are reused instead of being scanned again.
+	void ScanForFunctions(u32 startAddr, u32 endAddr, bool insertSymbols, const wxString& cacheFile = wxEmptyString);
+
+	// How the function around pc set up its stack frame, found by scanning back from pc
+	// to stop for the sp adjustment of its prologue. The result is cached until the code
+	// it was taken from changes, so unwinding the same frames again is cheap.
+	struct FrameLayout {
+		u32 entry;		// the instruction adjusting sp
+		int stackSize;
+		int raOffset;	// sp relative slot ra was saved to before pc, -1 if none
+	};
+
+	bool GetFrameLayout(DebugInterface* cpu, u32 pc, u32 stop, FrameLayout& layout);
 
 	enum LoadStoreLRType { LOADSTORE_NORMAL, LOADSTORE_LEFT, LOADSTORE_RIGHT };
 
@@ -26,6 +26,9 @@
 class DebugInterface;
 
 namespace MipsStackWalk {
+	// After this we assume we're stuck.
+	const size_t MAX_DEPTH = 1024;
+
 	struct StackFrame {
 		// Beginning of function symbol (may be estimated.)
 		u32 entry;
@@ -37,5 +40,5 @@ namespace MipsStackWalk {
 		int stackSize;
 	};
 
-	std::vector<StackFrame> Walk(DebugInterface* cpu, u32 pc, u32 ra, u32 sp, u32 threadEntry, u32 threadStackTop);
+	std::vector<StackFrame> Walk(DebugInterface* cpu, u32 pc, u32 ra, u32 sp, u32 threadEntry, u32 threadStackTop, size_t maxDepth = MAX_DEPTH);
 };
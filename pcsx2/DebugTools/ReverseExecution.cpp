@@ -0,0 +1,693 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ReverseExecution.h"
+#include "Breakpoints.h"
+#include "DebugControl.h"
+#include "IopCommon.h"
+#include "SaveState.h"
+#include "VUmicro.h"
+#include "System/SysThreads.h"
+
+// a snapshot about once a second
+static const u32 SNAPSHOT_INTERVAL = 60;
+static const size_t MAX_SNAPSHOTS = 120;
+static const u64 MAX_HISTORY_BYTES = 512 * _1mb;
+static const u32 UNDO_PAGE_SIZE = 0x1000;
+
+// how far a replay may run past the cycle the reverse operation started at before it
+// gives up looking for it
+static const u64 POSITION_SLACK = 4 * 1000 * 1000;
+static const size_t MAX_CANDIDATES = 4096;
+static const int REPLAY_TIMEOUT_MS = 60 * 1000;
+
+std::mutex CReverseExecution::mutex_;
+std::deque<std::unique_ptr<ReverseSnapshot>> CReverseExecution::snapshots_;
+std::vector<u8> CReverseExecution::memoryShadow_;
+std::vector<u8> CReverseExecution::internalsShadow_;
+u64 CReverseExecution::historyBytes_ = 0;
+
+std::atomic<bool> CReverseExecution::recording_(false);
+std::atomic<bool> CReverseExecution::scanning_(false);
+bool CReverseExecution::counting_ = false;
+bool CReverseExecution::exitRequested_ = false;
+bool CReverseExecution::snapshotDue_ = false;
+u32 CReverseExecution::vsyncs_ = 0;
+u64 CReverseExecution::cycleBase_ = 0;
+u32 CReverseExecution::eeCycleBase_ = 0;
+
+bool CReverseExecution::replayed_ = false;
+size_t CReverseExecution::replayedSnapshot_ = 0;
+u64 CReverseExecution::replayedCycle_ = 0;
+
+bool CReverseExecution::replaying_ = false;
+CReverseExecution::ReplayMode CReverseExecution::mode_ = REPLAY_SCAN;
+size_t CReverseExecution::replaySnapshot_ = 0;
+size_t CReverseExecution::nextExit_ = 0;
+u64 CReverseExecution::target_ = 0;
+u64 CReverseExecution::end_ = 0;
+u64 CReverseExecution::hits_ = 0;
+u64 CReverseExecution::instructions_ = 0;
+const CReverseExecution::Position* CReverseExecution::now_ = NULL;
+bool CReverseExecution::landed_ = false;
+s64 CReverseExecution::lastHit_ = -1;
+s64 CReverseExecution::prevHit_ = -1;
+s64 CReverseExecution::lastHitBefore_ = -1;
+bool CReverseExecution::lastHitIsNow_ = false;
+s64 CReverseExecution::lastInstructionBefore_ = -1;
+std::vector<CReverseExecution::Candidate> CReverseExecution::candidates_;
+
+// Saving the internals needs a buffer of a few MB, it's kept around between snapshots
+static std::unique_ptr<VmStateBuffer> saveBuffer;
+
+struct ImageChunk
+{
+	u8* data;
+	size_t size;
+};
+
+// Same layout as SaveStateBase::FreezeMainMemory, all sizes are a multiple of a page.
+static int getMemoryChunks(ImageChunk* chunks)
+{
+	int count = 0;
+	chunks[count++] = { eeMem->Main, Ps2MemSize::MainRam };
+	chunks[count++] = { eeMem->Scratch, Ps2MemSize::Scratch };
+	chunks[count++] = { eeHw, Ps2MemSize::Hardware };
+	chunks[count++] = { iopMem->Main, Ps2MemSize::IopRam };
+	chunks[count++] = { iopHw, Ps2MemSize::IopHardware };
+	chunks[count++] = { vuRegs[0].Micro, VU0_PROGSIZE };
+	chunks[count++] = { vuRegs[0].Mem, VU0_MEMSIZE };
+	chunks[count++] = { vuRegs[1].Micro, VU1_PROGSIZE };
+	chunks[count++] = { vuRegs[1].Mem, VU1_MEMSIZE };
+	return count;
+}
+
+// Brings shadow up to date with the chunks, the old contents of every page that changed
+// end up in undo.
+static void diffImage(std::vector<u8>& shadow, const ImageChunk* chunks, int count, ReverseUndo& undo)
+{
+	size_t size = 0;
+	for (int i = 0; i < count; i++)
+		size += chunks[i].size;
+
+	undo.size = (u32)shadow.size();
+
+	if (shadow.size() != size)
+	{
+		// nothing to compare against, keep the whole previous image
+		for (u32 page = 0; page * UNDO_PAGE_SIZE < shadow.size(); page++)
+			undo.pages.push_back(page);
+		undo.data.swap(shadow);
+
+		shadow.resize(size);
+		size_t offset = 0;
+		for (int i = 0; i < count; i++)
+		{
+			memcpy(&shadow[offset], chunks[i].data, chunks[i].size);
+			offset += chunks[i].size;
+		}
+		return;
+	}
+
+	size_t offset = 0;
+	for (int i = 0; i < count; i++)
+	{
+		for (size_t pos = 0; pos < chunks[i].size; pos += UNDO_PAGE_SIZE)
+		{
+			size_t length = std::min<size_t>(UNDO_PAGE_SIZE, chunks[i].size - pos);
+			u8* old = &shadow[offset + pos];
+			if (memcmp(old, chunks[i].data + pos, length) == 0)
+				continue;
+
+			undo.pages.push_back((u32)((offset + pos) / UNDO_PAGE_SIZE));
+			undo.data.insert(undo.data.end(), old, old + length);
+			memcpy(old, chunks[i].data + pos, length);
+		}
+		offset += chunks[i].size;
+	}
+}
+
+static void applyUndo(std::vector<u8>& image, const ReverseUndo& undo)
+{
+	image.resize(undo.size);
+
+	size_t pos = 0;
+	for (u32 page : undo.pages)
+	{
+		size_t offset = (size_t)page * UNDO_PAGE_SIZE;
+		size_t length = std::min<size_t>(UNDO_PAGE_SIZE, undo.size - offset);
+		memcpy(&image[offset], &undo.data[pos], length);
+		pos += length;
+	}
+}
+
+static void clearUndo(ReverseUndo& undo)
+{
+	undo.size = 0;
+	std::vector<u32>().swap(undo.pages);
+	std::vector<u8>().swap(undo.data);
+}
+
+static u64 getSnapshotBytes(const ReverseSnapshot& snapshot)
+{
+	return snapshot.memory.GetBytes() + snapshot.internals.GetBytes() + snapshot.exits.size() * sizeof(u64);
+}
+
+static u64 getDistance(u64 a, u64 b)
+{
+	return a > b ? a - b : b - a;
+}
+
+bool CReverseExecution::Start()
+{
+	// the VU1 thread runs at its own pace, replays wouldn't be deterministic
+	if (THREAD_VU1)
+	{
+		Console.Warning("Reverse execution isn't available with MTVU enabled.");
+		return false;
+	}
+
+	recording_ = true;
+	return true;
+}
+
+void CReverseExecution::Stop()
+{
+	recording_ = false;
+	Clear();
+}
+
+void CReverseExecution::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	snapshots_.clear();
+	std::vector<u8>().swap(memoryShadow_);
+	std::vector<u8>().swap(internalsShadow_);
+	historyBytes_ = 0;
+	replayed_ = false;
+	vsyncs_ = 0;
+}
+
+void CReverseExecution::GetStatus(ReverseStatus& status)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	status.recording = recording_;
+	status.snapshots = (u32)snapshots_.size();
+	status.span = snapshots_.empty() ? 0 : CurrentCycle() - snapshots_.front()->cycle;
+	status.bytes = historyBytes_ + memoryShadow_.size() + internalsShadow_.size();
+}
+
+u64 CReverseExecution::CurrentCycle()
+{
+	return cycleBase_ + (u32)(cpuRegs.cycle - eeCycleBase_);
+}
+
+void CReverseExecution::GetPosition(Position& pos)
+{
+	pos.cycle = CurrentCycle();
+	pos.pc = cpuRegs.pc;
+	pos.iopPc = psxRegs.pc;
+	pos.iopStop = CDebugControl::StoppedAtBreakpoint() && CDebugControl::GetStopCpu() == BREAKPOINT_IOP;
+	memcpy(pos.registers, &cpuRegs.GPR, sizeof(cpuRegs.GPR));
+	memcpy(pos.registers + sizeof(cpuRegs.GPR), &cpuRegs.HI, sizeof(cpuRegs.HI));
+	memcpy(pos.registers + sizeof(cpuRegs.GPR) + sizeof(cpuRegs.HI), &cpuRegs.LO, sizeof(cpuRegs.LO));
+}
+
+bool CReverseExecution::MatchesPosition(u32 pc)
+{
+	return pc == now_->pc
+		&& memcmp(now_->registers, &cpuRegs.GPR, sizeof(cpuRegs.GPR)) == 0
+		&& memcmp(now_->registers + sizeof(cpuRegs.GPR), &cpuRegs.HI, sizeof(cpuRegs.HI)) == 0
+		&& memcmp(now_->registers + sizeof(cpuRegs.GPR) + sizeof(cpuRegs.HI), &cpuRegs.LO, sizeof(cpuRegs.LO)) == 0;
+}
+
+void CReverseExecution::VsyncInThread()
+{
+	if (!recording_)
+		return;
+
+	// keeps the timeline going when cpuRegs.cycle wraps around
+	cycleBase_ = CurrentCycle();
+	eeCycleBase_ = cpuRegs.cycle;
+
+	if (replaying_)
+	{
+		// the recorded run left the recompiler at these vsyncs, so has the replay
+		if (replaySnapshot_ + 1 < snapshots_.size() && cycleBase_ >= snapshots_[replaySnapshot_ + 1]->cycle)
+		{
+			exitRequested_ = cycleBase_ == snapshots_[++replaySnapshot_]->cycle;
+			nextExit_ = 0;
+		}
+		else
+		{
+			const std::vector<u64>& exits = snapshots_[replaySnapshot_]->exits;
+			while (nextExit_ < exits.size() && exits[nextExit_] < cycleBase_)
+				nextExit_++;
+			if (nextExit_ < exits.size() && exits[nextExit_] == cycleBase_)
+			{
+				nextExit_++;
+				exitRequested_ = true;
+			}
+		}
+
+		if (end_ != 0 && cycleBase_ >= end_)
+			GetCoreThread().PauseSelfDebug();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	TruncateHistory();
+
+	if (!snapshots_.empty() && GetCoreThread().HasPendingStateChangeRequest())
+	{
+		snapshots_.back()->exits.push_back(cycleBase_);
+		historyBytes_ += sizeof(u64);
+	}
+
+	if (snapshots_.empty() || ++vsyncs_ >= SNAPSHOT_INTERVAL)
+	{
+		snapshotDue_ = true;
+		exitRequested_ = true;
+	}
+}
+
+void CReverseExecution::StateCheckInThread()
+{
+	if (!exitRequested_)
+		return;
+
+	exitRequested_ = false;
+	if (snapshotDue_ && !replaying_)
+	{
+		snapshotDue_ = false;
+		vsyncs_ = 0;
+		TakeSnapshot();
+	}
+}
+
+void CReverseExecution::TakeSnapshot()
+{
+	if (!recording_ || !GetCoreThread().HasActiveMachine())
+		return;
+
+	std::unique_ptr<ReverseSnapshot> snapshot(new ReverseSnapshot());
+	snapshot->cycle = CurrentCycle();
+	snapshot->eeCycle = cpuRegs.cycle;
+
+	if (!saveBuffer)
+		saveBuffer.reset(new VmStateBuffer(L"Reverse execution snapshot"));
+
+	size_t size;
+	try
+	{
+		memSavingState state(*saveBuffer);
+		state.FreezeInternals().FreezePlugins();
+		size = state.GetCurrentPos();
+	}
+	catch (BaseException& ex)
+	{
+		Console.Error(L"Reverse execution: saving a snapshot failed: " + ex.FormatDiagnosticMessage());
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	TruncateHistory();
+
+	ImageChunk internals = { saveBuffer->GetPtr(), size };
+	diffImage(internalsShadow_, &internals, 1, snapshot->internals);
+
+	ImageChunk memory[16];
+	diffImage(memoryShadow_, memory, getMemoryChunks(memory), snapshot->memory);
+
+	if (snapshots_.empty())
+	{
+		clearUndo(snapshot->memory);
+		clearUndo(snapshot->internals);
+	}
+
+	historyBytes_ += getSnapshotBytes(*snapshot);
+	snapshots_.push_back(std::move(snapshot));
+
+	// the oldest snapshot doesn't need undo data, nothing goes back past it
+	while (snapshots_.size() > 1 && (snapshots_.size() > MAX_SNAPSHOTS || historyBytes_ > MAX_HISTORY_BYTES))
+	{
+		historyBytes_ -= getSnapshotBytes(*snapshots_.front());
+		snapshots_.pop_front();
+
+		ReverseSnapshot& oldest = *snapshots_.front();
+		historyBytes_ -= oldest.memory.GetBytes() + oldest.internals.GetBytes();
+		clearUndo(oldest.memory);
+		clearUndo(oldest.internals);
+	}
+}
+
+// The core continued from a replayed position, what was recorded after it never happened.
+void CReverseExecution::TruncateHistory()
+{
+	if (!replayed_)
+		return;
+
+	replayed_ = false;
+	while (snapshots_.size() > replayedSnapshot_ + 1)
+	{
+		ReverseSnapshot& last = *snapshots_.back();
+		applyUndo(memoryShadow_, last.memory);
+		applyUndo(internalsShadow_, last.internals);
+		historyBytes_ -= getSnapshotBytes(last);
+		snapshots_.pop_back();
+	}
+
+	std::vector<u64>& exits = snapshots_[replayedSnapshot_]->exits;
+	std::vector<u64>::iterator later = std::upper_bound(exits.begin(), exits.end(), replayedCycle_);
+	historyBytes_ -= (exits.end() - later) * sizeof(u64);
+	exits.erase(later, exits.end());
+}
+
+bool CReverseExecution::Restore(size_t index)
+{
+	std::vector<u8> memory(memoryShadow_);
+	std::vector<u8> internals(internalsShadow_);
+	for (size_t i = snapshots_.size() - 1; i > index; i--)
+	{
+		applyUndo(memory, snapshots_[i]->memory);
+		applyUndo(internals, snapshots_[i]->internals);
+	}
+
+	ImageChunk chunks[16];
+	int count = getMemoryChunks(chunks);
+	size_t offset = 0;
+	for (int i = 0; i < count; i++)
+	{
+		memcpy(chunks[i].data, &memory[offset], chunks[i].size);
+		offset += chunks[i].size;
+	}
+
+	VmStateBuffer buffer(L"Reverse execution snapshot");
+	buffer.MakeRoomFor(internals.size());
+	memcpy(buffer.GetPtr(), internals.data(), internals.size());
+
+	try
+	{
+		memLoadingState state(buffer);
+		state.FreezeInternals().FreezePlugins();
+	}
+	catch (BaseException& ex)
+	{
+		Console.Error(L"Reverse execution: restoring a snapshot failed: " + ex.FormatDiagnosticMessage());
+		return false;
+	}
+
+	cycleBase_ = snapshots_[index]->cycle;
+	eeCycleBase_ = snapshots_[index]->eeCycle;
+
+	replayed_ = true;
+	replayedSnapshot_ = index;
+	replayedCycle_ = cycleBase_;
+	return true;
+}
+
+bool CReverseExecution::Replay(size_t index, ReplayMode mode, u64 target, u64 end)
+{
+	replaying_ = true;
+	counting_ = true;
+	mode_ = mode;
+	target_ = target;
+	end_ = end;
+	replaySnapshot_ = index;
+	nextExit_ = 0;
+	hits_ = 0;
+	instructions_ = 0;
+	landed_ = false;
+
+	if (!Restore(index))
+		return false;
+
+	// the replay has to hit breakpoints at the pcs we are stopped at right now
+	CBreakPoints::SetSkipFirst(BREAKPOINT_EE, 0);
+	CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, 0);
+
+	u32 sequence = CpuStateNotifier::GetSequence();
+	if (!GetCoreThread().ResumeDebug())
+		return false;
+
+	if (!CpuStateNotifier::WaitForPause(sequence, REPLAY_TIMEOUT_MS))
+	{
+		Console.Error("Reverse execution: the replay didn't stop in time.");
+		r5900Debug.pauseCpu();
+		return false;
+	}
+
+	replayedCycle_ = CurrentCycle();
+	return true;
+}
+
+bool CReverseExecution::Scan(size_t index, const Position* now, u64 end, ScanResult& result)
+{
+	now_ = now;
+	lastHit_ = -1;
+	prevHit_ = -1;
+	lastHitIsNow_ = false;
+	lastHitBefore_ = -1;
+	lastInstructionBefore_ = -1;
+	candidates_.clear();
+
+	if (!Replay(index, REPLAY_SCAN, 0, end))
+		return false;
+
+	result.instructions = instructions_;
+	if (now == NULL)
+	{
+		result.instruction = (s64)instructions_ - 1;
+		result.hit = lastHit_;
+		return true;
+	}
+
+	// the match closest to the recorded cycle is where we started
+	const Candidate* best = NULL;
+	for (const Candidate& candidate : candidates_)
+	{
+		if (best == NULL || getDistance(candidate.cycle, now->cycle) < getDistance(best->cycle, now->cycle))
+			best = &candidate;
+	}
+
+	if (best != NULL)
+	{
+		result.instruction = (s64)best->instruction - 1;
+		result.hit = best->lastHit;
+	}
+	else
+	{
+		DevCon.Warning("Reverse execution: the current position wasn't found again, going by cycles.");
+		result.instruction = lastInstructionBefore_;
+		result.hit = lastHitBefore_;
+	}
+	return true;
+}
+
+size_t CReverseExecution::FindSnapshotBefore(u64 cycle)
+{
+	size_t count = replayed_ ? replayedSnapshot_ + 1 : snapshots_.size();
+	for (size_t i = count; i > 0; i--)
+	{
+		if (snapshots_[i - 1]->cycle < cycle)
+			return i - 1;
+	}
+	return (size_t)-1;
+}
+
+ReverseResult CReverseExecution::StopAtBegin()
+{
+	return Restore(0) ? REVERSE_HISTORY_BEGIN : REVERSE_FAILED;
+}
+
+void CReverseExecution::Finish()
+{
+	replaying_ = false;
+	counting_ = false;
+	scanning_ = false;
+	exitRequested_ = false;
+	now_ = NULL;
+	end_ = 0;
+	candidates_.clear();
+
+	// drops the instruction callbacks and tells the debugger window
+	CBreakPoints::Update();
+}
+
+ReverseResult CReverseExecution::ContinueBack()
+{
+	if (!recording_ || !r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return REVERSE_FAILED;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (snapshots_.empty())
+		return REVERSE_FAILED;
+
+	Position now;
+	GetPosition(now);
+
+	ReverseResult result = REVERSE_FAILED;
+	size_t index = FindSnapshotBefore(now.cycle);
+	const Position* pos = &now;
+	u64 end = now.cycle + POSITION_SLACK;
+
+	scanning_ = true;
+	while (true)
+	{
+		if (index == (size_t)-1)
+		{
+			result = StopAtBegin();
+			break;
+		}
+
+		ScanResult scan;
+		if (!Scan(index, pos, end, scan))
+			break;
+
+		if (scan.hit >= 0)
+		{
+			// only the run to the hit is shown
+			scanning_ = false;
+			if (Replay(index, REPLAY_STOP_AT_HIT, scan.hit, end) && landed_)
+				result = REVERSE_STOPPED;
+			break;
+		}
+
+		// nothing in there, look through the whole interval before it
+		end = snapshots_[index]->cycle;
+		pos = NULL;
+		index = index == 0 ? (size_t)-1 : index - 1;
+	}
+
+	Finish();
+	return result;
+}
+
+ReverseResult CReverseExecution::StepBack(BreakPointCpu cpu)
+{
+	if (cpu != BREAKPOINT_EE || !recording_ || !r5900Debug.isAlive() || !r5900Debug.isCpuPaused())
+		return REVERSE_FAILED;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (snapshots_.empty())
+		return REVERSE_FAILED;
+
+	Position now;
+	GetPosition(now);
+
+	ReverseResult result = REVERSE_FAILED;
+	size_t index = FindSnapshotBefore(now.cycle);
+	const Position* pos = &now;
+	u64 end = now.cycle + POSITION_SLACK;
+
+	scanning_ = true;
+	while (true)
+	{
+		if (index == (size_t)-1)
+		{
+			result = StopAtBegin();
+			break;
+		}
+
+		ScanResult scan;
+		if (!Scan(index, pos, end, scan))
+			break;
+
+		if (scan.instruction >= 0)
+		{
+			scanning_ = false;
+			if (Replay(index, REPLAY_STOP_AT_INSTRUCTION, scan.instruction, end) && landed_)
+				result = REVERSE_STOPPED;
+			break;
+		}
+
+		// we are at the first instruction after a snapshot, the previous one is the last
+		// instruction of the interval before it
+		end = snapshots_[index]->cycle;
+		pos = NULL;
+		index = index == 0 ? (size_t)-1 : index - 1;
+	}
+
+	Finish();
+	return result;
+}
+
+bool CReverseExecution::BreakpointHit(BreakPointCpu cpu, u32 pc)
+{
+	if (!replaying_)
+		return true;
+
+	s64 hit = (s64)hits_++;
+	switch (mode_)
+	{
+	case REPLAY_STOP_AT_HIT:
+		if ((u64)hit != target_)
+			return false;
+		landed_ = true;
+		return true;
+
+	case REPLAY_SCAN:
+		// stopped at an IOP breakpoint, the EE reaches the position right after that hit
+		prevHit_ = lastHit_;
+		lastHit_ = hit;
+		lastHitIsNow_ = now_ != NULL && now_->iopStop && cpu == BREAKPOINT_IOP && pc == now_->iopPc;
+		return false;
+
+	default:
+		return false;
+	}
+}
+
+bool CReverseExecution::InstructionHit(u32 pc)
+{
+	if (!replaying_)
+		return false;
+
+	u64 instruction = instructions_++;
+	if (mode_ == REPLAY_STOP_AT_INSTRUCTION)
+	{
+		if (instruction != target_)
+			return false;
+
+		// looks like a finished step to the debuggers
+		landed_ = true;
+		CBreakPoints::SetBreakpointTriggered(true);
+		return true;
+	}
+
+	if (mode_ != REPLAY_SCAN || now_ == NULL)
+		return false;
+
+	s64 hit = lastHitIsNow_ ? prevHit_ : lastHit_;
+	lastHitIsNow_ = false;
+
+	u64 cycle = CurrentCycle();
+	if (cycle < now_->cycle)
+	{
+		lastInstructionBefore_ = (s64)instruction;
+		lastHitBefore_ = hit;
+	}
+
+	if (MatchesPosition(pc) && candidates_.size() < MAX_CANDIDATES)
+		candidates_.push_back({ instruction, cycle, hit });
+
+	// far past where we started, it won't show up anymore
+	return cycle > now_->cycle + POSITION_SLACK;
+}
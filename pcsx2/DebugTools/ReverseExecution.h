@@ -0,0 +1,188 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "DebugInterface.h"
+#include "Pcsx2Types.h"
+
+// Reverse execution for the debugger. While recording, the core leaves the recompiler
+// about once a second at a vsync and saves a snapshot there: the internal state like a
+// regular savestate, and for the PS2 memory only the pages that changed since the
+// previous one. Going backwards restores the closest snapshot before the current stop and
+// replays from it, counting breakpoint hits (reverse-continue) or EE instructions
+// (reverse-step) to find the target, then replays once more and stops right there.
+//
+// Replays are deterministic as long as they see the same breakpoints the recorded run
+// did, the vsyncs where the recorded run left the recompiler are reproduced. The current
+// stop is recognized by its pc and EE registers, so a slightly different timing (e.g.
+// from a step breakpoint splitting a block) doesn't throw it off.
+
+// The pages of an image that changed since the previous snapshot, with their old contents
+// and the old image size. Applied to the image of a snapshot they give the previous one.
+struct ReverseUndo
+{
+	u32 size;
+	std::vector<u32> pages;
+	std::vector<u8> data;
+
+	size_t GetBytes() const { return data.size() + pages.size() * sizeof(u32); }
+};
+
+struct ReverseSnapshot
+{
+	u64 cycle;					// position on the recorded timeline, in EE cycles
+	u32 eeCycle;				// cpuRegs.cycle at that point
+	ReverseUndo memory;			// empty for the oldest snapshot
+	ReverseUndo internals;
+	std::vector<u64> exits;		// vsyncs where the core left the recompiler afterwards
+};
+
+enum ReverseResult
+{
+	REVERSE_STOPPED,			// at the previous instruction or breakpoint hit
+	REVERSE_HISTORY_BEGIN,		// nothing was found, stopped at the oldest snapshot
+	REVERSE_FAILED,
+};
+
+struct ReverseStatus
+{
+	bool recording;
+	u32 snapshots;
+	u64 span;					// EE cycles between the oldest snapshot and now
+	u64 bytes;
+};
+
+class CReverseExecution
+{
+public:
+	// Recording stays off unless a debugger asks for it, it isn't available with MTVU.
+	static bool Start();
+	static void Stop();
+	static void Clear();
+	static bool IsRecording() { return recording_; }
+	static void GetStatus(ReverseStatus& status);
+
+	// From the debugger's thread with the core stopped. They return once the core stopped
+	// at the target. StepBack only supports the EE.
+	static ReverseResult StepBack(BreakPointCpu cpu);
+	static ReverseResult ContinueBack();
+
+	// True while a replay is in progress, the window isn't told about the stops in between.
+	static bool IsScanning() { return scanning_; }
+
+	// Called on the core thread
+	static void VsyncInThread();
+	static void StateCheckInThread();
+	static bool ExitRequested() { return exitRequested_; }
+
+	// From the breakpoint handlers of all CPUs, false if the hit was just counted and the
+	// core has to keep running.
+	static bool BreakpointHit(BreakPointCpu cpu, u32 pc);
+
+	// Only while replaying, the recompiler then calls InstructionHit before every EE
+	// instruction but delay slots. True if the core has to stop there.
+	static bool IsCountingInstructions() { return counting_; }
+	static bool InstructionHit(u32 pc);
+
+private:
+	enum ReplayMode
+	{
+		REPLAY_SCAN,
+		REPLAY_STOP_AT_HIT,
+		REPLAY_STOP_AT_INSTRUCTION,
+	};
+
+	// where the reverse operation started
+	struct Position
+	{
+		u64 cycle;
+		u32 pc;
+		u32 iopPc;
+		bool iopStop;
+		u8 registers[34 * 16];	// EE GPRs, HI and LO
+	};
+
+	// a point in the replay that looks like the position we started from
+	struct Candidate
+	{
+		u64 instruction;
+		u64 cycle;
+		s64 lastHit;
+	};
+
+	struct ScanResult
+	{
+		u64 instructions;		// counted until the end of the scan
+		s64 instruction;		// the instruction before the start position, -1 if none
+		s64 hit;				// the last breakpoint hit before it, -1 if none
+	};
+
+	static u64 CurrentCycle();
+	static void GetPosition(Position& pos);
+	static bool MatchesPosition(u32 pc);
+	static void TakeSnapshot();
+	static void TruncateHistory();
+	static bool Restore(size_t index);
+	static bool Replay(size_t index, ReplayMode mode, u64 target, u64 end);
+	static bool Scan(size_t index, const Position* now, u64 end, ScanResult& result);
+	static ReverseResult StopAtBegin();
+	static size_t FindSnapshotBefore(u64 cycle);
+	static void Finish();
+
+	static std::mutex mutex_;
+	static std::deque<std::unique_ptr<ReverseSnapshot>> snapshots_;
+	static std::vector<u8> memoryShadow_;		// memory as of the latest snapshot
+	static std::vector<u8> internalsShadow_;
+	static u64 historyBytes_;
+
+	static std::atomic<bool> recording_;
+	static std::atomic<bool> scanning_;
+	static bool counting_;
+	static bool exitRequested_;
+	static bool snapshotDue_;
+	static u32 vsyncs_;
+	static u64 cycleBase_;
+	static u32 eeCycleBase_;
+
+	// set when the core continues from a replayed position, the history after it is gone
+	static bool replayed_;
+	static size_t replayedSnapshot_;
+	static u64 replayedCycle_;
+
+	// replay state, set up while the core is stopped
+	static bool replaying_;
+	static ReplayMode mode_;
+	static size_t replaySnapshot_;
+	static size_t nextExit_;
+	static u64 target_;
+	static u64 end_;
+	static u64 hits_;
+	static u64 instructions_;
+	static const Position* now_;
+	static bool landed_;
+	static s64 lastHit_;
+	static s64 prevHit_;
+	static s64 lastHitBefore_;
+	static bool lastHitIsNow_;
+	static s64 lastInstructionBefore_;
+	static std::vector<Candidate> candidates_;
+};
@@ -0,0 +1,522 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "SamplingProfiler.h"
+#include "MipsStackWalk.h"
+#include "SymbolMap.h"
+#include "DwarfInfo.h"
+#include "IopCommon.h"
+
+#ifdef __POSIX__
+#include <zlib.h>
+#else
+#include <zlib/zlib.h>
+#endif
+
+struct ProfileSample
+{
+	u8 cpu;
+	u8 depth;
+	u32 pcs[CSamplingProfiler::MAX_DEPTH];	// innermost first
+};
+
+// Written by the core thread only and read by the aggregator, the indices only grow.
+// A couple of seconds worth of samples at the highest rate.
+static const u32 RING_SIZE = 1 << 16;
+static std::unique_ptr<ProfileSample[]> ring;
+static std::atomic<u32> ringWrite(0);
+static std::atomic<u32> ringRead(0);
+static std::atomic<u64> sampleCount(0);
+static std::atomic<u64> droppedCount(0);
+
+// the cpu followed by the pcs, innermost first
+typedef std::vector<u32> ProfileStack;
+static std::map<ProfileStack, u64> stacks;
+static std::mutex stacksMutex;
+
+static std::thread aggregator;
+static std::mutex aggregatorMutex;
+static std::condition_variable aggregatorWake;
+static bool aggregatorStop = false;
+
+// how often the aggregator empties the ring
+static const int AGGREGATE_INTERVAL_MS = 100;
+
+// while stopped the event test only gets here every few seconds
+static const u32 IDLE_INTERVAL = 0x40000000;
+
+std::atomic<u32> CSamplingProfiler::nextSample_(0);
+std::atomic<bool> CSamplingProfiler::running_(false);
+u32 CSamplingProfiler::interval_ = PS2CLK / CSamplingProfiler::DEFAULT_RATE;
+u32 CSamplingProfiler::rate_ = CSamplingProfiler::DEFAULT_RATE;
+int CSamplingProfiler::depth_ = CSamplingProfiler::DEFAULT_DEPTH;
+BreakPointCpu CSamplingProfiler::cpus_ = BREAKPOINT_IOP_AND_EE;
+
+// a profiler left running must not take its thread into the static destructors
+static struct ProfilerShutdown
+{
+	~ProfilerShutdown() { CSamplingProfiler::Stop(); }
+} profilerShutdown;
+
+bool CSamplingProfiler::Start(u32 rate, int depth, BreakPointCpu cpus)
+{
+	if (rate == 0 || rate > MAX_RATE || depth < 1 || depth > MAX_DEPTH)
+		return false;
+
+	Stop();
+
+	if (!ring)
+		ring.reset(new ProfileSample[RING_SIZE]);
+
+	rate_ = rate;
+	interval_ = PS2CLK / rate;
+	depth_ = depth;
+	cpus_ = cpus;
+
+	aggregatorStop = false;
+	aggregator = std::thread(AggregatorThread);
+
+	running_ = true;
+	nextSample_.store(cpuRegs.cycle, std::memory_order_relaxed);
+	return true;
+}
+
+void CSamplingProfiler::Stop()
+{
+	if (!running_)
+		return;
+
+	running_ = false;
+	{
+		std::lock_guard<std::mutex> lock(aggregatorMutex);
+		aggregatorStop = true;
+	}
+	aggregatorWake.notify_one();
+	if (aggregator.joinable())
+		aggregator.join();
+
+	Drain();
+}
+
+void CSamplingProfiler::Reset()
+{
+	Drain();
+
+	std::lock_guard<std::mutex> lock(stacksMutex);
+	stacks.clear();
+	sampleCount = 0;
+	droppedCount = 0;
+}
+
+void CSamplingProfiler::GetStatus(ProfileStatus& status)
+{
+	status.running = running_;
+	status.rate = rate_;
+	status.samples = sampleCount;
+	status.dropped = droppedCount;
+}
+
+void CSamplingProfiler::Sample(u32 cycle)
+{
+	if (!running_)
+	{
+		nextSample_.store(cycle + IDLE_INTERVAL, std::memory_order_relaxed);
+		return;
+	}
+
+	nextSample_.store(cycle + interval_, std::memory_order_relaxed);
+	if (cpus_ & BREAKPOINT_EE)
+		Record(BREAKPOINT_EE);
+	if (cpus_ & BREAKPOINT_IOP)
+		Record(BREAKPOINT_IOP);
+}
+
+void CSamplingProfiler::Record(BreakPointCpu cpu)
+{
+	const u32 write = ringWrite.load(std::memory_order_relaxed);
+	if (write - ringRead.load(std::memory_order_acquire) >= RING_SIZE)
+	{
+		droppedCount++;
+		return;
+	}
+
+	ProfileSample& sample = ring[write & (RING_SIZE - 1)];
+	sample.cpu = (u8)cpu;
+
+	// the event test runs with all registers written back
+	u32 pc, ra, sp;
+	DebugInterface* debug;
+	if (cpu == BREAKPOINT_EE)
+	{
+		pc = cpuRegs.pc;
+		ra = cpuRegs.GPR.n.ra.UL[0];
+		sp = cpuRegs.GPR.n.sp.UL[0];
+		debug = &r5900Debug;
+	}
+	else
+	{
+		pc = psxRegs.pc;
+		ra = psxRegs.GPR.n.ra;
+		sp = psxRegs.GPR.n.sp;
+		debug = &r3000Debug;
+	}
+
+	// frame layouts are cached by the analyst, a walk over known code is cheap
+	std::vector<MipsStackWalk::StackFrame> frames = MipsStackWalk::Walk(debug, pc, ra, sp, 0, 0, depth_);
+	if (frames.empty())
+	{
+		sample.depth = 1;
+		sample.pcs[0] = pc;
+	}
+	else
+	{
+		sample.depth = (u8)std::min<size_t>(frames.size(), depth_);
+		for (int i = 0; i < sample.depth; i++)
+			sample.pcs[i] = frames[i].pc;
+	}
+
+	ringWrite.store(write + 1, std::memory_order_release);
+	sampleCount++;
+}
+
+void CSamplingProfiler::AggregatorThread()
+{
+	std::unique_lock<std::mutex> lock(aggregatorMutex);
+	while (!aggregatorStop)
+	{
+		aggregatorWake.wait_for(lock, std::chrono::milliseconds(AGGREGATE_INTERVAL_MS));
+
+		lock.unlock();
+		Drain();
+		lock.lock();
+	}
+}
+
+void CSamplingProfiler::Drain()
+{
+	std::lock_guard<std::mutex> lock(stacksMutex);
+	if (!ring)
+		return;
+
+	const u32 write = ringWrite.load(std::memory_order_acquire);
+	u32 read = ringRead.load(std::memory_order_relaxed);
+
+	ProfileStack stack;
+	for (; read != write; read++)
+	{
+		const ProfileSample& sample = ring[read & (RING_SIZE - 1)];
+		stack.assign(1, sample.cpu);
+		stack.insert(stack.end(), sample.pcs, sample.pcs + sample.depth);
+		stacks[stack]++;
+	}
+
+	ringRead.store(read, std::memory_order_release);
+}
+
+// Names the function a pc is in. Only the EE has symbols, IOP functions go by address.
+static std::string getFunctionName(u32 cpu, u32 pc, u32& start)
+{
+	char buffer[32];
+	if (cpu == BREAKPOINT_EE)
+	{
+		start = symbolMap.GetFunctionStart(pc);
+		if (start != SymbolMap::INVALID_ADDRESS)
+		{
+			std::string name = symbolMap.GetLabelString(start);
+			if (!name.empty())
+				return name;
+
+			snprintf(buffer, sizeof(buffer), "sub_%08x", start);
+			return buffer;
+		}
+	}
+
+	start = pc;
+	snprintf(buffer, sizeof(buffer), cpu == BREAKPOINT_EE ? "0x%08x" : "iop_0x%08x", pc);
+	return buffer;
+}
+
+static std::map<ProfileStack, u64> copyStacks()
+{
+	std::lock_guard<std::mutex> lock(stacksMutex);
+	return stacks;
+}
+
+void CSamplingProfiler::GetFlatProfile(std::vector<ProfileFunction>& functions)
+{
+	Drain();
+	const std::map<ProfileStack, u64> counts = copyStacks();
+
+	std::unordered_map<std::string, ProfileFunction> byName;
+	std::vector<std::string> seen;
+	for (const auto& entry : counts)
+	{
+		const ProfileStack& stack = entry.first;
+		seen.clear();
+		for (size_t i = 1; i < stack.size(); i++)
+		{
+			u32 start;
+			std::string name = getFunctionName(stack[0], stack[i], start);
+			ProfileFunction& function = byName[name];
+			function.name = name;
+			if (i == 1)
+				function.self += entry.second;
+
+			// recursion counts once towards the total
+			if (std::find(seen.begin(), seen.end(), name) == seen.end())
+			{
+				function.total += entry.second;
+				seen.push_back(name);
+			}
+		}
+	}
+
+	functions.clear();
+	for (auto& entry : byName)
+		functions.push_back(entry.second);
+
+	std::sort(functions.begin(), functions.end(), [](const ProfileFunction& a, const ProfileFunction& b) {
+		return a.self != b.self ? a.self > b.self : a.total > b.total;
+	});
+}
+
+bool CSamplingProfiler::WriteCollapsed(const wxString& filename)
+{
+	Drain();
+	const std::map<ProfileStack, u64> counts = copyStacks();
+
+	// the same function stack can come from several pcs
+	std::map<std::string, u64> collapsed;
+	for (const auto& entry : counts)
+	{
+		const ProfileStack& stack = entry.first;
+		std::string line = stack[0] == BREAKPOINT_EE ? "EE" : "IOP";
+		for (size_t i = stack.size() - 1; i > 0; i--)
+		{
+			u32 start;
+			line += ';';
+			line += getFunctionName(stack[0], stack[i], start);
+		}
+		collapsed[line] += entry.second;
+	}
+
+	FILE* f = wxFopen(filename, L"w");
+	if (!f)
+		return false;
+
+	bool ok = true;
+	for (const auto& entry : collapsed)
+		ok &= fprintf(f, "%s %llu\n", entry.first.c_str(), (unsigned long long)entry.second) > 0;
+	ok &= fclose(f) == 0;
+	return ok;
+}
+
+// Just enough protobuf encoding for profile.proto
+class ProtoWriter
+{
+public:
+	void Varint(u64 value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back((u8)(value | 0x80));
+			value >>= 7;
+		}
+		data.push_back((u8)value);
+	}
+
+	void Uint(int field, u64 value)
+	{
+		Varint((u64)field << 3);
+		Varint(value);
+	}
+
+	void Bytes(int field, const void* bytes, size_t size)
+	{
+		Varint(((u64)field << 3) | 2);
+		Varint(size);
+		data.insert(data.end(), (const u8*)bytes, (const u8*)bytes + size);
+	}
+
+	void Message(int field, const ProtoWriter& message) { Bytes(field, message.data.data(), message.data.size()); }
+
+	void Packed(int field, const std::vector<u64>& values)
+	{
+		ProtoWriter packed;
+		for (u64 value : values)
+			packed.Varint(value);
+		Message(field, packed);
+	}
+
+	std::vector<u8> data;
+};
+
+class ProfileStrings
+{
+public:
+	ProfileStrings() { Get(""); }
+
+	u64 Get(const std::string& str)
+	{
+		auto it = indices.find(str);
+		if (it != indices.end())
+			return it->second;
+
+		indices[str] = table.size();
+		table.push_back(str);
+		return table.size() - 1;
+	}
+
+	std::vector<std::string> table;
+
+private:
+	std::unordered_map<std::string, u64> indices;
+};
+
+static bool writeGzip(const wxString& filename, const std::vector<u8>& data)
+{
+	z_stream stream = {};
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	// room for the gzip header and trailer too
+	std::vector<u8> out(deflateBound(&stream, data.size()) + 32);
+	stream.next_in = (Bytef*)data.data();
+	stream.avail_in = (uInt)data.size();
+	stream.next_out = out.data();
+	stream.avail_out = (uInt)out.size();
+	int rc = deflate(&stream, Z_FINISH);
+	size_t size = stream.total_out;
+	deflateEnd(&stream);
+	if (rc != Z_STREAM_END)
+		return false;
+
+	FILE* f = wxFopen(filename, L"wb");
+	if (!f)
+		return false;
+
+	bool ok = fwrite(out.data(), 1, size, f) == size;
+	ok &= fclose(f) == 0;
+	return ok;
+}
+
+bool CSamplingProfiler::WritePprof(const wxString& filename)
+{
+	Drain();
+	const std::map<ProfileStack, u64> counts = copyStacks();
+
+	ProtoWriter profile;
+	ProfileStrings strings;
+	const u64 period = 1000000000ULL / rate_;
+
+	// sample_type: samples/count and cpu/nanoseconds of emulated time
+	ProtoWriter samplesType, cpuType;
+	samplesType.Uint(1, strings.Get("samples"));
+	samplesType.Uint(2, strings.Get("count"));
+	cpuType.Uint(1, strings.Get("cpu"));
+	cpuType.Uint(2, strings.Get("nanoseconds"));
+	profile.Message(1, samplesType);
+	profile.Message(1, cpuType);
+
+	// one location per cpu and pc, one function per name
+	std::map<std::pair<u32, u32>, u64> locations;
+	std::unordered_map<std::string, u64> functions;
+	ProtoWriter locationData, functionData;
+
+	auto getFunction = [&](const std::string& name, const std::string& file) {
+		auto it = functions.find(name);
+		if (it != functions.end())
+			return it->second;
+
+		u64 id = functions.size() + 1;
+		functions[name] = id;
+
+		ProtoWriter function;
+		function.Uint(1, id);
+		function.Uint(2, strings.Get(name));
+		function.Uint(3, strings.Get(name));
+		if (!file.empty())
+			function.Uint(4, strings.Get(file));
+		functionData.Message(5, function);
+		return id;
+	};
+
+	auto getLocation = [&](u32 cpu, u32 pc) {
+		auto it = locations.find(std::make_pair(cpu, pc));
+		if (it != locations.end())
+			return it->second;
+
+		u64 id = locations.size() + 1;
+		locations[std::make_pair(cpu, pc)] = id;
+
+		u32 start;
+		std::string name = getFunctionName(cpu, pc, start);
+		std::string file;
+		u32 line = 0;
+		if (cpu == BREAKPOINT_EE)
+			CDwarfInfo::GetSourceLine(pc, file, line);
+
+		ProtoWriter lineData;
+		lineData.Uint(1, getFunction(name, file));
+		if (line != 0)
+			lineData.Uint(2, line);
+
+		ProtoWriter location;
+		location.Uint(1, id);
+		location.Uint(3, pc);
+		location.Message(4, lineData);
+		locationData.Message(4, location);
+		return id;
+	};
+
+	for (const auto& entry : counts)
+	{
+		const ProfileStack& stack = entry.first;
+		std::vector<u64> ids;
+		for (size_t i = 1; i < stack.size(); i++)
+			ids.push_back(getLocation(stack[0], stack[i]));
+
+		ProtoWriter sample;
+		sample.Packed(1, ids);
+		sample.Packed(2, { entry.second, entry.second * period });
+		profile.Message(2, sample);
+	}
+
+	profile.data.insert(profile.data.end(), locationData.data.begin(), locationData.data.end());
+	profile.data.insert(profile.data.end(), functionData.data.begin(), functionData.data.end());
+
+	// period_type and period
+	ProtoWriter periodType;
+	periodType.Uint(1, strings.Get("cpu"));
+	periodType.Uint(2, strings.Get("nanoseconds"));
+
+	for (const std::string& str : strings.table)
+		profile.Bytes(6, str.data(), str.size());
+	profile.Message(11, periodType);
+	profile.Uint(12, period);
+
+	return writeGzip(filename, profile.data);
+}
@@ -0,0 +1,85 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "DebugInterface.h"
+#include "Pcsx2Types.h"
+
+// Statistical profiler for the game code, independent of the recompilers and usable in
+// release builds. The EE event test takes a sample whenever the configured number of EE
+// cycles passed: the pc and a short stack walk of each selected CPU go into a lock-free
+// ring, which a background thread folds into per-stack counts. The functions come from
+// the symbol map once a report is asked for.
+
+struct ProfileStatus
+{
+	bool running;
+	u32 rate;
+	u64 samples;
+	u64 dropped;		// the ring was full
+};
+
+struct ProfileFunction
+{
+	std::string name;
+	u64 self;
+	u64 total;
+};
+
+class CSamplingProfiler
+{
+public:
+	static const u32 DEFAULT_RATE = 1000;
+	static const u32 MAX_RATE = 20000;
+	static const int DEFAULT_DEPTH = 16;
+	static const int MAX_DEPTH = 32;
+
+	// rate in samples per second of emulated time
+	static bool Start(u32 rate = DEFAULT_RATE, int depth = DEFAULT_DEPTH, BreakPointCpu cpus = BREAKPOINT_IOP_AND_EE);
+	static void Stop();
+	static void Reset();
+	static void GetStatus(ProfileStatus& status);
+
+	// Called by the EE event test, a single compare while no sample is due
+	static __fi void EventTest(u32 cycle)
+	{
+		if ((s32)(cycle - nextSample_.load(std::memory_order_relaxed)) >= 0)
+			Sample(cycle);
+	}
+
+	// Sorted by self samples. The collapsed stacks are the input of flamegraph.pl, the
+	// pprof file is a gzipped profile.proto.
+	static void GetFlatProfile(std::vector<ProfileFunction>& functions);
+	static bool WriteCollapsed(const wxString& filename);
+	static bool WritePprof(const wxString& filename);
+
+private:
+	static void Sample(u32 cycle);
+	static void Record(BreakPointCpu cpu);
+	static void AggregatorThread();
+	static void Drain();
+
+	static std::atomic<u32> nextSample_;
+	static std::atomic<bool> running_;
+	static u32 interval_;
+	static u32 rate_;
+	static int depth_;
+	static BreakPointCpu cpus_;
+};
@@ -26,6 +26,41 @@ SymbolMap symbolMap;
 
 #define ARRAY_SIZE(x) (sizeof((x))/sizeof(*(x)))
 
+// Position of address in a sorted array, -1 if it isn't there.
+static int FindExact(const std::vector<u32>& starts, u32 address) {
+	auto it = std::lower_bound(starts.begin(), starts.end(), address);
+	if (it == starts.end() || *it != address)
+		return -1;
+	return (int)(it - starts.begin());
+}
+
+// Last entry starting at or before address which also covers it, -1 if there's none.
+static int FindContaining(const std::vector<u32>& starts, const std::vector<u32>& sizes, u32 address) {
+	auto it = std::upper_bound(starts.begin(), starts.end(), address);
+	if (it == starts.begin())
+		return -1;
+
+	int i = (int)(it - starts.begin()) - 1;
+	if (starts[i] + sizes[i] > address)
+		return i;
+	return -1;
+}
+
+int SymbolMap::ActiveIndex::FindFunction(u32 address) const {
+	return FindContaining(functionStarts, functionSizes, address);
+}
+
+int SymbolMap::ActiveIndex::FindData(u32 address) const {
+	return FindContaining(dataStarts, dataSizes, address);
+}
+
+const char* SymbolMap::ActiveIndex::GetLabelName(u32 address) const {
+	int i = FindExact(labelAddresses, address);
+	if (i < 0)
+		return NULL;
+	return &names[labelNames[i]];
+}
+
 void SymbolMap::SortSymbols() {
 	std::lock_guard<std::recursive_mutex> guard(m_lock);
 	AssignFunctionIndices();
@@ -41,6 +76,7 @@ void SymbolMap::Clear() {
 	activeData.clear();
 	activeModuleEnds.clear();
 	modules.clear();
+	PublishIndex();
 }
 
 
@@ -103,68 +139,55 @@ bool SymbolMap::LoadNocashSym(const char *filename) {
 }
 
 SymbolType SymbolMap::GetSymbolType(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	if (activeFunctions.find(address) != activeFunctions.end())
+	const auto index = GetIndex();
+	if (FindExact(index->functionStarts, address) >= 0)
 		return ST_FUNCTION;
-	if (activeData.find(address) != activeData.end())
+	if (FindExact(index->dataStarts, address) >= 0)
 		return ST_DATA;
 	return ST_NONE;
 }
 
 bool SymbolMap::GetSymbolInfo(SymbolInfo *info, u32 address, SymbolType symmask) const {
-	u32 functionAddress = INVALID_ADDRESS;
-	u32 dataAddress = INVALID_ADDRESS;
+	const auto index = GetIndex();
+	int function = (symmask & ST_FUNCTION) ? index->FindFunction(address) : -1;
+	int data = (symmask & ST_DATA) ? index->FindData(address) : -1;
 
-	if (symmask & ST_FUNCTION)
-		functionAddress = GetFunctionStart(address);
-
-	if (symmask & ST_DATA)
-		dataAddress = GetDataStart(address);
-
-	if (functionAddress == INVALID_ADDRESS || dataAddress == INVALID_ADDRESS) {
-		if (functionAddress != INVALID_ADDRESS) {
-			if (info != NULL) {
-				info->type = ST_FUNCTION;
-				info->address = functionAddress;
-				info->size = GetFunctionSize(functionAddress);
-			}
-
-			return true;
-		}
-		
-		if (dataAddress != INVALID_ADDRESS) {
-			if (info != NULL) {
-				info->type = ST_DATA;
-				info->address = dataAddress;
-				info->size = GetDataSize(dataAddress);
-			}
-
-			return true;
+	// if both exist, return the function
+	if (function >= 0) {
+		if (info != NULL) {
+			info->type = ST_FUNCTION;
+			info->address = index->functionStarts[function];
+			info->size = index->functionSizes[function];
 		}
 
-		return false;
+		return true;
 	}
 
-	// if both exist, return the function
-	if (info != NULL) {
-		info->type = ST_FUNCTION;
-		info->address = functionAddress;
-		info->size = GetFunctionSize(functionAddress);
+	if (data >= 0) {
+		if (info != NULL) {
+			info->type = ST_DATA;
+			info->address = index->dataStarts[data];
+			info->size = index->dataSizes[data];
+		}
+
+		return true;
 	}
 
-	return true;
+	return false;
 }
 
 u32 SymbolMap::GetNextSymbolAddress(u32 address, SymbolType symmask) {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	const auto functionEntry = symmask & ST_FUNCTION ? activeFunctions.upper_bound(address) : activeFunctions.end();
-	const auto dataEntry = symmask & ST_DATA ? activeData.upper_bound(address) : activeData.end();
+	const auto index = GetIndex();
+	const auto& functions = index->functionStarts;
+	const auto& data = index->dataStarts;
+	const auto functionEntry = symmask & ST_FUNCTION ? std::upper_bound(functions.begin(), functions.end(), address) : functions.end();
+	const auto dataEntry = symmask & ST_DATA ? std::upper_bound(data.begin(), data.end(), address) : data.end();
 
-	if (functionEntry == activeFunctions.end() && dataEntry == activeData.end())
+	if (functionEntry == functions.end() && dataEntry == data.end())
 		return INVALID_ADDRESS;
 
-	u32 funcAddress = (functionEntry != activeFunctions.end()) ? functionEntry->first : 0xFFFFFFFF;
-	u32 dataAddress = (dataEntry != activeData.end()) ? dataEntry->first : 0xFFFFFFFF;
+	u32 funcAddress = (functionEntry != functions.end()) ? *functionEntry : 0xFFFFFFFF;
+	u32 dataAddress = (dataEntry != data.end()) ? *dataEntry : 0xFFFFFFFF;
 
 	if (funcAddress <= dataAddress)
 		return funcAddress;
@@ -173,16 +196,16 @@ u32 SymbolMap::GetNextSymbolAddress(u32 address, SymbolType symmask) {
 }
 
 std::string SymbolMap::GetDescription(unsigned int address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	const auto index = GetIndex();
 	const char* labelName = NULL;
 
-	u32 funcStart = GetFunctionStart(address);
-	if (funcStart != INVALID_ADDRESS) {
-		labelName = GetLabelName(funcStart);
+	int function = index->FindFunction(address);
+	if (function >= 0) {
+		labelName = index->GetLabelName(index->functionStarts[function]);
 	} else {
-		u32 dataStart = GetDataStart(address);
-		if (dataStart != INVALID_ADDRESS)
-			labelName = GetLabelName(dataStart);
+		int data = index->FindData(address);
+		if (data >= 0)
+			labelName = index->GetLabelName(index->dataStarts[data]);
 	}
 
 	if (labelName != NULL)
@@ -194,15 +217,15 @@ std::string SymbolMap::GetDescription(unsigned int address) const {
 }
 
 std::vector<SymbolEntry> SymbolMap::GetAllSymbols(SymbolType symmask) {
+	const auto index = GetIndex();
 	std::vector<SymbolEntry> result;
 
 	if (symmask & ST_FUNCTION) {
-		std::lock_guard<std::recursive_mutex> guard(m_lock);
-		for (auto it = activeFunctions.begin(); it != activeFunctions.end(); it++) {
+		for (size_t i = 0; i < index->functionStarts.size(); i++) {
 			SymbolEntry entry;
-			entry.address = it->first;
-			entry.size = GetFunctionSize(entry.address);
-			const char* name = GetLabelName(entry.address);
+			entry.address = index->functionStarts[i];
+			entry.size = index->functionSizes[i];
+			const char* name = index->GetLabelName(entry.address);
 			if (name != NULL)
 				entry.name = name;
 			result.push_back(entry);
@@ -210,12 +233,11 @@ std::vector<SymbolEntry> SymbolMap::GetAllSymbols(SymbolType symmask) {
 	}
 
 	if (symmask & ST_DATA) {
-		std::lock_guard<std::recursive_mutex> guard(m_lock);
-		for (auto it = activeData.begin(); it != activeData.end(); it++) {
+		for (size_t i = 0; i < index->dataStarts.size(); i++) {
 			SymbolEntry entry;
-			entry.address = it->first;
-			entry.size = GetDataSize(entry.address);
-			const char* name = GetLabelName(entry.address);
+			entry.address = index->dataStarts[i];
+			entry.size = index->dataSizes[i];
+			const char* name = index->GetLabelName(entry.address);
 			if (name != NULL)
 				entry.name = name;
 			result.push_back(entry);
@@ -368,52 +390,29 @@ void SymbolMap::AddFunction(const char* name, u32 address, u32 size, int moduleI
 }
 
 u32 SymbolMap::GetFunctionStart(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeFunctions.upper_bound(address);
-	if (it == activeFunctions.end()) {
-		// check last element
-		auto rit = activeFunctions.rbegin();
-		if (rit != activeFunctions.rend()) {
-			u32 start = rit->first;
-			u32 size = rit->second.size;
-			if (start <= address && start+size > address)
-				return start;
-		}
-		// otherwise there's no function that contains this address
+	const auto index = GetIndex();
+	int function = index->FindFunction(address);
+	if (function < 0)
 		return INVALID_ADDRESS;
-	}
-
-	if (it != activeFunctions.begin()) {
-		it--;
-		u32 start = it->first;
-		u32 size = it->second.size;
-		if (start <= address && start+size > address)
-			return start;
-	}
-
-	return INVALID_ADDRESS;
+	return index->functionStarts[function];
 }
 
 u32 SymbolMap::GetFunctionSize(u32 startAddress) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeFunctions.find(startAddress);
-	if (it == activeFunctions.end())
+	const auto index = GetIndex();
+	int function = FindExact(index->functionStarts, startAddress);
+	if (function < 0)
 		return INVALID_ADDRESS;
 
-	return it->second.size;
+	return index->functionSizes[function];
 }
 
 int SymbolMap::GetFunctionNum(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	u32 start = GetFunctionStart(address);
-	if (start == INVALID_ADDRESS)
+	const auto index = GetIndex();
+	int function = index->FindFunction(address);
+	if (function < 0)
 		return INVALID_ADDRESS;
 
-	auto it = activeFunctions.find(start);
-	if (it == activeFunctions.end())
-		return INVALID_ADDRESS;
-
-	return it->second.index;
+	return index->functionIndices[function];
 }
 
 void SymbolMap::AssignFunctionIndices() {
@@ -441,6 +440,9 @@ void SymbolMap::UpdateActiveSymbols() {
 	activeLabels.clear();
 	activeData.clear();
 
+	// before the copies below are taken, so they carry the new indices
+	AssignFunctionIndices();
+
 	for (auto it = functions.begin(), end = functions.end(); it != end; ++it) {
 		const auto mod = activeModuleIndexes.find(it->second.module);
 		if (it->second.module <= 0) {
@@ -468,7 +470,47 @@ void SymbolMap::UpdateActiveSymbols() {
 		}
 	}
 
-	AssignFunctionIndices();
+	PublishIndex();
+}
+
+void SymbolMap::PublishIndex() {
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	auto index = std::make_shared<ActiveIndex>();
+
+	index->functionStarts.reserve(activeFunctions.size());
+	index->functionSizes.reserve(activeFunctions.size());
+	index->functionIndices.reserve(activeFunctions.size());
+	for (auto it = activeFunctions.begin(), end = activeFunctions.end(); it != end; ++it) {
+		index->functionStarts.push_back(it->first);
+		index->functionSizes.push_back(it->second.size);
+		index->functionIndices.push_back(it->second.index);
+	}
+
+	size_t namesSize = 0;
+	for (auto it = activeLabels.begin(), end = activeLabels.end(); it != end; ++it)
+		namesSize += strlen(it->second.name) + 1;
+
+	index->labelAddresses.reserve(activeLabels.size());
+	index->labelNames.reserve(activeLabels.size());
+	index->names.reserve(namesSize);
+	for (auto it = activeLabels.begin(), end = activeLabels.end(); it != end; ++it) {
+		index->labelAddresses.push_back(it->first);
+		index->labelNames.push_back((u32)index->names.size());
+		index->names.insert(index->names.end(), it->second.name, it->second.name + strlen(it->second.name) + 1);
+	}
+
+	index->dataStarts.reserve(activeData.size());
+	index->dataSizes.reserve(activeData.size());
+	index->dataTypes.reserve(activeData.size());
+	for (auto it = activeData.begin(), end = activeData.end(); it != end; ++it) {
+		index->dataStarts.push_back(it->first);
+		index->dataSizes.push_back(it->second.size);
+		index->dataTypes.push_back(it->second.type);
+	}
+
+	// readers still holding the previous index keep it alive until they're done
+	std::atomic_store(&activeIndex, std::shared_ptr<const ActiveIndex>(std::move(index)));
+	version.fetch_add(1, std::memory_order_release);
 }
 
 bool SymbolMap::SetFunctionSize(u32 startAddress, u32 newSize) {
@@ -582,15 +624,6 @@ void SymbolMap::SetLabelName(const char* name, u32 address, bool updateImmediate
 	}
 }
 
-const char *SymbolMap::GetLabelName(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeLabels.find(address);
-	if (it == activeLabels.end())
-		return NULL;
-
-	return it->second.name;
-}
-
 const char *SymbolMap::GetLabelNameRel(u32 relAddress, int moduleIndex) const {
 	std::lock_guard<std::recursive_mutex> guard(m_lock);
 	auto it = labels.find(std::make_pair(moduleIndex, relAddress));
@@ -601,18 +634,18 @@ const char *SymbolMap::GetLabelNameRel(u32 relAddress, int moduleIndex) const {
 }
 
 std::string SymbolMap::GetLabelString(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	const char *label = GetLabelName(address);
+	const auto index = GetIndex();
+	const char *label = index->GetLabelName(address);
 	if (label == NULL)
 		return "";
 	return label;
 }
 
 bool SymbolMap::GetLabelValue(const char* name, u32& dest) {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	for (auto it = activeLabels.begin(); it != activeLabels.end(); it++) {
-		if (strcasecmp(name, it->second.name) == 0) {
-			dest = it->first;
+	const auto index = GetIndex();
+	for (size_t i = 0; i < index->labelAddresses.size(); i++) {
+		if (strcasecmp(name, &index->names[index->labelNames[i]]) == 0) {
+			dest = index->labelAddresses[i];
 			return true;
 		}
 	}
@@ -665,47 +698,25 @@ void SymbolMap::AddData(u32 address, u32 size, DataType type, int moduleIndex) {
 }
 
 u32 SymbolMap::GetDataStart(u32 address) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeData.upper_bound(address);
-	if (it == activeData.end())
-	{
-		// check last element
-		auto rit = activeData.rbegin();
-
-		if (rit != activeData.rend())
-		{
-			u32 start = rit->first;
-			u32 size = rit->second.size;
-			if (start <= address && start+size > address)
-				return start;
-		}
-		// otherwise there's no data that contains this address
+	const auto index = GetIndex();
+	int data = index->FindData(address);
+	if (data < 0)
 		return INVALID_ADDRESS;
-	}
-
-	if (it != activeData.begin()) {
-		it--;
-		u32 start = it->first;
-		u32 size = it->second.size;
-		if (start <= address && start+size > address)
-			return start;
-	}
-
-	return INVALID_ADDRESS;
+	return index->dataStarts[data];
 }
 
 u32 SymbolMap::GetDataSize(u32 startAddress) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeData.find(startAddress);
-	if (it == activeData.end())
+	const auto index = GetIndex();
+	int data = FindExact(index->dataStarts, startAddress);
+	if (data < 0)
 		return INVALID_ADDRESS;
-	return it->second.size;
+	return index->dataSizes[data];
 }
 
 DataType SymbolMap::GetDataType(u32 startAddress) const {
-	std::lock_guard<std::recursive_mutex> guard(m_lock);
-	auto it = activeData.find(startAddress);
-	if (it == activeData.end())
+	const auto index = GetIndex();
+	int data = FindExact(index->dataStarts, startAddress);
+	if (data < 0)
 		return DATATYPE_NONE;
-	return it->second.type;
+	return index->dataTypes[data];
 }
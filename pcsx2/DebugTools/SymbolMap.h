@@ -15,11 +15,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <set>
 #include <map>
 #include <string>
 #include <mutex>
+#include <memory>
 
 #include "Pcsx2Types.h"
 
@@ -94,11 +96,15 @@ public:
 
 	static const u32 INVALID_ADDRESS = (u32)-1;
 
+	// Lookups (GetFunctionStart, GetLabelString, ...) only see changes made since the last
+	// call once this has run again.
 	void UpdateActiveSymbols();
+	// Changes whenever what the lookups see changes, for caches of text made from symbols
+	u32 GetVersion() const { return version.load(std::memory_order_acquire); }
 	bool IsEmpty() const { return activeFunctions.empty() && activeLabels.empty() && activeData.empty(); };
 private:
 	void AssignFunctionIndices();
-	const char *GetLabelName(u32 address) const;
+	void PublishIndex();
 	const char *GetLabelNameRel(u32 relAddress, int moduleIndex) const;
 
 	struct FunctionEntry {
@@ -145,6 +151,34 @@ private:
 	std::map<SymbolKey, DataEntry> data;
 	std::vector<ModuleEntry> modules;
 
+	// Flattened copy of the active symbols for lookups: sorted start addresses with the
+	// other fields in parallel arrays and all label names in one arena. It is never
+	// modified once published, so readers only need the pointer and never take m_lock.
+	struct ActiveIndex {
+		std::vector<u32> functionStarts;
+		std::vector<u32> functionSizes;
+		std::vector<int> functionIndices;
+
+		std::vector<u32> labelAddresses;
+		std::vector<u32> labelNames;	// offsets into names
+
+		std::vector<u32> dataStarts;
+		std::vector<u32> dataSizes;
+		std::vector<DataType> dataTypes;
+
+		std::vector<char> names;
+
+		int FindFunction(u32 address) const;
+		int FindData(u32 address) const;
+		const char* GetLabelName(u32 address) const;
+	};
+
+	std::shared_ptr<const ActiveIndex> GetIndex() const { return std::atomic_load(&activeIndex); }
+
+	// Swapped with std::atomic_store, always valid (empty until the first update).
+	std::shared_ptr<const ActiveIndex> activeIndex = std::make_shared<ActiveIndex>();
+	std::atomic<u32> version{0};
+
 	mutable std::recursive_mutex m_lock;
 };
 
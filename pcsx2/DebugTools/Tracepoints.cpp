@@ -0,0 +1,533 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+#include "Tracepoints.h"
+#include "Breakpoints.h"
+
+#include <algorithm>
+
+// The EE sees far more traffic than the IOP, give it the larger share
+static const size_t TRACE_BUFFER_SIZE_EE = 16 * 1024 * 1024;
+static const size_t TRACE_BUFFER_SIZE_IOP = 4 * 1024 * 1024;
+
+// upper bound for a single collected memory range
+static const u32 TRACE_MEMORY_BLOCK_MAX = 64 * 1024;
+
+//
+// TraceBuffer
+//
+
+TraceBuffer::TraceBuffer()
+	: circular_(false), head_(0), reserved_(0), indexCount_(0)
+{
+}
+
+void TraceBuffer::Reset(size_t capacity, bool circular)
+{
+	data_.assign(capacity, 0);
+	index_.assign(INDEX_SIZE, IndexEntry());
+	circular_ = circular;
+	head_ = 0;
+	reserved_ = 0;
+	indexCount_ = 0;
+}
+
+bool TraceBuffer::Write(u64 frame, const void* record, u32 size)
+{
+	const u64 capacity = data_.size();
+	const u64 position = head_.load(std::memory_order_relaxed);
+	const u64 entry = indexCount_.load(std::memory_order_relaxed);
+
+	if (size > capacity)
+		return false;
+	if (!circular_ && (position + size > capacity || entry >= INDEX_SIZE))
+		return false;
+
+	// Announce the bytes about to be overwritten before touching them, readers
+	// check this after copying a frame out (seqlock style)
+	reserved_.store(position + size, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const u64 offset = position % capacity;
+	const u64 first = std::min<u64>(size, capacity - offset);
+	memcpy(&data_[offset], record, first);
+	memcpy(&data_[0], (const u8*)record + first, size - first);
+
+	// the slot being replaced belongs to entry - INDEX_SIZE, which readers
+	// already treat as gone while indexCount_ still reads entry
+	index_[entry % INDEX_SIZE].frame = frame;
+	index_[entry % INDEX_SIZE].position = position;
+
+	head_.store(position + size, std::memory_order_release);
+	indexCount_.store(entry + 1, std::memory_order_release);
+	return true;
+}
+
+void TraceBuffer::CopyOut(u64 position, void* dest, size_t size) const
+{
+	const u64 capacity = data_.size();
+	const u64 offset = position % capacity;
+	const u64 first = std::min<u64>(size, capacity - offset);
+	memcpy(dest, &data_[offset], first);
+	memcpy((u8*)dest + first, &data_[0], size - first);
+}
+
+bool TraceBuffer::Overwritten(u64 position) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return reserved_.load(std::memory_order_relaxed) > position + data_.size();
+}
+
+u64 TraceBuffer::FirstIndex() const
+{
+	u64 count = indexCount_.load(std::memory_order_acquire);
+	return count >= INDEX_SIZE ? count - INDEX_SIZE + 1 : 0;
+}
+
+bool TraceBuffer::ReadIndex(u64 entry, IndexEntry& dest) const
+{
+	u64 count = indexCount_.load(std::memory_order_acquire);
+	if (entry >= count || entry + INDEX_SIZE <= count)
+		return false;
+
+	dest = index_[entry % INDEX_SIZE];
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	count = indexCount_.load(std::memory_order_relaxed);
+	return entry + INDEX_SIZE > count;
+}
+
+bool TraceBuffer::FindFrame(u64 frame, u64& position) const
+{
+	if (data_.empty())
+		return false;
+
+	// frame numbers only grow within a buffer
+	u64 lo = FirstIndex();
+	u64 hi = indexCount_.load(std::memory_order_acquire);
+	while (lo < hi)
+	{
+		u64 mid = lo + (hi - lo) / 2;
+		IndexEntry entry;
+		if (!ReadIndex(mid, entry))
+		{
+			// lapped while searching
+			lo = mid + 1;
+			continue;
+		}
+
+		if (entry.frame == frame)
+		{
+			position = entry.position;
+			return true;
+		}
+
+		if (entry.frame < frame)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return false;
+}
+
+bool TraceBuffer::ReadFrame(u64 position, std::vector<u8>& dest) const
+{
+	if (data_.empty() || position >= head_.load(std::memory_order_acquire))
+		return false;
+
+	TraceFrameHeader header;
+	CopyOut(position, &header, sizeof(header));
+	if (Overwritten(position) || header.size < sizeof(header) || header.size > data_.size())
+		return false;
+
+	dest.resize(header.size);
+	CopyOut(position, dest.data(), header.size);
+	return !Overwritten(position);
+}
+
+u64 TraceBuffer::GetUsed() const
+{
+	return std::min<u64>(head_.load(std::memory_order_acquire), data_.size());
+}
+
+u64 TraceBuffer::GetFrameCount() const
+{
+	const u64 capacity = data_.size();
+	const u64 reserved = reserved_.load(std::memory_order_acquire);
+	const u64 oldest = reserved > capacity ? reserved - capacity : 0;
+
+	// first entry whose data hasn't been overwritten yet
+	u64 count = indexCount_.load(std::memory_order_acquire);
+	u64 lo = FirstIndex();
+	u64 hi = count;
+	while (lo < hi)
+	{
+		u64 mid = lo + (hi - lo) / 2;
+		IndexEntry entry;
+		if (!ReadIndex(mid, entry) || entry.position < oldest)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return count - std::min(lo, count);
+}
+
+//
+// CTracepoints
+//
+
+std::vector<Tracepoint> CTracepoints::tracepoints_;
+std::atomic<bool> CTracepoints::active_(false);
+bool CTracepoints::stoppedByUser_ = false;
+bool CTracepoints::stoppedByPassCount_ = false;
+bool CTracepoints::stoppedByFullBuffer_ = false;
+u32 CTracepoints::stopTracepoint_ = 0;
+bool CTracepoints::circular_ = false;
+std::atomic<u64> CTracepoints::frameCount_(0);
+TraceBuffer CTracepoints::bufferEE_;
+TraceBuffer CTracepoints::bufferIOP_;
+
+TraceBuffer& CTracepoints::GetBuffer(BreakPointCpu cpu)
+{
+	return cpu == BREAKPOINT_IOP ? bufferIOP_ : bufferEE_;
+}
+
+Tracepoint* CTracepoints::Find(u32 number, u32 addr)
+{
+	for (Tracepoint& tp : tracepoints_)
+	{
+		if (tp.number == number && tp.addr == addr)
+			return &tp;
+	}
+	return NULL;
+}
+
+bool CTracepoints::Reset()
+{
+	if (active_)
+		return false;
+
+	tracepoints_.clear();
+	circular_ = false;
+	return true;
+}
+
+bool CTracepoints::Define(BreakPointCpu cpu, u32 number, u32 addr, bool enabled, u64 passCount)
+{
+	if (active_)
+		return false;
+
+	Tracepoint* tp = Find(number, addr);
+	if (tp == NULL)
+	{
+		tracepoints_.push_back(Tracepoint());
+		tp = &tracepoints_.back();
+	}
+
+	tp->number = number;
+	tp->addr = addr;
+	tp->cpu = cpu;
+	tp->enabled = enabled;
+	tp->collectRegisters = false;
+	tp->passCount = passCount;
+	tp->hits = 0;
+	tp->memory.clear();
+	return true;
+}
+
+bool CTracepoints::AddRegisters(u32 number, u32 addr)
+{
+	Tracepoint* tp = Find(number, addr);
+	if (active_ || tp == NULL)
+		return false;
+
+	tp->collectRegisters = true;
+	return true;
+}
+
+bool CTracepoints::AddMemory(u32 number, u32 addr, const TracepointCollect& collect)
+{
+	Tracepoint* tp = Find(number, addr);
+	if (active_ || tp == NULL || collect.size == 0 || collect.size > TRACE_MEMORY_BLOCK_MAX)
+		return false;
+	if (collect.baseRegister >= 0 && collect.baseRegister + sizeof(u32) > sizeof(DebugRegisterSnapshot))
+		return false;
+
+	tp->memory.push_back(collect);
+	return true;
+}
+
+bool CTracepoints::SetCircular(bool circular)
+{
+	if (active_)
+		return false;
+
+	circular_ = circular;
+	return true;
+}
+
+void CTracepoints::UpdateCode()
+{
+	// the recompilers only emit collection calls while a run is active
+	CBreakPoints::Update();
+}
+
+bool CTracepoints::Start()
+{
+	if (active_)
+		return false;
+
+	bufferEE_.Reset(TRACE_BUFFER_SIZE_EE, circular_);
+	bufferIOP_.Reset(TRACE_BUFFER_SIZE_IOP, circular_);
+	frameCount_ = 0;
+	for (Tracepoint& tp : tracepoints_)
+		tp.hits = 0;
+
+	stoppedByUser_ = false;
+	stoppedByPassCount_ = false;
+	stoppedByFullBuffer_ = false;
+
+	active_ = true;
+	UpdateCode();
+	return true;
+}
+
+void CTracepoints::Stop()
+{
+	if (!active_)
+		return;
+
+	active_ = false;
+	stoppedByUser_ = true;
+	UpdateCode();
+}
+
+void CTracepoints::GetStatus(TraceStatus& status)
+{
+	status.running = active_;
+	status.stoppedByUser = stoppedByUser_;
+	status.stoppedByPassCount = stoppedByPassCount_;
+	status.stoppedByFullBuffer = stoppedByFullBuffer_;
+	status.stopTracepoint = stopTracepoint_;
+	status.circular = circular_;
+	status.frames = bufferEE_.GetFrameCount() + bufferIOP_.GetFrameCount();
+	status.created = frameCount_;
+	status.bufferSize = bufferEE_.GetCapacity() + bufferIOP_.GetCapacity();
+	status.bufferFree = status.bufferSize - bufferEE_.GetUsed() - bufferIOP_.GetUsed();
+}
+
+bool CTracepoints::IsTracepoint(BreakPointCpu cpu, u32 addr)
+{
+	if (!active_)
+		return false;
+
+	for (const Tracepoint& tp : tracepoints_)
+	{
+		if (tp.cpu == cpu && tp.addr == addr && tp.enabled)
+			return true;
+	}
+	return false;
+}
+
+void CTracepoints::Collect(BreakPointCpu cpu, u32 pc)
+{
+	// tracepoints_ doesn't change while a run is active
+	for (Tracepoint& tp : tracepoints_)
+	{
+		if (!active_)
+			return;
+		if (tp.cpu == cpu && tp.addr == pc && tp.enabled)
+			CollectFrame(tp, pc);
+	}
+}
+
+void CTracepoints::CollectFrame(Tracepoint& tp, u32 pc)
+{
+	// only ever touched by the core thread
+	static std::vector<u8> record;
+
+	DebugInterface* cpu = tp.cpu == BREAKPOINT_IOP ? (DebugInterface*)&r3000Debug : (DebugInterface*)&r5900Debug;
+
+	bool needRegisters = tp.collectRegisters;
+	for (const TracepointCollect& collect : tp.memory)
+		needRegisters = needRegisters || collect.baseRegister >= 0;
+
+	DebugRegisterSnapshot regs;
+	if (needRegisters)
+		cpu->getRegisterSnapshot(regs);
+
+	TraceFrameHeader header;
+	header.frame = frameCount_.load(std::memory_order_relaxed);
+	header.tracepoint = tp.number;
+	header.pc = pc;
+	header.flags = tp.collectRegisters ? TRACEFRAME_REGISTERS : 0;
+
+	record.resize(sizeof(header));
+	if (tp.collectRegisters)
+		record.insert(record.end(), (const u8*)&regs, (const u8*)&regs + sizeof(regs));
+
+	for (const TracepointCollect& collect : tp.memory)
+	{
+		TraceMemoryBlock block;
+		block.addr = collect.offset;
+		block.size = collect.size;
+		if (collect.baseRegister >= 0)
+		{
+			u32 base;
+			memcpy(&base, (const u8*)&regs + collect.baseRegister, sizeof(base));
+			block.addr += base;
+		}
+
+		size_t at = record.size();
+		record.resize(at + sizeof(block) + block.size);
+		if (!cpu->readMemory(block.addr, block.size, &record[at + sizeof(block)]))
+		{
+			// unmapped, the frame simply doesn't have it
+			record.resize(at);
+			continue;
+		}
+		memcpy(&record[at], &block, sizeof(block));
+	}
+
+	header.size = (u32)record.size();
+	memcpy(record.data(), &header, sizeof(header));
+
+	if (!GetBuffer(tp.cpu).Write(header.frame, record.data(), header.size))
+	{
+		stoppedByFullBuffer_ = true;
+		active_ = false;
+		return;
+	}
+
+	frameCount_.store(header.frame + 1, std::memory_order_release);
+
+	if (tp.passCount != 0 && ++tp.hits >= tp.passCount)
+	{
+		stoppedByPassCount_ = true;
+		stopTracepoint_ = tp.number;
+		active_ = false;
+	}
+}
+
+bool CTracepoints::ReadFrame(u64 frame, std::vector<u8>& dest)
+{
+	u64 position;
+	if (bufferEE_.FindFrame(frame, position))
+		return bufferEE_.ReadFrame(position, dest);
+	if (bufferIOP_.FindFrame(frame, position))
+		return bufferIOP_.ReadFrame(position, dest);
+	return false;
+}
+
+bool CTracepoints::FindFrame(TraceFindMode mode, s64 start, u64 arg1, u64 arg2, std::vector<u8>& dest)
+{
+	if (mode == TRACEFIND_FRAME)
+		return ReadFrame(arg1, dest);
+
+	const u64 count = frameCount_.load(std::memory_order_acquire);
+	for (u64 frame = start < 0 ? 0 : start + 1; frame < count; frame++)
+	{
+		if (!ReadFrame(frame, dest))
+			continue;
+
+		const TraceFrameHeader* header = traceFrameHeader(dest);
+		bool match = false;
+		switch (mode)
+		{
+		case TRACEFIND_PC:
+			match = header->pc == arg1;
+			break;
+		case TRACEFIND_TRACEPOINT:
+			match = header->tracepoint == arg1;
+			break;
+		case TRACEFIND_RANGE:
+			match = header->pc >= arg1 && header->pc <= arg2;
+			break;
+		case TRACEFIND_OUTSIDE:
+			match = header->pc < arg1 || header->pc > arg2;
+			break;
+		default:
+			break;
+		}
+
+		if (match)
+			return true;
+	}
+
+	return false;
+}
+
+//
+// Frame accessors
+//
+
+const TraceFrameHeader* traceFrameHeader(const std::vector<u8>& frame)
+{
+	if (frame.size() < sizeof(TraceFrameHeader))
+		return NULL;
+	return (const TraceFrameHeader*)frame.data();
+}
+
+const DebugRegisterSnapshot* traceFrameRegisters(const std::vector<u8>& frame)
+{
+	const TraceFrameHeader* header = traceFrameHeader(frame);
+	if (header == NULL || !(header->flags & TRACEFRAME_REGISTERS))
+		return NULL;
+	if (frame.size() < sizeof(TraceFrameHeader) + sizeof(DebugRegisterSnapshot))
+		return NULL;
+	return (const DebugRegisterSnapshot*)&frame[sizeof(TraceFrameHeader)];
+}
+
+bool traceFrameReadMemory(const std::vector<u8>& frame, u32 addr, u32 size, void* dest)
+{
+	const TraceFrameHeader* header = traceFrameHeader(frame);
+	if (header == NULL)
+		return false;
+
+	size_t pos = sizeof(TraceFrameHeader);
+	if (header->flags & TRACEFRAME_REGISTERS)
+		pos += sizeof(DebugRegisterSnapshot);
+
+	// the request may span several collected blocks, every byte has to come from one
+	std::vector<bool> covered(size, false);
+	u32 remaining = size;
+
+	while (pos + sizeof(TraceMemoryBlock) <= frame.size() && remaining != 0)
+	{
+		TraceMemoryBlock block;
+		memcpy(&block, &frame[pos], sizeof(block));
+		pos += sizeof(block);
+		if (pos + block.size > frame.size())
+			break;
+
+		const u64 start = std::max<u64>(addr, block.addr);
+		const u64 end = std::min<u64>((u64)addr + size, (u64)block.addr + block.size);
+		for (u64 a = start; a < end; a++)
+		{
+			if (covered[a - addr])
+				continue;
+			((u8*)dest)[a - addr] = frame[pos + (a - block.addr)];
+			covered[a - addr] = true;
+			remaining--;
+		}
+
+		pos += block.size;
+	}
+
+	return remaining == 0;
+}
@@ -0,0 +1,186 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2014  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include "DebugInterface.h"
+#include "Pcsx2Types.h"
+
+// Tracepoints collect registers and memory into a trace buffer whenever execution passes
+// them, without stopping the CPU. They are defined and inspected by the debugger (GDB's
+// QTDP/QTStart/QTFrame packets) and only armed while a trace run is active.
+
+struct TracepointCollect
+{
+	// memory ranges are [base register + offset, +size), baseRegister is an offset into
+	// DebugRegisterSnapshot or -1 for an absolute address
+	s32 baseRegister;
+	u32 offset;
+	u32 size;
+};
+
+struct Tracepoint
+{
+	u32 number;
+	u32 addr;
+	BreakPointCpu cpu;
+	bool enabled;
+	bool collectRegisters;
+	// the run stops once this many frames were collected, 0 means no limit
+	u64 passCount;
+	u64 hits;
+	std::vector<TracepointCollect> memory;
+};
+
+// Header of each frame in the trace buffer, followed by a DebugRegisterSnapshot when
+// TRACEFRAME_REGISTERS is set and then by the collected memory blocks.
+struct TraceFrameHeader
+{
+	u64 frame;		// global frame number, shared by all CPUs
+	u32 size;		// whole record including this header
+	u32 tracepoint;
+	u32 pc;
+	u32 flags;
+};
+
+struct TraceMemoryBlock
+{
+	u32 addr;
+	u32 size;
+};
+
+enum TraceFrameFlags
+{
+	TRACEFRAME_REGISTERS = 0x01,
+};
+
+// Byte ring written by a single producer (the core thread) and read by the debugger
+// thread without locking. Positions only ever grow: a reader validates its copy against
+// the write reservation afterwards and drops frames the producer has lapped since.
+// Without circular mode the producer refuses to lap and the run stops once it's full.
+class TraceBuffer
+{
+public:
+	TraceBuffer();
+
+	// only while nothing is being collected
+	void Reset(size_t capacity, bool circular);
+
+	// producer side, fails when the frame doesn't fit
+	bool Write(u64 frame, const void* record, u32 size);
+
+	// reader side, both fail once the frame was overwritten
+	bool FindFrame(u64 frame, u64& position) const;
+	bool ReadFrame(u64 position, std::vector<u8>& dest) const;
+
+	u64 GetCapacity() const { return data_.size(); }
+	u64 GetUsed() const;
+	u64 GetFrameCount() const;
+
+private:
+	struct IndexEntry
+	{
+		u64 frame;
+		u64 position;
+	};
+
+	void CopyOut(u64 position, void* dest, size_t size) const;
+	bool Overwritten(u64 position) const;
+	bool ReadIndex(u64 entry, IndexEntry& dest) const;
+	u64 FirstIndex() const;
+
+	static const u32 INDEX_SIZE = 1 << 16;
+
+	std::vector<u8> data_;
+	std::vector<IndexEntry> index_;
+	bool circular_;
+	std::atomic<u64> head_;
+	std::atomic<u64> reserved_;
+	std::atomic<u64> indexCount_;
+};
+
+enum TraceFindMode
+{
+	TRACEFIND_FRAME,
+	TRACEFIND_PC,
+	TRACEFIND_TRACEPOINT,
+	TRACEFIND_RANGE,
+	TRACEFIND_OUTSIDE,
+};
+
+struct TraceStatus
+{
+	bool running;
+	bool stoppedByUser;
+	bool stoppedByPassCount;
+	bool stoppedByFullBuffer;
+	u32 stopTracepoint;		// the one that reached its pass count
+	bool circular;
+	u64 frames;
+	u64 created;
+	u64 bufferSize;
+	u64 bufferFree;
+};
+
+class CTracepoints
+{
+public:
+	// definitions can only change while no trace run is active
+	static bool Reset();
+	static bool Define(BreakPointCpu cpu, u32 number, u32 addr, bool enabled, u64 passCount);
+	static bool AddRegisters(u32 number, u32 addr);
+	static bool AddMemory(u32 number, u32 addr, const TracepointCollect& collect);
+
+	static bool SetCircular(bool circular);
+	static bool Start();
+	static void Stop();
+	static void GetStatus(TraceStatus& status);
+
+	// Searches after frame start (-1 to search from the beginning). The selected frame
+	// is copied into dest so it stays readable while tracing continues.
+	static bool FindFrame(TraceFindMode mode, s64 start, u64 arg1, u64 arg2, std::vector<u8>& dest);
+
+	static bool IsActive() { return active_; }
+	static bool IsTracepoint(BreakPointCpu cpu, u32 addr);
+
+	// called from the interpreters and the recompiled code, on the core thread
+	static void Collect(BreakPointCpu cpu, u32 pc);
+
+private:
+	static TraceBuffer& GetBuffer(BreakPointCpu cpu);
+	static Tracepoint* Find(u32 number, u32 addr);
+	static bool ReadFrame(u64 frame, std::vector<u8>& dest);
+	static void CollectFrame(Tracepoint& tp, u32 pc);
+	static void UpdateCode();
+
+	static std::vector<Tracepoint> tracepoints_;
+	static std::atomic<bool> active_;
+	static bool stoppedByUser_;
+	static bool stoppedByPassCount_;
+	static bool stoppedByFullBuffer_;
+	static u32 stopTracepoint_;
+	static bool circular_;
+	static std::atomic<u64> frameCount_;
+	static TraceBuffer bufferEE_;
+	static TraceBuffer bufferIOP_;
+};
+
+// frame accessors for a record returned by CTracepoints::FindFrame
+const TraceFrameHeader* traceFrameHeader(const std::vector<u8>& frame);
+const DebugRegisterSnapshot* traceFrameRegisters(const std::vector<u8>& frame);
+bool traceFrameReadMemory(const std::vector<u8>& frame, u32 addr, u32 size, void* dest);
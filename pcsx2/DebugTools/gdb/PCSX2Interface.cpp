@@ -1,8 +1,14 @@
 #include "PrecompiledHeader.h"
 #include "PCSX2Interface.h"
 #include <R5900.h>
+#include "Memory.h"
 #include "DebugTools/DebugInterface.h"
-#include "Debugger/DisassemblyDialog.h"
+#include "DebugTools/Breakpoints.h"
+#include "DebugTools/Tracepoints.h"
+#include "DebugTools/DwarfInfo.h"
+#include "DebugTools/DebugControl.h"
+#include "DebugTools/ReverseExecution.h"
+#include "DebugTools/SamplingProfiler.h"
 #include "AppCoreThread.h"
 #include "App.h"
 
@@ -12,29 +18,90 @@ extern "C" {
 
 
 // todo:
-// - Disable GDB server when DisassemblyDialog closes
 // - Figure out how to implement the calling of the GDB run loop
 // - etc
 
 #define _ctx ((GDBSTUBCTX)m_ctx)
 
+// How long to wait for the core thread to act on a step/continue request
+#define GDB_STATE_TIMEOUT_MS 5000
+
+// Every CPU with a debug interface is a GDB thread, or an inferior of its own when GDB
+// speaks the multiprocess extensions. VU0/VU1 have no debug interface and aren't listed.
+enum {
+	GDB_THREAD_EE = 1,
+	GDB_THREAD_IOP = 2,
+};
+
 namespace GDB {
+	static DebugInterface* ThreadCpu(uint32_t thread) {
+		switch (thread) {
+			case GDB_THREAD_EE: return &r5900Debug;
+			case GDB_THREAD_IOP: return &r3000Debug;
+			default: return nullptr;
+		}
+	}
+
+	static uint32_t CpuThread(BreakPointCpu cpu) {
+		return cpu == BREAKPOINT_IOP ? GDB_THREAD_IOP : GDB_THREAD_EE;
+	}
+
 	void GDBThread(PCSX2Interface* gdb) {
-		gdb->Enable(6169); // todo: Make port configurable
+		gdb->Enable(gdb->GetPort());
 		if (gdb->IsEnabled()) gdb->Run();
 	}
 
-	PCSX2Interface::PCSX2Interface(DisassemblyDialog* dis) : WinSockInterface(Architecture::MIPSR5900) {
-		m_disDialog = dis;
+	PCSX2Interface::PCSX2Interface() : SocketInterface(Architecture::MIPSR5900) {
+		m_port = 6169;
+		m_cpu = &r5900Debug;
+		m_stopThread = GDB_THREAD_EE;
 		m_initialized = false;
+		m_traceFrameNumber = -1;
+		m_historyBegin = false;
+		m_historySequence = 0;
 	}
 
 	PCSX2Interface::~PCSX2Interface() {
+		CpuStateNotifier::SetListener(nullptr, nullptr);
+	}
+
+	static void OnCpuStateChanged(bool paused, void* userdata) {
+		((PCSX2Interface*)userdata)->CpuStateChanged(paused);
+	}
+
+	static Result OnSourceCommand(Interface* gdb, const char* args) {
+		return ((PCSX2Interface*)gdb)->SourceCommand(args);
+	}
+
+	static Result OnHistoryCommand(Interface* gdb, const char* args) {
+		return ((PCSX2Interface*)gdb)->HistoryCommand(args);
+	}
+
+	static Result OnProfileCommand(Interface* gdb, const char* args) {
+		return ((PCSX2Interface*)gdb)->ProfileCommand(args);
+	}
+
+	// The stub picks up the new state as soon as its poll returns and sends the stop
+	// reply on its own thread. A breakpoint stops the target in the CPU which hit it.
+	void PCSX2Interface::CpuStateChanged(bool paused) {
+		if (paused && CDebugControl::StoppedAtBreakpoint()) m_stopThread = CpuThread(CDebugControl::GetStopCpu());
+		IO_Wake();
 	}
 
 	void PCSX2Interface::Init() {
 		if (m_initialized) return;
 
+		if (const char* port = getenv("PCSX2_GDB_PORT")) {
+			int value = atoi(port);
+			if (value > 0 && value < 65536) m_port = (unsigned short)value;
+			else DebugPrintf("Invalid PCSX2_GDB_PORT %s, using %d", port, m_port);
+		}
+
+#ifndef _WIN32
+		// allow listening on a unix socket instead of TCP, for headless setups
+		if (const char* path = getenv("PCSX2_GDB_SOCKET")) SetUnixSocketPath(path);
+#endif
+
 		/*
 		GDB::RegisterType alltypes[] = {
 			RegisterType::GeneralPurpose,
@@ -103,22 +170,34 @@ namespace GDB {
 		}
 		*/
 
-		for (u8 r = 0;r < 32;r++) {
-			RegisterID id = DefineRegister(r5900Debug.getRegisterName(EECAT_GPR, r), 64, RegisterType::GeneralPurpose);
-			m_regInfo[id] = { EECAT_GPR, r, 64 };
-		}
+		// The definition order must match DebugRegisterSnapshot, which g/G copy as a whole.
+		// GDB's mips layout comes first, the R5900 extensions are appended after it.
+		for (u8 r = 0;r < 32;r++) DefineSnapshotRegister(r5900Debug.getRegisterName(EECAT_GPR, r), 64, offsetof(DebugRegisterSnapshot, gpr) + r * sizeof(u64));
+
+		DefineSnapshotRegister("sr"   , 64, offsetof(DebugRegisterSnapshot, sr));
+		DefineSnapshotRegister("lo"   , 64, offsetof(DebugRegisterSnapshot, lo));
+		DefineSnapshotRegister("hi"   , 64, offsetof(DebugRegisterSnapshot, hi));
+		DefineSnapshotRegister("bad"  , 64, offsetof(DebugRegisterSnapshot, badvaddr));
+		DefineSnapshotRegister("cause", 64, offsetof(DebugRegisterSnapshot, cause));
+		DefineSnapshotRegister("pc"   , 64, offsetof(DebugRegisterSnapshot, pc));
 
-		m_regInfo[DefineRegister("sr"   , 64, RegisterType::GeneralPurpose)] = { -1, -1, 64 };
-		m_regInfo[DefineRegister("lo"   , 64, RegisterType::GeneralPurpose)] = { EECAT_GPR, 34, 64 };
-		m_regInfo[DefineRegister("hi"   , 64, RegisterType::GeneralPurpose)] = { EECAT_GPR, 33, 64 };
-		m_regInfo[DefineRegister("bad"  , 64, RegisterType::GeneralPurpose)] = { -1, -1, 64 };
-		m_regInfo[DefineRegister("cause", 64, RegisterType::GeneralPurpose)] = { -1, -1, 64 };
-		m_regInfo[DefineRegister("pc"   , 64, RegisterType::GeneralPurpose)] = { EECAT_GPR, 32, 64 };
+		for (u8 r = 0;r < 32;r++) DefineSnapshotRegister(r5900Debug.getRegisterName(EECAT_FPR, r), 32, offsetof(DebugRegisterSnapshot, fpr) + r * sizeof(u32), RegisterType::FloatingPoint);
+		DefineSnapshotRegister("fcsr", 32, offsetof(DebugRegisterSnapshot, fcsr));
+		DefineSnapshotRegister("fir" , 32, offsetof(DebugRegisterSnapshot, fir));
 
+		// upper 64 bits of the 128 bit GPRs
 		for (u8 r = 0;r < 32;r++) {
-			RegisterID id = DefineRegister(r5900Debug.getRegisterName(EECAT_FPR, r), 32, RegisterType::FloatingPoint);
-			m_regInfo[id] = { EECAT_FPR, r, 32 };
+			m_regNames.push_back(std::string(r5900Debug.getRegisterName(EECAT_GPR, r)) + "_hi");
 		}
+		for (u8 r = 0;r < 32;r++) DefineSnapshotRegister(m_regNames[r].c_str(), 64, offsetof(DebugRegisterSnapshot, gprHi) + r * sizeof(u64));
+		DefineSnapshotRegister("lo1", 64, offsetof(DebugRegisterSnapshot, lo1));
+		DefineSnapshotRegister("hi1", 64, offsetof(DebugRegisterSnapshot, hi1));
+
+		for (u8 r = 0;r < 32;r++) DefineSnapshotRegister(r5900Debug.getRegisterName(EECAT_VU0F, r), 128, offsetof(DebugRegisterSnapshot, vf) + r * sizeof(u128));
+
+		DefineCustomCommand("source", OnSourceCommand, "Source file and line of an address (default: pc)");
+		DefineCustomCommand("history", OnHistoryCommand, "Recorded history for reverse step/continue");
+		DefineCustomCommand("profile", OnProfileCommand, "Sampling profiler: start [rate] [depth], stop, reset, report [count], collapsed <file>, pprof <file>");
 
 		m_initialized = true;
 	}
@@ -134,20 +213,27 @@ namespace GDB {
 		return strlen(msg);
 	}
 
-	void PCSX2Interface::PacketReceived(const char* pkt) {
-		DebugPrintf("Received: %s", pkt);
+	void PCSX2Interface::PacketReceived(const char* pkt, size_t size) {
+		DebugPrintf("Received: %.*s", (int)size, pkt);
 	}
 
 	ProcessStatus PCSX2Interface::Status() {
-		if (r5900Debug.isCpuPaused()) return ProcessStatus::Stopped;
+		if (CpuStateNotifier::IsPaused()) return ProcessStatus::Stopped;
 		return ProcessStatus::Running;
 	}
 
 	void PCSX2Interface::GDB_Connected() {
 		DebugPrint("GDB client connected");
+		m_cpu = &r5900Debug;
+		m_stopThread = GDB_THREAD_EE;
+		CpuStateNotifier::SetListener(OnCpuStateChanged, this);
+
+		// GDB can go back through whatever ran since it connected
+		m_historyBegin = false;
+		CReverseExecution::Start();
 		if (!r5900Debug.isAlive()) return;
 
-		m_disDialog->pauseExecution();
+		CDebugControl::Pause();
 
 		if (!r5900Debug.isCpuPaused()) {
 			DebugPrint("Failed to stop execution for GDB");
@@ -156,7 +242,8 @@ namespace GDB {
 
 	Result PCSX2Interface::StopExecution() {
 		if (!r5900Debug.isAlive()) return Result::TryAgain;
-		m_disDialog->pauseExecution();
+		m_stopThread = CpuThread(m_cpu->getCpuType());
+		CDebugControl::Pause();
 		if (!r5900Debug.isCpuPaused()) return Result::InternalError;
 		return Result::Success;
 	}
@@ -175,73 +262,188 @@ namespace GDB {
 	}
 
 	Result PCSX2Interface::SingleStepExecution() {
-		u128 curPc = r5900Debug.getRegister(EECAT_GPR, 32);
-		m_disDialog->stepInto();
-		// wait for cpu to reach the next instruction
-		// todo: timeout after x seconds
-		while(true) {
-			if (!r5900Debug.isAlive() || curPc != r5900Debug.getRegister(EECAT_GPR, 32)) {
-				break;
-			}
-		}
+		return SingleStepThread(CpuThread(m_cpu->getCpuType()));
+	}
+
+	// Both CPUs share the core thread, the other one runs along until the stepped one
+	// reaches its temporary breakpoint.
+	Result PCSX2Interface::SingleStepThread(uint32_t thread) {
+		DebugInterface* cpu = ThreadCpu(thread);
+		if (!cpu) return Result::NotFound;
+		if (!r5900Debug.isAlive()) return Result::InternalError;
+		u32 seq = CpuStateNotifier::GetSequence();
+		m_stopThread = thread;
+		if (CDebugControl::StepInto(cpu->getCpuType()) == (u32)-1) return Result::InternalError;
+
+		// the step runs to a temporary breakpoint, wait until the core stopped there
+		if (!CpuStateNotifier::WaitForPause(seq, GDB_STATE_TIMEOUT_MS)) return Result::TryAgain;
 		return Result::Success;
 	}
 
-	Result PCSX2Interface::ContinueExecution() {
+	// Both run the core through the recorded history and only return once it stopped at
+	// the target, GDB gets the stop reply right away like for a single step.
+	Result PCSX2Interface::ReverseStepThread(uint32_t thread) {
+		DebugInterface* cpu = thread ? ThreadCpu(thread) : m_cpu;
+		if (!cpu) return Result::NotFound;
+		if (!CReverseExecution::IsRecording() || cpu->getCpuType() != BREAKPOINT_EE) return Result::NotSupported;
 		if (!r5900Debug.isAlive()) return Result::InternalError;
-		m_disDialog->resumeExecution();
 
-		// wait for cpu resume
-		// todo: timeout after x seconds
-		while(true) {
-			if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused()) {
-				break;
-			}
-		}
+		ReverseResult result = CReverseExecution::StepBack(cpu->getCpuType());
+		if (result == REVERSE_FAILED) return Result::InternalError;
+		ReverseStopped(result == REVERSE_HISTORY_BEGIN);
+		return Result::Success;
+	}
 
-		if (r5900Debug.isCpuPaused()) return Result::InternalError;
+	Result PCSX2Interface::ReverseContinueExecution() {
+		if (!CReverseExecution::IsRecording()) return Result::NotSupported;
+		if (!r5900Debug.isAlive()) return Result::InternalError;
+
+		ReverseResult result = CReverseExecution::ContinueBack();
+		if (result == REVERSE_FAILED) return Result::InternalError;
+		ReverseStopped(result == REVERSE_HISTORY_BEGIN);
+		return Result::Success;
+	}
+
+	void PCSX2Interface::ReverseStopped(bool historyBegin) {
+		// a step or breakpoint stop already told the listener which CPU stopped
+		if (historyBegin) m_stopThread = GDB_THREAD_EE;
+		m_historyBegin = historyBegin;
+		m_historySequence = CpuStateNotifier::GetSequence();
+	}
+
+	Result PCSX2Interface::HistoryBegin(bool* begin) {
+		*begin = m_historyBegin && m_historySequence == CpuStateNotifier::GetSequence();
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::ContinueExecution() {
+		if (!r5900Debug.isAlive()) return Result::InternalError;
+		u32 seq = CpuStateNotifier::GetSequence();
+		CDebugControl::Resume();
+
+		// the stop itself is reported asynchronously through OnCpuStateChanged
+		if (!CpuStateNotifier::WaitForResume(seq, GDB_STATE_TIMEOUT_MS)) return Result::InternalError;
 		return Result::Success;
 	}
 
 	Result PCSX2Interface::ReadMem(size_t address, size_t size, void* dest) {
-		if (!r5900Debug.isValidAddress(address) || !dest) return Result::InvalidParameter;
-		u8* dst = (u8*)dest;
-		for (u32 i = 0;i < size;i++) {
-			if (!r5900Debug.isValidAddress(address + i)) return Result::InvalidParameter;
-			dst[i] = r5900Debug.read8(address + i);
+		if (!dest) return Result::InvalidParameter;
+		if (m_traceFrameNumber >= 0) {
+			// only what the tracepoint collected is available
+			if (!traceFrameReadMemory(m_traceFrame, address, size, dest)) return Result::InvalidParameter;
+			return Result::Success;
 		}
+		if (!m_cpu->readMemory(address, size, dest)) return Result::InvalidParameter;
 		return Result::Success;
 	}
 
 	Result PCSX2Interface::WriteMem(size_t address, size_t size, const void* src) {
-		if (!r5900Debug.isValidAddress(address) || !src) return Result::InvalidParameter;
-		for (u32 i = 0; i < size; i++) {
-			if (!r5900Debug.isValidAddress(address + i)) return Result::InvalidParameter;
-			r5900Debug.write8(address + i, ((u8*)src)[i]);
+		if (!src || m_traceFrameNumber >= 0) return Result::InvalidParameter;
+		if (!m_cpu->writeMemory(address, size, src)) return Result::InvalidParameter;
+		return Result::Success;
+	}
+
+	static bool IsRomPage(uptr ptr) {
+		const uptr roms[][2] = {
+			{ (uptr)eeMem->ROM , Ps2MemSize::Rom  },
+			{ (uptr)eeMem->ROM1, Ps2MemSize::Rom1 },
+			{ (uptr)eeMem->ROM2, Ps2MemSize::Rom2 },
+			{ (uptr)eeMem->EROM, Ps2MemSize::ERom }
+		};
+
+		for (const auto& rom : roms) {
+			if (ptr >= rom[0] && ptr < rom[0] + rom[1]) return true;
 		}
+		return false;
+	}
+
+	// Built from the EE vtlb: host backed pages are RAM (or ROM when they point into one
+	// of the BIOS images), handler pages are listed only when the debugger can access them
+	// (hardware registers, VU memory, GS privileged registers). GDB fetches the map once
+	// for all inferiors, so pages only the IOP can access are added as RAM.
+	Result PCSX2Interface::MemoryMap(const MemoryRegion** regions, int* count) {
+		using namespace vtlb_private;
+
+		if (!r5900Debug.isAlive() || !vtlbdata.vmap) return Result::TryAgain;
+
+		m_memoryMap.clear();
+		for (u64 page = 0;page < VTLB_VMAP_ITEMS;page++) {
+			const u32 vaddr = (u32)(page << VTLB_PAGE_BITS);
+			const auto vmv = vtlbdata.vmap[page];
+
+			MemoryType type;
+			if (!vmv.isHandler(vaddr)) type = IsRomPage(vmv.assumePtr(vaddr)) ? MemoryType::ROM : MemoryType::RAM;
+			else if (r5900Debug.isValidAddress(vaddr) || r3000Debug.isValidAddress(vaddr)) type = MemoryType::RAM;
+			else continue;
+
+			if (!m_memoryMap.empty()) {
+				MemoryRegion& last = m_memoryMap.back();
+				if (last.type == type && last.start + last.size == vaddr) {
+					last.size += VTLB_PAGE_SIZE;
+					continue;
+				}
+			}
+
+			m_memoryMap.push_back({ vaddr, VTLB_PAGE_SIZE, type });
+		}
+
+		*regions = m_memoryMap.data();
+		*count = (int)m_memoryMap.size();
 		return Result::Success;
 	}
 
+	void PCSX2Interface::DefineSnapshotRegister(const char* name, int bits, size_t offset, RegisterType type) {
+		RegisterID id = DefineRegister(name, bits, type);
+		m_regInfo[id] = { offset, bits };
+	}
+
+	bool PCSX2Interface::GetTraceFrameRegisters(DebugRegisterSnapshot& regs) {
+		if (m_traceFrameNumber < 0) return false;
+
+		// frames without collected registers still know where they were taken
+		if (const DebugRegisterSnapshot* collected = traceFrameRegisters(m_traceFrame)) {
+			memcpy(&regs, collected, sizeof(regs));
+		} else {
+			memset(&regs, 0, sizeof(regs));
+			regs.pc = traceFrameHeader(m_traceFrame)->pc;
+		}
+		return true;
+	}
+
 	Result PCSX2Interface::ReadRegister(RegisterID reg, void* dest) {
 		const auto& info = m_regInfo[reg];
-		const u8 bytes = info.bits / 8;
 
-		DebugPrintf("Fetching register %s (%d B)", RegisterName(reg), bytes);
-		const u128 val = r5900Debug.getRegister(info.cat, info.num);
-		for (u8 b = 0;b < bytes;b++) ((u8*)dest)[b] = val._u8[(bytes - 1) - b];
+		DebugRegisterSnapshot regs;
+		if (!GetTraceFrameRegisters(regs)) m_cpu->getRegisterSnapshot(regs);
+		memcpy(dest, (u8*)&regs + info.offset, info.bits / 8);
 
 		return Result::Success;
 	}
 
 	Result PCSX2Interface::WriteRegister(RegisterID reg, const void* src) {
+		if (m_traceFrameNumber >= 0) return Result::InvalidParameter;
 		const auto& info = m_regInfo[reg];
-		const u8 bytes = info.bits / 8;
 
-		u128 val;
-		val.lo = val.hi = 0;
-		for (u8 b = 0;b < bytes;b++) val._u8[(bytes - 1) - b] = ((u8*)src)[b];
+		DebugRegisterSnapshot regs;
+		m_cpu->getRegisterSnapshot(regs);
+		memcpy((u8*)&regs + info.offset, src, info.bits / 8);
+		m_cpu->setRegisterSnapshot(regs);
 
-		r5900Debug.setRegister(info.cat, info.num, val);
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::ReadRegisters(void* dest) {
+		DebugRegisterSnapshot regs;
+		if (!GetTraceFrameRegisters(regs)) m_cpu->getRegisterSnapshot(regs);
+		memcpy(dest, &regs, sizeof(regs));
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::WriteRegisters(const void* src) {
+		if (m_traceFrameNumber >= 0) return Result::InvalidParameter;
+		DebugRegisterSnapshot regs;
+		memcpy(&regs, src, sizeof(regs));
+		m_cpu->setRegisterSnapshot(regs);
 		return Result::Success;
 	}
 
@@ -249,19 +451,19 @@ namespace GDB {
 		switch (type) {
 			case TracepointType::ExecutionHardware:
 			case TracepointType::ExecutionSoftware: {
-				CBreakPoints::AddBreakPoint(m_disDialog->currentCpu->getCpu()->getCpuType(), address);
+				CBreakPoints::AddBreakPoint(m_cpu->getCpuType(), address);
 				break;
 			}
 			case TracepointType::MemoryRead: {
-				CBreakPoints::AddMemCheck(m_disDialog->currentCpu->getCpu()->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_READ, MemCheckResult::MEMCHECK_BREAK);
+				CBreakPoints::AddMemCheck(m_cpu->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_READ, MemCheckResult::MEMCHECK_BREAK);
 				break;
 			}
 			case TracepointType::MemoryWrite: {
-				CBreakPoints::AddMemCheck(m_disDialog->currentCpu->getCpu()->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_WRITE, MemCheckResult::MEMCHECK_BREAK);
+				CBreakPoints::AddMemCheck(m_cpu->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_WRITE, MemCheckResult::MEMCHECK_BREAK);
 				break;
 			}
 			case TracepointType::MemoryAccess: {
-				CBreakPoints::AddMemCheck(m_disDialog->currentCpu->getCpu()->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_READWRITE, MemCheckResult::MEMCHECK_BREAK);
+				CBreakPoints::AddMemCheck(m_cpu->getCpuType(), address, address + 1, MemCheckCondition::MEMCHECK_READWRITE, MemCheckResult::MEMCHECK_BREAK);
 				break;
 			}
 		}
@@ -269,11 +471,261 @@ namespace GDB {
 	}
 
 	Result PCSX2Interface::ClearTracepoint(size_t address){
-		CBreakPoints::RemoveBreakPoint(m_disDialog->currentCpu->getCpu()->getCpuType(), address);
+		CBreakPoints::RemoveBreakPoint(m_cpu->getCpuType(), address);
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceReset() {
+		m_traceFrame.clear();
+		m_traceFrameNumber = -1;
+
+		CTracepoints::Stop();
+		if (!CTracepoints::Reset()) return Result::InternalError;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceDefine(uint32_t number, size_t address, bool enabled, uint64_t passCount) {
+		BreakPointCpu cpu = m_cpu->getCpuType();
+		if (!CTracepoints::Define(cpu, number, address, enabled, passCount)) return Result::TryAgain;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceAddCollect(uint32_t number, size_t address, const TraceCollect& collect) {
+		if (collect.type == TraceCollectType::Registers) {
+			if (!CTracepoints::AddRegisters(number, address)) return Result::InvalidParameter;
+			return Result::Success;
+		}
+
+		// GDB sends register numbers, the collector works on snapshot offsets
+		TracepointCollect memory;
+		memory.baseRegister = -1;
+		memory.offset = (u32)collect.offset;
+		memory.size = collect.size;
+		if (collect.baseRegister >= 0) {
+			auto it = m_regInfo.find(collect.baseRegister);
+			if (it == m_regInfo.end()) return Result::InvalidParameter;
+			memory.baseRegister = (s32)it->second.offset;
+		}
+
+		if (!CTracepoints::AddMemory(number, address, memory)) return Result::InvalidParameter;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceSetCircular(bool circular) {
+		if (!CTracepoints::SetCircular(circular)) return Result::TryAgain;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceStart() {
+		if (!r5900Debug.isAlive()) return Result::TryAgain;
+
+		m_traceFrame.clear();
+		m_traceFrameNumber = -1;
+		if (!CTracepoints::Start()) return Result::TryAgain;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceStop() {
+		CTracepoints::Stop();
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceQueryStatus(TraceStatus* status) {
+		::TraceStatus trace;
+		CTracepoints::GetStatus(trace);
+
+		status->running = trace.running;
+		if (trace.stoppedByFullBuffer) status->stop = TraceStop::BufferFull;
+		else if (trace.stoppedByPassCount) status->stop = TraceStop::PassCount;
+		else if (trace.stoppedByUser) status->stop = TraceStop::User;
+		else status->stop = TraceStop::NotRun;
+		status->stopTracepoint = trace.stopTracepoint;
+		status->circular = trace.circular;
+		status->frames = trace.frames;
+		status->created = trace.created;
+		status->bufferSize = trace.bufferSize;
+		status->bufferFree = trace.bufferFree;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::TraceFindFrame(TraceFind mode, uint64_t arg1, uint64_t arg2, int* frame, uint32_t* tracepoint) {
+		if (mode == TraceFind::Frame && arg1 == UINT64_MAX) {
+			m_traceFrame.clear();
+			m_traceFrameNumber = -1;
+			*frame = -1;
+			return Result::Success;
+		}
+
+		TraceFindMode find = TRACEFIND_FRAME;
+		switch (mode) {
+			case TraceFind::Frame: find = TRACEFIND_FRAME; break;
+			case TraceFind::PC: find = TRACEFIND_PC; break;
+			case TraceFind::Tracepoint: find = TRACEFIND_TRACEPOINT; break;
+			case TraceFind::Range: find = TRACEFIND_RANGE; break;
+			case TraceFind::Outside: find = TRACEFIND_OUTSIDE; break;
+		}
+
+		// searches continue after the selected frame, tracing may still be adding frames
+		std::vector<u8> found;
+		if (!CTracepoints::FindFrame(find, m_traceFrameNumber, arg1, arg2, found)) {
+			m_traceFrame.clear();
+			m_traceFrameNumber = -1;
+			return Result::NotFound;
+		}
+
+		m_traceFrame.swap(found);
+		const TraceFrameHeader* header = traceFrameHeader(m_traceFrame);
+		m_traceFrameNumber = (int)header->frame;
+		*frame = m_traceFrameNumber;
+		*tracepoint = header->tracepoint;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::ThreadList(uint32_t* threads, uint32_t maxThreads, uint32_t* count) {
+		if (maxThreads < 2) return Result::BufferOverflow;
+		threads[0] = GDB_THREAD_EE;
+		threads[1] = GDB_THREAD_IOP;
+		*count = 2;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::SelectThread(uint32_t thread) {
+		DebugInterface* cpu = ThreadCpu(thread);
+		if (!cpu) return Result::NotFound;
+		m_cpu = cpu;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::StoppedThread(uint32_t* thread) {
+		*thread = m_stopThread;
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::ThreadName(uint32_t thread, char* name, size_t size) {
+		const char* cpuName;
+		switch (thread) {
+			case GDB_THREAD_EE: cpuName = "EE"; break;
+			case GDB_THREAD_IOP: cpuName = "IOP"; break;
+			default: return Result::NotFound;
+		}
+		snprintf(name, size, "%s", cpuName);
 		return Result::Success;
 	}
 
 	Result PCSX2Interface::InvalidCommand(const char* cmd) {
 		return Result::NotSupported;
 	}
+
+	// GDB only knows the source when it was given the ELF, which isn't the case when the
+	// game was booted from a disc image. The loader has the tables either way.
+	Result PCSX2Interface::SourceCommand(const char* args) {
+		u32 address = m_cpu->getPC();
+		if (args && *args) {
+			char* end;
+			address = strtoul(args, &end, 16);
+			if (end == args) return Result::InvalidParameter;
+		}
+
+		if (m_cpu->getCpuType() != BREAKPOINT_EE || !CDwarfInfo::IsLoaded()) {
+			CommandPrintf("No debug info loaded.\n");
+			return Result::Success;
+		}
+
+		std::string file;
+		u32 line;
+		DwarfFunction func;
+		bool hasLine = CDwarfInfo::GetSourceLine(address, file, line);
+		bool hasFunc = CDwarfInfo::GetFunction(address, func);
+
+		if (hasFunc && hasLine) CommandPrintf("%08x is in %s+0x%x (%s:%u).\n", address, func.name.c_str(), address - func.start, file.c_str(), line);
+		else if (hasLine) CommandPrintf("%08x is at %s:%u.\n", address, file.c_str(), line);
+		else if (hasFunc) CommandPrintf("%08x is in %s+0x%x.\n", address, func.name.c_str(), address - func.start);
+		else CommandPrintf("No source information for %08x.\n", address);
+		return Result::Success;
+	}
+
+	Result PCSX2Interface::HistoryCommand(const char* args) {
+		ReverseStatus status;
+		CReverseExecution::GetStatus(status);
+		if (!status.recording) {
+			CommandPrintf("Not recording, reverse execution is unavailable with MTVU.\n");
+			return Result::Success;
+		}
+
+		CommandPrintf("%u snapshots covering %llu EE cycles, %llu KB.\n", status.snapshots,
+			(unsigned long long)status.span, (unsigned long long)(status.bytes / 1024));
+		return Result::Success;
+	}
+
+	// The profiler keeps running while the target is stopped and resumed, the samples
+	// stay around until a reset.
+	Result PCSX2Interface::ProfileCommand(const char* args) {
+		char command[16] = "";
+		int offset = 0;
+		if (args) sscanf(args, "%15s %n", command, &offset);
+		const char* rest = args ? args + offset : "";
+
+		if (!strcmp(command, "start")) {
+			unsigned int rate = CSamplingProfiler::DEFAULT_RATE;
+			int depth = CSamplingProfiler::DEFAULT_DEPTH;
+			sscanf(rest, "%u %d", &rate, &depth);
+			if (!CSamplingProfiler::Start(rate, depth)) {
+				CommandPrintf("The rate has to be 1-%u samples per second, the depth 1-%d frames.\n",
+					CSamplingProfiler::MAX_RATE, CSamplingProfiler::MAX_DEPTH);
+				return Result::Success;
+			}
+			CommandPrintf("Sampling the EE and IOP %u times per second.\n", rate);
+			return Result::Success;
+		}
+
+		if (!strcmp(command, "stop")) {
+			CSamplingProfiler::Stop();
+			return ProfileCommand("");
+		}
+
+		if (!strcmp(command, "reset")) {
+			CSamplingProfiler::Reset();
+			CommandPrintf("Samples cleared.\n");
+			return Result::Success;
+		}
+
+		if (!strcmp(command, "report")) {
+			int count = 20;
+			sscanf(rest, "%d", &count);
+
+			std::vector<ProfileFunction> functions;
+			CSamplingProfiler::GetFlatProfile(functions);
+			u64 samples = 0;
+			for (const ProfileFunction& function : functions) samples += function.self;
+			if (samples == 0) {
+				CommandPrintf("No samples.\n");
+				return Result::Success;
+			}
+
+			CommandPrintf("   self    total  function\n");
+			for (int i = 0;i < count && i < (int)functions.size();i++) {
+				const ProfileFunction& function = functions[i];
+				CommandPrintf("%6.2f%%  %6.2f%%  %s\n", function.self * 100.0 / samples, function.total * 100.0 / samples, function.name.c_str());
+			}
+			return Result::Success;
+		}
+
+		if (!strcmp(command, "collapsed") || !strcmp(command, "pprof")) {
+			if (!*rest) return Result::InvalidParameter;
+
+			wxString filename = fromUTF8(rest);
+			bool written = command[0] == 'c' ? CSamplingProfiler::WriteCollapsed(filename) : CSamplingProfiler::WritePprof(filename);
+			if (written) CommandPrintf("Profile written to %s.\n", rest);
+			else CommandPrintf("Couldn't write %s.\n", rest);
+			return Result::Success;
+		}
+
+		if (*command) return Result::InvalidParameter;
+
+		ProfileStatus status;
+		CSamplingProfiler::GetStatus(status);
+		CommandPrintf("Profiler %s, %llu samples at %u per second, %llu dropped.\n", status.running ? "running" : "stopped",
+			(unsigned long long)status.samples, status.rate, (unsigned long long)status.dropped);
+		return Result::Success;
+	}
 };
\ No newline at end of file
@@ -1,21 +1,38 @@
 #pragma once
+#ifdef _WIN32
 #include "WinSockInterface.h"
+#else
+#include "PosixSocketInterface.h"
+#endif
 #include <unordered_map>
+#include <vector>
+#include <string>
 #include <thread>
+#include <atomic>
 
-class DisassemblyDialog;
+class DebugInterface;
+struct DebugRegisterSnapshot;
 
 namespace GDB {
-    class PCSX2Interface : public WinSockInterface {
+#ifdef _WIN32
+	typedef WinSockInterface SocketInterface;
+#else
+	typedef PosixSocketInterface SocketInterface;
+#endif
+
+    class PCSX2Interface : public SocketInterface {
         public:
-            PCSX2Interface(DisassemblyDialog* dis);
+            PCSX2Interface();
 			~PCSX2Interface();
 
 			void Init();
 			void EnableInSeparateThread();
+			unsigned short GetPort() const { return m_port; }
+			// CpuStateNotifier listener, runs on whichever thread paused/resumed the core
+			void CpuStateChanged(bool paused);
 
 			virtual int DebugPrint(const char* msg);
-			virtual void PacketReceived(const char* pkt);
+			virtual void PacketReceived(const char* pkt, size_t size);
 			virtual ProcessStatus Status();
 			virtual void GDB_Connected();
 			virtual Result StopExecution();
@@ -25,21 +42,68 @@ namespace GDB {
 			virtual Result ContinueExecution();
 			virtual Result ReadMem(size_t address, size_t size, void* dest);
 			virtual Result WriteMem(size_t address, size_t size, const void* src);
+			virtual Result MemoryMap(const MemoryRegion** regions, int* count);
 			virtual Result ReadRegister(RegisterID reg, void* dest);
 			virtual Result WriteRegister(RegisterID reg, const void* src);
+			virtual Result ReadRegisters(void* dest);
+			virtual Result WriteRegisters(const void* src);
 			virtual Result CreateTracepoint(size_t address, TracepointType type, TracepointAction action);
 			virtual Result ClearTracepoint(size_t address);
+			virtual Result TraceReset();
+			virtual Result TraceDefine(uint32_t number, size_t address, bool enabled, uint64_t passCount);
+			virtual Result TraceAddCollect(uint32_t number, size_t address, const TraceCollect& collect);
+			virtual Result TraceSetCircular(bool circular);
+			virtual Result TraceStart();
+			virtual Result TraceStop();
+			virtual Result TraceQueryStatus(TraceStatus* status);
+			virtual Result TraceFindFrame(TraceFind mode, uint64_t arg1, uint64_t arg2, int* frame, uint32_t* tracepoint);
+			virtual Result ThreadList(uint32_t* threads, uint32_t maxThreads, uint32_t* count);
+			virtual Result SelectThread(uint32_t thread);
+			virtual Result StoppedThread(uint32_t* thread);
+			virtual Result ThreadName(uint32_t thread, char* name, size_t size);
+			virtual Result SingleStepThread(uint32_t thread);
+			virtual Result ReverseStepThread(uint32_t thread);
+			virtual Result ReverseContinueExecution();
+			virtual Result HistoryBegin(bool* begin);
 			virtual Result InvalidCommand(const char* cmd);
 
+			// "monitor source [address]", the game's source position from its DWARF info
+			Result SourceCommand(const char* args);
+			// "monitor history", what reverse execution has recorded so far
+			Result HistoryCommand(const char* args);
+			// "monitor profile ...", the sampling profiler's controls and reports
+			Result ProfileCommand(const char* args);
+
 		private:
+			void DefineSnapshotRegister(const char* name, int bits, size_t offset, RegisterType type = RegisterType::GeneralPurpose);
+			// false when the live target is selected
+			bool GetTraceFrameRegisters(DebugRegisterSnapshot& regs);
+			void ReverseStopped(bool historyBegin);
+
+			// where a register lives in DebugRegisterSnapshot
 			struct reginfo {
-				int cat;
-				int num;
+				size_t offset;
 				int bits;
 			};
-			DisassemblyDialog* m_disDialog;
+			// TCP port, from PCSX2_GDB_PORT when set
+			unsigned short m_port;
+			// CPU selected by GDB ('Hg'), memory, register and breakpoint accesses go there
+			DebugInterface* m_cpu;
+			// thread reported in the next stop reply
+			std::atomic<uint32_t> m_stopThread;
+			// the last reverse execution stopped at the oldest snapshot, until the core
+			// changes its state again
+			bool m_historyBegin;
+			u32 m_historySequence;
 			std::unordered_map<RegisterID, reginfo> m_regInfo;
+			std::vector<MemoryRegion> m_memoryMap;
+			// DefineRegister keeps the name pointer
+			std::vector<std::string> m_regNames;
 			std::thread m_gdbThread;
+			// copy of the trace frame selected with QTFrame, registers and memory are
+			// read from it instead of the live target while m_traceFrameNumber >= 0
+			std::vector<u8> m_traceFrame;
+			int m_traceFrameNumber;
 			bool m_initialized;
     };
 }
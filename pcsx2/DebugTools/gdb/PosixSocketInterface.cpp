@@ -0,0 +1,322 @@
+#include "PosixSocketInterface.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace GDB {
+    static bool SetNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0) return false;
+        return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    PosixSocketInterface::PosixSocketInterface(Architecture arch) : Interface(arch), m_listening(false), m_listenFd(-1), m_conn(-1) {
+        m_wakeFds[0] = m_wakeFds[1] = -1;
+    }
+
+    PosixSocketInterface::~PosixSocketInterface() {
+        CloseAll();
+    }
+
+    void PosixSocketInterface::SetUnixSocketPath(const char* path) {
+        m_unixPath = path ? path : "";
+    }
+
+    bool PosixSocketInterface::OpenListenSocket(unsigned short port) {
+        if (!m_unixPath.empty()) {
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            if (m_unixPath.size() >= sizeof(addr.sun_path)) {
+                DebugPrintf("Unix socket path is too long: %s", m_unixPath.c_str());
+                return false;
+            }
+
+            m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (m_listenFd < 0) {
+                DebugPrintf("Failed to open unix socket <%s>.", strerror(errno));
+                return false;
+            }
+
+            addr.sun_family = AF_UNIX;
+            strcpy(addr.sun_path, m_unixPath.c_str());
+
+            // a stale socket file from a previous run would make bind() fail
+            unlink(m_unixPath.c_str());
+            if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+                DebugPrintf("Failed to bind GDB server to %s <%s>.", m_unixPath.c_str(), strerror(errno));
+                return false;
+            }
+        } else {
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+
+            m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (m_listenFd < 0) {
+                DebugPrintf("Failed to open socket <%s>.", strerror(errno));
+                return false;
+            }
+
+            int yes = 1;
+            setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            addr.sin_port = htons(port);
+
+            if (bind(m_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+                DebugPrintf("Failed to bind GDB server to port %d <%s>.", port, strerror(errno));
+                return false;
+            }
+        }
+
+        if (listen(m_listenFd, 1) < 0) {
+            DebugPrintf("Failed to listen for connections to GDB server <%s>.", strerror(errno));
+            return false;
+        }
+
+        if (!SetNonBlocking(m_listenFd)) {
+            DebugPrintf("Failed to make GDB server socket non-blocking <%s>.", strerror(errno));
+            return false;
+        }
+
+        return true;
+    }
+
+    bool PosixSocketInterface::IO_Open(unsigned short port) {
+        if (m_listenFd >= 0 || m_conn >= 0) {
+            DebugPrint("Socket is already open.");
+            return false;
+        }
+
+        Lock();
+        if (pipe(m_wakeFds) < 0) {
+            DebugPrintf("Failed to create wakeup pipe <%s>.", strerror(errno));
+            m_wakeFds[0] = m_wakeFds[1] = -1;
+            Unlock();
+            return false;
+        }
+
+        // never block the waking thread, and let IO_Poll drain whatever piled up
+        SetNonBlocking(m_wakeFds[0]);
+        SetNonBlocking(m_wakeFds[1]);
+
+        if (!OpenListenSocket(port)) {
+            CloseAll();
+            Unlock();
+            return false;
+        }
+
+        if (m_unixPath.empty()) DebugPrintf("Waiting for connection to GDB server on port %d...", port);
+        else DebugPrintf("Waiting for connection to GDB server on %s...", m_unixPath.c_str());
+
+        m_listening = true;
+        int listenFd = m_listenFd;
+        int wakeFd = m_wakeFds[0];
+        Unlock();
+
+        int conn = -1;
+        while (true) {
+            pollfd fds[2];
+            fds[0].fd = listenFd;
+            fds[0].events = POLLIN;
+            fds[0].revents = 0;
+            fds[1].fd = wakeFd;
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+
+            int r = poll(fds, 2, -1);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            // StopListening() was called
+            if (fds[1].revents) break;
+
+            if (fds[0].revents & POLLIN) {
+                conn = accept(listenFd, nullptr, nullptr);
+                if (conn >= 0) break;
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) continue;
+                break;
+            }
+
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) break;
+        }
+
+        Lock();
+        m_listening = false;
+        if (conn < 0) {
+            DebugPrint("Failed to accept connection to GDB server.");
+            CloseAll();
+            Unlock();
+            return false;
+        }
+
+        // only one debugger at a time, stop accepting new connections
+        close(m_listenFd);
+        m_listenFd = -1;
+
+        m_conn = conn;
+        SetNonBlocking(m_conn);
+
+        // GDB sends many tiny packets and waits for each reply, Nagle would
+        // hold every one of them back for a full delayed-ack period
+        if (m_unixPath.empty()) {
+            int yes = 1;
+            setsockopt(m_conn, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+        Unlock();
+
+        GDB_Connected();
+        return true;
+    }
+
+    void PosixSocketInterface::GDB_Connected() {
+    }
+
+    void PosixSocketInterface::CloseAll() {
+        if (m_conn >= 0) close(m_conn);
+        if (m_listenFd >= 0) close(m_listenFd);
+        if (!m_unixPath.empty()) unlink(m_unixPath.c_str());
+
+        m_conn = m_listenFd = -1;
+
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (m_wakeFds[0] >= 0) close(m_wakeFds[0]);
+        if (m_wakeFds[1] >= 0) close(m_wakeFds[1]);
+        m_wakeFds[0] = m_wakeFds[1] = -1;
+    }
+
+    void PosixSocketInterface::IO_Close() {
+        if (m_conn < 0 && m_listenFd < 0) {
+            DebugPrint("Socket is not currently open.");
+            return;
+        }
+
+        CloseAll();
+        DebugPrint("Closed GDB server.");
+    }
+
+    size_t PosixSocketInterface::IO_Peek() {
+        if (m_conn < 0) {
+            DebugPrint("Socket is not currently open.");
+            return 0;
+        }
+
+        int r = 0;
+        if (ioctl(m_conn, FIONREAD, &r) < 0) return 0;
+        return (size_t)r;
+    }
+
+    Result PosixSocketInterface::IO_Read(void* dest, size_t size, size_t* bytesRead) {
+        *bytesRead = 0;
+        if (m_conn < 0) {
+            DebugPrint("Socket is not currently open.");
+            return Result::InternalError;
+        }
+
+        while (true) {
+            ssize_t r = recv(m_conn, dest, size, 0);
+            if (r > 0) {
+                *bytesRead = (size_t)r;
+                return Result::Success;
+            }
+
+            if (r == 0) return Result::PeerDisconnected;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return Result::Success;
+            return Result::InternalError;
+        }
+    }
+
+    Result PosixSocketInterface::IO_Write(const void* src, size_t size) {
+        if (m_conn < 0) {
+            DebugPrint("Socket is not currently open.");
+            return Result::InternalError;
+        }
+
+        const char* data = (const char*)src;
+        while (size > 0) {
+            ssize_t r = send(m_conn, data, size, MSG_NOSIGNAL);
+            if (r > 0) {
+                data += r;
+                size -= (size_t)r;
+                continue;
+            }
+
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // socket buffer is full (large 'm' replies), wait until it drains
+                pollfd pfd;
+                pfd.fd = m_conn;
+                pfd.events = POLLOUT;
+                pfd.revents = 0;
+                if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return Result::InternalError;
+                if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) return Result::PeerDisconnected;
+                continue;
+            }
+
+            return r == 0 || errno == EPIPE || errno == ECONNRESET ? Result::PeerDisconnected : Result::InternalError;
+        }
+
+        return Result::Success;
+    }
+
+    Result PosixSocketInterface::IO_Poll() {
+        if (m_conn < 0) {
+            DebugPrint("Socket is not currently open.");
+            return Result::InternalError;
+        }
+
+        // Blocks until GDB sends something or IO_Wake is called (target stopped,
+        // server shutting down), an idle connection doesn't cost any CPU time
+        pollfd fds[2];
+        fds[0].fd = m_conn;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = m_wakeFds[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        int r = poll(fds, m_wakeFds[0] >= 0 ? 2 : 1, -1);
+        if (r < 0 && errno != EINTR) return Result::InternalError;
+        if (r > 0 && !(fds[0].revents & POLLIN) && (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))) return Result::PeerDisconnected;
+
+        if (r > 0 && (fds[1].revents & POLLIN)) {
+            char buf[64];
+            while (read(m_wakeFds[0], buf, sizeof(buf)) > 0) {}
+        }
+
+        return Result::Success;
+    }
+
+    void PosixSocketInterface::IO_Wake() {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (m_wakeFds[1] >= 0) {
+            char c = 0;
+            ssize_t r = write(m_wakeFds[1], &c, 1);
+            (void)r;
+        }
+    }
+
+    bool PosixSocketInterface::IsListening() const {
+        return m_listening;
+    }
+
+    void PosixSocketInterface::StopListening() {
+        IO_Wake();
+    }
+};
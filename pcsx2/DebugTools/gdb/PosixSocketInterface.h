@@ -0,0 +1,40 @@
+#pragma once
+#include "cpp_gdb.h"
+#include <string>
+#include <mutex>
+
+namespace GDB {
+    class PosixSocketInterface : public Interface {
+        public:
+            PosixSocketInterface(Architecture arch);
+            ~PosixSocketInterface();
+
+            // When set, IO_Open listens on a Unix-domain socket at this path instead of TCP
+            void SetUnixSocketPath(const char* path);
+
+            virtual bool IO_Open(unsigned short port);
+            virtual void GDB_Connected();
+            virtual void IO_Close();
+            virtual size_t IO_Peek();
+            virtual Result IO_Read(void* dest, size_t size, size_t* bytesRead);
+            virtual Result IO_Write(const void* src, size_t size);
+            virtual Result IO_Poll();
+            virtual void IO_Wake();
+
+            bool IsListening() const;
+            void StopListening();
+
+        protected:
+            bool OpenListenSocket(unsigned short port);
+            void CloseAll();
+
+            bool m_listening;
+            int m_listenFd;
+            int m_conn;
+            // self-pipe used to wake a blocked accept()/poll() from StopListening and IO_Wake
+            int m_wakeFds[2];
+            // IO_Wake can't take Lock(), this keeps the pipe alive while it writes
+            std::mutex m_wakeMutex;
+            std::string m_unixPath;
+    };
+};
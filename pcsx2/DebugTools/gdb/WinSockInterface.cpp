@@ -7,7 +7,7 @@
 #define _srv ((sockaddr_in*)m_server)
 #define _cli ((sockaddr_in*)m_client)
 namespace GDB {
-    WinSockInterface::WinSockInterface(Architecture arch) : Interface(arch), m_server(nullptr), m_socket(0), m_conn(0), m_listening(false) {
+    WinSockInterface::WinSockInterface(Architecture arch) : Interface(arch), m_server(nullptr), m_socket(0), m_conn(0), m_wake(0), m_listening(false) {
     }
 
     WinSockInterface::~WinSockInterface() {
@@ -114,6 +114,19 @@ namespace GDB {
 			Unlock();
             return false;
         }
+
+        if (!OpenWakeSocket()) {
+            DebugPrintf("Failed to create wakeup socket <%d>.", WSAGetLastError());
+            closesocket(m_conn);
+            if (m_socket) closesocket(m_socket);
+            WSACleanup();
+            free(m_server);
+            free(m_client);
+            m_conn = m_socket = 0;
+			m_server = m_client = nullptr;
+			Unlock();
+            return false;
+        }
         Unlock();
 
         GDB_Connected();
@@ -123,6 +136,40 @@ namespace GDB {
     void WinSockInterface::GDB_Connected() {
     }
 
+    bool WinSockInterface::OpenWakeSocket() {
+        SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (s == INVALID_SOCKET) return false;
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+
+        // bind to any free port, then connect to it so IO_Wake can simply send()
+        int len = sizeof(addr);
+        if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+            || getsockname(s, (sockaddr*)&addr, &len) == SOCKET_ERROR
+            || connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            closesocket(s);
+            return false;
+        }
+
+        // never block the waking thread, and let IO_Poll drain whatever piled up
+        u_long nonBlocking = 1;
+        ioctlsocket(s, FIONBIO, &nonBlocking);
+
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wake = s;
+        return true;
+    }
+
+    void WinSockInterface::CloseWakeSocket() {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (m_wake) closesocket(m_wake);
+        m_wake = 0;
+    }
+
     void WinSockInterface::IO_Close() {
         if (!m_server) {
             DebugPrint("Socket is not currently open.");
@@ -130,6 +177,7 @@ namespace GDB {
         }
 
         closesocket(m_socket);
+        CloseWakeSocket();
         WSACleanup();
         free(m_server);
 
@@ -200,9 +248,36 @@ namespace GDB {
             return Result::InternalError;
         }
 
+        // Blocks until GDB sends something or IO_Wake is called (target stopped,
+        // server shutting down), an idle connection doesn't cost any CPU time
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(m_conn, &fds);
+        if (m_wake) FD_SET(m_wake, &fds);
+
+        if (select(0, &fds, nullptr, nullptr, nullptr) == SOCKET_ERROR) {
+            return Result::InternalError;
+        }
+
+        if (m_wake && FD_ISSET(m_wake, &fds)) {
+            char buf[64];
+            while (recv(m_wake, buf, sizeof(buf), 0) > 0) {}
+        }
+
+        // readable with nothing to peek at, the other end closed the connection
+        if (FD_ISSET(m_conn, &fds)) {
+            char c;
+            if (recv(m_conn, &c, 1, MSG_PEEK) <= 0) return Result::PeerDisconnected;
+        }
+
         return Result::Success;
 	}
 
+    void WinSockInterface::IO_Wake() {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (m_wake) send(m_wake, "", 1, 0);
+    }
+
 	bool WinSockInterface::IsListening() const {
         return m_listening;
     }
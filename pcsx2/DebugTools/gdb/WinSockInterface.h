@@ -1,6 +1,7 @@
 #pragma once
 #include "cpp_gdb.h"
 #include <string.h>
+#include <mutex>
 
 namespace GDB {
     class WinSockInterface : public Interface {
@@ -15,14 +16,22 @@ namespace GDB {
             virtual Result IO_Read(void* dest, size_t size, size_t* bytesRead);
             virtual Result IO_Write(const void* src, size_t size);
             virtual Result IO_Poll();
+            virtual void IO_Wake();
 
             bool IsListening() const;
             void StopListening();
 
         protected:
+            bool OpenWakeSocket();
+            void CloseWakeSocket();
+
             bool m_listening;
             unsigned int m_socket;
             unsigned int m_conn;
+            // loopback datagram socket connected to itself, wakes a blocked select() in IO_Poll
+            unsigned int m_wake;
+            // IO_Wake can't take Lock(), this keeps the socket alive while it sends
+            std::mutex m_wakeMutex;
             void* m_server;
             void* m_client;
     };
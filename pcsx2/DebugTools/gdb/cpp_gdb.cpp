@@ -5,6 +5,11 @@
 
 #include "cpp_gdb.h"
 
+#ifndef _WIN32
+#include <strings.h>
+#define _stricmp strcasecmp
+#endif
+
 extern "C" {
     #include "gdb.h"
 }
@@ -15,16 +20,6 @@ extern "C" {
 #define _regs ((GDBSTUBREG*)m_registers)
 #define _cmds ((GDBSTUBCMD*)m_customCommands)
 
-void SwapBytes(void* pv, size_t n) {
-	char* p = (char*)pv;
-	size_t lo, hi;
-	for (lo = 0, hi = n - 1; hi > lo; lo++, hi--) {
-		char tmp = p[lo];
-		p[lo] = p[hi];
-		p[hi] = tmp;
-	}
-}
-
 namespace GDB {
 
 
@@ -128,7 +123,7 @@ namespace GDB {
         Interface::CommandCallback cb = i->GetCommandCallback(((GDBSTUBCMD*)pCmd)->pszCmd);
         
         if (cb) {
-            return cmdStatus(cb(i, args));
+            return cmdStatus(i->RunCommand(cb, args, hlp));
         }
         
         i->DebugPrint("InternalError: Command callback not found");
@@ -185,17 +180,22 @@ namespace GDB {
         return cmdStatus(i->WriteMem(GdbTgtMemAddr, cbWrite, pvSrc));
     }
 
+    int gdbStubIfTgtMemMapQuery(GDBSTUBCTX hGdbStubCtx, void *pvUser, PCGDBSTUBMEMREGION *ppaRegions, uint32_t *pcRegions) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->QueryMemoryMap((const void**)ppaRegions, pcRegions));
+    }
+
     int gdbStubIfTgtRegsRead(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *paRegs, uint32_t cRegs, void *pvDst) {
         Interface* i = (Interface*)pvUser;
 
-        uint8_t* dest = (uint8_t*)pvDst;
+        // 'g' always asks for every register in order
+        if (cRegs == (uint32_t)i->RegisterCount()) return cmdStatus(i->ReadRegisters(pvDst));
 
+        uint8_t* dest = (uint8_t*)pvDst;
         for (uint32_t r = 0; r < cRegs; r++) {
-            int bytes = i->RegisterBits((Interface::RegisterID)paRegs[r]) / 8;
             Result result = i->ReadRegister((Interface::RegisterID)paRegs[r], (void*)dest);
-            SwapBytes(dest, bytes);
             if (result != Result::Success) return cmdStatus(result);
-            dest += bytes;
+            dest += i->RegisterBits((Interface::RegisterID)paRegs[r]) / 8;
         }
 
         return GDBSTUB_INF_SUCCESS;
@@ -203,9 +203,18 @@ namespace GDB {
 
     int gdbStubIfTgtRegsWrite(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *paRegs, uint32_t cRegs, const void *pvSrc) {
         Interface* i = (Interface*)pvUser;
-        
-        // After inspecting gdb-stub.c, cRegs will always be 1
-        return cmdStatus(i->WriteRegister((Interface::RegisterID)*paRegs, pvSrc));
+
+        // 'G' always writes every register in order
+        if (cRegs == (uint32_t)i->RegisterCount()) return cmdStatus(i->WriteRegisters(pvSrc));
+
+        const uint8_t* src = (const uint8_t*)pvSrc;
+        for (uint32_t r = 0; r < cRegs; r++) {
+            Result result = i->WriteRegister((Interface::RegisterID)paRegs[r], (const void*)src);
+            if (result != Result::Success) return cmdStatus(result);
+            src += i->RegisterBits((Interface::RegisterID)paRegs[r]) / 8;
+        }
+
+        return GDBSTUB_INF_SUCCESS;
     }
 
     int gdbStubIfTgtTpSet(GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBTGTMEMADDR GdbTgtTpAddr, GDBSTUBTPTYPE enmTpType, GDBSTUBTPACTION enmTpAction) {
@@ -218,6 +227,131 @@ namespace GDB {
         return cmdStatus(i->ClearTracepoint(GdbTgtTpAddr));
     }
 
+    int gdbStubIfTgtTraceReset(GDBSTUBCTX hGdbStubCtx, void *pvUser) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->TraceReset());
+    }
+
+    int gdbStubIfTgtTraceTpDefine(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, int fEnabled, uint64_t cPass) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->TraceDefine(idTp, GdbTgtTpAddr, fEnabled != 0, cPass));
+    }
+
+    int gdbStubIfTgtTraceTpCollect(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, PCGDBSTUBTRACECOLLECT pCollect) {
+        Interface* i = (Interface*)pvUser;
+        TraceCollect collect;
+        switch (pCollect->enmType) {
+            case GDBSTUBTRACECOLLECTTYPE_REGS: collect.type = TraceCollectType::Registers; break;
+            case GDBSTUBTRACECOLLECTTYPE_MEM: collect.type = TraceCollectType::Memory; break;
+            default: return GDBSTUB_ERR_INVALID_PARAMETER;
+        }
+        collect.baseRegister = pCollect->idxRegBase;
+        collect.offset = pCollect->offMem;
+        collect.size = pCollect->cbMem;
+        return cmdStatus(i->TraceAddCollect(idTp, GdbTgtTpAddr, collect));
+    }
+
+    int gdbStubIfTgtTraceSetCircular(GDBSTUBCTX hGdbStubCtx, void *pvUser, int fCircular) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->TraceSetCircular(fCircular != 0));
+    }
+
+    int gdbStubIfTgtTraceStart(GDBSTUBCTX hGdbStubCtx, void *pvUser) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->TraceStart());
+    }
+
+    int gdbStubIfTgtTraceStop(GDBSTUBCTX hGdbStubCtx, void *pvUser) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->TraceStop());
+    }
+
+    int gdbStubIfTgtTraceStatus(GDBSTUBCTX hGdbStubCtx, void *pvUser, PGDBSTUBTRACESTATUS pStatus) {
+        Interface* i = (Interface*)pvUser;
+        TraceStatus status = {};
+        Result result = i->TraceQueryStatus(&status);
+        if (result != Result::Success) return cmdStatus(result);
+
+        pStatus->fRunning = status.running;
+        switch (status.stop) {
+            case TraceStop::User: pStatus->enmStop = GDBSTUBTRACESTOP_USER; break;
+            case TraceStop::PassCount: pStatus->enmStop = GDBSTUBTRACESTOP_PASSCOUNT; break;
+            case TraceStop::BufferFull: pStatus->enmStop = GDBSTUBTRACESTOP_BUFFER_FULL; break;
+            default: pStatus->enmStop = GDBSTUBTRACESTOP_NOT_RUN; break;
+        }
+        pStatus->idTpStop = status.stopTracepoint;
+        pStatus->fCircular = status.circular;
+        pStatus->cFrames = status.frames;
+        pStatus->cFramesCreated = status.created;
+        pStatus->cbBuffer = status.bufferSize;
+        pStatus->cbBufferFree = status.bufferFree;
+        return GDBSTUB_INF_SUCCESS;
+    }
+
+    int gdbStubIfTgtTraceFrameFind(GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBSTUBTRACEFIND enmFind, uint64_t u64Arg1, uint64_t u64Arg2,
+                                   int32_t *piFrame, uint32_t *pidTp) {
+        Interface* i = (Interface*)pvUser;
+        TraceFind mode;
+        switch (enmFind) {
+            case GDBSTUBTRACEFIND_FRAME: mode = TraceFind::Frame; break;
+            case GDBSTUBTRACEFIND_PC: mode = TraceFind::PC; break;
+            case GDBSTUBTRACEFIND_TP: mode = TraceFind::Tracepoint; break;
+            case GDBSTUBTRACEFIND_RANGE: mode = TraceFind::Range; break;
+            case GDBSTUBTRACEFIND_OUTSIDE: mode = TraceFind::Outside; break;
+            default: return GDBSTUB_ERR_INVALID_PARAMETER;
+        }
+
+        int frame = -1;
+        uint32_t tracepoint = 0;
+        Result result = i->TraceFindFrame(mode, u64Arg1, u64Arg2, &frame, &tracepoint);
+        *piFrame = frame;
+        *pidTp = tracepoint;
+        return cmdStatus(result);
+    }
+
+    int gdbStubIfTgtThreadList(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *paidThreads, uint32_t cThreadsMax, uint32_t *pcThreads) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->ThreadList(paidThreads, cThreadsMax, pcThreads));
+    }
+
+    int gdbStubIfTgtThreadSelect(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->SelectThread(idThread));
+    }
+
+    int gdbStubIfTgtThreadQueryStopped(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *pidThread) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->StoppedThread(pidThread));
+    }
+
+    int gdbStubIfTgtThreadQueryName(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread, char *pszName, size_t cbName) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->ThreadName(idThread, pszName, cbName));
+    }
+
+    int gdbStubIfTgtThreadStep(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->SingleStepThread(idThread));
+    }
+
+    int gdbStubIfTgtReverseStep(GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->ReverseStepThread(idThread));
+    }
+
+    int gdbStubIfTgtReverseCont(GDBSTUBCTX hGdbStubCtx, void *pvUser) {
+        Interface* i = (Interface*)pvUser;
+        return cmdStatus(i->ReverseContinueExecution());
+    }
+
+    int gdbStubIfTgtReverseQueryHistoryBegin(GDBSTUBCTX hGdbStubCtx, void *pvUser, int *pfBegin) {
+        Interface* i = (Interface*)pvUser;
+        bool begin = false;
+        Result result = i->HistoryBegin(&begin);
+        *pfBegin = begin ? 1 : 0;
+        return cmdStatus(result);
+    }
+
     int gdbStubIfMonCmd(GDBSTUBCTX hGdbStubCtx, PCGDBSTUBOUTHLP pHlp, const char *pszCmd, void *pvUser) {
         Interface* i = (Interface*)pvUser;
         return cmdStatus(i->InvalidCommand(pszCmd));
@@ -225,10 +359,7 @@ namespace GDB {
     
     void gdbStubIfPrePkt(GDBSTUBCTX hGdbStubCtx, const char* pkt, uint16_t sz, void* pvUser) {
         Interface* i = (Interface*)pvUser;
-        static char buf[512] = { 0 };
-        for (int i = 0;i < sz;i++) buf[i] = pkt[i];
-        buf[sz] = 0;
-        i->PacketReceived(buf);
+        i->PacketReceived(pkt, sz);
 	}
 
 	void gdbStubIfLock(void* pvUser) {
@@ -271,6 +402,7 @@ namespace GDB {
 
     Interface::Interface(Architecture arch) {
         m_enabled = false;
+        m_running = false;
         m_ctx = nullptr;
         m_io = nullptr;
         m_if = nullptr;
@@ -283,6 +415,9 @@ namespace GDB {
         m_registerCount = 0;
         m_customCommandCapacity = 8;
         m_customCommandCount = 0;
+        m_commandOutput = nullptr;
+        m_memRegions = nullptr;
+        m_memRegionCapacity = 0;
 
         m_io = malloc(sizeof(GDBSTUBIOIF));
         m_if = malloc(sizeof(GDBSTUBIF));
@@ -316,6 +451,23 @@ namespace GDB {
         _if->pfnPktCb = gdbStubIfPrePkt;
         _if->pfnLock = gdbStubIfLock;
         _if->pfnUnlock = gdbStubIfUnlock;
+        _if->pfnTgtMemMapQuery = gdbStubIfTgtMemMapQuery;
+        _if->pfnTgtTraceReset = gdbStubIfTgtTraceReset;
+        _if->pfnTgtTraceTpDefine = gdbStubIfTgtTraceTpDefine;
+        _if->pfnTgtTraceTpCollect = gdbStubIfTgtTraceTpCollect;
+        _if->pfnTgtTraceSetCircular = gdbStubIfTgtTraceSetCircular;
+        _if->pfnTgtTraceStart = gdbStubIfTgtTraceStart;
+        _if->pfnTgtTraceStop = gdbStubIfTgtTraceStop;
+        _if->pfnTgtTraceStatus = gdbStubIfTgtTraceStatus;
+        _if->pfnTgtTraceFrameFind = gdbStubIfTgtTraceFrameFind;
+        _if->pfnTgtThreadList = gdbStubIfTgtThreadList;
+        _if->pfnTgtThreadSelect = gdbStubIfTgtThreadSelect;
+        _if->pfnTgtThreadQueryStopped = gdbStubIfTgtThreadQueryStopped;
+        _if->pfnTgtThreadQueryName = gdbStubIfTgtThreadQueryName;
+        _if->pfnTgtThreadStep = gdbStubIfTgtThreadStep;
+        _if->pfnTgtReverseStep = gdbStubIfTgtReverseStep;
+        _if->pfnTgtReverseCont = gdbStubIfTgtReverseCont;
+        _if->pfnTgtReverseQueryHistoryBegin = gdbStubIfTgtReverseQueryHistoryBegin;
 
         _io->pfnPeek = gdbStubIoIfPeek;
         _io->pfnRead = gdbStubIoIfRead;
@@ -347,6 +499,11 @@ namespace GDB {
             m_registers = nullptr;
         }
 
+        if (m_memRegions) {
+            free(m_memRegions);
+            m_memRegions = nullptr;
+        }
+
         if (m_customCommands) {
             free(m_customCommands);
             m_customCommands = nullptr;
@@ -367,19 +524,28 @@ namespace GDB {
 
         if (GDBStubCtxCreate((GDBSTUBCTX*)&m_ctx, _io, _if, (void*)this) != GDBSTUB_INF_SUCCESS) DebugPrint("Failed to create GDB stub context");
         else {
+            // before m_enabled can be seen, so a Disable racing with the start of Run waits for it
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = true;
+            }
             m_enabled = IO_Open(port);
-			if (!m_enabled) GDBStubCtxDestroy(_ctx);
+            if (!m_enabled) {
+                GDBStubCtxDestroy(_ctx);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
         }
     }
 
     void Interface::Disable() {
         if (!m_enabled) return;
-        m_mutex.lock();
-        _ctx->doShutdown = true;
-        m_mutex.unlock();
-
-        while (!_ctx->didShutdown) {
-            
+        // the flag first, the run loop checks it once IO_Poll returned
+        GDBStubCtxShutdown(_ctx);
+        IO_Wake();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_runDone.wait(lock, [this] { return !m_running; });
         }
 
         GDBStubCtxDestroy(_ctx);
@@ -437,6 +603,26 @@ namespace GDB {
         return nullptr;
     }
 
+    Result Interface::RunCommand(Interface::CommandCallback cb, const char* args, const void* output) {
+        m_commandOutput = output;
+        Result r = cb(this, args);
+        m_commandOutput = nullptr;
+        return r;
+    }
+
+    int Interface::CommandPrintf(const char* fmt, ...) {
+        if (!m_commandOutput) return 0;
+
+        va_list l;
+        va_start(l, fmt);
+        char msg[2048];
+        vsnprintf(msg, sizeof(msg), fmt, l);
+        va_end(l);
+
+        PCGDBSTUBOUTHLP hlp = (PCGDBSTUBOUTHLP)m_commandOutput;
+        return hlp->pfnPrintf(hlp, "%s", msg);
+    }
+
     Interface::RegisterID Interface::DefineRegister(const char* name, unsigned char bits, RegisterType type) {
         if (m_enabled) {
             DebugPrint("InternalError: Cannot define registers once the GDB interface is started.");
@@ -467,7 +653,12 @@ namespace GDB {
     }
 
     Result Interface::Run() {
-        return cmdResult(GDBStubCtxRun(_ctx));
+        Result result = cmdResult(GDBStubCtxRun(_ctx));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_runDone.notify_all();
+        return result;
     }
 
     const char* Interface::RegisterName(RegisterID reg) const {
@@ -497,11 +688,16 @@ namespace GDB {
         return Result::InternalError;
     }
 
+    void Interface::IO_Wake() {
+    }
+
     int Interface::DebugPrintf(const char* fmt, ...) {
         va_list l;
         va_start(l, fmt);
         char msg[2048];
-        int c = vsnprintf(msg, 2047, fmt, l);
+        int c = vsnprintf(msg, sizeof(msg), fmt, l);
+        if (c < 0) c = 0;
+        if (c >= (int)sizeof(msg)) c = sizeof(msg) - 1;
         *(msg + c) = 0;
         va_end(l);
 
@@ -552,6 +748,36 @@ namespace GDB {
         return Result::NotSupported;
     }
 
+    Result Interface::QueryMemoryMap(const void** regions, uint32_t* count) {
+        const MemoryRegion* map = nullptr;
+        int mapCount = 0;
+        Result result = MemoryMap(&map, &mapCount);
+        if (result != Result::Success) return result;
+
+        if (mapCount > m_memRegionCapacity) {
+            void* newRegions = malloc(sizeof(GDBSTUBMEMREGION) * mapCount);
+            if (!newRegions) { DebugPrint("InternalError: Failed to allocate space for memory map."); return Result::NoMemory; }
+            if (m_memRegions) free(m_memRegions);
+            m_memRegions = newRegions;
+            m_memRegionCapacity = mapCount;
+        }
+
+        GDBSTUBMEMREGION* out = (GDBSTUBMEMREGION*)m_memRegions;
+        for (int r = 0;r < mapCount;r++) {
+            out[r].GdbTgtMemAddrStart = map[r].start;
+            out[r].cbRegion = map[r].size;
+            out[r].enmType = map[r].type == MemoryType::ROM ? GDBSTUBMEMTYPE_ROM : GDBSTUBMEMTYPE_RAM;
+        }
+
+        *regions = m_memRegions;
+        *count = mapCount;
+        return Result::Success;
+    }
+
+    Result Interface::MemoryMap(const MemoryRegion** regions, int* count) {
+        return Result::NotSupported;
+    }
+
     Result Interface::ReadRegister(RegisterID reg, void* dest) {
         return Result::NotSupported;
     }
@@ -560,6 +786,28 @@ namespace GDB {
         return Result::NotSupported;
     }
 
+    Result Interface::ReadRegisters(void* dest) {
+        uint8_t* out = (uint8_t*)dest;
+        for (RegisterID r = 0; r < m_registerCount; r++) {
+            Result result = ReadRegister(r, out);
+            if (result != Result::Success) return result;
+            out += RegisterBits(r) / 8;
+        }
+
+        return Result::Success;
+    }
+
+    Result Interface::WriteRegisters(const void* src) {
+        const uint8_t* in = (const uint8_t*)src;
+        for (RegisterID r = 0; r < m_registerCount; r++) {
+            Result result = WriteRegister(r, in);
+            if (result != Result::Success) return result;
+            in += RegisterBits(r) / 8;
+        }
+
+        return Result::Success;
+    }
+
     Result Interface::CreateTracepoint(size_t address, TracepointType type, TracepointAction action) {
         return Result::NotSupported;
     }
@@ -568,12 +816,77 @@ namespace GDB {
         return Result::NotSupported;
     }
 
+    Result Interface::TraceReset() {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceDefine(uint32_t number, size_t address, bool enabled, uint64_t passCount) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceAddCollect(uint32_t number, size_t address, const TraceCollect& collect) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceSetCircular(bool circular) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceStart() {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceStop() {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceQueryStatus(TraceStatus* status) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::TraceFindFrame(TraceFind mode, uint64_t arg1, uint64_t arg2, int* frame, uint32_t* tracepoint) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::ThreadList(uint32_t* threads, uint32_t maxThreads, uint32_t* count) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::SelectThread(uint32_t thread) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::StoppedThread(uint32_t* thread) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::ThreadName(uint32_t thread, char* name, size_t size) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::SingleStepThread(uint32_t thread) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::ReverseStepThread(uint32_t thread) {
+        return Result::NotSupported;
+    }
+
+    Result Interface::ReverseContinueExecution() {
+        return Result::NotSupported;
+    }
+
+    Result Interface::HistoryBegin(bool* begin) {
+        *begin = false;
+        return Result::NotSupported;
+    }
+
     Result Interface::InvalidCommand(const char* cmd) {
 		DebugPrintf("Invalid command: %s", cmd);
         return Result::NotSupported;
     }
 
-    void Interface::PacketReceived(const char* pkt) {
-        DebugPrintf("Received: %s", pkt);
+    void Interface::PacketReceived(const char* pkt, size_t size) {
+        DebugPrintf("Received: %.*s", (int)size, pkt);
     }
 };
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
+#include <condition_variable>
 #include <mutex>
+#include <stdint.h>
+#include <stddef.h>
 
 namespace GDB {
     enum class ProcessStatus {
@@ -42,6 +45,56 @@ namespace GDB {
         Stop
     };
 
+    enum class MemoryType {
+        RAM,
+        ROM
+    };
+
+    struct MemoryRegion {
+        size_t start;
+        size_t size;
+        MemoryType type;
+    };
+
+    enum class TraceCollectType {
+        Registers,
+        Memory
+    };
+
+    struct TraceCollect {
+        TraceCollectType type;
+        // register the memory range is relative to, -1 for an absolute address
+        int baseRegister;
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    enum class TraceFind {
+        Frame,
+        PC,
+        Tracepoint,
+        Range,
+        Outside
+    };
+
+    enum class TraceStop {
+        NotRun,
+        User,
+        PassCount,
+        BufferFull
+    };
+
+    struct TraceStatus {
+        bool running;
+        TraceStop stop;
+        uint32_t stopTracepoint;
+        bool circular;
+        uint64_t frames;
+        uint64_t created;
+        uint64_t bufferSize;
+        uint64_t bufferFree;
+    };
+
     enum class RegisterType {
         GeneralPurpose,
         FloatingPoint,
@@ -69,14 +122,21 @@ namespace GDB {
             // Custom GDB command helpers
             void DefineCustomCommand(const char* cmd, CommandCallback cb, const char* desc = nullptr);
             CommandCallback GetCommandCallback(const char* cmd);
+            Result RunCommand(CommandCallback cb, const char* args, const void* output);
+            // Output for GDB's console, only while a custom command runs
+            int CommandPrintf(const char* fmt, ...);
 
             // CPU register helpers
             RegisterID DefineRegister(const char* name, unsigned char bits, RegisterType type);
             int RegisterCount() const;
             const char* RegisterName(RegisterID reg) const;
             int RegisterBits(RegisterID reg) const;
+            // Has to follow a successful Enable, Disable waits for it to return
             Result Run();
 
+            // Converts the target memory map for the stub, the result stays valid until the next call
+            Result QueryMemoryMap(const void** regions, uint32_t* count);
+
             // IO methods
             virtual bool IO_Open(unsigned short port);
             virtual void IO_Close();
@@ -84,6 +144,8 @@ namespace GDB {
             virtual Result IO_Read(void* dest, size_t size, size_t* bytesRead);
             virtual Result IO_Write(const void* src, size_t size);
             virtual Result IO_Poll();
+            // Makes a blocked IO_Poll return early, callable from any thread without Lock()
+            virtual void IO_Wake();
 
             // Misc.
             int DebugPrintf(const char* fmt, ...);
@@ -100,12 +162,42 @@ namespace GDB {
             virtual Result ContinueExecution();
             virtual Result ReadMem(size_t address, size_t size, void* dest);
             virtual Result WriteMem(size_t address, size_t size, const void* src);
+            virtual Result MemoryMap(const MemoryRegion** regions, int* count);
+            // Register values are in target byte order
             virtual Result ReadRegister(RegisterID reg, void* dest);
             virtual Result WriteRegister(RegisterID reg, const void* src);
+            // All registers back to back in definition order (g/G packets), by default
+            // this goes through ReadRegister/WriteRegister one register at a time
+            virtual Result ReadRegisters(void* dest);
+            virtual Result WriteRegisters(const void* src);
             virtual Result CreateTracepoint(size_t address, TracepointType type, TracepointAction action);
             virtual Result ClearTracepoint(size_t address);
+            // GDB tracepoints (QTDP/QTStart/QTFrame), collected without stopping the target
+            virtual Result TraceReset();
+            virtual Result TraceDefine(uint32_t number, size_t address, bool enabled, uint64_t passCount);
+            virtual Result TraceAddCollect(uint32_t number, size_t address, const TraceCollect& collect);
+            virtual Result TraceSetCircular(bool circular);
+            virtual Result TraceStart();
+            virtual Result TraceStop();
+            virtual Result TraceQueryStatus(TraceStatus* status);
+            // Selects the frame memory and register reads are served from, arg1 of -1 with
+            // TraceFind::Frame goes back to the live target. NotFound if nothing matches.
+            virtual Result TraceFindFrame(TraceFind mode, uint64_t arg1, uint64_t arg2, int* frame, uint32_t* tracepoint);
+            // Targets with several CPUs expose each of them as a thread (an inferior of its own
+            // with GDB's multiprocess extensions). Ids start at 1, SelectThread picks the CPU
+            // register, memory and tracepoint accesses go to.
+            virtual Result ThreadList(uint32_t* threads, uint32_t maxThreads, uint32_t* count);
+            virtual Result SelectThread(uint32_t thread);
+            virtual Result StoppedThread(uint32_t* thread);
+            virtual Result ThreadName(uint32_t thread, char* name, size_t size);
+            virtual Result SingleStepThread(uint32_t thread);
+            // Reverse execution ('bs'/'bc'), both return once the target stopped again.
+            // HistoryBegin tells whether the last one ran out of recorded history.
+            virtual Result ReverseStepThread(uint32_t thread);
+            virtual Result ReverseContinueExecution();
+            virtual Result HistoryBegin(bool* begin);
             virtual Result InvalidCommand(const char* cmd);
-            virtual void PacketReceived(const char* pkt);
+            virtual void PacketReceived(const char* pkt, size_t size);   // not terminated
 
         protected:
             Architecture m_arch;
@@ -120,8 +212,13 @@ namespace GDB {
             CommandCallback* m_customCommandCallbacks;
             int m_customCommandCount;
             int m_customCommandCapacity;
+            const void* m_commandOutput;
+            void* m_memRegions;
+            int m_memRegionCapacity;
             bool m_enabled;
+            bool m_running;                         // a successful Enable until Run returned, under m_mutex
             std::mutex m_mutex;
+            std::condition_variable m_runDone;
     };
 };
 
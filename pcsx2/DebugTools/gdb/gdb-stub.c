@@ -29,6 +29,15 @@
 
 #include "gdb.h"
 
+#ifdef _MSC_VER
+# include <intrin.h>
+# define GDBSTUB_ATOMIC_READ(a_pVar)           _InterlockedOr((a_pVar), 0)
+# define GDBSTUB_ATOMIC_WRITE(a_pVar, a_Val)   _InterlockedExchange((a_pVar), (a_Val))
+#else
+# define GDBSTUB_ATOMIC_READ(a_pVar)           __atomic_load_n((a_pVar), __ATOMIC_ACQUIRE)
+# define GDBSTUB_ATOMIC_WRITE(a_pVar, a_Val)   __atomic_store_n((a_pVar), (a_Val), __ATOMIC_RELEASE)
+#endif
+
 /**
  * GDB architecture names.
  */
@@ -269,6 +278,278 @@ static inline int gdbStubCtxIfTgtTpClear(PGDBSTUBCTXINT pThis, GDBTGTMEMADDR Gdb
 }
 
 
+/**
+ * Wrapper for the interface trace reset callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static inline int gdbStubCtxIfTgtTraceReset(PGDBSTUBCTXINT pThis)
+{
+    if (pThis->pIf->pfnTgtTraceReset)
+        return pThis->pIf->pfnTgtTraceReset(pThis, pThis->pvUser);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface tracepoint define callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idTp                The tracepoint number.
+ * @param   GdbTgtTpAddr        The target address space memory address of the tracepoint.
+ * @param   fEnabled            Flag whether the tracepoint is enabled.
+ * @param   cPass               The pass count, 0 for no limit.
+ */
+static inline int gdbStubCtxIfTgtTraceTpDefine(PGDBSTUBCTXINT pThis, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, int fEnabled, uint64_t cPass)
+{
+    if (pThis->pIf->pfnTgtTraceTpDefine)
+        return pThis->pIf->pfnTgtTraceTpDefine(pThis, pThis->pvUser, idTp, GdbTgtTpAddr, fEnabled, cPass);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface tracepoint collection action callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idTp                The tracepoint number.
+ * @param   GdbTgtTpAddr        The target address space memory address of the tracepoint.
+ * @param   pCollect            The action to add.
+ */
+static inline int gdbStubCtxIfTgtTraceTpCollect(PGDBSTUBCTXINT pThis, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, PCGDBSTUBTRACECOLLECT pCollect)
+{
+    if (pThis->pIf->pfnTgtTraceTpCollect)
+        return pThis->pIf->pfnTgtTraceTpCollect(pThis, pThis->pvUser, idTp, GdbTgtTpAddr, pCollect);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface trace buffer mode callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   fCircular           Flag whether the buffer is circular.
+ */
+static inline int gdbStubCtxIfTgtTraceSetCircular(PGDBSTUBCTXINT pThis, int fCircular)
+{
+    if (pThis->pIf->pfnTgtTraceSetCircular)
+        return pThis->pIf->pfnTgtTraceSetCircular(pThis, pThis->pvUser, fCircular);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface trace start callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static inline int gdbStubCtxIfTgtTraceStart(PGDBSTUBCTXINT pThis)
+{
+    if (pThis->pIf->pfnTgtTraceStart)
+        return pThis->pIf->pfnTgtTraceStart(pThis, pThis->pvUser);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface trace stop callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static inline int gdbStubCtxIfTgtTraceStop(PGDBSTUBCTXINT pThis)
+{
+    if (pThis->pIf->pfnTgtTraceStop)
+        return pThis->pIf->pfnTgtTraceStop(pThis, pThis->pvUser);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface trace status callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pStatus             Where to store the status.
+ */
+static inline int gdbStubCtxIfTgtTraceStatus(PGDBSTUBCTXINT pThis, PGDBSTUBTRACESTATUS pStatus)
+{
+    if (pThis->pIf->pfnTgtTraceStatus)
+        return pThis->pIf->pfnTgtTraceStatus(pThis, pThis->pvUser, pStatus);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface trace frame select callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   enmFind             How to search for the frame.
+ * @param   u64Arg1             First search argument.
+ * @param   u64Arg2             Second search argument.
+ * @param   piFrame             Where to store the selected frame number.
+ * @param   pidTp               Where to store the tracepoint which collected the selected frame.
+ */
+static inline int gdbStubCtxIfTgtTraceFrameFind(PGDBSTUBCTXINT pThis, GDBSTUBTRACEFIND enmFind, uint64_t u64Arg1, uint64_t u64Arg2,
+                                                int32_t *piFrame, uint32_t *pidTp)
+{
+    if (pThis->pIf->pfnTgtTraceFrameFind)
+        return pThis->pIf->pfnTgtTraceFrameFind(pThis, pThis->pvUser, enmFind, u64Arg1, u64Arg2, piFrame, pidTp);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface thread list callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   paidThreads         Where to store the thread ids, GDBSTUB_THREADS_MAX entries.
+ * @param   pcThreads           Where to store the number of threads.
+ */
+static inline int gdbStubCtxIfTgtThreadList(PGDBSTUBCTXINT pThis, uint32_t *paidThreads, uint32_t *pcThreads)
+{
+    *pcThreads = 0;
+    if (pThis->pIf->pfnTgtThreadList)
+        return pThis->pIf->pfnTgtThreadList(pThis, pThis->pvUser, paidThreads, GDBSTUB_THREADS_MAX, pcThreads);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface thread select callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idThread            The thread to select.
+ */
+static inline int gdbStubCtxIfTgtThreadSelect(PGDBSTUBCTXINT pThis, uint32_t idThread)
+{
+    if (pThis->pIf->pfnTgtThreadSelect)
+        return pThis->pIf->pfnTgtThreadSelect(pThis, pThis->pvUser, idThread);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface stopped thread query callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pidThread           Where to store the thread id.
+ */
+static inline int gdbStubCtxIfTgtThreadQueryStopped(PGDBSTUBCTXINT pThis, uint32_t *pidThread)
+{
+    if (pThis->pIf->pfnTgtThreadQueryStopped)
+        return pThis->pIf->pfnTgtThreadQueryStopped(pThis, pThis->pvUser, pidThread);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface thread name query callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idThread            The thread to describe.
+ * @param   pszName             Where to store the description.
+ * @param   cbName              Size of the buffer in bytes.
+ */
+static inline int gdbStubCtxIfTgtThreadQueryName(PGDBSTUBCTXINT pThis, uint32_t idThread, char *pszName, size_t cbName)
+{
+    if (pThis->pIf->pfnTgtThreadQueryName)
+        return pThis->pIf->pfnTgtThreadQueryName(pThis, pThis->pvUser, idThread, pszName, cbName);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface thread step callback, falls back to stepping the whole target.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idThread            The thread to step, 0 for the target's choice.
+ */
+static inline int gdbStubCtxIfTgtThreadStep(PGDBSTUBCTXINT pThis, uint32_t idThread)
+{
+    if (   idThread
+        && pThis->pIf->pfnTgtThreadStep)
+    {
+        int rc = pThis->pIf->pfnTgtThreadStep(pThis, pThis->pvUser, idThread);
+        if (rc != GDBSTUB_ERR_NOT_SUPPORTED)
+            return rc;
+    }
+
+    return gdbStubCtxIfTgtStep(pThis);
+}
+
+
+/**
+ * Wrapper for the interface reverse step callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idThread            The thread to step, 0 for the target's choice.
+ */
+static inline int gdbStubCtxIfTgtReverseStep(PGDBSTUBCTXINT pThis, uint32_t idThread)
+{
+    if (pThis->pIf->pfnTgtReverseStep)
+        return pThis->pIf->pfnTgtReverseStep(pThis, pThis->pvUser, idThread);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface reverse continue callback.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static inline int gdbStubCtxIfTgtReverseCont(PGDBSTUBCTXINT pThis)
+{
+    if (pThis->pIf->pfnTgtReverseCont)
+        return pThis->pIf->pfnTgtReverseCont(pThis, pThis->pvUser);
+
+    return GDBSTUB_ERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Wrapper for the interface history begin query callback.
+ *
+ * @returns Flag whether the target stopped at the beginning of its recorded history.
+ * @param   pThis               The GDB stub context.
+ */
+static inline BOOLEAN gdbStubCtxIfTgtReverseQueryHistoryBegin(PGDBSTUBCTXINT pThis)
+{
+    int fBegin = 0;
+    if (   pThis->pIf->pfnTgtReverseQueryHistoryBegin
+        && pThis->pIf->pfnTgtReverseQueryHistoryBegin(pThis, pThis->pvUser, &fBegin) == GDBSTUB_INF_SUCCESS)
+        return fBegin ? TRUE : FALSE;
+
+    return FALSE;
+}
+
+
 /**
  * Wrapper for the I/O interface peek callback.
  *
@@ -984,6 +1265,101 @@ static int gdbStubCtxParseHexStringAsInteger(const uint8_t *pbBuf, size_t cbBuf,
 }
 
 
+/**
+ * Parses a hexadecimal number at the start of the given buffer, stopping at the first
+ * non hex character.
+ *
+ * @returns Number of characters consumed, 0 if there is no number.
+ * @param   pbBuf               The buffer to parse.
+ * @param   cbBuf               Size of the buffer in bytes.
+ * @param   puVal               Where to store the value.
+ */
+static size_t gdbStubCtxParseHexPrefix(const uint8_t *pbBuf, size_t cbBuf, uint64_t *puVal)
+{
+    uint64_t uVal = 0;
+    size_t cch = 0;
+
+    while (   cch < cbBuf
+           && gdbStubCtxChrToHex(pbBuf[cch]) != 0xff)
+        uVal = uVal * 16 + gdbStubCtxChrToHex(pbBuf[cch++]);
+
+    *puVal = uVal;
+    return cch;
+}
+
+
+/**
+ * Parses a thread id, either plain or in the multiprocess p<pid>.<tid> form.
+ *
+ * Each target thread is reported as a process with a single thread in multiprocess mode,
+ * so only the pid part identifies the thread there.
+ *
+ * @returns Status code.
+ * @param   pbBuf               The buffer to parse.
+ * @param   cbBuf               Size of the buffer in bytes.
+ * @param   piThread            Where to store the thread id, 0 for any thread and -1 for all threads.
+ * @param   ppbEnd              Where to store the pointer past the thread id, optional.
+ */
+static int gdbStubCtxParseThreadId(const uint8_t *pbBuf, size_t cbBuf, int64_t *piThread, const uint8_t **ppbEnd)
+{
+    BOOLEAN fProcess = FALSE;
+    uint64_t u64Tmp = 0;
+    int64_t iThread = 0;
+    size_t cch = 0;
+
+    if (   cbBuf
+        && *pbBuf == 'p')
+    {
+        fProcess = TRUE;
+        pbBuf++;
+        cbBuf--;
+    }
+
+    if (   cbBuf >= 2
+        && pbBuf[0] == '-'
+        && pbBuf[1] == '1')
+    {
+        iThread = -1;
+        cch = 2;
+    }
+    else
+    {
+        cch = gdbStubCtxParseHexPrefix(pbBuf, cbBuf, &u64Tmp);
+        if (!cch)
+            return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+        iThread = (int64_t)u64Tmp;
+    }
+
+    pbBuf += cch;
+    cbBuf -= cch;
+
+    /* Skip the tid part, every process has exactly one thread. */
+    if (   fProcess
+        && cbBuf
+        && *pbBuf == '.')
+    {
+        pbBuf++;
+        cbBuf--;
+        if (   cbBuf >= 2
+            && pbBuf[0] == '-'
+            && pbBuf[1] == '1')
+            cch = 2;
+        else
+            cch = gdbStubCtxParseHexPrefix(pbBuf, cbBuf, &u64Tmp);
+
+        if (!cch)
+            return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+        pbBuf += cch;
+    }
+
+    *piThread = iThread;
+    if (ppbEnd)
+        *ppbEnd = pbBuf;
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
 /**
  * Decodes the given ASCII hexstring as a byte buffer up until the given separator is found or the end of the string is reached.
  *
@@ -1020,6 +1396,37 @@ static int gdbStubCtxParseHexStringAsByteBuf(const uint8_t *pbBuf, size_t cbBuf,
 }
 
 
+/**
+ * Removes the escaping from binary packet data in place.
+ *
+ * @returns Number of decoded bytes.
+ * @param   pbBuf               The escaped data, overwritten with the decoded data.
+ * @param   cbBuf               Size of the escaped data in bytes.
+ */
+static size_t gdbStubCtxUnescapeBinary(uint8_t *pbBuf, size_t cbBuf)
+{
+    uint8_t *pbDst = pbBuf;
+    const uint8_t *pbSrc = pbBuf;
+
+    while (cbBuf)
+    {
+        uint8_t bByte = *pbSrc++;
+        cbBuf--;
+
+        if (   bByte == GDBSTUB_PKT_ESCAPE
+            && cbBuf)
+        {
+            bByte = *pbSrc++ ^ 0x20;
+            cbBuf--;
+        }
+
+        *pbDst++ = bByte;
+    }
+
+    return pbDst - pbBuf;
+}
+
+
 /**
  * Ensures that there is at least the given amount of bytes of free space left in the packet buffer.
  *
@@ -1132,37 +1539,148 @@ static int gdbStubCtxReplySendErr(PGDBSTUBCTXINT pThis, uint8_t uErr)
 
 
 /**
- * Sends a signal trap (S 05) packet to indicate that the target has stopped.
+ * Checks whether the target knows the given thread.
  *
- * @returns Status code.
+ * @returns Flag whether the thread exists.
  * @param   pThis               The GDB stub context.
+ * @param   idThread            The thread id to check.
  */
-static int gdbStubCtxReplySendSigTrap(PGDBSTUBCTXINT pThis)
+static BOOLEAN gdbStubCtxThreadIsValid(PGDBSTUBCTXINT pThis, uint32_t idThread)
 {
-    uint8_t achSigTrap[3] = { 'S', '0', '5' };
-    return gdbStubCtxReplySend(pThis, &achSigTrap[0], sizeof(achSigTrap));
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+
+    if (gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) != GDBSTUB_INF_SUCCESS)
+        return FALSE;
+
+    for (uint32_t i = 0; i < cThreads; i++)
+    {
+        if (aidThreads[i] == idThread)
+            return TRUE;
+    }
+
+    return FALSE;
 }
 
 
 /**
- * Sends a GDB stub status code indicating an error using the error reply packet,
- * data part only, packet start and and end needs to be handled separately.
+ * Returns the thread register and memory accesses currently apply to.
  *
- * @returns Status code.
+ * @returns Thread id, 0 if the target has no threads.
  * @param   pThis               The GDB stub context.
- * @param   rc                  The status code to send.
  */
-static int gdbStubCtxReplySendErrStsData(PGDBSTUBCTXINT pThis, int rc)
+static uint32_t gdbStubCtxThreadGetGeneral(PGDBSTUBCTXINT pThis)
 {
-    /** Todo convert error codes maybe. */
-    return gdbStubCtxReplySendErrData(pThis, (-rc) & 0xff);
+    /* Until GDB selects one the target works on its first thread. */
+    if (!pThis->idThreadGeneral)
+    {
+        uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+        uint32_t cThreads = 0;
+
+        if (   gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) == GDBSTUB_INF_SUCCESS
+            && cThreads)
+            pThis->idThreadGeneral = aidThreads[0];
+    }
+
+    return pThis->idThreadGeneral;
 }
 
 
 /**
- * Sends a GDB stub status code indicating an error using the error reply packet.
+ * Formats the given thread id the way GDB expects it.
  *
- * @returns Status code.
+ * @returns Number of characters written.
+ * @param   pThis               The GDB stub context.
+ * @param   pszBuf              Where to store the thread id.
+ * @param   idThread            The thread id.
+ */
+static int gdbStubCtxFmtThreadId(PGDBSTUBCTXINT pThis, char *pszBuf, uint32_t idThread)
+{
+    if (pThis->fFeatures & GDBSTUBCTX_FEATURES_F_MULTIPROCESS)
+        return sprintf(pszBuf, "p%x.1", idThread);
+
+    return sprintf(pszBuf, "%x", idThread);
+}
+
+
+/**
+ * Sends a signal trap (T 05) packet to indicate that the target has stopped.
+ *
+ * The program counter is expedited in the reply so GDB doesn't need another
+ * round trip to find out where the target stopped. This may be sent asynchronously
+ * while a partial packet sits in the receive buffer, so it must not use pbPktBuf.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static int gdbStubCtxReplySendSigTrap(PGDBSTUBCTXINT pThis)
+{
+    uint8_t achSigTrap[96] = { 'T', '0', '5' };
+    size_t cchSigTrap = 3;
+    uint32_t idThread = 0;
+
+    /* Tell GDB which thread stopped, it switches to it on its own. */
+    if (   gdbStubCtxIfTgtThreadQueryStopped(pThis, &idThread) == GDBSTUB_INF_SUCCESS
+        && idThread)
+    {
+        cchSigTrap += sprintf((char *)&achSigTrap[cchSigTrap], "thread:");
+        cchSigTrap += gdbStubCtxFmtThreadId(pThis, (char *)&achSigTrap[cchSigTrap], idThread);
+        achSigTrap[cchSigTrap++] = ';';
+    }
+
+    if (pThis->idxRegPc != UINT32_MAX)
+    {
+        uint32_t idxReg = pThis->idxRegPc;
+        size_t cbReg = pThis->pIf->paRegs[idxReg].cRegBits / 8;
+        int cchIdx = sprintf((char *)&achSigTrap[cchSigTrap], "%x:", idxReg);
+
+        /* The expedited pc belongs to the stopped thread, GDB's selection stays as it was. */
+        uint32_t idThreadGeneral = gdbStubCtxThreadGetGeneral(pThis);
+        BOOLEAN fSwitch = idThread && idThread != idThreadGeneral;
+        if (fSwitch)
+            gdbStubCtxIfTgtThreadSelect(pThis, idThread);
+
+        if (   cchSigTrap + cchIdx + cbReg * 2 + 1 <= sizeof(achSigTrap)
+            && gdbStubCtxIfTgtRegsRead(pThis, &idxReg, 1, pThis->pvRegsScratch) == GDBSTUB_INF_SUCCESS
+            && gdbStubCtxEncodeBinaryAsHex(&achSigTrap[cchSigTrap + cchIdx], sizeof(achSigTrap) - cchSigTrap - cchIdx,
+                                           pThis->pvRegsScratch, cbReg) == GDBSTUB_INF_SUCCESS)
+        {
+            cchSigTrap += cchIdx + cbReg * 2;
+            achSigTrap[cchSigTrap++] = ';';
+        }
+
+        if (fSwitch)
+            gdbStubCtxIfTgtThreadSelect(pThis, idThreadGeneral);
+    }
+
+    /* A reverse execution ran out of history, GDB reports that instead of a plain stop. */
+    if (   gdbStubCtxIfTgtReverseQueryHistoryBegin(pThis)
+        && cchSigTrap + sizeof("replaylog:begin;") - 1 <= sizeof(achSigTrap))
+        cchSigTrap += sprintf((char *)&achSigTrap[cchSigTrap], "replaylog:begin;");
+
+    return gdbStubCtxReplySend(pThis, &achSigTrap[0], cchSigTrap);
+}
+
+
+/**
+ * Sends a GDB stub status code indicating an error using the error reply packet,
+ * data part only, packet start and and end needs to be handled separately.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   rc                  The status code to send.
+ */
+static int gdbStubCtxReplySendErrStsData(PGDBSTUBCTXINT pThis, int rc)
+{
+    /** Todo convert error codes maybe. */
+    return gdbStubCtxReplySendErrData(pThis, (-rc) & 0xff);
+}
+
+
+/**
+ * Sends a GDB stub status code indicating an error using the error reply packet.
+ *
+ * @returns Status code.
  * @param   pThis               The GDB stub context.
  * @param   rc                  The status code to send.
  */
@@ -1241,8 +1759,44 @@ static int gdbStubCtxParseTpPktArgs(const uint8_t *pbArgs, size_t cbArgs, GDBSTU
  */
 static int gdbStubCtxPktProcessQueryTStatus(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
 {
-    char achReply[2] = { 'T', '0' };
-    return gdbStubCtxReplySend(pThis, &achReply[0], sizeof(achReply));
+    GDBSTUBTRACESTATUS Status = { 0 };
+
+    int rc = gdbStubCtxIfTgtTraceStatus(pThis, &Status);
+    if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
+    {
+        char achReply[2] = { 'T', '0' };
+        return gdbStubCtxReplySend(pThis, &achReply[0], sizeof(achReply));
+    }
+    else if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+
+    char achReply[256];
+    int cchReply = sprintf(achReply, "T%d", Status.fRunning ? 1 : 0);
+    if (!Status.fRunning)
+    {
+        switch (Status.enmStop)
+        {
+            case GDBSTUBTRACESTOP_USER:
+                cchReply += sprintf(&achReply[cchReply], ";tstop:0");
+                break;
+            case GDBSTUBTRACESTOP_PASSCOUNT:
+                cchReply += sprintf(&achReply[cchReply], ";tpasscount:%x", Status.idTpStop);
+                break;
+            case GDBSTUBTRACESTOP_BUFFER_FULL:
+                cchReply += sprintf(&achReply[cchReply], ";tfull:0");
+                break;
+            default:
+                cchReply += sprintf(&achReply[cchReply], ";tnotrun:0");
+                break;
+        }
+    }
+
+    cchReply += sprintf(&achReply[cchReply], ";tframes:%llx;tcreated:%llx;tsize:%llx;tfree:%llx;circular:%d;disconn:0",
+                        (unsigned long long)Status.cFrames, (unsigned long long)Status.cFramesCreated,
+                        (unsigned long long)Status.cbBuffer, (unsigned long long)Status.cbBufferFree,
+                        Status.fCircular ? 1 : 0);
+
+    return gdbStubCtxReplySend(pThis, achReply, cchReply);
 }
 
 
@@ -1280,6 +1834,25 @@ static int gdbStubCtxPktProcessFeatXmlRegs(PGDBSTUBCTXINT pThis, const uint8_t *
 }
 
 
+/**
+ * @copydoc{FNGDBSTUBQPKTPROC}
+ */
+static int gdbStubCtxPktProcessFeatMultiprocess(PGDBSTUBCTXINT pThis, const uint8_t *pbVal, size_t cbVal)
+{
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+
+    /* Every thread becomes an inferior of its own, only worth it if the target has threads at all. */
+    if (   *pbVal == '+'
+        && gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) == GDBSTUB_INF_SUCCESS)
+        pThis->fFeatures |= GDBSTUBCTX_FEATURES_F_MULTIPROCESS;
+    else
+        pThis->fFeatures &= ~GDBSTUBCTX_FEATURES_F_MULTIPROCESS;
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
 /**
  * Features which can be reported by the remote GDB which we might support.
  *
@@ -1289,6 +1862,7 @@ static const GDBSTUBFEATDESC g_aGdbFeatures[] =
 {
 #define GDBSTUBFEATDESC_INIT(a_Name, a_pfnHnd, a_fVal) { a_Name, sizeof(a_Name) - 1, a_pfnHnd, a_fVal }
     GDBSTUBFEATDESC_INIT("xmlRegisters",   gdbStubCtxPktProcessFeatXmlRegs, TRUE),
+    GDBSTUBFEATDESC_INIT("multiprocess",   gdbStubCtxPktProcessFeatMultiprocess, FALSE),
 #undef GDBSTUBFEATDESC_INIT
 };
 
@@ -1334,11 +1908,21 @@ static int gdbStubCtxQueryPktQueryFeatureLen(const uint8_t *pbArgs, size_t cbArg
  */
 static int gdbStubCtxPktProcessQuerySupportedReply(PGDBSTUBCTXINT pThis)
 {
-    /** @todo Enhance. */
+    char achReply[256];
+    int cchReply = sprintf(achReply, "PacketSize=%x;QStartNoAckMode+", GDBSTUB_PKT_SIZE_MAX);
+
     if (pThis->fFeatures & GDBSTUBCTX_FEATURES_F_TGT_DESC)
-        return gdbStubCtxReplySend(pThis, "qXfer:features:read+", sizeof("qXfer:features:read+") - 1);
+        cchReply += sprintf(&achReply[cchReply], ";qXfer:features:read+");
+    if (pThis->pIf->pfnTgtMemMapQuery)
+        cchReply += sprintf(&achReply[cchReply], ";qXfer:memory-map:read+");
+    if (pThis->fFeatures & GDBSTUBCTX_FEATURES_F_MULTIPROCESS)
+        cchReply += sprintf(&achReply[cchReply], ";multiprocess+");
+    if (pThis->pIf->pfnTgtReverseStep)
+        cchReply += sprintf(&achReply[cchReply], ";ReverseStep+");
+    if (pThis->pIf->pfnTgtReverseCont)
+        cchReply += sprintf(&achReply[cchReply], ";ReverseContinue+");
 
-    return gdbStubCtxReplySend(pThis, NULL, 0);
+    return gdbStubCtxReplySend(pThis, achReply, cchReply);
 }
 
 
@@ -1633,6 +2217,115 @@ static int gdbStubCtxPktProcessQueryXferFeatRead(PGDBSTUBCTXINT pThis, const uin
 }
 
 
+/**
+ * Creates the XML memory map from the regions reported by the target.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ */
+static int gdbStubCtxMemMapXmlCreate(PGDBSTUBCTXINT pThis)
+{
+    PCGDBSTUBMEMREGION paRegions = NULL;
+    uint32_t cRegions = 0;
+
+    int rc = pThis->pIf->pfnTgtMemMapQuery(pThis, pThis->pvUser, &paRegions, &cRegions);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return rc;
+
+    if (pThis->pbMemMapXml)
+        gdbStubCtxIfMemFree(pThis, pThis->pbMemMapXml);
+    pThis->cbMemMapXml = 0;
+
+    /* Each region line is well below 128 characters. */
+    size_t cbXml = 256 + cRegions * 128;
+    pThis->pbMemMapXml = (uint8_t *)gdbStubCtxIfMemAlloc(pThis, cbXml);
+    if (!pThis->pbMemMapXml)
+        return GDBSTUB_ERR_NO_MEMORY;
+
+    char *pszXmlCur = (char *)pThis->pbMemMapXml;
+    size_t totalLen = 0;
+    int len = sprintf(pszXmlCur,
+        "<?xml version=\"1.0\"?>\n"
+        "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" \"http://sourceware.org/gdb/gdb-memory-map.dtd\">\n"
+        "<memory-map>\n"
+    );
+    pszXmlCur += len;
+    totalLen += len;
+
+    for (uint32_t i = 0; i < cRegions; i++)
+    {
+        PCGDBSTUBMEMREGION pRegion = &paRegions[i];
+
+        len = sprintf(pszXmlCur, "    <memory type=\"%s\" start=\"0x%llx\" length=\"0x%llx\"/>\n",
+                      pRegion->enmType == GDBSTUBMEMTYPE_ROM ? "rom" : "ram",
+                      (unsigned long long)pRegion->GdbTgtMemAddrStart, (unsigned long long)pRegion->cbRegion);
+        pszXmlCur += len;
+        totalLen += len;
+    }
+
+    len = sprintf(pszXmlCur, "</memory-map>");
+    totalLen += len;
+
+    pThis->cbMemMapXml = totalLen;
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
+/**
+ * Processes the 'Xfer:memory-map:read' query.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryXferMemMapRead(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    int rc = GDBSTUB_INF_SUCCESS;
+
+    /* Skip the : following the Xfer:memory-map:read start. */
+    if (   cbArgs < 1
+        || pbArgs[0] != ':')
+        return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+    cbArgs--;
+    pbArgs++;
+
+    if (!pThis->pIf->pfnTgtMemMapQuery)
+        return gdbStubCtxReplySend(pThis, NULL, 0); /* Not supported. */
+
+    const char *pchAnnex = NULL;
+    size_t cchAnnex = 0;
+    uint32_t offRead = 0;
+    size_t cbRead = 0;
+
+    rc = gdbStubCtxPktProcessQueryXferParseAnnexOffLen(pbArgs, cbArgs,
+                                                       &pchAnnex, &cchAnnex,
+                                                       &offRead, &cbRead);
+    if (rc == GDBSTUB_INF_SUCCESS)
+    {
+        /* The memory map has no annex, regenerate it when GDB starts reading from the beginning as mappings can change. */
+        if (cchAnnex)
+            rc = gdbStubCtxReplySendErr(pThis, 0);
+        else
+        {
+            if (   !offRead
+                || !pThis->pbMemMapXml)
+                rc = gdbStubCtxMemMapXmlCreate(pThis);
+
+            if (rc == GDBSTUB_INF_SUCCESS)
+                rc = gdbStubCtxQueryXferReadReply(pThis, offRead, cbRead, pThis->pbMemMapXml, pThis->cbMemMapXml);
+            else
+                rc = gdbStubCtxReplySendErrSts(pThis, rc);
+        }
+    }
+    else
+        rc = gdbStubCtxReplySendErrSts(pThis, rc);
+
+    return rc;
+}
+
+
 /**
  * Calls the given command handler and processes the reply.
  *
@@ -1667,120 +2360,666 @@ static int gdbStubCtxCmdProcess(PGDBSTUBCTXINT pThis, PCGDBSTUBCMD pCmd, const c
             rc = gdbStubCtxReplySendErrStsData(pThis, rcCmd);
     }
 
-    return rc;
+    return rc;
+}
+
+
+/**
+ * Processes the 'Rcmd' query.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryRcmd(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    int rc = GDBSTUB_INF_SUCCESS;
+
+    /* Skip the , following the qRcmd start. */
+    if (   cbArgs < 1
+        || pbArgs[0] != ',')
+        return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+    if (!pThis->pIf->paCmds)
+        return GDBSTUB_ERR_NOT_FOUND;
+
+    cbArgs--;
+    pbArgs++;
+
+    /* Decode the command. */
+    /** @todo Make this dynamic. */
+    char szCmd[4096];
+    if (cbArgs / 2 >= sizeof(szCmd))
+        return GDBSTUB_ERR_BUFFER_OVERFLOW;
+
+    size_t cbDecoded = 0;
+    rc = gdbStubCtxParseHexStringAsByteBuf(pbArgs, cbArgs - 1, &szCmd[0], sizeof(szCmd), &cbDecoded);
+    if (rc == GDBSTUB_INF_SUCCESS)
+    {
+        const char *pszArgs = NULL;
+
+        cbDecoded /= 2;
+        szCmd[cbDecoded] = '\0'; /* Ensure zero termination. */
+
+        /** @todo Sanitize string. */
+
+        /* Look for the first space and take that as the separator between command identifier. */
+        uint8_t *pbDelim = gdbStubCtxMemchr(&szCmd[0], ' ', cbDecoded);
+        if (pbDelim)
+        {
+            *pbDelim = '\0';
+            pszArgs = pbDelim + 1;
+        }
+
+        /* Search for the command. */
+        PCGDBSTUBCMD pCmd = &pThis->pIf->paCmds[0];
+        rc = GDBSTUB_ERR_NOT_FOUND;
+        while (pCmd->pszCmd)
+        {
+            if (!gdbStubStrcmp(pCmd->pszCmd, &szCmd[0]))
+            {
+                rc = gdbStubCtxCmdProcess(pThis, pCmd, pszArgs);
+                break;
+            }
+            pCmd++;
+        }
+
+        if (   rc == GDBSTUB_ERR_NOT_FOUND
+            && pThis->pIf->pfnMonCmd)
+        {
+            /* Restore delimiter. */
+            if (pbDelim)
+                *pbDelim = ' ';
+            rc = gdbStubCtxCmdProcess(pThis, NULL, &szCmd[0]);
+        }
+        else if (rc != GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxReplySendErrSts(pThis, rc); /** @todo Send string. */
+    }
+
+    return rc;
+}
+
+
+/**
+ * Processes the 'fThreadInfo' query.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryThreadInfoFirst(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+
+    int rc = gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads);
+    if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+
+    /* The list is short enough to go out in one reply, 'qsThreadInfo' always ends it. */
+    char achReply[1 + GDBSTUB_THREADS_MAX * 20];
+    int cchReply = sprintf(achReply, "m");
+    for (uint32_t i = 0; i < cThreads && i < GDBSTUB_THREADS_MAX; i++)
+    {
+        if (i)
+            achReply[cchReply++] = ',';
+        cchReply += gdbStubCtxFmtThreadId(pThis, &achReply[cchReply], aidThreads[i]);
+    }
+
+    return gdbStubCtxReplySend(pThis, achReply, cchReply);
+}
+
+
+/**
+ * Processes the 'sThreadInfo' query.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryThreadInfoNext(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+
+    if (gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    return gdbStubCtxReplySend(pThis, "l", 1);
+}
+
+
+/**
+ * Processes the 'ThreadExtraInfo' query.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryThreadExtraInfo(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    int64_t iThread = 0;
+    const uint8_t *pbEnd = NULL;
+
+    /* Skip the , following the qThreadExtraInfo start. */
+    if (   cbArgs < 2
+        || pbArgs[0] != ',')
+        return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+    int rc = gdbStubCtxParseThreadId(pbArgs + 1, cbArgs - 1, &iThread, &pbEnd);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+    if (iThread <= 0)
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_INVALID_PARAMETER);
+
+    char szName[64] = { 0 };
+    rc = gdbStubCtxIfTgtThreadQueryName(pThis, (uint32_t)iThread, &szName[0], sizeof(szName) - 1);
+    if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+
+    uint8_t abReply[sizeof(szName) * 2];
+    size_t cchName = gdbStubStrlen(&szName[0]);
+    rc = gdbStubCtxEncodeBinaryAsHex(&abReply[0], sizeof(abReply), &szName[0], cchName);
+    if (rc == GDBSTUB_INF_SUCCESS)
+        rc = gdbStubCtxReplySend(pThis, &abReply[0], cchName * 2);
+    else
+        rc = gdbStubCtxReplySendErrSts(pThis, rc);
+
+    return rc;
+}
+
+
+/**
+ * Processes the 'C' query returning the current thread.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessQueryCurrentThread(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    /* Anything following the C is a different query (qCRC for instance) we don't support. */
+    if (   cbArgs != 1
+        || pbArgs[0] != GDBSTUB_PKT_END)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    uint32_t idThread = gdbStubCtxThreadGetGeneral(pThis);
+    if (!idThread)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    char achReply[32];
+    int cchReply = sprintf(achReply, "QC");
+    cchReply += gdbStubCtxFmtThreadId(pThis, &achReply[cchReply], idThread);
+
+    return gdbStubCtxReplySend(pThis, achReply, cchReply);
+}
+
+
+/**
+ * List of supported query packets.
+ */
+static const GDBSTUBQPKTPROC g_aQPktProcs[] =
+{
+#define GDBSTUBQPKTPROC_INIT(a_Name, a_pfnProc) { a_Name, sizeof(a_Name) - 1, a_pfnProc }
+    GDBSTUBQPKTPROC_INIT("TStatus",            gdbStubCtxPktProcessQueryTStatus),
+    GDBSTUBQPKTPROC_INIT("Supported",          gdbStubCtxPktProcessQuerySupported),
+    GDBSTUBQPKTPROC_INIT("Xfer:features:read", gdbStubCtxPktProcessQueryXferFeatRead),
+    GDBSTUBQPKTPROC_INIT("Xfer:memory-map:read", gdbStubCtxPktProcessQueryXferMemMapRead),
+    GDBSTUBQPKTPROC_INIT("Rcmd",               gdbStubCtxPktProcessQueryRcmd),
+    GDBSTUBQPKTPROC_INIT("fThreadInfo",        gdbStubCtxPktProcessQueryThreadInfoFirst),
+    GDBSTUBQPKTPROC_INIT("sThreadInfo",        gdbStubCtxPktProcessQueryThreadInfoNext),
+    GDBSTUBQPKTPROC_INIT("ThreadExtraInfo",    gdbStubCtxPktProcessQueryThreadExtraInfo),
+    /* Must come last, it is a prefix of other queries. */
+    GDBSTUBQPKTPROC_INIT("C",                  gdbStubCtxPktProcessQueryCurrentThread),
+#undef GDBSTUBQPKTPROC_INIT
+};
+
+
+/**
+ * Processes a 'q' packet, sending the appropriate reply.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbQuery             The query packet data (without the 'q').
+ * @param   cbQuery             Size of the remaining query packet in bytes.
+ */
+static int gdbStubCtxPktProcessQuery(PGDBSTUBCTXINT pThis, const uint8_t *pbQuery, size_t cbQuery)
+{
+    int rc = GDBSTUB_INF_SUCCESS;
+
+    /* Search the query and execute the processor or return an empty reply if not supported. */
+    for (uint32_t i = 0; i < ELEMENTS(g_aQPktProcs); i++)
+    {
+        size_t cbCmp = g_aQPktProcs[i].cchName < cbQuery ? g_aQPktProcs[i].cchName : cbQuery;
+
+        if (!gdbStubMemcmp(pbQuery, g_aQPktProcs[i].pszName, cbCmp))
+            return g_aQPktProcs[i].pfnProc(pThis, pbQuery + cbCmp, cbQuery - cbCmp);
+    }
+
+    return gdbStubCtxReplySend(pThis, NULL, 0);
+}
+
+
+/**
+ * Processes the 'StartNoAckMode' set packet.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetStartNoAckMode(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    /* The OK reply is still acknowledged by GDB, acks stop with the next packet. */
+    int rc = gdbStubCtxReplySendOk(pThis);
+    if (rc == GDBSTUB_INF_SUCCESS)
+        pThis->fFeatures |= GDBSTUBCTX_FEATURES_F_NO_ACK;
+
+    return rc;
+}
+
+
+/**
+ * Replies to a trace set packet according to the given status code, an empty reply tells GDB
+ * that tracing isn't supported.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   rc                  The status code of the operation.
+ */
+static int gdbStubCtxReplySendTraceSts(PGDBSTUBCTXINT pThis, int rc)
+{
+    if (rc == GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendOk(pThis);
+    if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    return gdbStubCtxReplySendErrSts(pThis, rc);
+}
+
+
+/**
+ * Parses the next ':' separated hex field of a trace packet, advancing the buffer.
+ *
+ * @returns Status code.
+ * @param   ppbArgs             The current position, updated past the field and its separator.
+ * @param   pcbArgs             The remaining size, updated accordingly.
+ * @param   puVal               Where to store the value.
+ */
+static int gdbStubCtxParseTraceField(const uint8_t **ppbArgs, size_t *pcbArgs, uint64_t *puVal)
+{
+    size_t cch = gdbStubCtxParseHexPrefix(*ppbArgs, *pcbArgs, puVal);
+    if (!cch)
+        return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+    *ppbArgs += cch;
+    *pcbArgs -= cch;
+    if (*pcbArgs && **ppbArgs == ':')
+    {
+        (*ppbArgs)++;
+        (*pcbArgs)--;
+    }
+
+    return GDBSTUB_INF_SUCCESS;
+}
+
+
+/**
+ * Parses the tracepoint actions of a 'QTDP:-' packet and hands them to the interface.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   idTp                The tracepoint number.
+ * @param   GdbTgtTpAddr        The address of the tracepoint.
+ * @param   pbArgs              The actions.
+ * @param   cbArgs              Size of the actions in bytes.
+ */
+static int gdbStubCtxPktProcessSetTDPActions(PGDBSTUBCTXINT pThis, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr,
+                                             const uint8_t *pbArgs, size_t cbArgs)
+{
+    int rc = GDBSTUB_INF_SUCCESS;
+
+    while (   cbArgs
+           && rc == GDBSTUB_INF_SUCCESS)
+    {
+        GDBSTUBTRACECOLLECT Collect = { GDBSTUBTRACECOLLECTTYPE_INVALID, -1, 0, 0 };
+        uint64_t u64Tmp = 0;
+        size_t cch = 0;
+
+        switch (*pbArgs)
+        {
+            case 'R': /* Register mask, all registers are collected anyway. */
+            {
+                cch = 1 + gdbStubCtxParseHexPrefix(pbArgs + 1, cbArgs - 1, &u64Tmp);
+                Collect.enmType = GDBSTUBTRACECOLLECTTYPE_REGS;
+                rc = gdbStubCtxIfTgtTraceTpCollect(pThis, idTp, GdbTgtTpAddr, &Collect);
+                break;
+            }
+            case 'M': /* M<basereg>,<offset>,<len>, basereg is -1 (FFFFFFFF) for absolute addresses. */
+            {
+                BOOLEAN fNeg = FALSE;
+
+                cch = 1;
+                if (cch < cbArgs && pbArgs[cch] == '-')
+                {
+                    fNeg = TRUE;
+                    cch++;
+                }
+
+                size_t cchNum = gdbStubCtxParseHexPrefix(pbArgs + cch, cbArgs - cch, &u64Tmp);
+                cch += cchNum;
+                if (   !cchNum
+                    || cch >= cbArgs
+                    || pbArgs[cch++] != ',')
+                    return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+                Collect.enmType    = GDBSTUBTRACECOLLECTTYPE_MEM;
+                Collect.idxRegBase = fNeg ? -(int32_t)u64Tmp : (int32_t)(uint32_t)u64Tmp;
+
+                cchNum = gdbStubCtxParseHexPrefix(pbArgs + cch, cbArgs - cch, &Collect.offMem);
+                cch += cchNum;
+                if (   !cchNum
+                    || cch >= cbArgs
+                    || pbArgs[cch++] != ',')
+                    return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+                cchNum = gdbStubCtxParseHexPrefix(pbArgs + cch, cbArgs - cch, &u64Tmp);
+                cch += cchNum;
+                if (!cchNum)
+                    return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+
+                Collect.cbMem = (uint32_t)u64Tmp;
+                rc = gdbStubCtxIfTgtTraceTpCollect(pThis, idTp, GdbTgtTpAddr, &Collect);
+                break;
+            }
+            case 'S': /* While-stepping actions follow, stepping frames aren't collected. */
+                return GDBSTUB_INF_SUCCESS;
+            default: /* Agent expressions (X) aren't supported. */
+                return GDBSTUB_ERR_NOT_SUPPORTED;
+        }
+
+        pbArgs += cch;
+        cbArgs -= cch;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Processes the 'TDP' set packet, defining a tracepoint or adding actions to it.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTDP(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    BOOLEAN fActions = FALSE;
+    uint64_t idTp = 0;
+    uint64_t GdbTgtTpAddr = 0;
+
+    if (cbArgs && pbArgs[cbArgs - 1] == GDBSTUB_PKT_END)
+        cbArgs--;
+    /* A trailing '-' announces more action packets for the same tracepoint. */
+    if (cbArgs && pbArgs[cbArgs - 1] == '-')
+        cbArgs--;
+
+    if (   cbArgs < 1
+        || pbArgs[0] != ':')
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+    pbArgs++;
+    cbArgs--;
+    if (cbArgs && pbArgs[0] == '-')
+    {
+        fActions = TRUE;
+        pbArgs++;
+        cbArgs--;
+    }
+
+    int rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &idTp);
+    if (rc == GDBSTUB_INF_SUCCESS)
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &GdbTgtTpAddr);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+
+    if (fActions)
+        rc = gdbStubCtxPktProcessSetTDPActions(pThis, (uint32_t)idTp, GdbTgtTpAddr, pbArgs, cbArgs);
+    else
+    {
+        /* QTDP:n:addr:E|D:step:pass, anything after the pass count isn't advertised and is ignored. */
+        uint64_t cStep = 0;
+        uint64_t cPass = 0;
+
+        if (   cbArgs < 2
+            || (pbArgs[0] != 'E' && pbArgs[0] != 'D')
+            || pbArgs[1] != ':')
+            return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+        int fEnabled = pbArgs[0] == 'E';
+        pbArgs += 2;
+        cbArgs -= 2;
+
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &cStep);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &cPass);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxIfTgtTraceTpDefine(pThis, (uint32_t)idTp, GdbTgtTpAddr, fEnabled, cPass);
+    }
+
+    return gdbStubCtxReplySendTraceSts(pThis, rc);
+}
+
+
+/**
+ * Processes the 'Tinit' set packet.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTinit(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    return gdbStubCtxReplySendTraceSts(pThis, gdbStubCtxIfTgtTraceReset(pThis));
+}
+
+
+/**
+ * Processes the 'TStart' set packet.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTStart(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    return gdbStubCtxReplySendTraceSts(pThis, gdbStubCtxIfTgtTraceStart(pThis));
+}
+
+
+/**
+ * Processes the 'TStop' set packet.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTStop(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    return gdbStubCtxReplySendTraceSts(pThis, gdbStubCtxIfTgtTraceStop(pThis));
+}
+
+
+/**
+ * Processes the 'TBuffer:circular:' set packet.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTBufferCircular(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    uint64_t fCircular = 0;
+    if (!gdbStubCtxParseHexPrefix(pbArgs, cbArgs, &fCircular))
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+    return gdbStubCtxReplySendTraceSts(pThis, gdbStubCtxIfTgtTraceSetCircular(pThis, fCircular != 0));
 }
 
 
 /**
- * Processes the 'Rcmd' query.
+ * Processes the 'TFrame' set packet, selecting a trace frame.
  *
  * @returns Status code.
  * @param   pThis               The GDB stub context.
  * @param   pbArgs              Pointer to the start of the arguments in the packet.
  * @param   cbArgs              Size of arguments in bytes.
  */
-static int gdbStubCtxPktProcessQueryRcmd(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+static int gdbStubCtxPktProcessSetTFrame(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
 {
+    GDBSTUBTRACEFIND enmFind = GDBSTUBTRACEFIND_FRAME;
+    uint64_t u64Arg1 = 0;
+    uint64_t u64Arg2 = 0;
     int rc = GDBSTUB_INF_SUCCESS;
 
-    /* Skip the , following the qRcmd start. */
-    if (   cbArgs < 1
-        || pbArgs[0] != ',')
-        return GDBSTUB_ERR_PROTOCOL_VIOLATION;
+    if (cbArgs && pbArgs[cbArgs - 1] == GDBSTUB_PKT_END)
+        cbArgs--;
 
-    if (!pThis->pIf->paCmds)
-        return GDBSTUB_ERR_NOT_FOUND;
+    if (   cbArgs < 1
+        || pbArgs[0] != ':')
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
 
-    cbArgs--;
     pbArgs++;
+    cbArgs--;
 
-    /* Decode the command. */
-    /** @todo Make this dynamic. */
-    char szCmd[4096];
-    if (cbArgs / 2 >= sizeof(szCmd))
-        return GDBSTUB_ERR_BUFFER_OVERFLOW;
-
-    size_t cbDecoded = 0;
-    rc = gdbStubCtxParseHexStringAsByteBuf(pbArgs, cbArgs - 1, &szCmd[0], sizeof(szCmd), &cbDecoded);
-    if (rc == GDBSTUB_INF_SUCCESS)
+    if (cbArgs >= 3 && !gdbStubMemcmp(pbArgs, "pc:", 3))
     {
-        const char *pszArgs = NULL;
+        enmFind = GDBSTUBTRACEFIND_PC;
+        pbArgs += 3;
+        cbArgs -= 3;
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &u64Arg1);
+    }
+    else if (cbArgs >= 4 && !gdbStubMemcmp(pbArgs, "tdp:", 4))
+    {
+        enmFind = GDBSTUBTRACEFIND_TP;
+        pbArgs += 4;
+        cbArgs -= 4;
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &u64Arg1);
+    }
+    else if (   (cbArgs >= 6 && !gdbStubMemcmp(pbArgs, "range:", 6))
+             || (cbArgs >= 8 && !gdbStubMemcmp(pbArgs, "outside:", 8)))
+    {
+        enmFind = pbArgs[0] == 'r' ? GDBSTUBTRACEFIND_RANGE : GDBSTUBTRACEFIND_OUTSIDE;
+        pbArgs += enmFind == GDBSTUBTRACEFIND_RANGE ? 6 : 8;
+        cbArgs -= enmFind == GDBSTUBTRACEFIND_RANGE ? 6 : 8;
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &u64Arg1);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &u64Arg2);
+    }
+    else if (cbArgs >= 2 && !gdbStubMemcmp(pbArgs, "-1", 2))
+        u64Arg1 = UINT64_MAX;
+    else
+    {
+        rc = gdbStubCtxParseTraceField(&pbArgs, &cbArgs, &u64Arg1);
+        /* GDB sends the frame number as a 32bit value, ffffffff selects the live target. */
+        if (u64Arg1 == 0xffffffff)
+            u64Arg1 = UINT64_MAX;
+    }
 
-        cbDecoded /= 2;
-        szCmd[cbDecoded] = '\0'; /* Ensure zero termination. */
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
 
-        /** @todo Sanitize string. */
+    int32_t iFrame = -1;
+    uint32_t idTp = 0;
+    rc = gdbStubCtxIfTgtTraceFrameFind(pThis, enmFind, u64Arg1, u64Arg2, &iFrame, &idTp);
+    if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+    else if (rc == GDBSTUB_ERR_NOT_FOUND || (rc == GDBSTUB_INF_SUCCESS && iFrame < 0))
+    {
+        char achReply[3] = { 'F', '-', '1' };
+        return gdbStubCtxReplySend(pThis, &achReply[0], sizeof(achReply));
+    }
+    else if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
 
-        /* Look for the first space and take that as the separator between command identifier. */
-        uint8_t *pbDelim = gdbStubCtxMemchr(&szCmd[0], ' ', cbDecoded);
-        if (pbDelim)
-        {
-            *pbDelim = '\0';
-            pszArgs = pbDelim + 1;
-        }
+    char achReply[32];
+    int cchReply = sprintf(achReply, "F%xT%x", (unsigned)iFrame, idTp);
+    return gdbStubCtxReplySend(pThis, achReply, cchReply);
+}
 
-        /* Search for the command. */
-        PCGDBSTUBCMD pCmd = &pThis->pIf->paCmds[0];
-        rc = GDBSTUB_ERR_NOT_FOUND;
-        while (pCmd->pszCmd)
-        {
-            if (!gdbStubStrcmp(pCmd->pszCmd, &szCmd[0]))
-            {
-                rc = gdbStubCtxCmdProcess(pThis, pCmd, pszArgs);
-                break;
-            }
-            pCmd++;
-        }
 
-        if (   rc == GDBSTUB_ERR_NOT_FOUND
-            && pThis->pIf->pfnMonCmd)
-        {
-            /* Restore delimiter. */
-            if (pbDelim)
-                *pbDelim = ' ';
-            rc = gdbStubCtxCmdProcess(pThis, NULL, &szCmd[0]);
-        }
-        else
-            rc = gdbStubCtxReplySendErrSts(pThis, rc); /** @todo Send string. */
-    }
+/**
+ * Processes trace set packets which are accepted without doing anything (trace state
+ * variables, notes, read-only sections and disconnected tracing).
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessSetTraceIgnored(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    if (!pThis->pIf->pfnTgtTraceStart)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
 
-    return rc;
+    return gdbStubCtxReplySendOk(pThis);
 }
 
 
 /**
- * List of supported query packets.
+ * List of supported set packets.
  */
-static const GDBSTUBQPKTPROC g_aQPktProcs[] =
+static const GDBSTUBQPKTPROC g_aQSetPktProcs[] =
 {
 #define GDBSTUBQPKTPROC_INIT(a_Name, a_pfnProc) { a_Name, sizeof(a_Name) - 1, a_pfnProc }
-    GDBSTUBQPKTPROC_INIT("TStatus",            gdbStubCtxPktProcessQueryTStatus),
-    GDBSTUBQPKTPROC_INIT("Supported",          gdbStubCtxPktProcessQuerySupported),
-    GDBSTUBQPKTPROC_INIT("Xfer:features:read", gdbStubCtxPktProcessQueryXferFeatRead),
-    GDBSTUBQPKTPROC_INIT("Rcmd",               gdbStubCtxPktProcessQueryRcmd),
+    GDBSTUBQPKTPROC_INIT("StartNoAckMode",     gdbStubCtxPktProcessSetStartNoAckMode),
+    /* Prefix matching, longer names sharing a prefix must come first. */
+    GDBSTUBQPKTPROC_INIT("TDPsrc",             gdbStubCtxPktProcessSetTraceIgnored),
+    GDBSTUBQPKTPROC_INIT("TDP",                gdbStubCtxPktProcessSetTDP),
+    GDBSTUBQPKTPROC_INIT("TDV",                gdbStubCtxPktProcessSetTraceIgnored),
+    GDBSTUBQPKTPROC_INIT("Tinit",              gdbStubCtxPktProcessSetTinit),
+    GDBSTUBQPKTPROC_INIT("TStart",             gdbStubCtxPktProcessSetTStart),
+    GDBSTUBQPKTPROC_INIT("TStop",              gdbStubCtxPktProcessSetTStop),
+    GDBSTUBQPKTPROC_INIT("TFrame",             gdbStubCtxPktProcessSetTFrame),
+    GDBSTUBQPKTPROC_INIT("TBuffer:circular:",  gdbStubCtxPktProcessSetTBufferCircular),
+    GDBSTUBQPKTPROC_INIT("TDisconnected",      gdbStubCtxPktProcessSetTraceIgnored),
+    GDBSTUBQPKTPROC_INIT("TNotes",             gdbStubCtxPktProcessSetTraceIgnored),
+    GDBSTUBQPKTPROC_INIT("Tro",                gdbStubCtxPktProcessSetTraceIgnored),
 #undef GDBSTUBQPKTPROC_INIT
 };
 
 
 /**
- * Processes a 'q' packet, sending the appropriate reply.
+ * Processes a 'Q' packet, sending the appropriate reply.
  *
  * @returns Status code.
  * @param   pThis               The GDB stub context.
- * @param   pbQuery             The query packet data (without the 'q').
- * @param   cbQuery             Size of the remaining query packet in bytes.
+ * @param   pbQuery             The set packet data (without the 'Q').
+ * @param   cbQuery             Size of the remaining set packet in bytes.
  */
-static int gdbStubCtxPktProcessQuery(PGDBSTUBCTXINT pThis, const uint8_t *pbQuery, size_t cbQuery)
+static int gdbStubCtxPktProcessSet(PGDBSTUBCTXINT pThis, const uint8_t *pbQuery, size_t cbQuery)
 {
-    int rc = GDBSTUB_INF_SUCCESS;
-
-    /* Search the query and execute the processor or return an empty reply if not supported. */
-    for (uint32_t i = 0; i < ELEMENTS(g_aQPktProcs); i++)
+    for (uint32_t i = 0; i < ELEMENTS(g_aQSetPktProcs); i++)
     {
-        size_t cbCmp = g_aQPktProcs[i].cchName < cbQuery ? g_aQPktProcs[i].cchName : cbQuery;
+        size_t cbCmp = g_aQSetPktProcs[i].cchName < cbQuery ? g_aQSetPktProcs[i].cchName : cbQuery;
 
-        if (!gdbStubMemcmp(pbQuery, g_aQPktProcs[i].pszName, cbCmp))
-            return g_aQPktProcs[i].pfnProc(pThis, pbQuery + cbCmp, cbQuery - cbCmp);
+        if (!gdbStubMemcmp(pbQuery, g_aQSetPktProcs[i].pszName, cbCmp))
+            return g_aQSetPktProcs[i].pfnProc(pThis, pbQuery + cbCmp, cbQuery - cbCmp);
     }
 
     return gdbStubCtxReplySend(pThis, NULL, 0);
@@ -1798,54 +3037,194 @@ static int gdbStubCtxPktProcessQuery(PGDBSTUBCTXINT pThis, const uint8_t *pbQuer
 static int gdbStubCtxPktProcessVCont(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
 {
     int rc = GDBSTUB_INF_SUCCESS;
+    BOOLEAN fCont = FALSE;
+    BOOLEAN fStep = FALSE;
+    BOOLEAN fStop = FALSE;
+    uint32_t idThreadStep = 0;
 
-    /* Skip the ; following the identifier. */
     if (   cbArgs < 2
         || pbArgs[0] != ';')
         return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
 
-    pbArgs++;
-    cbArgs--;
-
-    /** @todo For now we don't care about multiple threads and ignore thread IDs and multiple actions. */
-    switch (pbArgs[0])
+    /*
+     * Collect all actions first. The target threads can't run independently of each other,
+     * so a step of any thread takes precedence and the others run along while it steps.
+     */
+    while (   cbArgs
+           && pbArgs[0] == ';')
     {
-        case 'c':
+        pbArgs++;
+        cbArgs--;
+        if (!cbArgs)
+            return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+        uint8_t chAction = pbArgs[0];
+        pbArgs++;
+        cbArgs--;
+
+        /* The signal to deliver is meaningless for the target. */
+        if (   chAction == 'C'
+            || chAction == 'S')
         {
-            rc = gdbStubCtxIfTgtContinue(pThis);
-            if (rc == GDBSTUB_INF_SUCCESS)
-                pThis->enmTgtStateLast = GDBSTUBTGTSTATE_RUNNING;
-            break;
+            uint64_t u64Sig = 0;
+            size_t cchSig = gdbStubCtxParseHexPrefix(pbArgs, cbArgs, &u64Sig);
+            if (!cchSig)
+                return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+            pbArgs += cchSig;
+            cbArgs -= cchSig;
         }
-        case 's':
+
+        int64_t iThread = -1;
+        if (   cbArgs
+            && pbArgs[0] == ':')
         {
-            rc = gdbStubCtxIfTgtStep(pThis);
-            if (rc == GDBSTUB_INF_SUCCESS)
-                rc = gdbStubCtxReplySendSigTrap(pThis);
-            break;
+            const uint8_t *pbEnd = NULL;
+            rc = gdbStubCtxParseThreadId(pbArgs + 1, cbArgs - 1, &iThread, &pbEnd);
+            if (rc != GDBSTUB_INF_SUCCESS)
+                return gdbStubCtxReplySendErrSts(pThis, rc);
+            cbArgs -= pbEnd - pbArgs;
+            pbArgs = pbEnd;
         }
-        case 't':
+
+        switch (chAction)
         {
-            rc = gdbStubCtxIfTgtStop(pThis);
-            if (rc == GDBSTUB_INF_SUCCESS)
-                rc = gdbStubCtxReplySendSigTrap(pThis);
-            break;
+            case 'c':
+            case 'C':
+                fCont = TRUE;
+                break;
+            case 's':
+            case 'S':
+                if (!fStep)
+                {
+                    fStep = TRUE;
+                    idThreadStep = iThread > 0 ? (uint32_t)iThread : 0;
+                }
+                break;
+            case 't':
+                fStop = TRUE;
+                break;
+            default:
+                return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
         }
-        default:
-            rc = gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+    }
+
+    if (   cbArgs != 1
+        || pbArgs[0] != GDBSTUB_PKT_END)
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+    if (fStep)
+    {
+        if (!idThreadStep)
+            idThreadStep = pThis->idThreadCont ? pThis->idThreadCont : gdbStubCtxThreadGetGeneral(pThis);
+
+        rc = gdbStubCtxIfTgtThreadStep(pThis, idThreadStep);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxReplySendSigTrap(pThis);
+    }
+    else if (fCont)
+    {
+        rc = gdbStubCtxIfTgtContinue(pThis);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            pThis->enmTgtStateLast = GDBSTUBTGTSTATE_RUNNING;
+    }
+    else if (fStop)
+    {
+        rc = gdbStubCtxIfTgtStop(pThis);
+        if (rc == GDBSTUB_INF_SUCCESS)
+            rc = gdbStubCtxReplySendSigTrap(pThis);
     }
 
     return rc;
 }
 
 
+/**
+ * Processes a 'H<op><thread-id>' packet selecting the thread for subsequent operations.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessThreadSet(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+    int64_t iThread = 0;
+    const uint8_t *pbEnd = NULL;
+
+    if (gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    if (   cbArgs < 2
+        || (   pbArgs[0] != 'g'
+            && pbArgs[0] != 'c'))
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+    int rc = gdbStubCtxParseThreadId(pbArgs + 1, cbArgs - 1, &iThread, &pbEnd);
+    if (   rc != GDBSTUB_INF_SUCCESS
+        || *pbEnd != GDBSTUB_PKT_END)
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+
+    /* 0 (any) and -1 (all) keep the current selection. */
+    if (   iThread > 0
+        && !gdbStubCtxThreadIsValid(pThis, (uint32_t)iThread))
+        return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_NOT_FOUND);
+
+    if (pbArgs[0] == 'g')
+    {
+        if (iThread > 0)
+        {
+            rc = gdbStubCtxIfTgtThreadSelect(pThis, (uint32_t)iThread);
+            if (rc != GDBSTUB_INF_SUCCESS)
+                return gdbStubCtxReplySendErrSts(pThis, rc);
+            pThis->idThreadGeneral = (uint32_t)iThread;
+        }
+    }
+    else
+        pThis->idThreadCont = iThread > 0 ? (uint32_t)iThread : 0;
+
+    return gdbStubCtxReplySendOk(pThis);
+}
+
+
+/**
+ * Processes a 'T<thread-id>' packet checking whether the thread is alive.
+ *
+ * @returns Status code.
+ * @param   pThis               The GDB stub context.
+ * @param   pbArgs              Pointer to the start of the arguments in the packet.
+ * @param   cbArgs              Size of arguments in bytes.
+ */
+static int gdbStubCtxPktProcessThreadAlive(PGDBSTUBCTXINT pThis, const uint8_t *pbArgs, size_t cbArgs)
+{
+    uint32_t aidThreads[GDBSTUB_THREADS_MAX];
+    uint32_t cThreads = 0;
+    int64_t iThread = 0;
+    const uint8_t *pbEnd = NULL;
+
+    if (gdbStubCtxIfTgtThreadList(pThis, &aidThreads[0], &cThreads) == GDBSTUB_ERR_NOT_SUPPORTED)
+        return gdbStubCtxReplySend(pThis, NULL, 0);
+
+    int rc = gdbStubCtxParseThreadId(pbArgs, cbArgs, &iThread, &pbEnd);
+    if (rc != GDBSTUB_INF_SUCCESS)
+        return gdbStubCtxReplySendErrSts(pThis, rc);
+
+    if (   iThread > 0
+        && gdbStubCtxThreadIsValid(pThis, (uint32_t)iThread))
+        return gdbStubCtxReplySendOk(pThis);
+
+    return gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_NOT_FOUND);
+}
+
+
 /**
  * List of supported 'v<identifier>' packets.
  */
 static const GDBSTUBVPKTPROC g_aVPktProcs[] =
 {
 #define GDBSTUBVPKTPROC_INIT(a_Name, a_pszReply, a_pfnProc) { a_Name, sizeof(a_Name) - 1, a_pszReply, sizeof(a_pszReply) - 1, a_pfnProc }
-    GDBSTUBVPKTPROC_INIT("Cont", "vCont;s;c;t", gdbStubCtxPktProcessVCont)
+    GDBSTUBVPKTPROC_INIT("Cont", "vCont;c;C;s;S;t", gdbStubCtxPktProcessVCont)
 #undef GDBSTUBVPKTPROC_INIT
 };
 
@@ -1930,7 +3309,7 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
             }
             case 's': /* Single step, target stopped immediately again. */
             {
-                rc = gdbStubCtxIfTgtStep(pThis);
+                rc = gdbStubCtxIfTgtThreadStep(pThis, pThis->idThreadCont ? pThis->idThreadCont : gdbStubCtxThreadGetGeneral(pThis));
                 if (rc == GDBSTUB_INF_SUCCESS)
                     rc = gdbStubCtxReplySendSigTrap(pThis);
                 break;
@@ -1942,6 +3321,23 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                     pThis->enmTgtStateLast = GDBSTUBTGTSTATE_RUNNING;
                 break;
             }
+            case 'b': /* Reverse step/continue, the target stopped again when the callback returns. */
+            {
+                if (pThis->cbPkt >= 2 && pThis->pbPktBuf[2] == 's')
+                    rc = gdbStubCtxIfTgtReverseStep(pThis, pThis->idThreadCont ? pThis->idThreadCont : gdbStubCtxThreadGetGeneral(pThis));
+                else if (pThis->cbPkt >= 2 && pThis->pbPktBuf[2] == 'c')
+                    rc = gdbStubCtxIfTgtReverseCont(pThis);
+                else
+                    rc = GDBSTUB_ERR_NOT_SUPPORTED;
+
+                if (rc == GDBSTUB_INF_SUCCESS)
+                    rc = gdbStubCtxReplySendSigTrap(pThis);
+                else if (rc == GDBSTUB_ERR_NOT_SUPPORTED) /* Empty reply for unsupported packets. */
+                    rc = gdbStubCtxReplySend(pThis, NULL, 0);
+                else
+                    rc = gdbStubCtxReplySendErrSts(pThis, rc);
+                break;
+            }
             case 'g': /* Read general registers. */
             {
                 rc = gdbStubCtxIfTgtRegsRead(pThis, pThis->paidxRegs, pThis->cRegs, pThis->pvRegsScratch);
@@ -1966,6 +3362,24 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                     rc = gdbStubCtxReplySendErrSts(pThis, rc);
                 break;
             }
+            case 'G': /* Write general registers. */
+            {
+                /* The whole register file in definition order, same layout as the 'g' reply. */
+                if (pThis->cbPkt - 2 == pThis->cbRegs * 2)
+                {
+                    rc = gdbStubCtxParseHexStringAsByteBuf(&pThis->pbPktBuf[2], pThis->cbRegs * 2, pThis->pvRegsScratch, pThis->cbRegs, NULL);
+                    if (rc == GDBSTUB_INF_SUCCESS)
+                        rc = gdbStubCtxIfTgtRegsWrite(pThis, pThis->paidxRegs, pThis->cRegs, pThis->pvRegsScratch);
+
+                    if (rc == GDBSTUB_INF_SUCCESS)
+                        rc = gdbStubCtxReplySendOk(pThis);
+                    else
+                        rc = gdbStubCtxReplySendErrSts(pThis, rc);
+                }
+                else
+                    rc = gdbStubCtxReplySendErrSts(pThis, GDBSTUB_ERR_PROTOCOL_VIOLATION);
+                break;
+            }
             case 'm': /* Read memory. */
             {
                 GDBTGTMEMADDR GdbTgtAddr = 0;
@@ -1984,28 +3398,15 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                         rc = gdbStubCtxEnsurePktBufSpace(pThis, cbReplyPkt);
                         if (rc == GDBSTUB_INF_SUCCESS)
                         {
-                            uint8_t *pbPktBuf = pThis->pbPktBuf;
-                            size_t cbPktBufLeft = cbReplyPkt;
+                            /*
+                             * Read the whole range in one go into the upper half of the reply buffer and
+                             * expand it to hex in place, the encoder never overtakes the unread input.
+                             */
+                            uint8_t *pbRaw = pThis->pbPktBuf + cbRead;
 
-                            while (   cbRead
-                                   && rc == GDBSTUB_INF_SUCCESS)
-                            {
-                                size_t cbThisRead = cbRead < 1024 ? cbRead : 1024;
-                                uint8_t abTmp[1024];
-
-                                rc = gdbStubCtxIfTgtMemRead(pThis, GdbTgtAddr, &abTmp[0], cbThisRead);
-                                if (rc != GDBSTUB_INF_SUCCESS)
-                                    break;
-
-                                rc = gdbStubCtxEncodeBinaryAsHex(pbPktBuf, cbPktBufLeft, &abTmp[0], cbThisRead);
-                                if (rc != GDBSTUB_INF_SUCCESS)
-                                    break;
-
-                                GdbTgtAddr   += cbThisRead;
-                                cbRead       -= cbThisRead;
-                                pbPktBuf     += cbThisRead;
-                                cbPktBufLeft -= cbThisRead;
-                            }
+                            rc = gdbStubCtxIfTgtMemRead(pThis, GdbTgtAddr, pbRaw, cbRead);
+                            if (rc == GDBSTUB_INF_SUCCESS)
+                                rc = gdbStubCtxEncodeBinaryAsHex(pThis->pbPktBuf, cbReplyPkt, pbRaw, cbRead);
 
                             if (rc == GDBSTUB_INF_SUCCESS)
                                 rc = gdbStubCtxReplySend(pThis, pThis->pbPktBuf, cbReplyPkt);
@@ -2069,6 +3470,43 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                     rc = gdbStubCtxReplySendErrSts(pThis, rc);
                 break;
             }
+            case 'X': /* Write memory, binary data. */
+            {
+                GDBTGTMEMADDR GdbTgtAddr = 0;
+                const uint8_t *pbPktSep = NULL;
+
+                int rc = gdbStubCtxParseHexStringAsInteger(&pThis->pbPktBuf[2], pThis->cbPkt - 1, &GdbTgtAddr,
+                                                           ',', &pbPktSep);
+                if (rc == GDBSTUB_INF_SUCCESS)
+                {
+                    size_t cbProcessed = pbPktSep - &pThis->pbPktBuf[2];
+                    uint64_t cbWrite = 0;
+                    rc = gdbStubCtxParseHexStringAsInteger(pbPktSep + 1, pThis->cbPkt - 1 - cbProcessed - 1, &cbWrite, ':', &pbPktSep);
+                    if (rc == GDBSTUB_INF_SUCCESS)
+                    {
+                        /* The data runs up to the packet end character at pbPktBuf[cbPkt]. */
+                        uint8_t *pbData = (uint8_t *)pbPktSep + 1;
+                        size_t cbData = &pThis->pbPktBuf[pThis->cbPkt] - pbData;
+                        size_t cbDecoded = gdbStubCtxUnescapeBinary(pbData, cbData);
+
+                        /* A zero length write is GDB probing for 'X' support. */
+                        if (cbDecoded != cbWrite)
+                            rc = GDBSTUB_ERR_PROTOCOL_VIOLATION;
+                        else if (cbWrite)
+                            rc = gdbStubCtxIfTgtMemWrite(pThis, GdbTgtAddr, pbData, cbWrite);
+
+                        if (rc == GDBSTUB_INF_SUCCESS)
+                            rc = gdbStubCtxReplySendOk(pThis);
+                        else
+                            rc = gdbStubCtxReplySendErrSts(pThis, rc);
+                    }
+                    else
+                        rc = gdbStubCtxReplySendErrSts(pThis, rc);
+                }
+                else
+                    rc = gdbStubCtxReplySendErrSts(pThis, rc);
+                break;
+            }
             case 'p': /* Read a single register */
             {
                 uint64_t uReg = 0;
@@ -2122,11 +3560,12 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                     if (idxReg < pThis->cRegs)
                     {
                         size_t cbProcessed = pbPktSep - &pThis->pbPktBuf[2];
-                        uint32_t u32RegVal = 0;
-                        rc = gdbStubCtxParseHexStringAsByteBuf(pbPktSep + 1, pThis->cbPkt - 1 - cbProcessed - 1, &u32RegVal, sizeof(u32RegVal), NULL);
+                        size_t cbReg = pThis->pIf->paRegs[idxReg].cRegBits / 8;
+                        gdbStubCtxMemset(pThis->pvRegsScratch, 0, cbReg);
+                        rc = gdbStubCtxParseHexStringAsByteBuf(pbPktSep + 1, pThis->cbPkt - 1 - cbProcessed - 1, pThis->pvRegsScratch, cbReg, NULL);
                         if (rc == GDBSTUB_INF_SUCCESS)
                         {
-                            rc = gdbStubCtxIfTgtRegsWrite(pThis, &idxReg, 1, &u32RegVal);
+                            rc = gdbStubCtxIfTgtRegsWrite(pThis, &idxReg, 1, pThis->pvRegsScratch);
                             if (rc == GDBSTUB_INF_SUCCESS)
                                 rc = gdbStubCtxReplySendOk(pThis);
                             else if (rc == GDBSTUB_ERR_NOT_SUPPORTED)
@@ -2184,11 +3623,26 @@ static int gdbStubCtxPktProcess(PGDBSTUBCTXINT pThis)
                     rc = gdbStubCtxReplySendErrSts(pThis, rc);
                 break;
             }
+            case 'H': /* Select thread. */
+            {
+                rc = gdbStubCtxPktProcessThreadSet(pThis, &pThis->pbPktBuf[2], pThis->cbPkt - 1);
+                break;
+            }
+            case 'T': /* Thread alive. */
+            {
+                rc = gdbStubCtxPktProcessThreadAlive(pThis, &pThis->pbPktBuf[2], pThis->cbPkt - 1);
+                break;
+            }
             case 'q': /* Query packet */
             {
                 rc = gdbStubCtxPktProcessQuery(pThis, &pThis->pbPktBuf[2], pThis->cbPkt - 1);
                 break;
             }
+            case 'Q': /* Set packet */
+            {
+                rc = gdbStubCtxPktProcessSet(pThis, &pThis->pbPktBuf[2], pThis->cbPkt - 1);
+                break;
+            }
             case 'v': /* Multiletter identifier (verbose?) */
             {
                 rc = gdbStubCtxPktProcessV(pThis, &pThis->pbPktBuf[2], pThis->cbPkt - 1);
@@ -2351,7 +3805,12 @@ static int gdbStubCtxPktBufProcessChksum(PGDBSTUBCTXINT pThis, size_t cbData, si
         for (uint32_t i = 1; i < pThis->cbPkt; i++)
             uSum += pThis->pbPktBuf[i];
 
-        if (uSum == uChkSum)
+        if (pThis->fFeatures & GDBSTUBCTX_FEATURES_F_NO_ACK)
+        {
+            /* No acknowledgements and no retransmissions, the transport is reliable. */
+            rc = gdbStubCtxPktProcess(pThis);
+        }
+        else if (uSum == uChkSum)
         {
             /* Checksum matches, send acknowledge and continue processing the complete payload. */
             char chAck = '+';
@@ -2444,13 +3903,13 @@ static int gdbStubCtxRecv(PGDBSTUBCTXINT pThis)
 
     pThis->enmTgtStateLast = enmTgtState;
 
-    while (rc == GDBSTUB_INF_SUCCESS && !pThis->doShutdown)
+    while (rc == GDBSTUB_INF_SUCCESS && !GDBSTUB_ATOMIC_READ(&pThis->doShutdown))
     {
-        gdbStubCtxLock(pThis);
         size_t cbRead = gdbStubCtxIoIfPeek(pThis);
 
         if (cbRead)
         {
+            gdbStubCtxLock(pThis);
             rc = gdbStubCtxEnsurePktBufSpace(pThis, cbRead);
             if (rc == GDBSTUB_INF_SUCCESS)
             {
@@ -2459,15 +3918,17 @@ static int gdbStubCtxRecv(PGDBSTUBCTXINT pThis)
                 if (rc == GDBSTUB_INF_SUCCESS)
                     rc = gdbStubCtxPktBufProcess(pThis, cbThisRead);
             }
+            gdbStubCtxUnlock(pThis);
         }
         else
         {
-            /* Block when poll is available. */
+            /* Block when poll is available, without the lock so other threads can stop us meanwhile. */
             if (pThis->pIoIf->pfnPoll)
                 rc = gdbStubCtxIoIfPoll(pThis);
             else
                 rc = GDBSTUB_INF_TRY_AGAIN;
 
+            gdbStubCtxLock(pThis);
             if (pThis->enmTgtStateLast == GDBSTUBTGTSTATE_RUNNING) {
                 enmTgtState = gdbStubCtxIfTgtGetState(pThis);
                 if (enmTgtState == GDBSTUBTGTSTATE_STOPPED) {
@@ -2475,13 +3936,11 @@ static int gdbStubCtxRecv(PGDBSTUBCTXINT pThis)
                     pThis->enmTgtStateLast = enmTgtState;
                 }
             }
+            gdbStubCtxUnlock(pThis);
         }
-        gdbStubCtxUnlock(pThis);
     }
 
-    gdbStubCtxLock(pThis);
-    pThis->didShutdown = TRUE;
-	gdbStubCtxUnlock(pThis);
+    GDBSTUB_ATOMIC_WRITE(&pThis->didShutdown, 1);
     return rc;
 }
 
@@ -2504,9 +3963,13 @@ int GDBStubCtxCreate(PGDBSTUBCTX phCtx, PCGDBSTUBIOIF pIoIf, PCGDBSTUBIF pIf, vo
         pThis->fFeatures       = GDBSTUBCTX_FEATURES_F_TGT_DESC;
         pThis->pbTgtXmlDesc    = NULL;
         pThis->cbTgtXmlDesc    = 0;
+        pThis->pbMemMapXml     = NULL;
+        pThis->cbMemMapXml     = 0;
         pThis->fExtendedMode   = FALSE;
-        pThis->doShutdown      = FALSE;
-        pThis->didShutdown     = FALSE;
+        pThis->idThreadGeneral = 0;
+        pThis->idThreadCont    = 0;
+        pThis->doShutdown      = 0;
+        pThis->didShutdown     = 0;
         gdbStubOutCtxInit(&pThis->OutCtx, pThis);
 
         uint32_t cRegs = 0;
@@ -2519,6 +3982,20 @@ int GDBStubCtxCreate(PGDBSTUBCTX phCtx, PCGDBSTUBIOIF pIoIf, PCGDBSTUBIF pIf, vo
 
         pThis->cRegs = cRegs;
         pThis->cbRegs = cbRegs;
+        pThis->idxRegPc = UINT32_MAX;
+
+        /* MIPS targets describe pc as a plain integer register (GDB rejects code_ptr there), so fall back to the name. */
+        for (uint32_t i = 0; i < cRegs; i++)
+        {
+            if (pIf->paRegs[i].enmType == GDBSTUBREGTYPE_PC)
+            {
+                pThis->idxRegPc = i;
+                break;
+            }
+            else if (   pThis->idxRegPc == UINT32_MAX
+                     && !gdbStubStrcmp(pIf->paRegs[i].pszName, "pc"))
+                pThis->idxRegPc = i;
+        }
 
         /* Allocate scratch space for register content and index array. */
         void *pvRegsScratch = gdbStubCtxIfMemAlloc(pThis, cRegs * cbRegs + cRegs * sizeof(uint32_t));
@@ -2554,6 +4031,10 @@ void GDBStubCtxDestroy(GDBSTUBCTX hCtx)
 
     if (pThis->pbPktBuf)
         pIf->pfnMemFree(pThis, pvUser, pThis->pbPktBuf);
+    if (pThis->pbTgtXmlDesc)
+        pIf->pfnMemFree(pThis, pvUser, pThis->pbTgtXmlDesc);
+    if (pThis->pbMemMapXml)
+        pIf->pfnMemFree(pThis, pvUser, pThis->pbMemMapXml);
     pIf->pfnMemFree(NULL, pvUser, pThis);
 }
 
@@ -2567,6 +4048,14 @@ int GDBStubCtxRun(GDBSTUBCTX hCtx)
     return gdbStubCtxRecv(pThis);
 }
 
+void GDBStubCtxShutdown(GDBSTUBCTX hCtx)
+{
+    PGDBSTUBCTXINT pThis = hCtx;
+
+    if (pThis)
+        GDBSTUB_ATOMIC_WRITE(&pThis->doShutdown, 1);
+}
+
 int GDBStubCtxReset(GDBSTUBCTX hCtx)
 {
     PGDBSTUBCTXINT pThis = hCtx;
@@ -6,7 +6,7 @@
 /** Character indicating the end of a packet (excluding the checksum). */
 #define GDBSTUB_PKT_END '#'
 /** The escape character. */
-#define GDBSTUB_PKT_ESCAPE '{'
+#define GDBSTUB_PKT_ESCAPE '}'
 /** The out-of-band interrupt character. */
 #define GDBSTUB_OOB_INTERRUPT 0x03
 
@@ -101,6 +101,8 @@ typedef struct GDBSTUBCTXINT
 	void* pvRegsScratch;
 	/** Register index array for querying setting. */
 	uint32_t* paidxRegs;
+	/** Index of the program counter, expedited in stop replies (UINT32_MAX if there is none). */
+	uint32_t idxRegPc;
 	/** Send packet checksum. */
 	uint8_t uChkSumSend;
 	/** Feature flags supported we negotiated with the remote end. */
@@ -109,19 +111,37 @@ typedef struct GDBSTUBCTXINT
 	uint8_t* pbTgtXmlDesc;
 	/** Size of the XML target description. */
 	size_t cbTgtXmlDesc;
+	/** Pointer to the XML memory map, rebuilt whenever GDB starts reading it. */
+	uint8_t* pbMemMapXml;
+	/** Size of the XML memory map. */
+	size_t cbMemMapXml;
 	/** Flag whether the stub is in extended mode. */
 	BOOLEAN fExtendedMode;
+	/** Thread selected with 'Hg' for register, memory and breakpoint accesses, 0 until GDB picks one. */
+	uint32_t idThreadGeneral;
+	/** Thread selected with 'Hc' for stepping, 0 if GDB didn't pick one. */
+	uint32_t idThreadCont;
 	/** Output context. */
 	GDBSTUBOUTCTX OutCtx;
-	/** Whether or not to stop the main loop */
-	BOOLEAN doShutdown;
-	/** Whether or not the main loop shutdown */
-	BOOLEAN didShutdown;
+	/** Whether or not to stop the main loop, set from other threads (atomic access only). */
+	volatile long doShutdown;
+	/** Whether or not the main loop shutdown (atomic access only). */
+	volatile long didShutdown;
 } GDBSTUBCTXINT;
 
 
 /** Indicate support for the 'qXfer:features:read' packet to support the target description. */
 #define GDBSTUBCTX_FEATURES_F_TGT_DESC BIT(0)
+/** Acknowledgement of packets was turned off with 'QStartNoAckMode'. */
+#define GDBSTUBCTX_FEATURES_F_NO_ACK BIT(1)
+/** Threads are reported as processes using GDB's multiprocess extensions (p<pid>.<tid> thread ids). */
+#define GDBSTUBCTX_FEATURES_F_MULTIPROCESS BIT(2)
+
+/** Maximum number of target threads the stub handles. */
+#define GDBSTUB_THREADS_MAX 16
+
+/** The packet size advertised to GDB in the 'qSupported' reply, the packet buffer grows on demand. */
+#define GDBSTUB_PKT_SIZE_MAX 0x10000
 
 /**
  * Specific query packet processor callback.
@@ -176,6 +176,142 @@ typedef GDBSTUBREG *PGDBSTUBREG;
 typedef const GDBSTUBREG *PCGDBSTUBREG;
 
 
+/**
+ * Memory region type.
+ */
+typedef enum GDBSTUBMEMTYPE
+{
+    /** Invalid type, do not use. */
+    GDBSTUBMEMTYPE_INVALID = 0,
+    /** Readable and writable memory. */
+    GDBSTUBMEMTYPE_RAM,
+    /** Read only memory. */
+    GDBSTUBMEMTYPE_ROM,
+    /** 32bit hack. */
+    GDBSTUBMEMTYPE_32BIT_HACK = 0x7fffffff
+} GDBSTUBMEMTYPE;
+
+
+/**
+ * A memory map entry.
+ */
+typedef struct GDBSTUBMEMREGION
+{
+    /** Start address of the region. */
+    GDBTGTMEMADDR               GdbTgtMemAddrStart;
+    /** Size of the region in bytes. */
+    uint64_t                    cbRegion;
+    /** Region type. */
+    GDBSTUBMEMTYPE              enmType;
+} GDBSTUBMEMREGION;
+/** Pointer to a memory map entry. */
+typedef GDBSTUBMEMREGION *PGDBSTUBMEMREGION;
+/** Pointer to a const memory map entry. */
+typedef const GDBSTUBMEMREGION *PCGDBSTUBMEMREGION;
+
+
+/**
+ * Tracepoint collection action type.
+ */
+typedef enum GDBSTUBTRACECOLLECTTYPE
+{
+    /** Invalid type, do not use. */
+    GDBSTUBTRACECOLLECTTYPE_INVALID = 0,
+    /** Collect all registers. */
+    GDBSTUBTRACECOLLECTTYPE_REGS,
+    /** Collect a memory range. */
+    GDBSTUBTRACECOLLECTTYPE_MEM,
+    /** 32bit hack. */
+    GDBSTUBTRACECOLLECTTYPE_32BIT_HACK = 0x7fffffff
+} GDBSTUBTRACECOLLECTTYPE;
+
+
+/**
+ * A single tracepoint collection action.
+ */
+typedef struct GDBSTUBTRACECOLLECT
+{
+    /** Action type. */
+    GDBSTUBTRACECOLLECTTYPE     enmType;
+    /** Register the memory range is relative to, -1 for an absolute address. */
+    int32_t                     idxRegBase;
+    /** Offset from the base register or absolute start address of the memory range. */
+    uint64_t                    offMem;
+    /** Size of the memory range in bytes. */
+    uint32_t                    cbMem;
+} GDBSTUBTRACECOLLECT;
+/** Pointer to a tracepoint collection action. */
+typedef GDBSTUBTRACECOLLECT *PGDBSTUBTRACECOLLECT;
+/** Pointer to a const tracepoint collection action. */
+typedef const GDBSTUBTRACECOLLECT *PCGDBSTUBTRACECOLLECT;
+
+
+/**
+ * Trace frame search mode.
+ */
+typedef enum GDBSTUBTRACEFIND
+{
+    /** Invalid mode, do not use. */
+    GDBSTUBTRACEFIND_INVALID = 0,
+    /** Select the frame with the given number. */
+    GDBSTUBTRACEFIND_FRAME,
+    /** Next frame collected at the given address. */
+    GDBSTUBTRACEFIND_PC,
+    /** Next frame collected by the given tracepoint. */
+    GDBSTUBTRACEFIND_TP,
+    /** Next frame collected inside the given address range. */
+    GDBSTUBTRACEFIND_RANGE,
+    /** Next frame collected outside the given address range. */
+    GDBSTUBTRACEFIND_OUTSIDE,
+    /** 32bit hack. */
+    GDBSTUBTRACEFIND_32BIT_HACK = 0x7fffffff
+} GDBSTUBTRACEFIND;
+
+
+/**
+ * Why the last trace run stopped.
+ */
+typedef enum GDBSTUBTRACESTOP
+{
+    /** No trace run was started yet. */
+    GDBSTUBTRACESTOP_NOT_RUN = 0,
+    /** Stopped by the debugger. */
+    GDBSTUBTRACESTOP_USER,
+    /** A tracepoint reached its pass count. */
+    GDBSTUBTRACESTOP_PASSCOUNT,
+    /** The trace buffer is full. */
+    GDBSTUBTRACESTOP_BUFFER_FULL,
+    /** 32bit hack. */
+    GDBSTUBTRACESTOP_32BIT_HACK = 0x7fffffff
+} GDBSTUBTRACESTOP;
+
+
+/**
+ * Trace run status.
+ */
+typedef struct GDBSTUBTRACESTATUS
+{
+    /** Flag whether a trace run is active. */
+    int                         fRunning;
+    /** Why the last run stopped, ignored while running. */
+    GDBSTUBTRACESTOP            enmStop;
+    /** The tracepoint which reached its pass count for GDBSTUBTRACESTOP_PASSCOUNT. */
+    uint32_t                    idTpStop;
+    /** Flag whether the trace buffer overwrites the oldest frames when full. */
+    int                         fCircular;
+    /** Number of frames currently in the trace buffer. */
+    uint64_t                    cFrames;
+    /** Number of frames created during the run, including overwritten ones. */
+    uint64_t                    cFramesCreated;
+    /** Size of the trace buffer in bytes. */
+    uint64_t                    cbBuffer;
+    /** Free space in the trace buffer in bytes. */
+    uint64_t                    cbBufferFree;
+} GDBSTUBTRACESTATUS;
+/** Pointer to a trace run status. */
+typedef GDBSTUBTRACESTATUS *PGDBSTUBTRACESTATUS;
+
+
 /** Forward decleration of a const output helper structure. */
 typedef const struct GDBSTUBOUTHLP *PCGDBSTUBOUTHLP;
 
@@ -411,6 +547,194 @@ typedef struct GDBSTUBIF
     // unlock context
     void (*pfnUnlock) (void* pvUser);
 
+    /**
+     * Returns the target memory map - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   ppaRegions          Where to store the pointer to the region array, owned by the callee and
+     *                              valid until the next call.
+     * @param   pcRegions           Where to store the number of regions.
+     */
+    int    (*pfnTgtMemMapQuery) (GDBSTUBCTX hGdbStubCtx, void *pvUser, PCGDBSTUBMEMREGION *ppaRegions, uint32_t *pcRegions);
+
+    /**
+     * Deletes all tracepoints and discards the collected trace frames - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     */
+    int    (*pfnTgtTraceReset) (GDBSTUBCTX hGdbStubCtx, void *pvUser);
+
+    /**
+     * Defines a new tracepoint, replacing any previous one with the same number and address - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idTp                The tracepoint number assigned by GDB.
+     * @param   GdbTgtTpAddr        The target address space memory address of the tracepoint.
+     * @param   fEnabled            Flag whether the tracepoint is enabled.
+     * @param   cPass               Number of hits after which the trace run stops, 0 for no limit.
+     */
+    int    (*pfnTgtTraceTpDefine) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, int fEnabled, uint64_t cPass);
+
+    /**
+     * Adds a collection action to a previously defined tracepoint - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idTp                The tracepoint number.
+     * @param   GdbTgtTpAddr        The target address space memory address of the tracepoint.
+     * @param   pCollect            The action to add.
+     */
+    int    (*pfnTgtTraceTpCollect) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idTp, GDBTGTMEMADDR GdbTgtTpAddr, PCGDBSTUBTRACECOLLECT pCollect);
+
+    /**
+     * Sets whether the trace buffer overwrites the oldest frames when full - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   fCircular           Flag whether the buffer is circular.
+     */
+    int    (*pfnTgtTraceSetCircular) (GDBSTUBCTX hGdbStubCtx, void *pvUser, int fCircular);
+
+    /**
+     * Starts a trace run, discarding the frames of the previous one - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     */
+    int    (*pfnTgtTraceStart) (GDBSTUBCTX hGdbStubCtx, void *pvUser);
+
+    /**
+     * Stops the current trace run, the collected frames stay available - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     */
+    int    (*pfnTgtTraceStop) (GDBSTUBCTX hGdbStubCtx, void *pvUser);
+
+    /**
+     * Queries the trace run status - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   pStatus             Where to store the status.
+     */
+    int    (*pfnTgtTraceStatus) (GDBSTUBCTX hGdbStubCtx, void *pvUser, PGDBSTUBTRACESTATUS pStatus);
+
+    /**
+     * Selects a trace frame, memory and register reads are served from it until another frame is
+     * selected - optional.
+     *
+     * @returns Status code, GDBSTUB_ERR_NOT_FOUND if no frame matches (the live target is selected then).
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   enmFind             How to search for the frame.
+     * @param   u64Arg1             Frame number, address, tracepoint number or range start depending on enmFind.
+     * @param   u64Arg2             Range end (inclusive) for the range modes.
+     * @param   piFrame             Where to store the selected frame number.
+     * @param   pidTp               Where to store the tracepoint which collected the selected frame.
+     *
+     * @note Selecting frame -1 (GDBSTUBTRACEFIND_FRAME with UINT64_MAX) switches back to the live target.
+     */
+    int    (*pfnTgtTraceFrameFind) (GDBSTUBCTX hGdbStubCtx, void *pvUser, GDBSTUBTRACEFIND enmFind, uint64_t u64Arg1, uint64_t u64Arg2,
+                                    int32_t *piFrame, uint32_t *pidTp);
+
+    /**
+     * Returns the threads of the target - optional, the target is a single thread without it.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   paidThreads         Where to store the thread ids, 0 and -1 are reserved.
+     * @param   cThreadsMax         Maximum number of entries paidThreads can hold.
+     * @param   pcThreads           Where to store the number of threads.
+     *
+     * @note Threads are reported as separate processes (inferiors) when GDB supports the multiprocess extensions.
+     */
+    int    (*pfnTgtThreadList) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *paidThreads, uint32_t cThreadsMax, uint32_t *pcThreads);
+
+    /**
+     * Selects the thread subsequent register, memory and breakpoint callbacks apply to - optional.
+     *
+     * @returns Status code, GDBSTUB_ERR_NOT_FOUND for an unknown thread.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idThread            The thread to select.
+     */
+    int    (*pfnTgtThreadSelect) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread);
+
+    /**
+     * Returns the thread which caused the target to stop - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   pidThread           Where to store the thread id.
+     */
+    int    (*pfnTgtThreadQueryStopped) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t *pidThread);
+
+    /**
+     * Returns a short description of the given thread shown by GDB - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idThread            The thread to describe.
+     * @param   pszName             Where to store the zero terminated description.
+     * @param   cbName              Size of the buffer in bytes.
+     */
+    int    (*pfnTgtThreadQueryName) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread, char *pszName, size_t cbName);
+
+    /**
+     * Single steps the given thread, the others keep running along - optional, pfnTgtStep is used without it.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idThread            The thread to step.
+     */
+    int    (*pfnTgtThreadStep) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread);
+
+    /**
+     * Steps the given thread backwards to its previous instruction - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   idThread            The thread to step, 0 for the target's choice.
+     */
+    int    (*pfnTgtReverseStep) (GDBSTUBCTX hGdbStubCtx, void *pvUser, uint32_t idThread);
+
+    /**
+     * Runs the target backwards until the previous breakpoint hit - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     */
+    int    (*pfnTgtReverseCont) (GDBSTUBCTX hGdbStubCtx, void *pvUser);
+
+    /**
+     * Returns whether the last reverse step or continue ran into the beginning of the
+     * recorded history - optional.
+     *
+     * @returns Status code.
+     * @param   hGdbStubCtx         The GDB stub context handle invoking the callback.
+     * @param   pvUser              Opaque user data passed during creation of the stub context.
+     * @param   pfBegin             Where to store the flag.
+     */
+    int    (*pfnTgtReverseQueryHistoryBegin) (GDBSTUBCTX hGdbStubCtx, void *pvUser, int *pfBegin);
+
 } GDBSTUBIF;
 /** Pointer to a interface callback table. */
 typedef GDBSTUBIF *PGDBSTUBIF;
@@ -503,6 +827,16 @@ void GDBStubCtxDestroy(GDBSTUBCTX hCtx);
  */
 int GDBStubCtxRun(GDBSTUBCTX hCtx);
 
+/**
+ * Makes GDBStubCtxRun() return once it is done with the current packet, callable from any thread.
+ *
+ * @returns nothing.
+ * @param   hCtx                    The GDB stub context handle.
+ *
+ * @note The I/O interface has to be woken up afterwards if the run loop might be blocked in pfnPoll.
+ */
+void GDBStubCtxShutdown(GDBSTUBCTX hCtx);
+
 /**
  * Resets the given GDB stub context to an initial state without freeing allocated scratch buffers.
  *
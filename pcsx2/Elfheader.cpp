@@ -19,6 +19,7 @@
 #include "GS.h"			// for sending game crc to mtgs
 #include "Elfheader.h"
 #include "DebugTools/SymbolMap.h"
+#include "DebugTools/DwarfInfo.h"
 #include "AppCoreThread.h"
 
 u32 ElfCRC;
@@ -232,6 +233,7 @@ void ElfObject::loadSectionHeaders()
 	const u8* sections_names = data.GetPtr( secthead[ (header.e_shstrndx == 0xffff ? 0 : header.e_shstrndx) ].sh_offset );
 
 	int i_st = -1, i_dt = -1;
+	DwarfSections dwarf;
 
 	for( int i = 0 ; i < header.e_shnum ; i++ )
 	{
@@ -275,6 +277,25 @@ void ElfObject::loadSectionHeaders()
 			i_st = i;
 			i_dt = secthead[i].sh_link;
 		}
+
+		// debug info is copied, the loader parses it in the background after the ELF is gone
+		if (secthead[ i ].sh_type == 0x01 && secthead[ i ].sh_size != 0 && secthead[ i ].sh_offset < (u32)data.GetLength()
+			&& secthead[ i ].sh_size <= (u32)data.GetLength() - secthead[ i ].sh_offset)
+		{
+			const char* name = (const char*)&sections_names[ secthead[ i ].sh_name ];
+			std::vector<u8>* dest = NULL;
+			if (strcmp(name, ".debug_info") == 0) dest = &dwarf.info;
+			else if (strcmp(name, ".debug_abbrev") == 0) dest = &dwarf.abbrev;
+			else if (strcmp(name, ".debug_line") == 0) dest = &dwarf.line;
+			else if (strcmp(name, ".debug_str") == 0) dest = &dwarf.str;
+			else if (strcmp(name, ".debug_line_str") == 0) dest = &dwarf.lineStr;
+
+			if (dest)
+			{
+				const u8* start = data.GetPtr(secthead[ i ].sh_offset);
+				dest->assign(start, start + secthead[ i ].sh_size);
+			}
+		}
 	}
 
 	if ((i_st >= 0) && (i_dt >= 0))
@@ -293,6 +314,11 @@ void ElfObject::loadSectionHeaders()
 			}
 		}
 	}
+
+	// after the symbol table, its names take precedence over the ones from the debug info
+	if (!dwarf.line.empty() || !dwarf.info.empty())
+		Console.WriteLn("found DWARF debug info (%u KB), loading in the background", (u32)((dwarf.info.size() + dwarf.line.size()) / 1024));
+	CDwarfInfo::Load(std::move(dwarf));
 }
 
 void ElfObject::loadHeaders()
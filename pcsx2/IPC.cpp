@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <thread>
 #include <sys/types.h>
 #if _WIN32
@@ -32,6 +33,9 @@
 #define close_portable(a) (close(a))
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include "Common.h"
@@ -75,6 +79,8 @@ SocketIPC::SocketIPC(SysCoreThread* vm, unsigned int slot)
 		return;
 	}
 
+	m_ring_name = IPC_EMULATOR_NAME "_ring_" + std::to_string(slot);
+
 #else
 	char* runtime_dir = nullptr;
 #ifdef __APPLE__
@@ -94,6 +100,7 @@ SocketIPC::SocketIPC(SysCoreThread* vm, unsigned int slot)
 
 	if (slot != IPC_DEFAULT_SLOT)
 		m_socket_name += "." + std::to_string(slot);
+	m_ring_name = m_socket_name + ".ring";
 
 	struct sockaddr_un server;
 
@@ -142,6 +149,199 @@ char* SocketIPC::MakeFailIPC(char* ret_buffer, uint32_t size = 5)
 	return ret_buffer;
 }
 
+void SocketIPC::ReadBlock(u32 address, u32 size, char* data)
+{
+	using namespace vtlb_private;
+
+	// the interpreter's cache emulation has to see every access
+	const bool direct = CHECK_EEREC || !CHECK_CACHE;
+
+	while (size > 0)
+	{
+		const u32 chunk = std::min(size, VTLB_PAGE_SIZE - (address & VTLB_PAGE_MASK));
+		const auto vmv = vtlbdata.vmap[address >> VTLB_PAGE_BITS];
+
+		if (direct && !vmv.isHandler(address))
+			memcpy(data, (void*)vmv.assumePtr(address), chunk);
+		else
+		{
+			for (u32 i = 0; i < chunk; i++)
+				data[i] = memRead8(address + i);
+		}
+
+		address += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+void SocketIPC::SnapshotBlock(u32 address, u32 size, char* data)
+{
+	using namespace vtlb_private;
+
+	while (size > 0)
+	{
+		const u32 chunk = std::min(size, VTLB_PAGE_SIZE - (address & VTLB_PAGE_MASK));
+		const auto vmv = vtlbdata.vmap[address >> VTLB_PAGE_BITS];
+
+		if (!vmv.isHandler(address))
+			memcpy(data, (void*)vmv.assumePtr(address), chunk);
+		else
+			memset(data, 0, chunk);
+
+		address += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+bool SocketIPC::IsHostMapped(u32 address, u32 size)
+{
+	using namespace vtlb_private;
+
+	if (size == 0 || address + size - 1 < address)
+		return false;
+
+	const u32 last = (address + size - 1) >> VTLB_PAGE_BITS;
+	for (u32 page = address >> VTLB_PAGE_BITS; page <= last; page++)
+	{
+		if (vtlbdata.vmap[page].isHandler(page << VTLB_PAGE_BITS))
+			return false;
+	}
+	return true;
+}
+
+void SocketIPC::WriteBlock(u32 address, u32 size, const char* data)
+{
+	using namespace vtlb_private;
+
+	const bool direct = CHECK_EEREC || !CHECK_CACHE;
+
+	while (size > 0)
+	{
+		const u32 chunk = std::min(size, VTLB_PAGE_SIZE - (address & VTLB_PAGE_MASK));
+		const auto vmv = vtlbdata.vmap[address >> VTLB_PAGE_BITS];
+
+		// like memWrite*, a write to a page holding recompiled code faults and
+		// clears the blocks
+		if (direct && !vmv.isHandler(address))
+			memcpy((void*)vmv.assumePtr(address), data, chunk);
+		else
+		{
+			for (u32 i = 0; i < chunk; i++)
+				memWrite8(address + i, data[i]);
+		}
+
+		address += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+bool SocketIPC::Subscribe(const std::vector<IPCRange>& ranges, u32 size)
+{
+	Unsubscribe();
+
+	const u32 slot_size = IPC_RING_SLOT_HEADER_SIZE + ((size + 7) & ~7);
+	const u32 ring_size = IPC_RING_HEADER_SIZE + IPC_RING_SLOTS * slot_size;
+	char* ring;
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, ring_size, m_ring_name.c_str());
+	if (handle == NULL)
+		return false;
+	ring = (char*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, ring_size);
+	if (ring == NULL)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+#else
+	// the file is truncated first so a client still mapping the previous
+	// ring doesn't see stale snapshots in the new layout
+	int fd = open(m_ring_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		return false;
+	if (ftruncate(fd, ring_size) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	ring = (char*)mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED)
+		return false;
+#endif
+	memset(ring, 0, ring_size);
+	ToArray<u32>(ring, IPC_RING_SLOTS, 4);
+	ToArray<u32>(ring, slot_size, 8);
+	ToArray<u32>(ring, size, 12);
+	std::atomic_thread_fence(std::memory_order_release);
+	ToArray<u32>(ring, IPC_RING_MAGIC, 0);
+
+	std::lock_guard<std::mutex> lock(m_sub_lock);
+#ifdef _WIN32
+	m_ring_handle = handle;
+#endif
+	m_ring = ring;
+	m_ring_size = ring_size;
+	m_sub_ranges = ranges;
+	m_sub_size = size;
+	m_sub_sequence = 0;
+	m_sub_active = true;
+	return true;
+}
+
+void SocketIPC::Unsubscribe()
+{
+	std::lock_guard<std::mutex> lock(m_sub_lock);
+	m_sub_active = false;
+	if (m_ring == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_ring);
+	CloseHandle(m_ring_handle);
+	m_ring_handle = NULL;
+#else
+	munmap(m_ring, m_ring_size);
+	unlink(m_ring_name.c_str());
+#endif
+	m_ring = nullptr;
+	m_ring_size = 0;
+	m_sub_ranges.clear();
+}
+
+void SocketIPC::VsyncEnd(u32 frame)
+{
+	if (!m_sub_active)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_sub_lock);
+	if (m_ring == nullptr)
+		return;
+
+	const u64 sequence = ++m_sub_sequence;
+	const u32 slot_size = IPC_RING_SLOT_HEADER_SIZE + ((m_sub_size + 7) & ~7);
+	char* slot = &m_ring[IPC_RING_HEADER_SIZE + (sequence % IPC_RING_SLOTS) * slot_size];
+
+	// a reader that started copying this slot sees its sequence change
+	((volatile u64*)slot)[0] = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	ToArray<u32>(slot, frame, 8);
+	char* data = &slot[IPC_RING_SLOT_HEADER_SIZE];
+	for (const IPCRange& range : m_sub_ranges)
+	{
+		SnapshotBlock(range.address, range.size, data);
+		data += range.size;
+	}
+
+	std::atomic_thread_fence(std::memory_order_release);
+	((volatile u64*)slot)[0] = sequence;
+	((volatile u64*)&m_ring[16])[0] = sequence;
+}
+
 int SocketIPC::StartSocket()
 {
 	m_msgsock = accept(m_sock, 0, 0);
@@ -241,6 +441,7 @@ void SocketIPC::ExecuteTaskInThread()
 SocketIPC::~SocketIPC()
 {
 	m_end = true;
+	Unsubscribe();
 #ifdef _WIN32
 	WSACleanup();
 #else
@@ -378,6 +579,95 @@ SocketIPC::IPCBuffer SocketIPC::ParseCommand(char* buf, char* ret_buffer, u32 bu
 				buf_cnt += 12;
 				break;
 			}
+			case MsgReadN:
+			{
+				// several MsgReadN in one message gather all the blocks into
+				// the same reply
+				//         IPC Message event (1 byte)
+				//         |  Memory address (4 byte)
+				//         |  |           size (4 byte)
+				//         |  |           |
+				// format: XX YY YY YY YY ZZ ZZ ZZ ZZ
+				// reply:  the block, size bytes
+				if (!m_vm->HasActiveMachine())
+					goto error;
+				if (!SafetyChecks(buf_cnt, 8, ret_cnt, 0, buf_size))
+					goto error;
+				const u32 a = FromArray<u32>(&buf[buf_cnt], 0);
+				const u32 size = FromArray<u32>(&buf[buf_cnt], 4);
+				if (size >= MAX_IPC_RETURN_SIZE || !SafetyChecks(buf_cnt, 8, ret_cnt, size, buf_size))
+					goto error;
+				ReadBlock(a, size, &ret_buffer[ret_cnt]);
+				ret_cnt += size;
+				buf_cnt += 8;
+				break;
+			}
+			case MsgWriteN:
+			{
+				//         IPC Message event (1 byte)
+				//         |  Memory address (4 byte)
+				//         |  |           size (4 byte)
+				//         |  |           |           data (size bytes)
+				//         |  |           |           |
+				// format: XX YY YY YY YY ZZ ZZ ZZ ZZ WW ...
+				if (!m_vm->HasActiveMachine())
+					goto error;
+				if (!SafetyChecks(buf_cnt, 8, ret_cnt, 0, buf_size))
+					goto error;
+				const u32 a = FromArray<u32>(&buf[buf_cnt], 0);
+				const u32 size = FromArray<u32>(&buf[buf_cnt], 4);
+				if (size >= MAX_IPC_SIZE || !SafetyChecks(buf_cnt, 8 + size, ret_cnt, 0, buf_size))
+					goto error;
+				WriteBlock(a, size, &buf[buf_cnt + 8]);
+				buf_cnt += 8 + size;
+				break;
+			}
+			case MsgSubscribe:
+			{
+				// replaces any previous subscription, the client maps the
+				// ring by its name
+				//         IPC Message event (1 byte)
+				//         |  range count (4 byte)
+				//         |  |           Memory address (4 byte)
+				//         |  |           |           size (4 byte)
+				//         |  |           |           |
+				// format: XX CC CC CC CC YY YY YY YY ZZ ZZ ZZ ZZ ...
+				// reply:  ring size (4 byte), ring name (256 byte)
+				if (!m_vm->HasActiveMachine())
+					goto error;
+				if (!SafetyChecks(buf_cnt, 4, ret_cnt, 4 + 256, buf_size))
+					goto error;
+				const u32 count = FromArray<u32>(&buf[buf_cnt], 0);
+				if (count == 0 || count > (buf_size - buf_cnt - 4) / 8)
+					goto error;
+				std::vector<IPCRange> ranges(count);
+				u64 size = 0;
+				for (u32 i = 0; i < count; i++)
+				{
+					ranges[i].address = FromArray<u32>(&buf[buf_cnt], 4 + i * 8);
+					ranges[i].size = FromArray<u32>(&buf[buf_cnt], 8 + i * 8);
+					size += ranges[i].size;
+					// reading hardware registers every vsync would have side effects
+					if (!IsHostMapped(ranges[i].address, ranges[i].size))
+						goto error;
+				}
+				if (size == 0 || size > MAX_IPC_SUBSCRIPTION_SIZE)
+					goto error;
+				if (!Subscribe(ranges, (u32)size))
+					goto error;
+				char name[256] = {};
+				snprintf(name, sizeof(name), "%s", m_ring_name.c_str());
+				ToArray<u32>(ret_buffer, m_ring_size, ret_cnt);
+				memcpy(&ret_buffer[ret_cnt + 4], name, 256);
+				ret_cnt += 4 + 256;
+				buf_cnt += 4 + count * 8;
+				break;
+			}
+			case MsgUnsubscribe:
+			{
+				Unsubscribe();
+				break;
+			}
 			case MsgVersion:
 			{
 				char version[256] = {};
@@ -27,7 +27,10 @@
 
 #include "Utilities/PersistentThread.h"
 #include "System/SysThreads.h"
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 #ifdef _WIN32
 #include <WinSock2.h>
 #include <windows.h>
@@ -105,6 +108,10 @@ protected:
 		MsgUUID = 0xD,          /**< Returns the game UUID. */
 		MsgGameVersion = 0xE,   /**< Returns the game verion. */
 		MsgStatus = 0xF,        /**< Returns the emulator status. */
+		MsgReadN = 0x10,        /**< Read a block of memory of any size. */
+		MsgWriteN = 0x11,       /**< Write a block of memory of any size. */
+		MsgSubscribe = 0x12,    /**< Publishes memory ranges at every vsync. */
+		MsgUnsubscribe = 0x13,  /**< Stops publishing memory ranges. */
 		MsgUnimplemented = 0xFF /**< Unimplemented IPC message. */
 	};
 
@@ -141,6 +148,63 @@ protected:
 		IPC_FAIL = 0xFF /**< IPC command failed to complete. */
 	};
 
+	/**
+	 * Subscription ring.
+	 * After a MsgSubscribe the subscribed ranges are copied, packed in the
+	 * order they were given, into a ring of snapshots in shared memory at the
+	 * end of every vsync. Only ranges backed by host memory (RAM, scratchpad,
+	 * ROM) can be subscribed, hardware registers are refused. It starts with
+	 * a header:
+	 *     u32 magic ("PCSR"), u32 slot count, u32 slot size, u32 data size,
+	 *     u64 sequence number of the newest complete snapshot (0 if none)
+	 * followed by the slots. Snapshot n lives in slot n % slot count:
+	 *     u64 sequence number (0 while being written), u32 frame, u32 padding,
+	 *     the packed data
+	 * A reader copies a slot out and checks its sequence number didn't change.
+	 */
+#define IPC_RING_MAGIC 0x52534350
+#define IPC_RING_SLOTS 16
+#define IPC_RING_HEADER_SIZE 24
+#define IPC_RING_SLOT_HEADER_SIZE 16
+
+	/**
+	 * Maximum size of a subscription snapshot.
+	 */
+#define MAX_IPC_SUBSCRIPTION_SIZE (4 * 1024 * 1024)
+
+	/**
+	 * A subscribed memory range.
+	 */
+	struct IPCRange
+	{
+		u32 address; /**< EE virtual address of the range. */
+		u32 size;    /**< Size of the range in bytes. */
+	};
+
+	std::vector<IPCRange> m_sub_ranges;
+	u32 m_sub_size = 0;
+	u64 m_sub_sequence = 0;
+	char* m_ring = nullptr;
+	u32 m_ring_size = 0;
+	// name the client opens the ring with: a file next to the socket, or a
+	// named file mapping on windows
+	std::string m_ring_name;
+#ifdef _WIN32
+	HANDLE m_ring_handle = NULL;
+#endif
+	// taken by the IPC thread while it changes the subscription and by the
+	// vm thread while it publishes a snapshot
+	std::mutex m_sub_lock;
+	std::atomic<bool> m_sub_active{false};
+
+	/**
+	 * Creates the shared memory ring for a new set of ranges, replacing
+	 * any previous subscription.
+	 * return value: false if the ring couldn't be created.
+	 */
+	bool Subscribe(const std::vector<IPCRange>& ranges, u32 size);
+	void Unsubscribe();
+
 	// handle to the main vm thread
 	SysCoreThread* m_vm;
 
@@ -166,6 +230,30 @@ protected:
 	static inline char* MakeOkIPC(char* ret_buffer, uint32_t size);
 	static inline char* MakeFailIPC(char* ret_buffer, uint32_t size);
 
+	/**
+	 * Copies a block of EE memory from or to an IPC buffer.
+	 * Pages backed by host memory are copied directly, a page at a time,
+	 * handler (MMIO) pages go through the vtlb a byte at a time.
+	 * address: EE virtual address of the block.
+	 * size: size of the block in bytes.
+	 * data: IPC buffer to copy from or to.
+	 */
+	static void ReadBlock(u32 address, u32 size, char* data);
+	static void WriteBlock(u32 address, u32 size, const char* data);
+
+	/**
+	 * Copies a block of EE memory for the subscription ring. Runs on the VM
+	 * thread at vsync, so it only ever copies pages backed by host memory:
+	 * anything else, a page unmapped since the subscription, is zero filled
+	 * instead of going through handlers or TLB misses.
+	 */
+	static void SnapshotBlock(u32 address, u32 size, char* data);
+
+	/**
+	 * Whether every page of the block is backed by host memory.
+	 */
+	static bool IsHostMapped(u32 address, u32 size);
+
 	/**
 	 * Initializes an open socket for IPC communication.
 	 * return value: -1 if a fatal failure happened, 0 otherwise. 
@@ -221,4 +309,11 @@ public:
 	SocketIPC(SysCoreThread* vm, unsigned int slot = IPC_DEFAULT_SLOT);
 	virtual ~SocketIPC();
 
+	/**
+	 * Publishes a snapshot of the subscribed ranges, called by the vm
+	 * thread at the end of every vsync.
+	 * frame: number of the frame that just ended.
+	 */
+	void VsyncEnd(u32 frame);
+
 }; // class SocketIPC
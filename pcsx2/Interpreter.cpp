@@ -19,11 +19,14 @@
 
 #include "R5900OpcodeTables.h"
 #include "R5900Exceptions.h"
+#include "R3000A.h"
 #include "System/SysThreads.h"
 
 #include "Elfheader.h"
 
 #include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/Tracepoints.h"
+#include "../DebugTools/ReverseExecution.h"
 
 #include <float.h>
 
@@ -59,6 +62,9 @@ void intBreakpoint(bool memcheck)
 			return;
 	}
 
+	if (!CReverseExecution::BreakpointHit(BREAKPOINT_EE, pc))
+		return;
+
 	CBreakPoints::SetBreakpointTriggered(true);
 	GetCoreThread().PauseSelfDebug();
 	throw Exception::ExitCpuExecute();
@@ -73,26 +79,15 @@ void intMemcheck(u32 op, u32 bits, bool store)
 	if (bits == 128)
 		start &= ~0x0F;
 
-	start = standardizeBreakpointAddress(BREAKPOINT_EE, start);
-	u32 end = start + bits/8;
-	
-	auto checks = CBreakPoints::GetMemChecks();
-	for (size_t i = 0; i < checks.size(); i++)
-	{
-		auto& check = checks[i];
-
-		if (check.cpu != BREAKPOINT_EE)
-			continue;
-		if (check.result == 0)
-			continue;
-		if ((check.cond & MEMCHECK_WRITE) == 0 && store)
-			continue;
-		if ((check.cond & MEMCHECK_READ) == 0 && !store)
-			continue;
+	// the page table rules out nearly every access before the ranges are looked at
+	if (!(memCheckPages[start >> MEMCHECK_PAGE_BITS] & memCheckPageMask(BREAKPOINT_EE, store)))
+		return;
 
-		if (start < check.end && check.start < end)
-			intBreakpoint(true);
-	}
+	u32 result = CBreakPoints::CheckMemAccess(BREAKPOINT_EE, start, bits / 8, store);
+	if (result & MEMCHECK_LOG)
+		DevCon.WriteLn("Hit %s breakpoint @0x%x", store ? "store" : "load", start);
+	if (result & MEMCHECK_BREAK)
+		intBreakpoint(true);
 }
 
 void intCheckMemcheck()
@@ -135,13 +130,27 @@ static void execI()
 	// not yet usable with the interpreter
 //#define EXTRA_DEBUG
 #ifdef EXTRA_DEBUG
-	// check if any breakpoints or memchecks are triggered by this instruction
+	// check if any breakpoints are triggered by this instruction
 	if (isBreakpointNeeded(cpuRegs.pc))
 		intBreakpoint(false);
-
-	intCheckMemcheck();
 #endif
 
+	// Reverse execution counts instructions while it replays the recorded history
+	if (CReverseExecution::IsCountingInstructions() && !cpuRegs.branch && CReverseExecution::InstructionHit(cpuRegs.pc))
+	{
+		GetCoreThread().PauseSelfDebug();
+		throw Exception::ExitCpuExecute();
+	}
+
+	// Memchecks cost a single compare until one is set. Delay slot accesses are
+	// checked along with their branch, same as the recompiler.
+	if (CBreakPoints::GetNumMemchecks() != 0 && !cpuRegs.branch)
+		intCheckMemcheck();
+
+	// Tracepoints only cost a flag test outside of trace runs
+	if (CTracepoints::IsActive() && !cpuRegs.branch)
+		CTracepoints::Collect(BREAKPOINT_EE, cpuRegs.pc);
+
 	u32 pc = cpuRegs.pc;
 	// We need to increase the pc before executing the memRead32. An exception could appears
 	// and it expects the PC counter to be pre-incremented
@@ -504,6 +513,12 @@ static void intEventTest()
 {
 	// Perform counters, ints, and IOP updates:
 	_cpuEventTest_Shared();
+
+	// the IOP stopped at a breakpoint, same as recEventTest
+	if (iopBreakpoint) {
+		iopBreakpoint = false;
+		throw Exception::ExitCpuExecute();
+	}
 }
 
 static void intExecute()
@@ -48,6 +48,7 @@ BIOS
 #include "SPU2/spu2.h"
 
 #include "Utilities/PageFaultSource.h"
+#include "System/SysThreads.h"
 
 #ifdef ENABLECACHE
 #include "Cache.h"
@@ -721,6 +722,9 @@ void eeMemoryReserve::Commit()
 {
 	_parent::Commit();
 	eeMem = (EEVM_MemoryAllocMess*)m_reserve.GetPtr();
+
+	// Before anything is mapped or loaded, the fastmem window needs eeMem in shared memory.
+	vtlb_FastmemAttach(eeMem, sizeof(*eeMem));
 }
 
 // Resets memory mappings, unmaps TLBs, reloads bios roms, etc.
@@ -854,6 +858,7 @@ void eeMemoryReserve::Reset()
 
 void eeMemoryReserve::Decommit()
 {
+	vtlb_FastmemDetach();
 	_parent::Decommit();
 	eeMem = NULL;
 }
@@ -884,6 +889,13 @@ eeMemoryReserve::~eeMemoryReserve()
 // back to protected], so that blocks which underwent a single invalidation don't need to
 // incur a permanent performance penalty.
 //
+// Mixed pages:
+// Where the platform can single-step the faulting instruction, a write fault doesn't drop
+// the protection of the page right away. Only the blocks overlapping the written bytes (at
+// a 64 byte granularity) are cleared, the write is let through and the page is protected
+// again after it. Pages that keep faulting anyway -- the fault count decays every few
+// vsyncs -- go to manual protection as described above, and stay there until they calm down.
+//
 // Page Granularity:
 // Fortunately for us MIPS and x86 use the same page granularity for TLB and memory
 // protection, so we can use a 1:1 correspondence when protecting pages.  Page granularity
@@ -901,9 +913,37 @@ struct vtlb_PageProtectionInfo
 	u32 ReverseRamMap;
 
 	vtlb_ProtectionMode Mode;
+
+	// Assigned each time the page goes under write protection. Since any write drops the
+	// protection again, an unchanged generation means the page wasn't written in between.
+	u32 Generation;
+
+	// Write faults taken by the page, halved every few vsyncs by mmap_DecayPageStats.
+	u16 Faults;
+
+	// 64 byte granules of the page that recompiled blocks were compiled from. Granules of
+	// blocks cleared some other way stay set, which costs an unneeded clear at worst.
+	u64 CodeMask;
 };
 
+static const uint PageGranuleShift = 6;
+
+// Write faults (after decay) at which a page is given up on and goes to manual protection
+static const u16 PageFaultLimit = 8;
+
 static __aligned16 vtlb_PageProtectionInfo m_PageProtectInfo[Ps2MemSize::MainRam >> 12];
+static u32 m_PageGenerationCounter = 0;
+static PageProtectionStats m_PageProtectStats;
+static PageProtectionStats m_PageProtectStatsLogged;
+
+// Granules of a page covered by [start,end), both offsets into the page
+static __fi u64 mmap_GranuleMask( uint start, uint end )
+{
+	const uint first = start >> PageGranuleShift;
+	const uint last = (end - 1) >> PageGranuleShift;
+	const u64 upto = (last == 63) ? ~0ULL : ((1ULL << (last + 1)) - 1);
+	return upto & ~((1ULL << first) - 1);
+}
 
 
 // returns:
@@ -927,11 +967,47 @@ vtlb_ProtectionMode mmap_GetRamPageInfo( u32 paddr )
 	return m_PageProtectInfo[rampage].Mode;
 }
 
+// returns:
+//  0 - page isn't write protected, its contents may change without notice
+//  Or the generation the page was given when it was last protected
+//
+// Lets the debugger tell that code it already looked at is unchanged without reading it.
+u32 mmap_GetRamPageGeneration( u32 paddr )
+{
+	if( !eeMem ) return 0;
+
+	paddr &= ~0xfff;
+
+	uptr ptr = (uptr)PSM( paddr );
+	uptr rampage = ptr - (uptr)eeMem->Main;
+
+	if (rampage >= Ps2MemSize::MainRam)
+		return 0;
+
+	const vtlb_PageProtectionInfo& info = m_PageProtectInfo[rampage >> 12];
+	return info.Mode == ProtMode_Write ? info.Generation : 0;
+}
+
+// True while the page still has recent write faults to its name. Manual pages shouldn't be
+// protected again before that, they'd only fault their way back.
+bool mmap_IsBusyRamPage( u32 paddr )
+{
+	pxAssert( eeMem );
+
+	uptr rampage = (uptr)PSM( paddr & ~0xfff ) - (uptr)eeMem->Main;
+	if (rampage >= Ps2MemSize::MainRam)
+		return false;
+
+	return m_PageProtectInfo[rampage >> 12].Faults != 0;
+}
+
 // paddr - physically mapped PS2 address
-void mmap_MarkCountedRamPage( u32 paddr )
+// size - bytes of code from paddr on that a block was compiled from (0 when re-protecting)
+void mmap_MarkCountedRamPage( u32 paddr, u32 size )
 {
 	pxAssert( eeMem );
-	
+
+	const uint inpage = paddr & 0xfff;
 	paddr &= ~0xfff;
 
 	uptr ptr = (uptr)PSM( paddr );
@@ -942,6 +1018,9 @@ void mmap_MarkCountedRamPage( u32 paddr )
 
 	m_PageProtectInfo[rampage].ReverseRamMap = paddr;
 
+	if( size )
+		m_PageProtectInfo[rampage].CodeMask |= mmap_GranuleMask( inpage, std::min<uint>( inpage + size, 0x1000 ) );
+
 	if( m_PageProtectInfo[rampage].Mode == ProtMode_Write )
 		return;		// skip town if we're already protected.
 
@@ -950,8 +1029,12 @@ void mmap_MarkCountedRamPage( u32 paddr )
 		paddr>>12
 	);
 
+	// skip 0, it stands for an untracked page
+	if( ++m_PageGenerationCounter == 0 ) ++m_PageGenerationCounter;
+	m_PageProtectInfo[rampage].Generation = m_PageGenerationCounter;
 	m_PageProtectInfo[rampage].Mode = ProtMode_Write;
 	HostSys::MemProtect( &eeMem->Main[rampage<<12], __pagesize, PageAccess_ReadOnly() );
+	vtlb_FastmemProtect( rampage<<12, true );
 }
 
 // offset - offset of address relative to psM.
@@ -969,22 +1052,153 @@ static __fi void mmap_ClearCpuBlock( uint offset )
 		"Attempted to clear a block that is already under manual protection." );
 
 	HostSys::MemProtect( &eeMem->Main[rampage<<12], __pagesize, PageAccess_ReadWrite() );
+	vtlb_FastmemProtect( rampage<<12, false );
 	m_PageProtectInfo[rampage].Mode = ProtMode_Manual;
+	m_PageProtectInfo[rampage].CodeMask = 0;
 	Cpu->Clear( m_PageProtectInfo[rampage].ReverseRamMap, 0x400 );
+	m_PageProtectStats.PageClears++;
+}
+
+// Runs from the trap after a write let through by mmap_WriteFault
+static void mmap_ReprotectRamPage( uptr rampage )
+{
+	vtlb_PageProtectionInfo& info = m_PageProtectInfo[rampage];
+
+	// Reset or cleared in between
+	if( info.Mode != ProtMode_Write ) return;
+
+	if( ++m_PageGenerationCounter == 0 ) ++m_PageGenerationCounter;
+	info.Generation = m_PageGenerationCounter;
+	HostSys::MemProtect( &eeMem->Main[rampage<<12], __pagesize, PageAccess_ReadOnly() );
+	vtlb_FastmemProtect( rampage<<12, true );
+	m_PageProtectStats.Reprotects++;
+}
+
+// offset - offset of the written address relative to psM.
+// Clears the blocks overlapping the written bytes and lets the write through, with the page
+// protected again right after it when other code remains in there. Pages that fault too
+// often go to manual protection instead.
+// Only the EE thread gets that treatment: while the page is open for its write, writes from
+// the other threads (IPC, debugger...) would go through without clearing anything.
+static void mmap_WriteFault( uint offset )
+{
+	const uint rampage = offset >> 12;
+	vtlb_PageProtectionInfo& info = m_PageProtectInfo[rampage];
+
+	m_PageProtectStats.Faults++;
+	if( info.Faults < 0xffff ) info.Faults++;
+
+	if( info.Faults > PageFaultLimit || !Source_PageFault->CanStep() || !GetCoreThread().IsSelf() )
+	{
+		mmap_ClearCpuBlock( offset );
+		return;
+	}
+
+	// Only the faulting address is known, assume the widest access (a 64 byte host store,
+	// memcpy may well use those).
+	const uint start = offset & 0xfff;
+	const uint end = std::min<uint>( start + 64, 0x1000 );
+	const u64 written = mmap_GranuleMask( start, end );
+
+	if( info.CodeMask & written )
+	{
+		const uint first = start & ~((1 << PageGranuleShift) - 1);
+		const uint last = (end + (1 << PageGranuleShift) - 1) & ~((1 << PageGranuleShift) - 1);
+		info.CodeMask &= ~written;
+		Cpu->Clear( info.ReverseRamMap + first, (last - first) / 4 );
+		m_PageProtectStats.PartialClears++;
+	}
+	else
+		m_PageProtectStats.DataFaults++;
+
+	// Nothing left to protect, the next block compiled from here protects it again
+	if( !info.CodeMask )
+	{
+		info.Mode = ProtMode_None;
+		HostSys::MemProtect( &eeMem->Main[rampage<<12], __pagesize, PageAccess_ReadWrite() );
+		vtlb_FastmemProtect( rampage<<12, false );
+		m_PageProtectStats.Released++;
+		return;
+	}
+
+	// The page can't stay unprotected any longer than the write
+	if( !Source_PageFault->StepThen( mmap_ReprotectRamPage, rampage ) )
+	{
+		mmap_ClearCpuBlock( offset );
+		return;
+	}
+
+	HostSys::MemProtect( &eeMem->Main[rampage<<12], __pagesize, PageAccess_ReadWrite() );
+	vtlb_FastmemProtect( rampage<<12, false );
+}
+
+// Faults in the fastmem window come from recompiled code: either a write to an alias of a
+// protected ram page, or an access to a page the window doesn't map (hardware registers,
+// TLB misses...). The latter gets patched to use the vtlb lookup from now on.
+static void mmap_FastmemFault( const PageFaultInfo& info, bool& handled )
+{
+	const u32 vaddr = (u32)(info.addr - (uptr)vtlb_GetFastmemBase());
+
+	const u32 offset = vtlb_FastmemGetOffset( vaddr );
+	if( offset < Ps2MemSize::MainRam && m_PageProtectInfo[offset >> 12].Mode == ProtMode_Write )
+	{
+		mmap_WriteFault( offset );
+		handled = true;
+		return;
+	}
+
+	if( !info.pc ) return;
+
+	const uptr resume = vtlb_BackpatchFastmem( info.pc );
+	if( !resume ) return;
+
+	Source_PageFault->ResumeAt( resume );
+	handled = true;
 }
 
 void mmap_PageFaultHandler::OnPageFaultEvent( const PageFaultInfo& info, bool& handled )
 {
 	pxAssert( eeMem );
 
+	if( u8* fastmem = vtlb_GetFastmemBase() )
+	{
+		if( info.addr - (uptr)fastmem < (uptr)_4gb )
+		{
+			mmap_FastmemFault( info, handled );
+			return;
+		}
+	}
+
 	// get bad virtual address
 	uptr offset = info.addr - (uptr)eeMem->Main;
 	if( offset >= Ps2MemSize::MainRam ) return;
 
-	mmap_ClearCpuBlock( offset );
+	mmap_WriteFault( offset );
 	handled = true;
 }
 
+// Called every few vsyncs: ages the fault counts, and reports the protection activity since
+// the last call to the perf log.
+void mmap_DecayPageStats()
+{
+	for( uint i = 0; i < ArraySize(m_PageProtectInfo); ++i )
+		m_PageProtectInfo[i].Faults >>= 1;
+
+	const PageProtectionStats& now = m_PageProtectStats;
+	PageProtectionStats& last = m_PageProtectStatsLogged;
+	if( now.Faults == last.Faults ) return;
+
+	eeRecPerfLog.Write( "Page protection: %llu faults (%llu data, %llu partial clears, %llu reprotected, %llu released), %llu pages to manual",
+		now.Faults - last.Faults, now.DataFaults - last.DataFaults, now.PartialClears - last.PartialClears,
+		now.Reprotects - last.Reprotects, now.Released - last.Released, now.PageClears - last.PageClears );
+	last = now;
+}
+
+void mmap_GetPageProtectionStats( PageProtectionStats& stats )
+{
+	stats = m_PageProtectStats;
+}
+
 // Clears all block tracking statuses, manual protection flags, and write protection.
 // This does not clear any recompiler blocks.  It is assumed (and necessary) for the caller
 // to ensure the EErec is also reset in conjunction with calling this function.
@@ -994,4 +1208,5 @@ void mmap_ResetBlockTracking()
 	//DbgCon.WriteLn( "vtlb/mmap: Block Tracking reset..." );
 	memzero( m_PageProtectInfo );
 	if (eeMem) HostSys::MemProtect( eeMem->Main, Ps2MemSize::MainRam, PageAccess_ReadWrite() );
+	vtlb_FastmemUnprotectAll();
 }
@@ -124,9 +124,24 @@ enum vtlb_ProtectionMode
 	ProtMode_NotRequired	// page doesn't require any protection
 };
 
+// Activity of the write protection of recompiled code, counted since startup
+struct PageProtectionStats
+{
+	u64 Faults;				// writes to protected pages
+	u64 DataFaults;			// ...that missed the code in the page, nothing was cleared
+	u64 PartialClears;		// ...that cleared the blocks of the written bytes only
+	u64 Reprotects;			// pages protected again right after the write
+	u64 Released;			// pages left unprotected since the writes cleared all of their code
+	u64 PageClears;			// pages that went to manual protection, with all of their blocks
+};
+
 extern vtlb_ProtectionMode mmap_GetRamPageInfo( u32 paddr );
-extern void mmap_MarkCountedRamPage( u32 paddr );
+extern bool mmap_IsBusyRamPage( u32 paddr );
+extern void mmap_MarkCountedRamPage( u32 paddr, u32 size );
+extern u32 mmap_GetRamPageGeneration( u32 paddr );
 extern void mmap_ResetBlockTracking();
+extern void mmap_DecayPageStats();
+extern void mmap_GetPageProtectionStats( PageProtectionStats& stats );
 
 #define memRead8 vtlb_memRead<mem8_t>
 #define memRead16 vtlb_memRead<mem16_t>
@@ -116,6 +116,11 @@ Pcsx2Config::RecompilerOptions::RecompilerOptions()
 
 	EnableEE	= true;
 	EnableEECache = false;
+	EnableFastmem = false;
+	EnableEEBlockCache = false;
+	EnableEESuperblocks = false;
+	EnableEETiering = false;
+	EnableWriteFaultStep = false;
 	EnableIOP	= true;
 	EnableVU0	= true;
 	EnableVU1	= true;
@@ -171,6 +176,11 @@ void Pcsx2Config::RecompilerOptions::LoadSave( IniInterface& ini )
 	IniBitBool( EnableEE );
 	IniBitBool( EnableIOP );
 	IniBitBool( EnableEECache );
+	IniBitBool( EnableFastmem );
+	IniBitBool( EnableEEBlockCache );
+	IniBitBool( EnableEESuperblocks );
+	IniBitBool( EnableEETiering );
+	IniBitBool( EnableWriteFaultStep );
 	IniBitBool( EnableVU0 );
 	IniBitBool( EnableVU1 );
 
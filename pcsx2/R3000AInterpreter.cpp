@@ -20,6 +20,8 @@
 
 #include "R5900OpcodeTables.h"
 #include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/Tracepoints.h"
+#include "../DebugTools/ReverseExecution.h"
 
 using namespace R3000A;
 
@@ -126,6 +128,9 @@ void psxJALR()
 	doBranch(_u32(_rRs_));
 }
 
+// Set when a breakpoint stopped intExecuteBlock before the instruction at psxRegs.pc
+static bool intBreakpointHit = false;
+
 void psxBreakpoint(bool memcheck)
 {
 	u32 pc = psxRegs.pc;
@@ -139,9 +144,17 @@ void psxBreakpoint(bool memcheck)
 			return;
 	}
 
-	CBreakPoints::SetBreakpointTriggered(true);
+	if (!CReverseExecution::BreakpointHit(BREAKPOINT_IOP, pc))
+		return;
+
+	CBreakPoints::SetBreakpointTriggered(true, BREAKPOINT_IOP);
 	GetCoreThread().PauseSelfDebug();
-	throw Exception::ExitCpuExecute();
+
+	// Leave through the end of intExecuteBlock like the recompiler leaves through its block
+	// exit, the EE event test stops the EE. This runs from inside the EE recompiler's event
+	// test, an exception would have to unwind through its code.
+	iopBreakpoint = true;
+	intBreakpointHit = true;
 }
 
 void psxMemcheck(u32 op, u32 bits, bool store)
@@ -153,26 +166,15 @@ void psxMemcheck(u32 op, u32 bits, bool store)
 	if (bits == 128)
 		start &= ~0x0F;
 
-	start = standardizeBreakpointAddress(BREAKPOINT_IOP, start);
-	u32 end = start + bits / 8;
+	// the page table rules out nearly every access before the ranges are looked at
+	if (!(memCheckPages[start >> MEMCHECK_PAGE_BITS] & memCheckPageMask(BREAKPOINT_IOP, store)))
+		return;
 
-	auto checks = CBreakPoints::GetMemChecks();
-	for (size_t i = 0; i < checks.size(); i++)
-	{
-		auto& check = checks[i];
-
-		if (check.cpu != BREAKPOINT_IOP)
-			continue;
-		if (check.result == 0)
-			continue;
-		if ((check.cond & MEMCHECK_WRITE) == 0 && store)
-			continue;
-		if ((check.cond & MEMCHECK_READ) == 0 && !store)
-			continue;
-
-		if (start < check.end && check.start < end)
-			psxBreakpoint(true);
-	}
+	u32 result = CBreakPoints::CheckMemAccess(BREAKPOINT_IOP, start, bits / 8, store);
+	if (result & MEMCHECK_LOG)
+		DevCon.WriteLn("Hit %s breakpoint @0x%x", store ? "store" : "load", start);
+	if (result & MEMCHECK_BREAK)
+		psxBreakpoint(true);
 }
 
 void psxCheckMemcheck()
@@ -218,10 +220,19 @@ static __fi void execI()
 #ifdef EXTRA_DEBUG
 	if (psxIsBreakpointNeeded(psxRegs.pc))
 		psxBreakpoint(false);
-
-	psxCheckMemcheck();
 #endif
 
+	// Memchecks cost a single compare until one is set. Delay slot accesses are
+	// checked along with their branch, same as the recompiler.
+	if (CBreakPoints::GetNumMemchecks() != 0 && !iopIsDelaySlot)
+		psxCheckMemcheck();
+
+	if (intBreakpointHit)
+		return;
+
+	if (CTracepoints::IsActive() && !iopIsDelaySlot)
+		CTracepoints::Collect(BREAKPOINT_IOP, psxRegs.pc);
+
 	// Inject IRX hack
 	if (psxRegs.pc == 0x1630 && g_Conf->CurrentIRX.Length() > 3) {
 		if (iopMemRead32(0x20018) == 0x1F) {
@@ -278,13 +289,14 @@ static s32 intExecuteBlock( s32 eeCycles )
 {
 	iopBreak = 0;
 	iopCycleEE = eeCycles;
+	intBreakpointHit = false;
 
-	while (iopCycleEE > 0){
+	while (iopCycleEE > 0 && !intBreakpointHit){
 		if ((psxHu32(HW_ICFG) & 8) && ((psxRegs.pc & 0x1fffffffU) == 0xa0 || (psxRegs.pc & 0x1fffffffU) == 0xb0 || (psxRegs.pc & 0x1fffffffU) == 0xc0))
 			psxBiosCall();
 
 		branch2 = 0;
-		while (!branch2) {
+		while (!branch2 && !intBreakpointHit) {
 			execI();
         }
 	}
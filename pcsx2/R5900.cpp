@@ -37,6 +37,7 @@
 #include "GameDatabase.h"
 
 #include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/SamplingProfiler.h"
 #include "R5900OpcodeTables.h"
 
 using namespace R5900;	// for R5900 disasm tools
@@ -370,6 +371,9 @@ __fi void _cpuEventTest_Shared()
 	ScopedBool etest(eeEventTestIsActive);
 	g_nextEventCycle = cpuRegs.cycle + eeWaitCycles;
 
+	// eeWaitCycles keeps the event tests frequent enough for any sampling rate
+	CSamplingProfiler::EventTest(cpuRegs.cycle);
+
 	// ---- INTC / DMAC (CPU-level Exceptions) -----------------
 	// Done first because exceptions raised during event tests need to be postponed a few
 	// cycles (fixes Grandia II [PAL], which does a spin loop on a vsync and expects to
@@ -400,6 +400,11 @@ extern R5900cpu *Cpu;
 extern R5900cpu intCpu;
 extern R5900cpu recCpu;
 
+// Persistent EE block cache of the recompiler, see iR5900BlockCache.cpp. Opening a file
+// saves the blocks collected for the previous one.
+extern void recBlockCacheOpen(const wxString& filename);
+extern void recBlockCacheClose();
+
 enum EE_EventType
 {
 	DMAC_VIF0	= 0,
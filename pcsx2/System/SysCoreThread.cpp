@@ -38,6 +38,9 @@
 
 #include "../DebugTools/MIPSAnalyst.h"
 #include "../DebugTools/SymbolMap.h"
+#include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/DebugControl.h"
+#include "../DebugTools/ReverseExecution.h"
 
 #include "Utilities/PageFaultSource.h"
 #include "Utilities/Threading.h"
@@ -68,6 +71,7 @@ SysCoreThread::SysCoreThread()
 	m_resetProfilers = true;
 	m_resetVsyncTimers = true;
 	m_resetVirtualMachine = true;
+	m_debugPause = false;
 
 	m_hasActiveMachine = false;
 }
@@ -98,6 +102,7 @@ bool SysCoreThread::Cancel(const wxTimeSpan& span)
 void SysCoreThread::OnStart()
 {
 	_parent::OnStart();
+	CDebugControl::CoreStarted();
 }
 
 void SysCoreThread::Start()
@@ -128,6 +133,22 @@ void SysCoreThread::OnResumeReady()
 
 	if (!m_hasActiveMachine)
 		m_resetRecompilers = true;
+
+	CpuStateNotifier::Signal(false);
+}
+
+// A pending reset has to go through the full Resume()
+bool SysCoreThread::ResumeDebug()
+{
+	if (m_resetVirtualMachine || !m_hasActiveMachine)
+		return false;
+
+	return _parent::ResumeDebug();
+}
+
+void SysCoreThread::OnResumeDebug()
+{
+	CpuStateNotifier::Signal(false);
 }
 
 // This function *will* reset the emulator in order to allow the specified elf file to
@@ -151,6 +172,7 @@ void SysCoreThread::ResetQuick()
 	m_resetVirtualMachine = true;
 	m_hasActiveMachine = false;
 	R3000A::ioman::reset();
+	CReverseExecution::Clear();
 }
 
 void SysCoreThread::Reset()
@@ -190,6 +212,7 @@ void SysCoreThread::UploadStateCopy(const VmStateBuffer& copy)
 	memLoadingState loadme(copy);
 	loadme.FreezeAll();
 	m_resetVirtualMachine = false;
+	CReverseExecution::Clear();
 }
 
 // --------------------------------------------------------------------------------------
@@ -198,7 +221,7 @@ void SysCoreThread::UploadStateCopy(const VmStateBuffer& copy)
 // --------------------------------------------------------------------------------------
 bool SysCoreThread::HasPendingStateChangeRequest() const
 {
-	return !m_hasActiveMachine || GetMTGS().HasPendingException() || _parent::HasPendingStateChangeRequest();
+	return !m_hasActiveMachine || GetMTGS().HasPendingException() || CReverseExecution::ExitRequested() || _parent::HasPendingStateChangeRequest();
 }
 
 void SysCoreThread::_reset_stuff_as_needed()
@@ -213,6 +236,7 @@ void SysCoreThread::_reset_stuff_as_needed()
 	{
 		SysClearExecutionCache();
 		memBindConditionalHandlers();
+		pxEnableSingleStep(EmuConfig.Cpu.Recompiler.EnableWriteFaultStep);
 		SetCPUState(EmuConfig.Cpu.sseMXCSR, EmuConfig.Cpu.sseVUMXCSR);
 
 		m_resetRecompilers = false;
@@ -257,13 +281,36 @@ void SysCoreThread::VsyncInThread()
 {
 	ApplyLoadedPatches(PPT_CONTINUOUSLY);
 	ApplyLoadedPatches(PPT_COMBINED_0_1);
+	CReverseExecution::VsyncInThread();
+}
+
+void SysCoreThread::VsyncEndInThread()
+{
+	if (m_IpcState == ON)
+		m_socketIpc->VsyncEnd(g_FrameCount);
 }
 
 void SysCoreThread::GameStartingInThread()
 {
 	GetMTGS().SendGameCRC(ElfCRC);
 
-	MIPSAnalyst::ScanForFunctions(ElfTextRange.first, ElfTextRange.first + ElfTextRange.second, true);
+	// the analysis is kept per ELF, so the debugger is ready right away next time
+	wxString analysisCache;
+	wxString blockCache;
+	if (ElfCRC != 0)
+	{
+		wxDirName cacheFolder(PathDefs::GetCache());
+		if (cacheFolder.Mkdir())
+		{
+			analysisCache = (cacheFolder + pxsFmt(L"%08X.functions", ElfCRC)).GetFullPath();
+			blockCache = (cacheFolder + pxsFmt(L"%08X.eeblocks", ElfCRC)).GetFullPath();
+		}
+	}
+
+	// same for the recompiled blocks
+	recBlockCacheOpen(blockCache);
+
+	MIPSAnalyst::ScanForFunctions(ElfTextRange.first, ElfTextRange.first + ElfTextRange.second, true, analysisCache);
 	symbolMap.UpdateActiveSymbols();
 	sApp.PostAppMethod(&Pcsx2App::resetDebugger);
 
@@ -284,6 +331,7 @@ void SysCoreThread::GameStartingInThread()
 bool SysCoreThread::StateCheckInThread()
 {
 	GetMTGS().RethrowException();
+	CReverseExecution::StateCheckInThread();
 	return _parent::StateCheckInThread() && (_reset_stuff_as_needed(), true);
 }
 
@@ -317,6 +365,7 @@ void SysCoreThread::ExecuteTaskInThread()
 
 void SysCoreThread::OnSuspendInThread()
 {
+	CpuStateNotifier::Signal(true);
 	GetCorePlugins().Close();
 	DEV9close();
 	USBclose();
@@ -326,6 +375,24 @@ void SysCoreThread::OnSuspendInThread()
 	SPU2close();
 }
 
+// Runs on the thread requesting the pause, before the core thread actually stopped
+void SysCoreThread::OnPauseDebug()
+{
+	m_debugPause = true;
+}
+
+// Covers breakpoints as well, they pause through PauseSelfDebug()
+void SysCoreThread::OnPauseInThread()
+{
+	if (m_debugPause.exchange(false))
+	{
+		CDebugControl::CoreStopped();
+		OnPauseDebugInThread();
+	}
+
+	CpuStateNotifier::Signal(true);
+}
+
 void SysCoreThread::OnResumeInThread(bool isSuspended)
 {
 	GetCorePlugins().Open();
@@ -347,6 +414,9 @@ void SysCoreThread::OnCleanupInThread()
 
 	m_hasActiveMachine = false;
 	m_resetVirtualMachine = true;
+	CpuStateNotifier::Signal(true);
+
+	recBlockCacheClose();
 
 	R3000A::ioman::reset();
 	// FIXME: temporary workaround for deadlock on exit, which actually should be a crash
@@ -193,6 +193,22 @@ void SysThreadBase::PauseSelfDebug()
 	}
 }
 
+bool SysThreadBase::ResumeDebug()
+{
+	if (IsSelf() || !IsRunning())
+		return false;
+
+	ScopedLock locker(m_ExecModeMutex);
+
+	if (m_ExecMode != ExecMode_Paused)
+		return false;
+
+	OnResumeDebug();
+	m_ExecMode = ExecMode_Opened;
+	m_sem_Resume.Post();
+	return true;
+}
+
 // Resumes the core execution state, or does nothing is the core is already running.  If
 // settings were changed, resets will be performed as needed and emulation state resumed from
 // memory savestates.
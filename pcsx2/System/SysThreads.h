@@ -117,6 +117,11 @@ public:
 	virtual void PauseSelf();
 	virtual void PauseSelfDebug();
 
+	// Continues a thread that is merely paused, without the checks and settings a full
+	// Resume() applies on its way, so any thread can use it directly. Returns false when
+	// the thread isn't paused or needs a full Resume().
+	virtual bool ResumeDebug();
+
 protected:
 	virtual void OnStart();
 
@@ -126,6 +131,7 @@ protected:
 	virtual void OnResumeReady() {}
 	virtual void OnPause() {}
 	virtual void OnPauseDebug() {}
+	virtual void OnResumeDebug() {}
 
 	virtual bool StateCheckInThread();
 	virtual void OnCleanupInThread();
@@ -171,6 +177,10 @@ protected:
 	bool m_resetVsyncTimers;
 	bool m_resetVirtualMachine;
 
+	// Set when the pause in progress was requested by the debugger, which has some
+	// bookkeeping to do once the thread actually stopped.
+	std::atomic<bool> m_debugPause;
+
 	// Stores the state of the socket IPC thread.
 	std::unique_ptr<SocketIPC> m_socketIpc;
 
@@ -199,6 +209,7 @@ public:
 	bool HasPendingStateChangeRequest() const;
 
 	virtual void OnResumeReady();
+	virtual bool ResumeDebug();
 	virtual void Reset();
 	virtual void ResetQuick();
 	virtual void Cancel(bool isBlocking = true);
@@ -206,6 +217,7 @@ public:
 
 	virtual bool StateCheckInThread();
 	virtual void VsyncInThread();
+	virtual void VsyncEndInThread();
 	virtual void GameStartingInThread();
 
 	virtual void ApplySettings(const Pcsx2Config& src);
@@ -221,8 +233,12 @@ protected:
 
 	virtual void Start();
 	virtual void OnStart();
+	virtual void OnPauseDebug();
+	virtual void OnResumeDebug();
 	virtual void OnSuspendInThread();
-	virtual void OnPauseInThread() {}
+	virtual void OnPauseInThread();
+	// after a debug pause took effect, once CDebugControl is done with it
+	virtual void OnPauseDebugInThread() {}
 	virtual void OnResumeInThread(bool IsSuspended);
 	virtual void OnCleanupInThread();
 	virtual void ExecuteTaskInThread();
@@ -596,6 +596,7 @@ public:
 	void enterDebugMode();
 	void leaveDebugMode();
 	void resetDebugger();
+	void updateDebugger();
 
 	bool HasMainFrame() const { return GetMainFramePtr() != NULL; }
 
@@ -108,6 +108,12 @@ namespace PathDefs
 			static const wxDirName retval( L"docs" );
 			return retval;
 		}
+
+		const wxDirName& Cache()
+		{
+			static const wxDirName retval( L"cache" );
+			return retval;
+		}
 	};
 
 	// Specifies the root folder for the application install.
@@ -211,6 +217,12 @@ namespace PathDefs
 		return AppRoot() + Base::Docs();
 	}
 
+	// data PCSX2 can recreate at any time, not user configurable
+	wxDirName GetCache()
+	{
+		return GetDocuments() + Base::Cache();
+	}
+
 	wxDirName GetSavestates()
 	{
 		return GetDocuments() + Base::Savestates();
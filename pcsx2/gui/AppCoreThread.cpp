@@ -22,6 +22,7 @@
 #include "fmt/core.h"
 
 #include "Debugger/DisassemblyDialog.h"
+#include "DebugTools/ReverseExecution.h"
 
 #include "Utilities/Threading.h"
 
@@ -249,10 +250,20 @@ void AppCoreThread::OnPause()
 	_parent::OnPause();
 }
 
-void AppCoreThread::OnPauseDebug()
+void AppCoreThread::OnPauseDebugInThread()
 {
-	sApp.PostAppMethod(&Pcsx2App::enterDebugMode);
-	_parent::OnPause();
+	// posted from here so the window sees why the core stopped, the stops of a reverse
+	// execution replay aren't shown
+	if (!CReverseExecution::IsScanning())
+		sApp.PostAppMethod(&Pcsx2App::enterDebugMode);
+	_parent::OnPauseDebugInThread();
+}
+
+void AppCoreThread::OnResumeDebug()
+{
+	if (!CReverseExecution::IsScanning())
+		sApp.PostAppMethod(&Pcsx2App::leaveDebugMode);
+	_parent::OnResumeDebug();
 }
 
 // Load Game Settings found in database
@@ -159,7 +159,8 @@ protected:
 
 	virtual void OnResumeReady();
 	virtual void OnPause();
-	virtual void OnPauseDebug();
+	virtual void OnPauseDebugInThread();
+	virtual void OnResumeDebug();
 	virtual void OnResumeInThread(bool IsSuspended);
 	virtual void OnSuspendInThread();
 	virtual void OnCleanupInThread();
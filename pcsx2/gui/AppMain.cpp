@@ -35,6 +35,7 @@
 #include "Dialogs/LogOptionsDialog.h"
 
 #include "Debugger/DisassemblyDialog.h"
+#include "DebugTools/DwarfInfo.h"
 
 #ifndef DISABLE_RECORDING
 #	include "Recording/InputRecordingControls.h"
@@ -842,6 +843,13 @@ void Pcsx2App::resetDebugger()
 		dlg->reset();
 }
 
+void Pcsx2App::updateDebugger()
+{
+	DisassemblyDialog* dlg = GetDisassemblyPtr();
+	if (dlg)
+		dlg->update();
+}
+
 // NOTE: Plugins are *not* applied by this function.  Changes to plugins need to handled
 // manually.  The PluginSelectorPanel does this, for example.
 void AppApplySettings( const AppConfig* oldconf )
@@ -1151,6 +1159,7 @@ protected:
 		DbgCon.WriteLn( Color_Gray, "(SysExecute) received." );
 
 		CoreThread.ResetQuick();
+		CDwarfInfo::Clear();
 		symbolMap.Clear();
 		CBreakPoints::SetSkipFirst(BREAKPOINT_EE, 0);
 		CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, 0);
@@ -18,6 +18,7 @@
 #include "DebugTools/Breakpoints.h"
 #include "DebugTools/Debug.h"
 #include "DebugTools/MipsAssembler.h"
+#include "DebugTools/DwarfInfo.h"
 
 #include "DebugEvents.h"
 #include "BreakpointWindow.h"
@@ -1070,6 +1071,15 @@ void CtrlDisassemblyView::updateStatusBarText()
 		}
 	}
 
+	// source position from the game's debug info, the IOP modules don't have any
+	std::string sourceFile;
+	u32 sourceLine;
+	if (cpu->getCpuType() == BREAKPOINT_EE && CDwarfInfo::GetSourceLine(curAddress,sourceFile,sourceLine))
+	{
+		size_t length = strlen(text);
+		snprintf(text+length,sizeof(text)-length,"%s%s:%u",length != 0 ? "    " : "",sourceFile.c_str(),sourceLine);
+	}
+
 	postEvent(debEVT_SETSTATUSBARTEXT,wxString(text,wxConvUTF8));
 }
 
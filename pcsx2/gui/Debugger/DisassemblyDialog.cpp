@@ -21,11 +21,11 @@
 #include "DebugTools/DebugInterface.h"
 #include "DebugTools/DisassemblyManager.h"
 #include "DebugTools/Breakpoints.h"
+#include "DebugTools/DebugControl.h"
 #include "DebugTools/MipsStackWalk.h"
 #include "BreakpointWindow.h"
 #include "PathDefs.h"
 #include "wx/busyinfo.h"
-#include "DebugTools/gdb/PCSX2Interface.h"
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -268,7 +268,7 @@ DisassemblyDialog::DisassemblyDialog(wxWindow* parent):
 	Bind(wxEVT_BUTTON, &DisassemblyDialog::onBreakpointClicked, this, breakpointButton->GetId());
 	topRowSizer->Add(breakpointButton);
 
-	gdbButton = new wxButton(panel, wxID_ANY, L"Enable GDB");
+	gdbButton = new wxButton(panel, wxID_ANY, CDebugControl::IsGdbServerRunning() ? L"Disable GDB" : L"Enable GDB");
 	Bind(wxEVT_BUTTON, &DisassemblyDialog::onToggleGDB, this, gdbButton->GetId());
 	topRowSizer->Add(gdbButton);
 
@@ -298,9 +298,6 @@ DisassemblyDialog::DisassemblyDialog(wxWindow* parent):
 		SetSize(width,height);
 
 	setDebugMode(true,true);
-
-	// Not sure when all the stuff allocated here gets deallocated, so I just won't explicitly deallocate this!
-	gdbInterface = new GDB::PCSX2Interface(this);
 }
 
 void DisassemblyDialog::onSizeEvent(wxSizeEvent& event)
@@ -361,113 +358,56 @@ void DisassemblyDialog::onPageChanging(wxCommandEvent& evt)
 }
 
 void DisassemblyDialog::pauseExecution() {
-	if (!r5900Debug.isCpuPaused()) r5900Debug.pauseCpu();
+	CDebugControl::Pause();
 	gotoPc();
 }
 
 void DisassemblyDialog::resumeExecution() {
-	if (r5900Debug.isCpuPaused()) {
-		// If the current PC is on a breakpoint, the user doesn't want to do nothing.
-		CBreakPoints::SetSkipFirst(BREAKPOINT_EE, r5900Debug.getPC());
-		CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, r3000Debug.getPC());
-		r5900Debug.resumeCpu();
-	}
+	CDebugControl::Resume();
 }
 
 void DisassemblyDialog::stepOver()
 {
-	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused() || currentCpu == NULL)
+	if (currentCpu == NULL)
 		return;
 	DebugInterface *debug = currentCpu->getCpu();
-
 	CtrlDisassemblyView* disassembly = currentCpu->getDisassembly();
 
-	// If the current PC is on a breakpoint, the user doesn't want to do nothing.
-	CBreakPoints::SetSkipFirst(debug->getCpuType(), debug->getPC());
 	u32 currentPc = debug->getPC();
+	u32 size = disassembly->getInstructionSizeAt(currentPc);
+	u32 breakpointAddress = CDebugControl::StepOver(debug->getCpuType(), size);
 
-	MIPSAnalyst::MipsOpcodeInfo info = MIPSAnalyst::GetOpcodeInfo(debug,debug->getPC());
-	u32 breakpointAddress = currentPc+disassembly->getInstructionSizeAt(currentPc);
-	if (info.isBranch)
-	{
-		if (!info.isConditional)
-		{
-			if (info.isLinkedBranch)	// jal, jalr
-			{
-				// it's a function call with a delay slot - skip that too
-				breakpointAddress += 4;
-			} else {					// j, ...
-				// in case of absolute branches, set the breakpoint at the branch target
-				breakpointAddress = info.branchTarget;
-			}
-		} else {						// beq, ...
-			if (info.conditionMet)
-			{
-				breakpointAddress = info.branchTarget;
-			} else {
-				breakpointAddress = currentPc+2*4;
-				disassembly->scrollStepping(breakpointAddress);
-			}
-		}
-	} else {
+	// keep following the code unless the step leaves the current spot
+	if (breakpointAddress == currentPc+size || breakpointAddress == currentPc+2*4)
 		disassembly->scrollStepping(breakpointAddress);
-	}
-
-	CBreakPoints::AddBreakPoint(debug->getCpuType(), breakpointAddress,true);
-	r5900Debug.resumeCpu();
 }
 
 void DisassemblyDialog::stepInto()
 {
-	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused() || currentCpu == NULL)
+	if (currentCpu == NULL)
 		return;
-	
 	DebugInterface *debug = currentCpu->getCpu();
 	CtrlDisassemblyView* disassembly = currentCpu->getDisassembly();
 
-	// If the current PC is on a breakpoint, the user doesn't want to do nothing.
-	CBreakPoints::SetSkipFirst(debug->getCpuType(), debug->getPC());
 	u32 currentPc = debug->getPC();
+	u32 size = disassembly->getInstructionSizeAt(currentPc);
+	u32 breakpointAddress = CDebugControl::StepInto(debug->getCpuType(), size);
 
-	MIPSAnalyst::MipsOpcodeInfo info = MIPSAnalyst::GetOpcodeInfo(debug,debug->getPC());
-	u32 breakpointAddress = currentPc+disassembly->getInstructionSizeAt(currentPc);
-	if (info.isBranch)
-	{
-		if (!info.isConditional)
-		{
-			breakpointAddress = info.branchTarget;
-		} else {
-			if (info.conditionMet)
-			{
-				breakpointAddress = info.branchTarget;
-			} else {
-				breakpointAddress = currentPc+2*4;
-				disassembly->scrollStepping(breakpointAddress);
-			}
-		}
-	}
-
-	if (info.isSyscall)
-		breakpointAddress = info.branchTarget;
-
-	CBreakPoints::AddBreakPoint(debug->getCpuType(), breakpointAddress,true);
-	r5900Debug.resumeCpu();
+	// a conditional branch that isn't taken
+	if (breakpointAddress == currentPc+2*4)
+		disassembly->scrollStepping(breakpointAddress);
 }
 
 void DisassemblyDialog::stepOut()
 {
-	if (!r5900Debug.isAlive() || !r5900Debug.isCpuPaused() || currentCpu == NULL)
+	if (currentCpu == NULL)
 		return;
-	DebugInterface *debug = currentCpu->getCpu();
-	// If the current PC is on a breakpoint, the user doesn't want to do nothing.
-	CBreakPoints::SetSkipFirst(debug->getCpuType(), debug->getPC());
 
 	u32 addr = currentCpu->getStepOutAddress();
 	if (addr == (u32)-1)
 		return;
 
-	CBreakPoints::AddBreakPoint(debug->getCpuType(), addr,true);
-	r5900Debug.resumeCpu();
+	CDebugControl::RunTo(currentCpu->getCpu()->getCpuType(), addr);
 }
 
 void DisassemblyDialog::onBreakpointClicked(wxCommandEvent& evt)
@@ -484,12 +424,11 @@ void DisassemblyDialog::onBreakpointClicked(wxCommandEvent& evt)
 }
 
 void DisassemblyDialog::onToggleGDB(wxCommandEvent& evt) {
-	if (gdbInterface->IsEnabled() || gdbInterface->IsListening()) {
-		if (gdbInterface->IsListening()) gdbInterface->StopListening();
-		else gdbInterface->Disable();
+	if (CDebugControl::IsGdbServerRunning()) {
+		CDebugControl::StopGdbServer();
 		gdbButton->SetLabel("Enable GDB");
 	} else {
-		gdbInterface->EnableInSeparateThread();
+		CDebugControl::StartGdbServer();
 		gdbButton->SetLabel("Disable GDB");
 	}
 }
@@ -648,29 +587,24 @@ void DisassemblyDialog::setDebugMode(bool debugMode, bool switchPC)
 
 		if (debugMode)
 		{
-				if (!CBreakPoints::GetBreakpointTriggered())
-				{
-					wxBusyInfo wait("Please wait, Reading ELF functions");
-					populate();
-				}
-			CBreakPoints::ClearTemporaryBreakPoints();
+			// the core already dropped the temporary breakpoints and reset the triggered state
+			bool breakpoint = CDebugControl::StoppedAtBreakpoint();
+			if (!breakpoint)
+			{
+				wxBusyInfo wait("Please wait, Reading ELF functions");
+				populate();
+			}
 			breakRunButton->SetLabel(L"Run");
 
 			stepOverButton->Enable(true);
 			stepIntoButton->Enable(true);
 			stepOutButton->Enable(currentCpu == eeTab);
 
-			if (switchPC || CBreakPoints::GetBreakpointTriggered())
+			if (switchPC || breakpoint)
 				gotoPc();
 			
-			if (CBreakPoints::GetBreakpointTriggered())
-			{
-				if (currentCpu != NULL)
-					currentCpu->getDisassembly()->SetFocus();
-				CBreakPoints::SetBreakpointTriggered(false);
-				CBreakPoints::SetSkipFirst(BREAKPOINT_EE, 0);
-				CBreakPoints::SetSkipFirst(BREAKPOINT_IOP, 0);
-			}
+			if (breakpoint && currentCpu != NULL)
+				currentCpu->getDisassembly()->SetFocus();
 
 			if (currentCpu != NULL)
 				currentCpu->loadCycles();
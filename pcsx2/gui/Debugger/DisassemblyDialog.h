@@ -78,10 +78,6 @@ private:
 	u32 symbolCount;
 };
 
-namespace GDB {
-	class PCSX2Interface;
-};
-
 class DisassemblyDialog : public wxFrame
 {
 public:
@@ -98,7 +94,6 @@ public:
 
 	wxDECLARE_EVENT_TABLE();
 protected:
-	friend class GDB::PCSX2Interface;
 	void onBreakRunClicked(wxCommandEvent& evt);
 	void onStepOverClicked(wxCommandEvent& evt);
 	void onStepIntoClicked(wxCommandEvent& evt);
@@ -124,5 +119,4 @@ private:
 
 	wxBoxSizer* topSizer;
 	wxButton *breakRunButton, *stepIntoButton, *stepOverButton, *stepOutButton, *breakpointButton, *gdbButton, *helpButton;
-	GDB::PCSX2Interface* gdbInterface;
 };
@@ -38,6 +38,10 @@
 
 #include "Utilities/MemsetFast.inl"
 
+#include <algorithm>
+#include <bitset>
+#include <vector>
+
 using namespace R5900;
 using namespace vtlb_private;
 
@@ -658,6 +662,217 @@ __fi u32 vtlb_V2P(u32 vaddr)
 	return paddr;
 }
 
+// --------------------------------------------------------------------------------------
+//  Fastmem
+// --------------------------------------------------------------------------------------
+// A 4GB host range mirroring the EE virtual address space, which lets the recompiler access
+// memory with a single base+address operation. eeMem lives in a shared memory object, and
+// every vmap entry pointing into it gets the same page mapped at its place in the window.
+// Everything else (hardware registers, unmapped pages, memory outside eeMem) stays
+// inaccessible and faults, the recompiler then patches the access to go through the vmap.
+// The aliases of write protected ram pages are read-only as well.
+
+#ifdef __M_X86_64
+static u8* s_fastmem_base = nullptr;
+static void* s_fastmem_handle = nullptr;
+static uptr s_fastmem_mem = 0;			// eeMem, while it is attached
+static size_t s_fastmem_size = 0;
+
+// page of the shared memory mapped at each virtual page plus one, 0 if none
+static std::vector<u32> s_fastmem_pages;
+
+static const uint FASTMEM_RAM_PAGES = Ps2MemSize::MainRam >> VTLB_PAGE_BITS;
+
+// window pages aliasing each page of main ram, and the ram pages that are write protected
+static std::vector<u32> s_fastmem_aliases[FASTMEM_RAM_PAGES];
+static std::bitset<FASTMEM_RAM_PAGES> s_fastmem_readonly;
+
+static bool vtlb_FastmemIsReadOnly(u32 page)
+{
+	return page && page - 1 < FASTMEM_RAM_PAGES && s_fastmem_readonly[page - 1];
+}
+
+static u32 vtlb_FastmemLookup(u32 vpage)
+{
+	const u32 vaddr = vpage << VTLB_PAGE_BITS;
+	const VTLBVirtual vmv = vtlbdata.vmap[vpage];
+	if (vmv.isHandler(vaddr))
+		return 0;
+
+	const uptr offset = vmv.assumePtr(vaddr) - s_fastmem_mem;
+	if (offset >= s_fastmem_size || (offset & VTLB_PAGE_MASK))
+		return 0;
+
+	return (u32)(offset >> VTLB_PAGE_BITS) + 1;
+}
+
+static void vtlb_FastmemSetPage(u32 vpage, u32 page)
+{
+	const u32 old = s_fastmem_pages[vpage];
+	if (old && old - 1 < FASTMEM_RAM_PAGES)
+	{
+		std::vector<u32>& aliases = s_fastmem_aliases[old - 1];
+		auto it = std::find(aliases.begin(), aliases.end(), vpage);
+		if (it != aliases.end())
+			aliases.erase(it);
+	}
+	if (page && page - 1 < FASTMEM_RAM_PAGES)
+		s_fastmem_aliases[page - 1].push_back(vpage);
+
+	s_fastmem_pages[vpage] = page;
+}
+
+static void vtlb_FastmemMapRun(u32 vpage, u32 count, u32 page)
+{
+	u8* addr = s_fastmem_base + ((uptr)vpage << VTLB_PAGE_BITS);
+	const size_t size = (size_t)count << VTLB_PAGE_BITS;
+
+	if (!page)
+	{
+		HostSys::UnmapSharedMemory(addr, size);
+		return;
+	}
+
+	const PageProtectionMode mode = vtlb_FastmemIsReadOnly(page) ? PageAccess_ReadOnly() : PageAccess_ReadWrite();
+	if (!HostSys::MapSharedMemory(s_fastmem_handle, (size_t)(page - 1) << VTLB_PAGE_BITS, addr, size, mode))
+	{
+		// Not fatal, the accesses will fault and take the slow path.
+		HostSys::UnmapSharedMemory(addr, size);
+		for (u32 i = 0; i < count; i++)
+			vtlb_FastmemSetPage(vpage + i, 0);
+	}
+}
+
+// Brings the window in line with the vmap for the given range, only the pages that changed
+// are remapped.
+static void vtlb_FastmemUpdate(u32 vaddr, u32 size)
+{
+	if (!s_fastmem_mem)
+		return;
+
+	u32 vpage = vaddr >> VTLB_PAGE_BITS;
+	const u32 end = vpage + (size >> VTLB_PAGE_BITS);
+
+	u32 runStart = 0, runCount = 0, runPage = 0;
+	for (; vpage < end; vpage++)
+	{
+		const u32 page = vtlb_FastmemLookup(vpage);
+		if (page == s_fastmem_pages[vpage])
+			continue;
+
+		vtlb_FastmemSetPage(vpage, page);
+
+		const bool contiguous = runCount && vpage == runStart + runCount &&
+			(runPage ? page == runPage + runCount && vtlb_FastmemIsReadOnly(page) == vtlb_FastmemIsReadOnly(runPage) : !page);
+		if (contiguous)
+		{
+			runCount++;
+			continue;
+		}
+
+		if (runCount)
+			vtlb_FastmemMapRun(runStart, runCount, runPage);
+		runStart = vpage;
+		runCount = 1;
+		runPage = page;
+	}
+
+	if (runCount)
+		vtlb_FastmemMapRun(runStart, runCount, runPage);
+}
+
+u8* vtlb_GetFastmemBase()
+{
+	return s_fastmem_mem ? s_fastmem_base : nullptr;
+}
+
+u32 vtlb_FastmemGetOffset(u32 vaddr)
+{
+	if (!s_fastmem_mem)
+		return (u32)-1;
+
+	const u32 page = s_fastmem_pages[vaddr >> VTLB_PAGE_BITS];
+	return page ? ((page - 1) << VTLB_PAGE_BITS) | (vaddr & VTLB_PAGE_MASK) : (u32)-1;
+}
+
+void vtlb_FastmemProtect(u32 offset, bool readonly)
+{
+	const u32 page = offset >> VTLB_PAGE_BITS;
+	if (!s_fastmem_mem || page >= FASTMEM_RAM_PAGES || s_fastmem_readonly[page] == readonly)
+		return;
+
+	s_fastmem_readonly[page] = readonly;
+	for (u32 vpage : s_fastmem_aliases[page])
+		HostSys::MemProtect(s_fastmem_base + ((uptr)vpage << VTLB_PAGE_BITS), VTLB_PAGE_SIZE,
+			readonly ? PageAccess_ReadOnly() : PageAccess_ReadWrite());
+}
+
+void vtlb_FastmemUnprotectAll()
+{
+	if (!s_fastmem_readonly.any())
+		return;
+
+	for (u32 page = 0; page < FASTMEM_RAM_PAGES; page++)
+		vtlb_FastmemProtect(page << VTLB_PAGE_BITS, false);
+}
+
+// Moves the memory at mem to a shared memory object so that its pages can be mirrored in the
+// window. Meant to be called right after committing it, the contents are lost.
+void vtlb_FastmemAttach(void* mem, size_t size)
+{
+	if (!s_fastmem_base || s_fastmem_mem == (uptr)mem)
+		return;
+
+	vtlb_FastmemDetach();
+
+	s_fastmem_handle = HostSys::CreateSharedMemory(size);
+	if (!s_fastmem_handle)
+	{
+		Console.Warning("(vtlb) Fastmem is unavailable, shared memory could not be created.");
+		return;
+	}
+
+	if (!HostSys::MapSharedMemory(s_fastmem_handle, 0, mem, size, PageAccess_ReadWrite()))
+	{
+		Console.Warning("(vtlb) Fastmem is unavailable, shared memory could not be mapped.");
+		HostSys::MmapResetPtr(mem, size);
+		HostSys::MmapCommitPtr(mem, size, PageAccess_ReadWrite());
+		HostSys::DestroySharedMemory(s_fastmem_handle);
+		s_fastmem_handle = nullptr;
+		return;
+	}
+
+	s_fastmem_mem = (uptr)mem;
+	s_fastmem_size = size;
+}
+
+void vtlb_FastmemDetach()
+{
+	if (!s_fastmem_mem)
+		return;
+
+	HostSys::UnmapSharedMemory(s_fastmem_base, _4gb);
+	std::fill(s_fastmem_pages.begin(), s_fastmem_pages.end(), 0);
+	for (std::vector<u32>& aliases : s_fastmem_aliases)
+		aliases.clear();
+	s_fastmem_readonly.reset();
+
+	// the memory itself stays mapped until its owner decommits it
+	HostSys::DestroySharedMemory(s_fastmem_handle);
+	s_fastmem_handle = nullptr;
+	s_fastmem_mem = 0;
+	s_fastmem_size = 0;
+}
+#else
+static void vtlb_FastmemUpdate(u32 vaddr, u32 size) {}
+u8* vtlb_GetFastmemBase() { return nullptr; }
+u32 vtlb_FastmemGetOffset(u32 vaddr) { return (u32)-1; }
+void vtlb_FastmemProtect(u32 offset, bool readonly) {}
+void vtlb_FastmemUnprotectAll() {}
+void vtlb_FastmemAttach(void* mem, size_t size) {}
+void vtlb_FastmemDetach() {}
+#endif
+
 //virtual mappings
 //TODO: Add invalid paddr checks
 void vtlb_VMap(u32 vaddr,u32 paddr,u32 size)
@@ -666,6 +881,8 @@ void vtlb_VMap(u32 vaddr,u32 paddr,u32 size)
 	verify(0==(paddr&VTLB_PAGE_MASK));
 	verify(0==(size&VTLB_PAGE_MASK) && size>0);
 
+	const u32 start = vaddr, total = size;
+
 	while (size > 0)
 	{
 		VTLBVirtual vmv;
@@ -688,6 +905,8 @@ void vtlb_VMap(u32 vaddr,u32 paddr,u32 size)
 		paddr += VTLB_PAGE_SIZE;
 		size -= VTLB_PAGE_SIZE;
 	}
+
+	vtlb_FastmemUpdate(start, total);
 }
 
 void vtlb_VMapBuffer(u32 vaddr,void* buffer,u32 size)
@@ -695,6 +914,8 @@ void vtlb_VMapBuffer(u32 vaddr,void* buffer,u32 size)
 	verify(0==(vaddr&VTLB_PAGE_MASK));
 	verify(0==(size&VTLB_PAGE_MASK) && size>0);
 
+	const u32 start = vaddr, total = size;
+
 	uptr bu8 = (uptr)buffer;
 	while (size > 0)
 	{
@@ -703,6 +924,8 @@ void vtlb_VMapBuffer(u32 vaddr,void* buffer,u32 size)
 		bu8 += VTLB_PAGE_SIZE;
 		size -= VTLB_PAGE_SIZE;
 	}
+
+	vtlb_FastmemUpdate(start, total);
 }
 
 void vtlb_VMapUnmap(u32 vaddr,u32 size)
@@ -710,6 +933,8 @@ void vtlb_VMapUnmap(u32 vaddr,u32 size)
 	verify(0==(vaddr&VTLB_PAGE_MASK));
 	verify(0==(size&VTLB_PAGE_MASK) && size>0);
 
+	const u32 start = vaddr, total = size;
+
 	while (size > 0)
 	{
 
@@ -724,6 +949,8 @@ void vtlb_VMapUnmap(u32 vaddr,u32 size)
 		vaddr += VTLB_PAGE_SIZE;
 		size -= VTLB_PAGE_SIZE;
 	}
+
+	vtlb_FastmemUpdate(start, total);
 }
 
 // vtlb_Init -- Clears vtlb handlers and memory mappings.
@@ -805,6 +1032,20 @@ void vtlb_Core_Alloc()
 			);
 		}
 	}
+
+#ifdef __M_X86_64
+	// Reserved once like the vmap, fastmem stays off if the host can't spare the range.
+	if (!s_fastmem_base)
+	{
+		// (mmap reports failures as -1)
+		void* window = HostSys::MmapReservePtr(nullptr, _4gb);
+		if (window && (sptr)window != -1)
+		{
+			s_fastmem_base = (u8*)window;
+			s_fastmem_pages.assign(VTLB_VMAP_ITEMS, 0);
+		}
+	}
+#endif
 }
 
 // The LUT is only used for 1 game so we allocate it only when the gamefix is enabled (save 4MB)
@@ -825,6 +1066,8 @@ void vtlb_Alloc_Ppmap()
 
 void vtlb_Core_Free()
 {
+	vtlb_FastmemDetach();
+
 	if (vtlbdata.vmap) {
 		HostSys::MmapResetPtr(vtlbdata.vmap, VMAP_SIZE);
 		vtlbdata.vmap = nullptr;
@@ -83,6 +83,15 @@ extern void vtlb_VMap(u32 vaddr,u32 paddr,u32 sz);
 extern void vtlb_VMapBuffer(u32 vaddr,void* buffer,u32 sz);
 extern void vtlb_VMapUnmap(u32 vaddr,u32 sz);
 
+// Fastmem window (x86-64 only), NULL when unavailable. The offsets are relative to the
+// memory attached to it (eeMem), vtlb_FastmemGetOffset returns -1 for inaccessible pages.
+extern u8*  vtlb_GetFastmemBase();
+extern u32  vtlb_FastmemGetOffset(u32 vaddr);
+extern void vtlb_FastmemProtect(u32 offset, bool readonly);
+extern void vtlb_FastmemUnprotectAll();
+extern void vtlb_FastmemAttach(void* mem, size_t size);
+extern void vtlb_FastmemDetach();
+
 //Memory functions
 
 template< typename DataType >
@@ -103,6 +112,12 @@ extern void vtlb_DynGenWrite_Const( u32 bits, u32 addr_const );
 extern void vtlb_DynGenRead64_Const( u32 bits, u32 addr_const );
 extern void vtlb_DynGenRead32_Const( u32 bits, bool sign, u32 addr_const );
 
+extern void vtlb_DynGenFastmemSlowPaths();
+extern void vtlb_DiscardFastmemSlowPaths();
+extern uptr vtlb_BackpatchFastmem(uptr pc);
+extern void vtlb_AddFastmemSite(u8* start, u8* end, u8* slowpath);
+extern void vtlb_ResetFastmemSites();
+
 // --------------------------------------------------------------------------------------
 //  VtlbMemoryReserve
 // --------------------------------------------------------------------------------------
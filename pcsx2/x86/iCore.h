@@ -208,6 +208,7 @@ int _signExtendXMMtoM(uptr to, x86SSERegType from, int candestroy); // returns t
 
 #define EEINSTINFO_COP1		1
 #define EEINSTINFO_COP2		2
+#define EEINSTINFO_DEADFLAGS	4	// hot blocks: the VU0 status/mac flags this COP2 op writes are overwritten unread
 
 struct EEINST
 {
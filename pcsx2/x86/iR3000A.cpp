@@ -39,6 +39,8 @@
 
 #include "Utilities/Perf.h"
 #include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/Tracepoints.h"
+#include "../DebugTools/ReverseExecution.h"
 
 using namespace x86Emitter;
 
@@ -1060,10 +1062,10 @@ void psxDynarecCheckBreakpoint()
 			hit = true;
 	}
 
-	if (!hit)
+	if (!hit || !CReverseExecution::BreakpointHit(BREAKPOINT_IOP, pc))
 		return;
 
-	CBreakPoints::SetBreakpointTriggered(true);
+	CBreakPoints::SetBreakpointTriggered(true, BREAKPOINT_IOP);
 	GetCoreThread().PauseSelfDebug();
 	iopBreakpoint = true;
 }
@@ -1074,7 +1076,10 @@ void psxDynarecMemcheck()
 	if (CBreakPoints::CheckSkipFirst(BREAKPOINT_IOP, pc) == pc)
 		return;
 
-	CBreakPoints::SetBreakpointTriggered(true);
+	if (!CReverseExecution::BreakpointHit(BREAKPOINT_IOP, pc))
+		return;
+
+	CBreakPoints::SetBreakpointTriggered(true, BREAKPOINT_IOP);
 	GetCoreThread().PauseSelfDebug();
 	iopBreakpoint = true;
 }
@@ -1087,6 +1092,26 @@ void __fastcall psxDynarecMemLogcheck(u32 start, bool store)
 		DevCon.WriteLn("Hit load breakpoint @0x%x", start);
 }
 
+static void psxDynarecMemcheckHit(u32 addr, u32 size, bool store)
+{
+	u32 result = CBreakPoints::CheckMemAccess(BREAKPOINT_IOP, addr, size, store);
+
+	if (result & MEMCHECK_LOG)
+		psxDynarecMemLogcheck(addr, store);
+	if (result & MEMCHECK_BREAK)
+		psxDynarecMemcheck();
+}
+
+static void __fastcall psxDynarecMemcheckRead(u32 addr, u32 size)
+{
+	psxDynarecMemcheckHit(addr, size, false);
+}
+
+static void __fastcall psxDynarecMemcheckWrite(u32 addr, u32 size)
+{
+	psxDynarecMemcheckHit(addr, size, true);
+}
+
 void psxRecMemcheck(u32 op, u32 bits, bool store)
 {
 	_psxFlushCall(FLUSH_EVERYTHING | FLUSH_PC);
@@ -1098,51 +1123,22 @@ void psxRecMemcheck(u32 op, u32 bits, bool store)
 	if (bits == 128)
 		xAND(ecx, ~0x0F);
 
-	xFastCall((void*)standardizeBreakpointAddressIop, ecx);
-	xMOV(ecx, eax);
-	xMOV(edx, eax);
-	xADD(edx, bits / 8);
-
 	// ecx = access address
-	// edx = access address+size
-
-	auto checks = CBreakPoints::GetMemChecks();
-	for (size_t i = 0; i < checks.size(); i++)
-	{
-		if (checks[i].cpu != BREAKPOINT_IOP)
-			continue;
-		if (checks[i].result == 0)
-			continue;
-		if ((checks[i].cond & MEMCHECK_WRITE) == 0 && store)
-			continue;
-		if ((checks[i].cond & MEMCHECK_READ) == 0 && !store)
-			continue;
-
-		// logic: memAddress < bpEnd && bpStart < memAddress+memSize
 
-		xMOV(eax, standardizeBreakpointAddress(BREAKPOINT_IOP, checks[i].end));
-		xCMP(ecx, eax);				// address < end
-		xForwardJGE8 next1;			// if address >= end then goto next1
+	// Same page table test as the EE recompiler, the ranges are only walked on a hit
+	xMOV(eax, ecx);
+	xSHR(eax, MEMCHECK_PAGE_BITS);
+	xTEST(ptr8[xComplexAddress(rdx, memCheckPages, rax)], memCheckPageMask(BREAKPOINT_IOP, store));
+	xForwardJZ8 skip;
 
-		xMOV(eax, standardizeBreakpointAddress(BREAKPOINT_IOP, checks[i].start));
-		xCMP(eax, edx);				// start < address+size
-		xForwardJGE8 next2;			// if start >= address+size then goto next2
+	xMOV(edx, bits / 8);
+	xFastCall((void*)(store ? psxDynarecMemcheckWrite : psxDynarecMemcheckRead), ecx, edx);
 
-									// hit the breakpoint
-		if (checks[i].result & MEMCHECK_LOG) {
-			xMOV(edx, store);
-			xFastCall((void*)psxDynarecMemLogcheck, ecx, edx);
-		}
-		if (checks[i].result & MEMCHECK_BREAK) {
-			xFastCall((void*)psxDynarecMemcheck);
-		}
-
-		next1.SetTarget();
-		next2.SetTarget();
-	}
 	// get out of here
 	xCMP(ptr8[&iopBreakpoint], 0);
 	xJNE(iopExitRecompiledCode);
+
+	skip.SetTarget();
 }
 
 void psxEncodeBreakpoint()
@@ -1187,6 +1183,20 @@ void psxEncodeMemcheck()
 	}
 }
 
+static void __fastcall psxDynarecCollectTracepoint(u32 addr)
+{
+	CTracepoints::Collect(BREAKPOINT_IOP, addr);
+}
+
+void psxEncodeTracepoint()
+{
+	if (!CTracepoints::IsTracepoint(BREAKPOINT_IOP, psxpc))
+		return;
+
+	_psxFlushCall(FLUSH_EVERYTHING | FLUSH_PC);
+	xFastCall((void*)psxDynarecCollectTracepoint, psxpc);
+}
+
 void psxRecompileNextInstruction(int delayslot)
 {
 	// pblock isn't used elsewhere in this function.
@@ -1196,6 +1206,7 @@ void psxRecompileNextInstruction(int delayslot)
 	if (!delayslot)
 	{
 		psxEncodeBreakpoint();
+		psxEncodeTracepoint();
 		psxEncodeMemcheck();
 	}
 
@@ -125,6 +125,15 @@ u32* recGetImm64(u32 hi, u32 lo);
 
 void _vuRegsCOP22(VURegs * VU, _VURegsNum *VUregsn);
 
+// What a COP2 instruction does with the VU0 status/mac flags (dead flag elimination)
+enum COP2FlagUse
+{
+	COP2FLAGS_None = 0,
+	COP2FLAGS_Write,		// all of them, the sticky bits are only added to
+	COP2FLAGS_Read,			// or might
+};
+COP2FlagUse _vuFlagsCOP2(u32 code);
+
 //////////////////////////////////////
 // Templates for code recompilation //
 //////////////////////////////////////
@@ -0,0 +1,94 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2010  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+// Persistent cache of recompiled EE blocks, kept per ELF in the cache folder. A block is
+// stored along with the guest code it was compiled from and everything in its x86 code that
+// depends on where it was placed, so recRecompile can move it into recMem next time instead
+// of compiling the guest code again. See iR5900BlockCache.cpp.
+
+enum BlockCacheRelocType
+{
+	BCRELOC_Relative = 0,	// rel32 to an address outside of the block
+	BCRELOC_Const,			// rel32 to a recGetImm64 constant
+	BCRELOC_ConstAbsolute,	// disp32 holding the address of a recGetImm64 constant
+};
+
+struct BlockCacheReloc
+{
+	u32 offset;				// of the field in the block
+	u32 type;
+	u32 base;				// offset the rel32 is relative to
+	u32 sub;				// offset into the constant
+	u64 value;				// target address, or the constant (hi:lo)
+};
+
+struct BlockCacheLink
+{
+	u32 offset;
+	u32 pc;
+};
+
+struct BlockCacheFastmem
+{
+	u32 start;
+	u32 end;
+	u32 slowpath;
+};
+
+// TLB lookups done at compile time for constant addresses
+struct BlockCacheVtlb
+{
+	u32 page;
+	u32 reserved;
+	u64 raw;
+};
+
+struct CachedBlock
+{
+	u32 startpc;
+	u32 endpc;				// end of the analysed range
+	u32 pc;					// where the compiled code stops
+	u32 split;				// willbranch3
+
+	std::vector<u32> guest;
+	std::vector<u8> code;
+	std::vector<BlockCacheReloc> relocs;
+	std::vector<BlockCacheLink> links;
+	std::vector<BlockCacheFastmem> fastmem;
+	std::vector<BlockCacheVtlb> vtlb;
+
+	size_t GetBytes() const;
+};
+
+// From recRecompile. Blocks can only be cached or restored when nothing was emitted for
+// them yet and the debugger doesn't need its own code in them.
+extern bool recBlockCacheUsable();
+extern const CachedBlock* recBlockCacheFind(u32 startpc, u32 endpc, bool split);
+extern bool recBlockCacheRestore(const CachedBlock& block, u8* dest);
+
+// Recording of the block being compiled, End stores it if nothing got in the way.
+extern void recBlockCacheBegin(u32 startpc, u32 endpc, bool split);
+extern void recBlockCacheEnd(const u8* code, const u8* end, u32 pc);
+extern void recBlockCacheAbort();
+
+// Notifications from the code generators while recording
+extern void recBlockCacheLink(s32* jumpptr, u32 pc);
+extern void recBlockCacheConst(const u32* imm64);
+extern void recBlockCacheVtlbConst(u32 vaddr);
+extern void recBlockCacheFastmemSite(const u8* start, const u8* end, const u8* slowpath);
@@ -21,6 +21,7 @@
 #include "R5900Exceptions.h"
 #include "R5900OpcodeTables.h"
 #include "iR5900.h"
+#include "iR5900BlockCache.h"
 #include "BaseblockEx.h"
 #include "System/RecTypes.h"
 
@@ -33,12 +34,16 @@
 #include "Elfheader.h"
 
 #include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/Tracepoints.h"
+#include "../DebugTools/ReverseExecution.h"
 #include "Patch.h"
 
 #if !PCSX2_SEH
 #	include <csetjmp>
 #endif
 
+#include <unordered_set>
+
 
 #include "Utilities/MemsetFast.inl"
 #include "Utilities/Perf.h"
@@ -104,6 +109,39 @@ static EEINST* s_psaveInstInfo = NULL;
 
 static u32 s_savenBlockCycles = 0;
 
+// Loops -- blocks branching back to their own start -- count how often they do that, and
+// are recompiled as superblocks once it's often enough: the body is unrolled a few times,
+// with the back edges of all but the last copy going straight on to the next one instead
+// of through an event test and the block link. BASEBLOCKEX entries move around as blocks
+// come and go, the counts live in a table of their own (collisions only shift the moment
+// a loop gets promoted).
+static const u32 LOOP_HOT_COUNT = 2048;		// back edges taken before the loop is promoted
+static const u32 LOOP_UNROLL_INSTS = 64;	// instructions of all the copies together
+static const int LOOP_MAX_COPIES = 4;
+static const int LOOP_COUNTER_SLOTS = 1024;
+
+static __aligned16 u32 s_loopCounters[LOOP_COUNTER_SLOTS];
+static std::unordered_set<u32> s_hotLoops;	// HWADDR of the promoted loops
+
+static u32 s_loopStartPc;				// startpc of the block being recompiled
+static u32* s_loopCounter = NULL;		// counter of the block, if it's a loop
+static int s_loopCopiesLeft = 0;		// copies of the body to compile after the current one
+static bool s_loopMayWriteCode;			// body has stores, so it could clear itself
+static std::vector<s32*> s_loopNextCopy;	// back edges to patch to the next copy
+
+// Tiers: blocks are first compiled in one quick pass. Those using COP2 count their entries,
+// and are compiled again with the analysis that only pays off on code run that often once
+// they reach the threshold. Promoted loops go to the second tier along with becoming
+// superblocks, they aren't counted twice.
+static const u32 BLOCK_HOT_COUNT = 4096;	// entries before the block is promoted
+static const int BLOCK_COUNTER_SLOTS = 4096;
+
+static __aligned16 u32 s_blockCounters[BLOCK_COUNTER_SLOTS];
+static std::unordered_set<u32> s_hotBlocks;	// HWADDR of the promoted blocks
+
+static u32* s_blockCounter = NULL;		// entry counter of the block being recompiled
+static bool s_blockHot = false;			// block being recompiled is in the second tier
+
 #ifdef PCSX2_DEBUG
 static u32 dumplog = 0;
 #else
@@ -111,6 +149,9 @@ static u32 dumplog = 0;
 #endif
 
 static void iBranchTest(u32 newpc = 0xffffffff);
+static void recLinkBlock(u32 pc, s32* jumpptr);
+static void __fastcall recPromoteLoop(u32 startpc);
+static void __fastcall recPromoteBlock(u32 startpc);
 static void ClearRecLUT(BASEBLOCK* base, int count);
 static u32 scaleblockcycles();
 static void recExitExecution();
@@ -262,7 +303,10 @@ u32* recGetImm64(u32 hi, u32 lo)
 
 	imm64 = imm64_cache[cacheidx];
 	if (imm64 && imm64[0] == lo && imm64[1] == hi)
+	{
+		recBlockCacheConst(imm64);
 		return imm64;
+	}
 
 	if (recConstBufPtr >= recConstBuf + RECCONSTBUF_SIZE)
 	{
@@ -289,6 +333,7 @@ u32* recGetImm64(u32 hi, u32 lo)
 
 	//Console.Warning("Consts allocated: %d of %u", (recConstBufPtr - recConstBuf) / 2, count);
 
+	recBlockCacheConst(imm64);
 	return imm64;
 }
 
@@ -611,7 +656,9 @@ static void recResetRaw()
 
 	Console.WriteLn( Color_StrongBlack, "EE/iR5900-32 Recompiler Reset" );
 
+	recBlockCacheAbort();
 	recMem->Reset();
+	vtlb_ResetFastmemSites();
 	ClearRecLUT((BASEBLOCK*)recLutReserve_RAM, recLutSize);
 	memset(recRAMCopy, 0, Ps2MemSize::MainRam);
 
@@ -624,6 +671,8 @@ static void recResetRaw()
 
 	recBlocks.Reset();
 	mmap_ResetBlockTracking();
+	s_hotLoops.clear();
+	s_hotBlocks.clear();
 
 	x86SetPtr(*recMem);
 
@@ -918,7 +967,23 @@ void SetBranchImm( u32 imm )
 
 	// end the current block
 	iFlushCall(FLUSH_EVERYTHING);
+
+	if (imm == s_loopStartPc && s_loopCopiesLeft)
+	{
+		s_loopNextCopy.push_back(xJcc32());
+		return;
+	}
+
 	xMOV(ptr32[&cpuRegs.pc], imm);
+
+	if (imm == s_loopStartPc && s_loopCounter)
+	{
+		xSUB(ptr32[s_loopCounter], 1);
+		xForwardJNZ8 notHot;
+		xFastCall((void*)recPromoteLoop, imm);
+		notHot.SetTarget();
+	}
+
 	iBranchTest(imm);
 }
 
@@ -1059,6 +1124,14 @@ u32 scaleblockcycles_clear()
 	return scaled;
 }
 
+// Static jumps to other blocks, the persistent block cache links them again when it
+// restores the block.
+static void recLinkBlock(u32 pc, s32* jumpptr)
+{
+	recBlocks.Link(pc, jumpptr);
+	recBlockCacheLink(jumpptr, pc);
+}
+
 // Generates dynarec code for Event tests followed by a block dispatch (branch).
 // Parameters:
 //   newpc - address to jump to at the end of the block.  If newpc == 0xffffffff then
@@ -1096,7 +1169,7 @@ static void iBranchTest(u32 newpc)
 		if (newpc == 0xffffffff)
 			xJS( DispatcherReg );
 		else
-			recBlocks.Link(HWADDR(newpc), xJcc32(Jcc_Signed));
+			recLinkBlock(HWADDR(newpc), xJcc32(Jcc_Signed));
 
 		xJMP( (void*)DispatcherEvent );
 	}
@@ -1192,7 +1265,7 @@ void dynarecCheckBreakpoint()
 			hit = true;
 	}
 
-	if (!hit)
+	if (!hit || !CReverseExecution::BreakpointHit(BREAKPOINT_EE, pc))
 		return;
 
 	CBreakPoints::SetBreakpointTriggered(true);
@@ -1206,6 +1279,9 @@ void dynarecMemcheck()
  	if (CBreakPoints::CheckSkipFirst(BREAKPOINT_EE, pc) != 0)
 		return;
 
+	if (!CReverseExecution::BreakpointHit(BREAKPOINT_EE, pc))
+		return;
+
 	CBreakPoints::SetBreakpointTriggered(true);
 	GetCoreThread().PauseSelfDebug();
 	recExitExecution();
@@ -1219,6 +1295,27 @@ void __fastcall dynarecMemLogcheck(u32 start, bool store)
 		DevCon.WriteLn("Hit load breakpoint @0x%x", start);
 }
 
+// Only reached when the access touched a watched page, the ranges are checked here
+static void dynarecMemcheckHit(u32 addr, u32 size, bool store)
+{
+	u32 result = CBreakPoints::CheckMemAccess(BREAKPOINT_EE, addr, size, store);
+
+	if (result & MEMCHECK_LOG)
+		dynarecMemLogcheck(addr, store);
+	if (result & MEMCHECK_BREAK)
+		dynarecMemcheck();
+}
+
+static void __fastcall dynarecMemcheckRead(u32 addr, u32 size)
+{
+	dynarecMemcheckHit(addr, size, false);
+}
+
+static void __fastcall dynarecMemcheckWrite(u32 addr, u32 size)
+{
+	dynarecMemcheckHit(addr, size, true);
+}
+
 void recMemcheck(u32 op, u32 bits, bool store)
 {
 	iFlushCall(FLUSH_EVERYTHING|FLUSH_PC);
@@ -1230,56 +1327,94 @@ void recMemcheck(u32 op, u32 bits, bool store)
 	if (bits == 128)
 		xAND(ecx, ~0x0F);
 
-	xFastCall((void*)standardizeBreakpointAddressEE, ecx);
-	xMOV(ecx,eax);
-	xMOV(edx,eax);
-	xADD(edx,bits/8);
-
 	// ecx = access address
-	// edx = access address+size
 
-	auto checks = CBreakPoints::GetMemChecks();
-	for (size_t i = 0; i < checks.size(); i++)
-	{
-		if (checks[i].cpu != BREAKPOINT_EE)
-			continue;
-		if (checks[i].result == 0)
-			continue;
-		if ((checks[i].cond & MEMCHECK_WRITE) == 0 && store)
-			continue;
-		if ((checks[i].cond & MEMCHECK_READ) == 0 && !store)
-			continue;
+	// A single test against the watched page table, no matter how many memchecks
+	// there are. Mirrors are already folded into the table.
+	xMOV(eax, ecx);
+	xSHR(eax, MEMCHECK_PAGE_BITS);
+	xTEST(ptr8[xComplexAddress(rdx, memCheckPages, rax)], memCheckPageMask(BREAKPOINT_EE, store));
+	xForwardJZ8 skip;
 
-		// logic: memAddress < bpEnd && bpStart < memAddress+memSize
+	// A break leaves from the middle of the block, so the instructions before this one
+	// are charged here instead of at the end of it. Taken back when it didn't break.
+	const u32 cycles = s_nBlockCycles ? scaleblockcycles() : 0;
+	if (cycles)
+		xADD(ptr32[&cpuRegs.cycle], cycles);
 
-		xMOV(eax,standardizeBreakpointAddress(BREAKPOINT_EE, checks[i].end));
-		xCMP(ecx,eax);				// address < end
-		xForwardJGE8 next1;			// if address >= end then goto next1
+	xMOV(edx, bits / 8);
+	xFastCall((void*)(store ? dynarecMemcheckWrite : dynarecMemcheckRead), ecx, edx);
 
-		xMOV(eax,standardizeBreakpointAddress(BREAKPOINT_EE, checks[i].start));
-		xCMP(eax,edx);				// start < address+size
-		xForwardJGE8 next2;			// if start >= address+size then goto next2
+	if (cycles)
+		xSUB(ptr32[&cpuRegs.cycle], cycles);
 
-		// hit the breakpoint
-		if (checks[i].result & MEMCHECK_LOG) {
-			xMOV(edx, store);
-			xFastCall((void*)dynarecMemLogcheck, ecx, edx);
-		}
-		if (checks[i].result & MEMCHECK_BREAK) {
-			xFastCall((void*)dynarecMemcheck);
-		}
+	skip.SetTarget();
+}
 
-		next1.SetTarget();
-		next2.SetTarget();
+static void recLoadConditionOperand(const xRegister64& to, const CompiledExpressionOp& op)
+{
+	switch (op.type)
+	{
+	case CEXOP_LOAD32:
+		xMOV(xRegister32(to.Id), ptr32[(u32*)(uptr)op.value]);
+		break;
+	case CEXOP_LOAD64:
+		xMOV(to, ptr64[(u64*)(uptr)op.value]);
+		break;
+	default:
+		xMOV64(to, op.value);
+		break;
 	}
 }
 
+// Emits the breakpoint condition inline when it's a plain comparison, so a conditional
+// breakpoint in a hot loop costs a compare instead of a trip through the evaluator.
+// On success, failed is the condition code for "don't break".
+static bool recEncodeBreakpointCondition(int bpFlags, JccComparisonType& failed)
+{
+	// delay slot breakpoints are left to dynarecCheckBreakpoint
+	if (bpFlags != 1)
+		return false;
+
+	BreakPointCond* cond = CBreakPoints::GetBreakPointCondition(BREAKPOINT_EE, pc);
+	SimpleExpression expr;
+	if (cond == NULL || !getSimpleExpression(cond->compiled, expr))
+		return false;
+
+	recLoadConditionOperand(rax, expr.left);
+	recLoadConditionOperand(rdx, expr.right);
+	xCMP(rax, rdx);
+
+	switch (expr.compare)
+	{
+	case EXCMP_EQUAL:			failed = Jcc_NotEqual; break;
+	case EXCMP_NOTEQUAL:		failed = Jcc_Equal; break;
+	case EXCMP_GREATEREQUAL:	failed = Jcc_Below; break;
+	case EXCMP_GREATER:			failed = Jcc_BelowOrEqual; break;
+	case EXCMP_LOWEREQUAL:		failed = Jcc_Above; break;
+	default:					failed = Jcc_AboveOrEqual; break;
+	}
+	return true;
+}
+
 void encodeBreakpoint()
 {
-	if (isBreakpointNeeded(pc) != 0)
+	int bpFlags = isBreakpointNeeded(pc);
+	if (bpFlags != 0)
 	{
 		iFlushCall(FLUSH_EVERYTHING|FLUSH_PC);
-		xFastCall((void*)dynarecCheckBreakpoint);
+
+		JccComparisonType failed;
+		if (recEncodeBreakpointCondition(bpFlags, failed))
+		{
+			// only call out once the condition holds, the handler still checks
+			// skip-first and re-evaluates before pausing
+			xForwardJump8 skip(failed);
+			xFastCall((void*)dynarecCheckBreakpoint);
+			skip.SetTarget();
+		}
+		else
+			xFastCall((void*)dynarecCheckBreakpoint);
 	}
 }
 
@@ -1313,6 +1448,41 @@ void encodeMemcheck()
 	}
 }
 
+static void __fastcall dynarecCollectTracepoint(u32 addr)
+{
+	CTracepoints::Collect(BREAKPOINT_EE, addr);
+}
+
+void encodeTracepoint()
+{
+	// only armed while a trace run is active, starting and stopping one clears the cache
+	if (!CTracepoints::IsTracepoint(BREAKPOINT_EE, pc))
+		return;
+
+	// collection never stops the cpu, so the block just carries on afterwards
+	iFlushCall(FLUSH_EVERYTHING|FLUSH_PC);
+	xFastCall((void*)dynarecCollectTracepoint, pc);
+}
+
+static void __fastcall dynarecReverseStep(u32 addr)
+{
+	if (!CReverseExecution::InstructionHit(addr))
+		return;
+
+	GetCoreThread().PauseSelfDebug();
+	recExitExecution();
+}
+
+void encodeReverseStep()
+{
+	// only while reverse execution replays, starting and finishing a replay clears the cache
+	if (!CReverseExecution::IsCountingInstructions())
+		return;
+
+	iFlushCall(FLUSH_EVERYTHING|FLUSH_PC);
+	xFastCall((void*)dynarecReverseStep, pc);
+}
+
 void recompileNextInstruction(int delayslot)
 {
 	u32 i;
@@ -1321,7 +1491,9 @@ void recompileNextInstruction(int delayslot)
 	// add breakpoint
 	if (!delayslot)
 	{
+		encodeReverseStep();
 		encodeBreakpoint();
+		encodeTracepoint();
 		encodeMemcheck();
 	}
 
@@ -1534,12 +1706,15 @@ void __fastcall dyna_block_discard(u32 start,u32 sz)
 
 // called when a page under manual protection has been run enough times to be a candidate
 // for being reset under the faster vtlb write protection.  All blocks in the page are cleared
-// and the block is re-assigned for write protection.
+// and the block is re-assigned for write protection.  Pages that were written a lot lately
+// are left alone until their fault count decays, they'd only fault their way back here.
 void __fastcall dyna_page_reset(u32 start,u32 sz)
 {
+	if (mmap_IsBusyRamPage(start)) return;
+
 	recClear(start & ~0xfffUL, 0x400);
 	manual_counter[start >> 12]++;
-	mmap_MarkCountedRamPage( start );
+	mmap_MarkCountedRamPage( start, 0 );
 }
 
 static void memory_protect_recompiled_code(u32 startpc, u32 size)
@@ -1561,7 +1736,7 @@ static void memory_protect_recompiled_code(u32 startpc, u32 size)
 
 		case ProtMode_None:
         case ProtMode_Write:
-			mmap_MarkCountedRamPage( inpage_ptr );
+			mmap_MarkCountedRamPage( inpage_ptr, inpage_sz );
 			manual_page[inpage_ptr >> 12] = 0;
 			break;
 
@@ -1625,6 +1800,131 @@ static void memory_protect_recompiled_code(u32 startpc, u32 size)
 	}
 }
 
+// Called from the back edge of a loop which was taken often enough. The block is cleared,
+// the link the back edge is about to take now leads to its recompilation as a superblock.
+static void __fastcall recPromoteLoop(u32 startpc)
+{
+	eeRecPerfLog.Write( "Hot loop @ 0x%08X, recompiling as a superblock", startpc );
+	s_hotLoops.insert(HWADDR(startpc));
+	recClear(startpc, 1);
+}
+
+// Called on entry of a block which was entered often enough, same as recPromoteLoop
+static void __fastcall recPromoteBlock(u32 startpc)
+{
+	eeRecPerfLog.Write( "Hot block @ 0x%08X, recompiling in the second tier", startpc );
+	s_hotBlocks.insert(HWADDR(startpc));
+	recClear(startpc, 1);
+}
+
+// Whether the block has anything the second tier would do better
+static bool recBlockTierable(u32 startpc)
+{
+	if (!CHECK_EETIERING || !EmuConfig.Speedhacks.vuFlagHack)
+		return false;
+
+	for (u32 i = startpc; i < s_nEndBlock; i += 4) {
+		const u32 code = *(u32*)PSM(i);
+		if ((code >> 26) == 022 && _vuFlagsCOP2(code) == COP2FLAGS_Write)
+			return true;
+	}
+	return false;
+}
+
+// Marks the COP2 ops whose status/mac flag updates are overwritten by a later op of the
+// block before anything can look at them. The sticky status bits of the dropped updates
+// are lost, which is why this depends on the mVU flag hack. A load or store faulting into
+// a handler which reads the flags is a chance the flag hack takes as well.
+static void recAnalyzeCOP2Flags(u32 startpc)
+{
+	bool overwritten = false;	// the block end counts as a read
+	EEINST* pinst = s_pInstCache + (s_nEndBlock - startpc) / 4;
+
+	for (u32 i = s_nEndBlock; i > startpc; pinst--) {
+		i -= 4;
+		const u32 code = *(u32*)PSM(i);
+		const u32 op = code >> 26;
+		const u32 funct = code & 0x3f;
+
+		if (op == 022) {
+			switch (_vuFlagsCOP2(code)) {
+				case COP2FLAGS_Write:
+					if (overwritten)
+						pinst->info |= EEINSTINFO_DEADFLAGS;
+					overwritten = true;
+					break;
+				case COP2FLAGS_Read:
+					overwritten = false;
+					break;
+				default:
+					break;
+			}
+		}
+		// branches and jumps (the delay slot of a likely one may not run), cop0, syscall,
+		// break and the traps
+		else if ((op >= 001 && op <= 007) || (op >= 024 && op <= 027) || op == 020
+			|| (op == 021 && ((code >> 21) & 0x1f) == 010)
+			|| (op == 0 && (funct == 010 || funct == 011 || funct == 014 || funct == 015 || (funct & 070) == 060)))
+			overwritten = false;
+	}
+}
+
+// Copies of the body a loop block gets as a superblock, 0 when it isn't eligible.
+static int recLoopCopies(u32 startpc)
+{
+	if (!CHECK_EESUPERBLOCKS || s_branchTo != startpc || s_nBlockFF)
+		return 0;
+
+	// Only the first copy runs the manual protection checks, so writes to the code have
+	// to be caught by the page protection. The thread stacks are always checked manually.
+	if ((startpc >> 12) == 0x81 || (startpc >> 12) == 0x80001)
+		return 0;
+
+	const vtlb_ProtectionMode mode = mmap_GetRamPageInfo(HWADDR(startpc));
+	if (mode != ProtMode_Write && mode != ProtMode_NotRequired)
+		return 0;
+
+	s_loopMayWriteCode = false;
+	for (u32 i = startpc; i < s_nEndBlock; i += 4) {
+		const u32 op = *(u32*)PSM(i) >> 26;
+		// sq, sb..swr and cache, sc/swc1/swc2/sd and the like
+		if (op == 037 || (op >= 050 && op <= 057) || op >= 070)
+			s_loopMayWriteCode = true;
+	}
+
+	return std::min<int>(LOOP_MAX_COPIES, LOOP_UNROLL_INSTS / ((s_nEndBlock - startpc) / 4));
+}
+
+// Starts the next copy of a superblock, where the back edges of the previous one land
+static void recLoopNextCopy(u32 startpc)
+{
+	for (s32* jump : s_loopNextCopy)
+		*jump = xGetPtr() - ((u8*)jump + 4);
+	s_loopNextCopy.clear();
+	s_loopCopiesLeft--;
+
+	// A store that hit the code of the loop cleared it, leave before running the old code
+	if (s_loopMayWriteCode)
+	{
+		xLoadFarAddr(rax, &s_pCurBlock->m_pFnptr);
+		xLoadFarAddr(rcx, recPtr);
+		xCMP(ptrNative[rax], rcx);
+		xForwardJE8 unchanged;
+		xMOV(ptr32[&cpuRegs.pc], startpc);
+		xADD(ptr32[&cpuRegs.cycle], scaleblockcycles());
+		xJMP((void*)DispatcherReg);
+		unchanged.SetTarget();
+	}
+
+	// everything was flushed by the back edge
+	pc = startpc;
+	g_branch = 0;
+	g_cpuHasConstReg = g_cpuFlushedConstReg = 1;
+	_initX86regs();
+	_initXMMregs();
+	g_pCurInstInfo = s_pInstCache;
+}
+
 // Skip MPEG Game-Fix
 bool skipMPEG_By_Pattern(u32 sPC) {
 
@@ -1787,10 +2087,10 @@ static void __fastcall recRecompile( const u32 startpc )
 	s_nEndBlock = 0xffffffff;
 	s_branchTo = -1;
 
-	// compile breakpoints as individual blocks
-	int n1 = isBreakpointNeeded(i);
-	int n2 = isMemcheckNeeded(i);
-	int n = std::max<int>(n1,n2);
+	// compile breakpoints as individual blocks. Memchecks don't need this, their guard
+	// is cheap enough to sit in the middle of a block and flushes everything, including
+	// the cycles so far, before it can break out.
+	int n = isBreakpointNeeded(i);
 	if (n != 0)
 	{
 		s_nEndBlock = i + n*4;
@@ -1801,7 +2101,7 @@ static void __fastcall recRecompile( const u32 startpc )
 		BASEBLOCK* pblock = PC_GETBLOCK(i);
 
 		// stop before breakpoints
-		if (isBreakpointNeeded(i) != 0 || isMemcheckNeeded(i) != 0)
+		if (isBreakpointNeeded(i) != 0)
 		{
 			s_nEndBlock = i;
 			break;
@@ -2049,15 +2349,84 @@ StartRecomp:
 	// Detect and handle self-modified code
 	memory_protect_recompiled_code(startpc, (s_nEndBlock-startpc) >> 2);
 
+	// Loops count their iterations until they are promoted to a superblock
+	s_loopStartPc = startpc;
+	s_loopCounter = NULL;
+	s_loopCopiesLeft = 0;
+	s_loopNextCopy.clear();
+	if (int copies = recLoopCopies(startpc)) {
+		if (copies > 1 && s_hotLoops.count(HWADDR(startpc))) {
+			s_loopCopiesLeft = copies - 1;
+			eeRecPerfLog.Write( "Superblock @ %08X : size=%d insts, %d copies", startpc, (s_nEndBlock-startpc) / 4, copies );
+		}
+		else if (copies > 1) {
+			s_loopCounter = &s_loopCounters[(HWADDR(startpc) >> 2) % LOOP_COUNTER_SLOTS];
+			*s_loopCounter = LOOP_HOT_COUNT;
+		}
+	}
+
+	// and the other blocks count their entries until they are promoted to the second tier
+	s_blockCounter = NULL;
+	s_blockHot = false;
+	if (recBlockTierable(startpc)) {
+		if (s_hotBlocks.count(HWADDR(startpc)) || s_hotLoops.count(HWADDR(startpc))) {
+			s_blockHot = true;
+			recAnalyzeCOP2Flags(startpc);
+			eeRecPerfLog.Write( "Second tier @ %08X : size=%d insts", startpc, (s_nEndBlock-startpc) / 4 );
+		}
+		else if (!s_loopCounter) {
+			s_blockCounter = &s_blockCounters[(HWADDR(startpc) >> 2) % BLOCK_COUNTER_SLOTS];
+			*s_blockCounter = BLOCK_HOT_COUNT;
+		}
+	}
+
 	// Skip Recompilation if sceMpegIsEnd Pattern detected
 	bool doRecompilation = !skipMPEG_By_Pattern(startpc);
 
+	// Blocks from the persistent cache only need to be moved into place. Anything emitted
+	// before this point (hooks, manual protection checks) isn't part of the cached code.
+	// (the recording and the fastmem sites of a block which threw half way through are
+	// dropped first)
+	recBlockCacheAbort();
+	vtlb_DiscardFastmemSlowPaths();
+	const CachedBlock* cached = NULL;
+	if (doRecompilation && !s_loopCopiesLeft && !s_blockHot && xGetPtr() == recPtr && recBlockCacheUsable()) {
+		cached = recBlockCacheFind(startpc, s_nEndBlock, willbranch3 != 0);
+
+		// its constants are allocated again
+		if (cached && (recConstBufPtr + cached->relocs.size() * 2 > recConstBuf + RECCONSTBUF_SIZE
+			|| !recBlockCacheRestore(*cached, recPtr)))
+			cached = NULL;
+
+		if (cached) {
+			xSetPtr(recPtr + cached->code.size());
+			pc = cached->pc;
+			doRecompilation = false;
+		}
+		else
+			recBlockCacheBegin(startpc, s_nEndBlock, willbranch3 != 0);
+	}
+
 	if (doRecompilation) {
+		if (s_blockCounter) {
+			xSUB(ptr32[s_blockCounter], 1);
+			xForwardJNZ8 notHot;
+			xFastCall((void*)recPromoteBlock, startpc);
+			notHot.SetTarget();
+		}
+
 		// Finally: Generate x86 recompiled code!
 		g_pCurInstInfo = s_pInstCache;
 		while (!g_branch && pc < s_nEndBlock) {
 			recompileNextInstruction(0);		// For the love of recursion, batman!
 		}
+
+		// superblocks: the rest of the copies of the loop body
+		while (!s_loopNextCopy.empty()) {
+			recLoopNextCopy(startpc);
+			while (!g_branch && pc < s_nEndBlock)
+				recompileNextInstruction(0);
+		}
 	}
 
 #ifdef PCSX2_DEBUG
@@ -2103,7 +2472,13 @@ StartRecomp:
 	if( !(pc&0x10000000) )
 		maxrecmem = std::max( (pc&~0xa0000000), maxrecmem );
 
-	if( g_branch == 2 )
+	if( cached )
+	{
+		// the tail and the slow paths came along with the block
+		for (const BlockCacheLink& link : cached->links)
+			recBlocks.Link(link.pc, (s32*)(recPtr + link.offset));
+	}
+	else if( g_branch == 2 )
 	{
 		// Branch type 2 - This is how I "think" this works (air):
 		// Performs a branch/event test but does not actually "break" the block.
@@ -2136,11 +2511,19 @@ StartRecomp:
 			{
 				xMOV( ptr32[&cpuRegs.pc], pc );
 				xADD( ptr32[&cpuRegs.cycle], scaleblockcycles() );
-				recBlocks.Link( HWADDR(pc), xJcc32() );
+				recLinkBlock( HWADDR(pc), xJcc32() );
 			}
 		}
 	}
 
+	if( !cached )
+	{
+		// out of line part of the fastmem loads/stores
+		vtlb_DynGenFastmemSlowPaths();
+
+		recBlockCacheEnd(recPtr, xGetPtr(), pc);
+	}
+
 	pxAssert( xGetPtr() < recMem->GetPtrEnd() );
 	pxAssert( recConstBufPtr < recConstBuf + RECCONSTBUF_SIZE );
 
@@ -2161,6 +2544,10 @@ StartRecomp:
 
 	s_pCurBlock = NULL;
 	s_pCurBlockEx = NULL;
+	s_loopCounter = NULL;
+	s_loopCopiesLeft = 0;
+	s_blockCounter = NULL;
+	s_blockHot = false;
 }
 
 // The only *safe* way to throw exceptions from the context of recompiled code.
@@ -0,0 +1,589 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2010  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+#include "Common.h"
+#include "vtlb.h"
+#include "iR5900.h"
+#include "iR5900BlockCache.h"
+
+#include "../DebugTools/Breakpoints.h"
+#include "../DebugTools/Tracepoints.h"
+#include "../DebugTools/ReverseExecution.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+
+using namespace x86Emitter;
+using namespace vtlb_private;
+
+// --------------------------------------------------------------------------------------
+//  Persistent EE block cache
+// --------------------------------------------------------------------------------------
+// While a block is compiled, the emitter reports every rip-relative operand and rel32
+// jump or call it writes. Once the block is done, the ones pointing outside of it are
+// kept as relocations: most go to the pcsx2 image or the VM reserve and only need the
+// new distance, the ones to recGetImm64 constants get the constant allocated again. Jumps
+// to other blocks are linked again through recBlocks, and the fastmem sites get the
+// current window and are registered for backpatching.
+//
+// Anything else the code refers to by absolute address has to stay where it was, so the
+// file is only used by the same build with the same image, VM and vmap addresses (see
+// GetEnvironment), which rules out ASLR builds. The compile time TLB lookups of constant
+// addresses are checked again before a block is used.
+//
+// Only x86-64 code is cached, 32 bit blocks are full of absolute addresses.
+
+static const u32 BLOCK_CACHE_MAGIC = 0x43424545;	// EEBC
+static const u32 BLOCK_CACHE_VERSION = 1;
+
+// per ELF, the cache doesn't evict anything
+static const size_t BLOCK_CACHE_MAX_BYTES = _64mb;
+
+// compiled variants of the same guest code, e.g. with different TLB mappings
+static const size_t BLOCK_CACHE_MAX_VARIANTS = 4;
+
+struct BlockCacheHeader
+{
+	u32 magic;
+	u32 version;
+	u64 environment;
+	u32 count;
+	u32 reserved;
+};
+
+struct BlockCacheRecord
+{
+	u32 startpc;
+	u32 endpc;
+	u32 pc;
+	u32 split;
+	u32 guest;
+	u32 code;
+	u32 relocs;
+	u32 links;
+	u32 fastmem;
+	u32 vtlb;
+};
+
+struct BlockCacheField
+{
+	s32* field;
+	const u8* base;		// NULL for an absolute disp32
+};
+
+// keyed by HashBlock
+typedef std::unordered_multimap<u64, CachedBlock> BlockCacheMap;
+
+static BlockCacheMap s_blocks;
+static wxString s_filename;
+static u64 s_environment = 0;
+static size_t s_bytes = 0;
+static bool s_dirty = false;
+
+// recording state
+static bool s_recording = false;
+static bool s_failed = false;
+static CachedBlock s_block;
+static std::vector<BlockCacheField> s_fields;
+static std::vector<std::pair<s32*, u32>> s_links;
+static std::vector<const u32*> s_consts;
+static std::vector<const u8*> s_fastmem;		// start, end, slowpath
+
+size_t CachedBlock::GetBytes() const
+{
+	return sizeof(*this) + guest.size() * sizeof(u32) + code.size()
+		+ relocs.size() * sizeof(BlockCacheReloc) + links.size() * sizeof(BlockCacheLink)
+		+ fastmem.size() * sizeof(BlockCacheFastmem) + vtlb.size() * sizeof(BlockCacheVtlb);
+}
+
+static __fi void HashBytes(u64& hash, const void* data, size_t size)
+{
+	const u8* bytes = (const u8*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+static u64 HashBlock(u32 startpc, u32 endpc, const u32* guest)
+{
+	u64 hash = 0xcbf29ce484222325ULL;
+	HashBytes(hash, &startpc, sizeof(startpc));
+	HashBytes(hash, &endpc, sizeof(endpc));
+	HashBytes(hash, guest, endpc - startpc);
+	return hash;
+}
+
+// The build, the addresses the code refers to directly and the settings which change the
+// generated code.
+static u64 GetEnvironment()
+{
+	static u64 image = 0;
+	if (image == 0)
+	{
+		wxFileName exe(wxStandardPaths::Get().GetExecutablePath());
+		u64 size = exe.GetSize().GetValue();
+		s64 modified = exe.GetModificationTime().GetValue().GetValue();
+
+		image = 0xcbf29ce484222325ULL;
+		HashBytes(image, &size, sizeof(size));
+		HashBytes(image, &modified, sizeof(modified));
+	}
+
+	u64 hash = image;
+
+	const uptr anchors[] = { (uptr)&cpuRegs, (uptr)&recGetImm64, (uptr)eeMem, (uptr)vtlbdata.vmap };
+	HashBytes(hash, anchors, sizeof(anchors));
+
+	const u32 config[] = {
+		EmuConfig.Cpu.Recompiler.bitset,
+		EmuConfig.Cpu.sseMXCSR.bitmask,
+		EmuConfig.Cpu.sseVUMXCSR.bitmask,
+		EmuConfig.Speedhacks.bitset,
+		(u32)EmuConfig.Speedhacks.EECycleRate,
+		EmuConfig.Speedhacks.EECycleSkip,
+		EmuConfig.Gamefixes.bitset,
+		CHECK_FASTMEM && vtlb_GetFastmemBase() != NULL,
+	};
+	HashBytes(hash, config, sizeof(config));
+
+	return hash;
+}
+
+static void InsertBlock(u64 hash, CachedBlock&& block)
+{
+	if (s_blocks.count(hash) >= BLOCK_CACHE_MAX_VARIANTS)
+		return;
+
+	s_bytes += block.GetBytes();
+	s_blocks.emplace(hash, std::move(block));
+}
+
+// Everything that gets patched has to be inside of the code
+static bool IsValid(const CachedBlock& block)
+{
+	const size_t size = block.code.size();
+
+	for (const BlockCacheReloc& reloc : block.relocs)
+	{
+		if ((size_t)reloc.offset + 4 > size || reloc.type > BCRELOC_ConstAbsolute || reloc.sub >= 8)
+			return false;
+	}
+	for (const BlockCacheLink& link : block.links)
+	{
+		if ((size_t)link.offset + 4 > size)
+			return false;
+	}
+	for (const BlockCacheFastmem& site : block.fastmem)
+	{
+		if ((size_t)site.start + 10 > size || site.end > size || site.slowpath >= size)
+			return false;
+	}
+	for (const BlockCacheVtlb& lookup : block.vtlb)
+	{
+		if (lookup.page >= VTLB_VMAP_ITEMS)
+			return false;
+	}
+	return true;
+}
+
+template< typename T >
+static bool ReadVector(FILE* f, std::vector<T>& dest, u32 count)
+{
+	dest.resize(count);
+	return count == 0 || fread(dest.data(), sizeof(T), count, f) == count;
+}
+
+template< typename T >
+static bool WriteVector(FILE* f, const std::vector<T>& src)
+{
+	return src.empty() || fwrite(src.data(), sizeof(T), src.size(), f) == src.size();
+}
+
+static void LoadBlocks()
+{
+	FILE* f = wxFopen(s_filename, L"rb");
+	if (!f)
+		return;
+
+	BlockCacheHeader header;
+	bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == BLOCK_CACHE_MAGIC
+		&& header.version == BLOCK_CACHE_VERSION && header.environment == s_environment;
+
+	for (u32 i = 0; ok && i < header.count; i++)
+	{
+		BlockCacheRecord record;
+		CachedBlock block;
+
+		ok = fread(&record, sizeof(record), 1, f) == 1
+			&& record.endpc > record.startpc && record.endpc - record.startpc <= _64kb
+			&& record.guest == (record.endpc - record.startpc) / 4 && record.code != 0 && record.code < _64kb
+			&& record.relocs + record.links + record.fastmem + record.vtlb <= record.code
+			&& ReadVector(f, block.guest, record.guest) && ReadVector(f, block.code, record.code)
+			&& ReadVector(f, block.relocs, record.relocs) && ReadVector(f, block.links, record.links)
+			&& ReadVector(f, block.fastmem, record.fastmem) && ReadVector(f, block.vtlb, record.vtlb)
+			&& IsValid(block);
+
+		if (ok)
+		{
+			block.startpc = record.startpc;
+			block.endpc = record.endpc;
+			block.pc = record.pc;
+			block.split = record.split;
+			InsertBlock(HashBlock(block.startpc, block.endpc, block.guest.data()), std::move(block));
+		}
+	}
+	fclose(f);
+
+	if (!ok)
+	{
+		Console.Warning(L"(EErec) Discarding the block cache %s", WX_STR(s_filename));
+		s_blocks.clear();
+		s_bytes = 0;
+		return;
+	}
+
+	Console.WriteLn(Color_StrongGreen, L"(EErec) Loaded %u cached blocks from %s", (u32)s_blocks.size(), WX_STR(s_filename));
+}
+
+static void SaveBlocks()
+{
+	FILE* f = wxFopen(s_filename, L"wb");
+	if (!f)
+	{
+		Console.Warning(L"(EErec) Could not write the block cache %s", WX_STR(s_filename));
+		return;
+	}
+
+	BlockCacheHeader header = { BLOCK_CACHE_MAGIC, BLOCK_CACHE_VERSION, s_environment, (u32)s_blocks.size(), 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+	for (auto it = s_blocks.begin(); ok && it != s_blocks.end(); ++it)
+	{
+		const CachedBlock& block = it->second;
+		BlockCacheRecord record = {
+			block.startpc, block.endpc, block.pc, block.split,
+			(u32)block.guest.size(), (u32)block.code.size(), (u32)block.relocs.size(),
+			(u32)block.links.size(), (u32)block.fastmem.size(), (u32)block.vtlb.size()
+		};
+
+		ok = fwrite(&record, sizeof(record), 1, f) == 1
+			&& WriteVector(f, block.guest) && WriteVector(f, block.code) && WriteVector(f, block.relocs)
+			&& WriteVector(f, block.links) && WriteVector(f, block.fastmem) && WriteVector(f, block.vtlb);
+	}
+	fclose(f);
+
+	// a partial file would only be rejected next time
+	if (!ok)
+		wxRemoveFile(s_filename);
+}
+
+void recBlockCacheOpen(const wxString& filename)
+{
+	recBlockCacheAbort();
+
+	// the same ELF again keeps its blocks, unless the settings changed in between
+	if (filename == s_filename && (s_filename.IsEmpty() || GetEnvironment() == s_environment))
+		return;
+
+	if (s_dirty && !s_filename.IsEmpty())
+		SaveBlocks();
+
+	s_blocks.clear();
+	s_bytes = 0;
+	s_dirty = false;
+	s_filename = filename;
+
+	if (s_filename.IsEmpty() || !CHECK_EEREC || !CHECK_EEBLOCKCACHE)
+		return;
+
+	s_environment = GetEnvironment();
+	LoadBlocks();
+}
+
+void recBlockCacheClose()
+{
+	recBlockCacheOpen(wxEmptyString);
+}
+
+bool recBlockCacheUsable()
+{
+#ifdef __M_X86_64
+	if (s_filename.IsEmpty() || !CHECK_EEREC || !CHECK_EEBLOCKCACHE)
+		return false;
+
+	// breakpoints and friends emit calls to the debugger in the middle of blocks
+	if (CBreakPoints::GetNumBreakpoints() || CBreakPoints::GetNumMemchecks() || CTracepoints::IsActive()
+		|| CReverseExecution::IsCountingInstructions())
+		return false;
+
+	// clears the recompiler from inside of blocks
+	if (EmuConfig.Gamefixes.GoemonTlbHack)
+		return false;
+
+	// settings changed since the game started, the file is for the old ones
+	return GetEnvironment() == s_environment;
+#else
+	return false;
+#endif
+}
+
+static bool VtlbMatches(const CachedBlock& block)
+{
+	for (const BlockCacheVtlb& lookup : block.vtlb)
+	{
+		if (vtlbdata.vmap[lookup.page].raw() != (uptr)lookup.raw)
+			return false;
+	}
+	return true;
+}
+
+const CachedBlock* recBlockCacheFind(u32 startpc, u32 endpc, bool split)
+{
+	if (s_blocks.empty())
+		return NULL;
+
+	const u32* guest = (u32*)PSM(startpc);
+	auto range = s_blocks.equal_range(HashBlock(startpc, endpc, guest));
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const CachedBlock& block = it->second;
+		if (block.startpc != startpc || block.endpc != endpc || block.split != (u32)split)
+			continue;
+
+		if (memcmp(block.guest.data(), guest, endpc - startpc) || !VtlbMatches(block))
+			continue;
+
+		return &block;
+	}
+
+	return NULL;
+}
+
+bool recBlockCacheRestore(const CachedBlock& block, u8* dest)
+{
+	memcpy(dest, block.code.data(), block.code.size());
+
+	for (const BlockCacheReloc& reloc : block.relocs)
+	{
+		s32* field = (s32*)(dest + reloc.offset);
+		const u8* target;
+
+		if (reloc.type == BCRELOC_Relative)
+			target = (const u8*)(uptr)reloc.value;
+		else
+			target = (const u8*)recGetImm64((u32)(reloc.value >> 32), (u32)reloc.value) + reloc.sub;
+
+		sptr displacement = reloc.type == BCRELOC_ConstAbsolute ? (sptr)target : target - (dest + reloc.base);
+		if (displacement != (s32)displacement)
+			return false;
+
+		*field = (s32)displacement;
+	}
+
+	if (!block.fastmem.empty())
+	{
+		u8* base = vtlb_GetFastmemBase();
+		for (const BlockCacheFastmem& site : block.fastmem)
+		{
+			// mov rbx, imm64
+			*(u64*)(dest + site.start + 2) = (uptr)base;
+			vtlb_AddFastmemSite(dest + site.start, dest + site.end, dest + site.slowpath);
+		}
+	}
+
+	return true;
+}
+
+static void RecordField(s32* field, const u8* base)
+{
+	if (!s_recording)
+		return;
+
+	if (field)
+	{
+		s_fields.push_back({ field, base });
+		return;
+	}
+
+	// the emit pointer went back to base, whatever was recorded past it was overwritten
+	const u8* ptr = base;
+	s_fields.erase(std::remove_if(s_fields.begin(), s_fields.end(),
+		[ptr](const BlockCacheField& f) { return (u8*)f.field >= ptr; }), s_fields.end());
+	s_links.erase(std::remove_if(s_links.begin(), s_links.end(),
+		[ptr](const std::pair<s32*, u32>& link) { return (u8*)link.first >= ptr; }), s_links.end());
+
+	for (size_t i = 0; i < s_fastmem.size(); i += 3)
+	{
+		if (s_fastmem[i] >= ptr)
+		{
+			s_fastmem.resize(i);
+			break;
+		}
+	}
+}
+
+void recBlockCacheBegin(u32 startpc, u32 endpc, bool split)
+{
+	s_recording = true;
+	s_failed = s_bytes >= BLOCK_CACHE_MAX_BYTES;
+
+	s_block.startpc = startpc;
+	s_block.endpc = endpc;
+	s_block.split = split;
+
+	const u32* guest = (u32*)PSM(startpc);
+	s_block.guest.assign(guest, guest + (endpc - startpc) / 4);
+	s_block.vtlb.clear();
+
+	s_fields.clear();
+	s_links.clear();
+	s_consts.clear();
+	s_fastmem.clear();
+
+	x86RelativeFieldHook = RecordField;
+}
+
+void recBlockCacheAbort()
+{
+	s_recording = false;
+	x86RelativeFieldHook = NULL;
+}
+
+void recBlockCacheLink(s32* jumpptr, u32 pc)
+{
+	if (s_recording)
+		s_links.push_back(std::make_pair(jumpptr, pc));
+}
+
+void recBlockCacheConst(const u32* imm64)
+{
+	if (s_recording)
+		s_consts.push_back(imm64);
+}
+
+void recBlockCacheVtlbConst(u32 vaddr)
+{
+	if (!s_recording)
+		return;
+
+	const u32 page = vaddr >> VTLB_PAGE_BITS;
+	for (const BlockCacheVtlb& lookup : s_block.vtlb)
+	{
+		if (lookup.page == page)
+			return;
+	}
+
+	s_block.vtlb.push_back({ page, 0, (u64)vtlbdata.vmap[page].raw() });
+}
+
+void recBlockCacheFastmemSite(const u8* start, const u8* end, const u8* slowpath)
+{
+	if (!s_recording)
+		return;
+
+	s_fastmem.push_back(start);
+	s_fastmem.push_back(end);
+	s_fastmem.push_back(slowpath);
+}
+
+static const u32* FindConst(const u8* target)
+{
+	for (const u32* imm64 : s_consts)
+	{
+		if (target >= (const u8*)imm64 && target < (const u8*)(imm64 + 2))
+			return imm64;
+	}
+	return NULL;
+}
+
+void recBlockCacheEnd(const u8* code, const u8* end, u32 pc)
+{
+	if (!s_recording)
+		return;
+	recBlockCacheAbort();
+
+	if (s_failed)
+		return;
+
+	CachedBlock& block = s_block;
+	block.pc = pc;
+	block.code.assign(code, end);
+	block.relocs.clear();
+	block.links.clear();
+	block.fastmem.clear();
+
+	for (const std::pair<s32*, u32>& link : s_links)
+		block.links.push_back({ (u32)((u8*)link.first - code), link.second });
+
+	for (const BlockCacheField& rec : s_fields)
+	{
+		// linked through recBlocks
+		auto isLink = [&rec](const std::pair<s32*, u32>& link) { return link.first == rec.field; };
+		if (std::find_if(s_links.begin(), s_links.end(), isLink) != s_links.end())
+			continue;
+
+		const u8* target = rec.base ? rec.base + *rec.field : (const u8*)(sptr)*rec.field;
+
+		BlockCacheReloc reloc;
+		reloc.offset = (u8*)rec.field - code;
+		reloc.base = rec.base ? rec.base - code : 0;
+		reloc.sub = 0;
+
+		if (target >= code && target <= end)
+		{
+			// an absolute address of the block itself can't be moved
+			if (!rec.base)
+				return;
+			continue;
+		}
+		else if (const u32* imm64 = FindConst(target))
+		{
+			reloc.type = rec.base ? BCRELOC_Const : BCRELOC_ConstAbsolute;
+			reloc.sub = target - (const u8*)imm64;
+			reloc.value = ((u64)imm64[1] << 32) | imm64[0];
+		}
+		else if (rec.base)
+		{
+			reloc.type = BCRELOC_Relative;
+			reloc.value = (uptr)target;
+		}
+		else
+		{
+			// absolute addresses of the image and the VM stay valid
+			continue;
+		}
+
+		block.relocs.push_back(reloc);
+	}
+
+	for (size_t i = 0; i < s_fastmem.size(); i += 3)
+	{
+		// the window address is patched in, it has to be the mov rbx, imm64
+		if (s_fastmem[i][0] != 0x48 || s_fastmem[i][1] != 0xbb)
+			return;
+
+		block.fastmem.push_back({ (u32)(s_fastmem[i] - code), (u32)(s_fastmem[i + 1] - code), (u32)(s_fastmem[i + 2] - code) });
+	}
+
+	InsertBlock(HashBlock(block.startpc, block.endpc, block.guest.data()), std::move(block));
+	block = CachedBlock();
+	s_dirty = true;
+}
@@ -21,8 +21,12 @@
 
 #include "iCore.h"
 #include "iR5900.h"
+#include "iR5900BlockCache.h"
 #include "Utilities/Perf.h"
 
+#include <map>
+#include <vector>
+
 using namespace vtlb_private;
 using namespace x86Emitter;
 
@@ -153,12 +157,10 @@ namespace vtlb_private
 	// ------------------------------------------------------------------------
 	// Prepares eax, ecx, and, ebx for Direct or Indirect operations.
 	// Returns the writeback pointer for ebx (return address from indirect handling)
+	// Callers emit the memory profiler first, it dirties ebx as well.
 	//
 	static u32* DynGen_PrepRegs()
 	{
-		// Warning dirty ebx (in case someone got the very bad idea to move this code)
-		EE::Profiler.EmitMem();
-
 		xMOV( eax, arg1regd );
 		xSHR( eax, VTLB_PAGE_BITS );
 		xMOV( rax, ptrNative[xComplexAddress(rbx, vtlbdata.vmap, rax*wordsize)] );
@@ -169,34 +171,54 @@ namespace vtlb_private
 	}
 
 	// ------------------------------------------------------------------------
-	static void DynGen_DirectRead( u32 bits, bool sign )
+	// Fastmem accesses may fault half way and get redone by the slow path, so the 128 bit
+	// copy can't borrow an allocated xmm register. (The vtlb flush frees them anyway.)
+	static void DynGen_FastmemMOV128( const xIndirectVoid& destRm, const xIndirectVoid& srcRm )
+	{
+		if( _hasFreeXMMreg() )
+		{
+			iMOV128_SSE( destRm, srcRm );
+			return;
+		}
+
+		xMOV( rax, srcRm );
+		xMOV( destRm, rax );
+		xMOV( rax, srcRm+8 );
+		xMOV( destRm+8, rax );
+	}
+
+	// ------------------------------------------------------------------------
+	static void DynGen_DirectRead( u32 bits, bool sign, const xAddressVoid& addr, bool fastmem = false )
 	{
 		switch( bits )
 		{
 			case 8:
 				if( sign )
-					xMOVSX( eax, ptr8[arg1reg] );
+					xMOVSX( eax, ptr8[addr] );
 				else
-					xMOVZX( eax, ptr8[arg1reg] );
+					xMOVZX( eax, ptr8[addr] );
 			break;
 
 			case 16:
 				if( sign )
-					xMOVSX( eax, ptr16[arg1reg] );
+					xMOVSX( eax, ptr16[addr] );
 				else
-					xMOVZX( eax, ptr16[arg1reg] );
+					xMOVZX( eax, ptr16[addr] );
 			break;
 
 			case 32:
-				xMOV( eax, ptr[arg1reg] );
+				xMOV( eax, ptr[addr] );
 			break;
 
 			case 64:
-				iMOV64_Smart( ptr[arg2reg], ptr[arg1reg] );
+				iMOV64_Smart( ptr[arg2reg], ptr[addr] );
 			break;
 
 			case 128:
-				iMOV128_SSE( ptr[arg2reg], ptr[arg1reg] );
+				if( fastmem )
+					DynGen_FastmemMOV128( ptr[arg2reg], ptr[addr] );
+				else
+					iMOV128_SSE( ptr[arg2reg], ptr[addr] );
 			break;
 
 			jNO_DEFAULT
@@ -204,7 +226,7 @@ namespace vtlb_private
 	}
 
 	// ------------------------------------------------------------------------
-	static void DynGen_DirectWrite( u32 bits )
+	static void DynGen_DirectWrite( u32 bits, const xAddressVoid& addr, bool fastmem = false )
 	{
 		// TODO: x86Emitter can't use dil
 		switch(bits)
@@ -212,23 +234,26 @@ namespace vtlb_private
 			//8 , 16, 32 : data on EDX
 			case 8:
 				xMOV( edx, arg2regd );
-				xMOV( ptr[arg1reg], dl );
+				xMOV( ptr[addr], dl );
 			break;
 
 			case 16:
-				xMOV( ptr[arg1reg], xRegister16(arg2reg) );
+				xMOV( ptr[addr], xRegister16(arg2reg) );
 			break;
 
 			case 32:
-				xMOV( ptr[arg1reg], arg2regd );
+				xMOV( ptr[addr], arg2regd );
 			break;
 
 			case 64:
-				iMOV64_Smart( ptr[arg1reg], ptr[arg2reg] );
+				iMOV64_Smart( ptr[addr], ptr[arg2reg] );
 			break;
 
 			case 128:
-				iMOV128_SSE( ptr[arg1reg], ptr[arg2reg] );
+				if( fastmem )
+					DynGen_FastmemMOV128( ptr[addr], ptr[arg2reg] );
+				else
+					iMOV128_SSE( ptr[addr], ptr[arg2reg] );
 			break;
 		}
 	}
@@ -367,16 +392,160 @@ static void vtlb_SetWriteback(u32 *writeback)
 	*writeback = val;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+//                            Fastmem
+//
+// The access goes straight to the fastmem window, which maps the guest address space 1:1:
+//
+//    mov rbx, fastmem_base
+//    mov eax, [rbx+rcx]
+//
+// Anything the window doesn't map faults. The usual vtlb lookup for the access is emitted out
+// of line at the end of the block, the fault handler overwrites the start of the site with a
+// jump to it and resumes there. Most sites never fault, and the ones hitting hardware
+// registers only pay for it once.
+
+struct FastmemAccess
+{
+	u8* start;
+	u8* end;
+	int mode;
+	u32 bits;
+	bool sign;
+};
+
+struct FastmemSite
+{
+	u8* end;
+	u8* slowpath;
+};
+
+// sites of the block being compiled, waiting for their slow path
+static std::vector<FastmemAccess> s_fastmem_pending;
+
+// unpatched sites by start address, cleared along with the recompiler
+static std::map<uptr, FastmemSite> s_fastmem_sites;
+
+static bool DynGen_UseFastmem()
+{
+	return wordsize == 8 && CHECK_FASTMEM && vtlb_GetFastmemBase();
+}
+
+static void DynGen_FastmemAccess( int mode, u32 bits, bool sign )
+{
+	// Warning dirty ebx (the profiler uses it too)
+	EE::Profiler.EmitMem();
+
+	FastmemAccess access;
+	access.start = xGetPtr();
+	access.mode = mode;
+	access.bits = bits;
+	access.sign = sign;
+
+#ifdef __M_X86_64
+	xMOV64( rbx, (sptr)vtlb_GetFastmemBase() );
+#endif
+	if( mode )
+		DynGen_DirectWrite( bits, rbx + arg1reg, true );
+	else
+		DynGen_DirectRead( bits, sign, rbx + arg1reg, true );
+
+	access.end = xGetPtr();
+	pxAssert( access.end - access.start >= 5 );		// room for the jmp
+
+	s_fastmem_pending.push_back( access );
+}
+
+// Called once the block is done, emits the slow paths of its fastmem sites.
+void vtlb_DynGenFastmemSlowPaths()
+{
+	for( const FastmemAccess& access : s_fastmem_pending )
+	{
+		FastmemSite site;
+		site.end = access.end;
+		site.slowpath = xGetPtr();
+
+		EE::Profiler.EmitSlowMem();
+
+		u32* writeback = DynGen_PrepRegs();
+
+		DynGen_IndirectDispatch( access.mode, access.bits, access.sign && access.bits < 32 );
+		if( access.mode )
+			DynGen_DirectWrite( access.bits, arg1reg );
+		else
+			DynGen_DirectRead( access.bits, access.sign, arg1reg );
+
+		vtlb_SetWriteback(writeback);
+		xJMP( access.end );
+
+		s_fastmem_sites[(uptr)access.start] = site;
+		recBlockCacheFastmemSite( access.start, access.end, site.slowpath );
+	}
+
+	s_fastmem_pending.clear();
+}
+
+// From the page fault handler, pc is the faulting instruction. Returns where to resume, or 0
+// if the fault didn't come from a fastmem site.
+uptr vtlb_BackpatchFastmem( uptr pc )
+{
+	auto it = s_fastmem_sites.upper_bound( pc );
+	if( it == s_fastmem_sites.begin() )
+		return 0;
+	--it;
+
+	u8* start = (u8*)it->first;
+	const FastmemSite site = it->second;
+	if( pc >= (uptr)site.end )
+		return 0;
+
+	// jmp rel32, recMem is always writable
+	start[0] = 0xe9;
+	*(s32*)(start + 1) = (s32)(site.slowpath - (start + 5));
+
+	s_fastmem_sites.erase( it );
+	return (uptr)site.slowpath;
+}
+
+// For blocks restored from the persistent block cache
+void vtlb_AddFastmemSite( u8* start, u8* end, u8* slowpath )
+{
+	FastmemSite site;
+	site.end = end;
+	site.slowpath = slowpath;
+	s_fastmem_sites[(uptr)start] = site;
+}
+
+// The block they were waiting in was abandoned (an exception while compiling it), its code
+// is overwritten by the next one.
+void vtlb_DiscardFastmemSlowPaths()
+{
+	s_fastmem_pending.clear();
+}
+
+void vtlb_ResetFastmemSites()
+{
+	s_fastmem_pending.clear();
+	s_fastmem_sites.clear();
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 //                            Dynarec Load Implementations
 void vtlb_DynGenRead64(u32 bits)
 {
 	pxAssume( bits == 64 || bits == 128 );
 
+	if( DynGen_UseFastmem() )
+	{
+		DynGen_FastmemAccess( 0, bits, false );
+		return;
+	}
+
+	EE::Profiler.EmitMem();
 	u32* writeback = DynGen_PrepRegs();
 
 	DynGen_IndirectDispatch( 0, bits );
-	DynGen_DirectRead( bits, false );
+	DynGen_DirectRead( bits, false, arg1reg );
 
 	vtlb_SetWriteback(writeback);		// return target for indirect's call/ret
 }
@@ -389,10 +558,17 @@ void vtlb_DynGenRead32(u32 bits, bool sign)
 {
 	pxAssume( bits <= 32 );
 
+	if( DynGen_UseFastmem() )
+	{
+		DynGen_FastmemAccess( 0, bits, sign );
+		return;
+	}
+
+	EE::Profiler.EmitMem();
 	u32* writeback = DynGen_PrepRegs();
 
 	DynGen_IndirectDispatch( 0, bits, sign && bits < 32 );
-	DynGen_DirectRead( bits, sign );
+	DynGen_DirectRead( bits, sign, arg1reg );
 
 	vtlb_SetWriteback(writeback);
 }
@@ -403,6 +579,7 @@ void vtlb_DynGenRead32(u32 bits, bool sign)
 void vtlb_DynGenRead64_Const( u32 bits, u32 addr_const )
 {
 	EE::Profiler.EmitConstMem(addr_const);
+	recBlockCacheVtlbConst(addr_const);
 
 	auto vmv = vtlbdata.vmap[addr_const>>VTLB_PAGE_BITS];
 	if( !vmv.isHandler(addr_const) )
@@ -449,6 +626,7 @@ void vtlb_DynGenRead64_Const( u32 bits, u32 addr_const )
 void vtlb_DynGenRead32_Const( u32 bits, bool sign, u32 addr_const )
 {
 	EE::Profiler.EmitConstMem(addr_const);
+	recBlockCacheVtlbConst(addr_const);
 
 	auto vmv = vtlbdata.vmap[addr_const>>VTLB_PAGE_BITS];
 	if( !vmv.isHandler(addr_const) )
@@ -523,10 +701,17 @@ void vtlb_DynGenRead32_Const( u32 bits, bool sign, u32 addr_const )
 
 void vtlb_DynGenWrite(u32 sz)
 {
+	if( DynGen_UseFastmem() )
+	{
+		DynGen_FastmemAccess( 1, sz, false );
+		return;
+	}
+
+	EE::Profiler.EmitMem();
 	u32* writeback = DynGen_PrepRegs();
 
 	DynGen_IndirectDispatch( 1, sz );
-	DynGen_DirectWrite( sz );
+	DynGen_DirectWrite( sz, arg1reg );
 
 	vtlb_SetWriteback(writeback);
 }
@@ -539,6 +724,7 @@ void vtlb_DynGenWrite(u32 sz)
 void vtlb_DynGenWrite_Const( u32 bits, u32 addr_const )
 {
 	EE::Profiler.EmitConstMem(addr_const);
+	recBlockCacheVtlbConst(addr_const);
 
 	auto vmv = vtlbdata.vmap[addr_const>>VTLB_PAGE_BITS];
 	if( !vmv.isHandler(addr_const) )
@@ -82,9 +82,16 @@ void endMacroOp(int mode) {
 	microVU0.cop2 = 0;
 }
 
+// Hot blocks leave out the flag updates a later op overwrites before anything sees them
+static __fi int macroFlagMode(int mode) {
+	if ((mode & 0x10) && (g_pCurInstInfo->info & EEINSTINFO_DEADFLAGS)) return mode & ~0x10;
+	return mode;
+}
+
 #define REC_COP2_mVU0(f, opName, mode)						\
 	void recV##f() {										\
-		setupMacroOp(mode, opName);							\
+		const int flagMode = macroFlagMode(mode);			\
+		setupMacroOp(flagMode, opName);						\
 		if (mode & 4) {										\
 			mVU_##f(microVU0, 0);							\
 			if (!microVU0.prog.IRinfo.info[0].lOp.isNOP) {	\
@@ -92,7 +99,7 @@ void endMacroOp(int mode) {
 			}												\
 		}													\
 		else { mVU_##f(microVU0, 1); }						\
-		endMacroOp(mode);									\
+		endMacroOp(flagMode);								\
 	}
 
 #define INTERPRETATE_COP2_FUNC(f)							\
@@ -483,6 +490,36 @@ void rec_C2UNK() {
 // This is called by EE Recs to setup sVU info, this isn't needed for mVU Macro (cottonvibes)
 void _vuRegsCOP22(VURegs* VU, _VURegsNum* VUregsn) {}
 
+// Upper ops of the tables above which have mode 0x10 (index of SPECIAL1, or of SPECIAL2
+// where the layout is the same up to 0x30)
+static __fi bool macroWritesFlags(u32 op) {
+	if (op < 0x10) return true;								// ADD, SUB, MADD, MSUB bc
+	if (op < 0x18) return false;							// MAX, MINI bc / ITOF, FTOI
+	if (op < 0x20) return op <= 0x1c || op == 0x1e;			// MUL bc, MULq, MULi
+	if (op < 0x28) return true;								// ADD, MADD, SUB, MSUB q/i
+	if (op < 0x30) return op != 0x2b && op != 0x2f;			// ADD, MADD, MUL, SUB, MSUB, OPMSUB/OPMULA
+	return false;
+}
+
+COP2FlagUse _vuFlagsCOP2(u32 code) {
+	if (!(code & (0x10 << 21))) return COP2FLAGS_Read;		// transfers, CFC2 and BC2
+	const u32 funct = code & 0x3f;
+	if (funct < 0x3c) {
+		if (macroWritesFlags(funct)) return COP2FLAGS_Write;
+		// MAX, MINI and the integer ops; VCALLMS starts a micro program
+		if (funct < 0x36 && funct != 0x33) return COP2FLAGS_None;
+		return COP2FLAGS_Read;
+	}
+	const u32 op = (code & 3) | ((code >> 4) & 0x7c);
+	if (macroWritesFlags(op)) return COP2FLAGS_Write;
+	if (op < 0x30) return COP2FLAGS_None;					// ITOF, FTOI, ABS, CLIP, NOP
+	// MOVE, MR32, LQI..SQD, WAITQ, MTIR, MFIR, ILWR, ISWR, the R ops. DIV and friends set
+	// the D/I flags themselves.
+	if (op == 0x30 || op == 0x31 || (op >= 0x34 && op <= 0x37) || (op >= 0x3b && op <= 0x43))
+		return COP2FLAGS_None;
+	return COP2FLAGS_Read;
+}
+
 // Recompilation
 void (*recCOP2t[32])() = {
     rec_C2UNK,	   recQMFC2,      recCFC2,		 rec_C2UNK,		rec_C2UNK,	   recQMTC2,      recCTC2,       rec_C2UNK,